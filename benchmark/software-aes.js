@@ -0,0 +1,61 @@
+"use strict";
+// Compares the built-in constant-time software AES with OpenSSL's kernels.
+//
+// On CPUs with AES instructions, OpenSSL's generic table-based code (what
+// it runs on e.g. a Raspberry Pi 1) can be selected by hiding AES-NI and
+// PCLMULQDQ from it:
+//   OPENSSL_ia32cap="~0x200000200000000" node benchmark/software-aes.js
+
+const crypto = require("crypto");
+const aead = require("../");
+
+const SIZES = [16, 64, 256, 1024, 16384];
+const MIN_TIME_NS = 200e6;
+
+function measure(fn) {
+	// warm up, then repeat until enough time has passed
+	fn();
+	let iterations = 0;
+	const start = process.hrtime();
+	let elapsed;
+	do {
+		for (let i = 0; i < 100; i++) fn();
+		iterations += 100;
+		const diff = process.hrtime(start);
+		elapsed = diff[0] * 1e9 + diff[1];
+	} while (elapsed < MIN_TIME_NS);
+	return elapsed / iterations;
+}
+
+// The tuning may pick the built-in AES-NI kernels for some sizes, so the
+// OpenSSL column forces OpenSSL's kernels
+const tuning = aead.configureTuning();
+const openssl = tuning.buckets.map(() => "openssl");
+
+function run(name, fn) {
+	const results = {};
+	aead.configureTuning({ kernels: { gcm: openssl, ccm: openssl } });
+	aead.configureSoftwareAes(false);
+	results[false] = measure(fn);
+	aead.configureTuning({ kernels: tuning.kernels });
+	aead.configureSoftwareAes(true);
+	results[true] = measure(fn);
+	aead.configureSoftwareAes();
+	console.log(
+		name.padEnd(20) +
+		(results[false] / 1000).toFixed(2).padStart(12) + " µs" +
+		(results[true] / 1000).toFixed(2).padStart(12) + " µs" +
+		(results[false] / results[true]).toFixed(2).padStart(10) + "x"
+	);
+}
+
+const key = crypto.randomBytes(16);
+const aad = crypto.randomBytes(16);
+console.log("".padEnd(20) + "OpenSSL".padStart(15) + "software".padStart(15) + "speedup".padStart(11));
+for (const size of SIZES) {
+	const plaintext = crypto.randomBytes(size);
+	const gcmIv = crypto.randomBytes(12);
+	const ccmIv = crypto.randomBytes(13);
+	run("gcm.encrypt " + size, () => aead.gcm.encrypt(key, gcmIv, plaintext, aad));
+	run("ccm.encrypt " + size, () => aead.ccm.encrypt(key, ccmIv, plaintext, aad, 16));
+}
@@ -1,10 +1,53 @@
 {
+    "variables": {
+        # build with libsodium's AES-256-GCM as an additional backend:
+        # node-gyp rebuild -- -Dwith_libsodium=true
+        "with_libsodium%": "false"
+    },
     "targets": [
         {
             "target_name": "node-aead-crypto",
             "sources": [
                 "src/node-aes-ccm.cc",
                 "src/node-aes-gcm.cc",
+                "src/node-aead-keyring.cc",
+                "src/node-aead-async.cc",
+                "src/node-aead-ring.cc",
+                "src/node-aead-fixed.cc",
+                "src/node-aead-trial.cc",
+                "src/aead-key.cc",
+                "src/aead-backend.cc",
+                "src/aead-backend-openssl.cc",
+                "src/aead-backend-builtin.cc",
+                "src/aead-backend-sodium.cc",
+                "src/aead-epoch.cc",
+                "src/aead-keyring.cc",
+                "src/aead-nonce.cc",
+                "src/aead-random.cc",
+                "src/aead-replay.cc",
+                "src/aead-reuse.cc",
+                "src/aead-pool.cc",
+                "src/aead-scheduler.cc",
+                "src/aead-dispatch.cc",
+                "src/aead-tuning.cc",
+                "src/aead-parallel.cc",
+                "src/aead-gcm-parallel.cc",
+                "src/aead-ccm-parallel.cc",
+                "src/aead-cpu.cc",
+                "src/aead-capabilities.cc",
+                "src/aead-aesni.cc",
+                "src/aead-gcm-multi.cc",
+                "src/aead-ccm-multi.cc",
+                "src/aead-ccm-format.cc",
+                "src/aead-gcm-small.cc",
+                "src/aead-ccm-small.cc",
+                "src/aead-gcm-wide.cc",
+                "src/aead-fixed.cc",
+                "src/aead-gcm-verify.cc",
+                "src/aead-trial.cc",
+                "src/aead-soft-aes.cc",
+                "src/aead-soft.cc",
+                "src/aead-ring.cc",
                 "src/addon.cc"
             ],
             'include_dirs' : [
@@ -16,6 +59,14 @@
                         'uint=unsigned int',
                     ],
                 }],
+                [ 'with_libsodium=="true"', {
+                    'defines': [
+                        'AEAD_WITH_LIBSODIUM',
+                    ],
+                    'libraries': [
+                        '-lsodium',
+                    ],
+                }],
             ],
         }
     ]
@@ -1,17 +1,507 @@
 /// <reference types="node" />
+import { EventEmitter } from "events";
 export interface EncryptionResult {
     ciphertext: Buffer;
     auth_tag: Buffer;
 }
+export interface RandomIvEncryptionResult extends EncryptionResult {
+    /** The generated IV */
+    iv: Buffer;
+}
 export interface DecryptionResult {
     plaintext: Buffer;
     auth_ok: boolean;
 }
+export interface VerifiedDecryptionResult {
+    /** null if the auth tag doesn't match */
+    plaintext: Buffer | null;
+    auth_ok: boolean;
+}
+/**
+ * A dedicated entry point for one configuration, named aes<key bits>_<IV bytes>_<tag bytes>.
+ * The key, IV and auth tag must have exactly these lengths.
+ */
+export interface FixedCipher {
+    encrypt(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null): EncryptionResult;
+    /** For CCM, a plaintext that failed authentication is zeroed */
+    decrypt(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer): DecryptionResult;
+}
+export type Callback<T> = (error: Error | null, result: T) => void;
+/**
+ * One operation of a batch: [encrypt, iv, data, aad, authTag]. When encrypting,
+ * the last element is the optional auth tag length instead of the tag.
+ */
+export type BatchOperation =
+    [true, Buffer, Buffer, Buffer | null | undefined, number | undefined] |
+    [false, Buffer, Buffer, Buffer | null | undefined, Buffer];
+/** Per operation, the result or the Error it failed with */
+export type BatchResult = (EncryptionResult | DecryptionResult | Error)[];
+/** Scheduling of an async job on the crypto thread pool */
+export interface ScheduleOptions {
+    /** Tenants share the pool fairly by bytes processed. Default: "default" */
+    tenant?: string | number;
+    /** Milliseconds after which the job fails instead of running (further) */
+    timeout?: number;
+}
 export namespace ccm {
     export function encrypt(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer, authTagLength: number): EncryptionResult;
+    /** Generates a random nonce of 7 to 13 bytes */
+    export function encrypt(key: Buffer, ivLength: number, plaintext: Buffer, aad: Buffer, authTagLength: number): RandomIvEncryptionResult;
     export function decrypt(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer, authTag: Buffer): DecryptionResult;
+    /** Runs on the crypto thread pool. The buffers must not be modified until the callback is called */
+    export function encryptAsync(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, authTagLength: number, callback: Callback<EncryptionResult>): void;
+    export function encryptAsync(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, authTagLength: number, options: ScheduleOptions, callback: Callback<EncryptionResult>): void;
+    export function decryptAsync(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, callback: Callback<DecryptionResult>): void;
+    export function decryptAsync(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, options: ScheduleOptions, callback: Callback<DecryptionResult>): void;
+    /** Without a callback, calls with the same key Buffer are batched into one job */
+    export function encryptAsync(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, authTagLength: number, options?: ScheduleOptions): Promise<EncryptionResult>;
+    export function decryptAsync(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, options?: ScheduleOptions): Promise<DecryptionResult>;
+    /** Runs several operations with one key as a single job on the crypto thread pool */
+    export function batchAsync(key: Buffer, operations: BatchOperation[], callback: Callback<BatchResult>): void;
+    export function batchAsync(key: Buffer, operations: BatchOperation[], options: ScheduleOptions, callback: Callback<BatchResult>): void;
+    /**
+     * Like encryptAsync, but messages below a cutoff measured at runtime are processed
+     * inline, where that is faster than the thread pool. The result is always delivered asynchronously.
+     */
+    export function encryptAuto(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, authTagLength: number, callback: Callback<EncryptionResult>): void;
+    export function encryptAuto(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, authTagLength: number, options: ScheduleOptions, callback: Callback<EncryptionResult>): void;
+    export function encryptAuto(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, authTagLength: number, options?: ScheduleOptions): Promise<EncryptionResult>;
+    export function decryptAuto(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, callback: Callback<DecryptionResult>): void;
+    export function decryptAuto(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, options: ScheduleOptions, callback: Callback<DecryptionResult>): void;
+    export function decryptAuto(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, options?: ScheduleOptions): Promise<DecryptionResult>;
+    export const aes128_13_8: FixedCipher;
+    export const aes128_12_16: FixedCipher;
+    export const aes128_12_8: FixedCipher;
 }
 export namespace gcm {
     export function encrypt(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer): EncryptionResult;
+    /** Generates a random IV of 12 to 16 bytes */
+    export function encrypt(key: Buffer, ivLength: number, plaintext: Buffer, aad: Buffer): RandomIvEncryptionResult;
     export function decrypt(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer, authTag: Buffer): DecryptionResult;
-}
\ No newline at end of file
+    /**
+     * Checks the auth tag before decrypting, so a forged message only costs
+     * the hash over its AAD and ciphertext and no plaintext is made for it
+     */
+    export function decryptVerified(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer): VerifiedDecryptionResult;
+    /** Runs on the crypto thread pool. The buffers must not be modified until the callback is called */
+    export function encryptAsync(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, callback: Callback<EncryptionResult>): void;
+    export function encryptAsync(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, options: ScheduleOptions, callback: Callback<EncryptionResult>): void;
+    export function decryptAsync(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, callback: Callback<DecryptionResult>): void;
+    export function decryptAsync(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, options: ScheduleOptions, callback: Callback<DecryptionResult>): void;
+    /** Without a callback, calls with the same key Buffer are batched into one job */
+    export function encryptAsync(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, options?: ScheduleOptions): Promise<EncryptionResult>;
+    export function decryptAsync(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, options?: ScheduleOptions): Promise<DecryptionResult>;
+    /** Runs several operations with one key as a single job on the crypto thread pool */
+    export function batchAsync(key: Buffer, operations: BatchOperation[], callback: Callback<BatchResult>): void;
+    export function batchAsync(key: Buffer, operations: BatchOperation[], options: ScheduleOptions, callback: Callback<BatchResult>): void;
+    /**
+     * Like encryptAsync, but messages below a cutoff measured at runtime are processed
+     * inline, where that is faster than the thread pool. The result is always delivered asynchronously.
+     */
+    export function encryptAuto(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, callback: Callback<EncryptionResult>): void;
+    export function encryptAuto(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, options: ScheduleOptions, callback: Callback<EncryptionResult>): void;
+    export function encryptAuto(key: Buffer, iv: Buffer, plaintext: Buffer, aad: Buffer | null, options?: ScheduleOptions): Promise<EncryptionResult>;
+    export function decryptAuto(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, callback: Callback<DecryptionResult>): void;
+    export function decryptAuto(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, options: ScheduleOptions, callback: Callback<DecryptionResult>): void;
+    export function decryptAuto(key: Buffer, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, options?: ScheduleOptions): Promise<DecryptionResult>;
+    /**
+     * Detects IVs reused with the same key among roughly the last `capacity` encryptions
+     * (probabilistically, with about 0.1% false positives). A capacity of 0 disables detection.
+     * It covers encrypt(), encryptAsync(), batchAsync() and the encrypt() of aes128_12_16 and
+     * aes256_12_16. If reject is set, those throw or fail for reused IVs.
+     */
+    export function setNonceReuseDetection(capacity: number, reject?: boolean): void;
+    /** The number of reused IVs detected since detection was enabled */
+    export function getNonceReuseCount(): number;
+    export const aes128_12_16: FixedCipher;
+    export const aes256_12_16: FixedCipher;
+}
+export type KeyMode = "gcm" | "ccm";
+/** A frame for batch decryption: [keyId, iv, ciphertext, aad, authTag] */
+export type KeyringFrame = [number, Buffer, Buffer, Buffer | null, Buffer];
+/** A frame for batch decryption with a replay window: [keyId, iv, ciphertext, aad, authTag, sequenceNumber] */
+export type SequencedKeyringFrame = [number, Buffer, Buffer, Buffer | null, Buffer, number | bigint];
+export interface ReuseDetectionOptions {
+    /** Number of recent nonces to remember. Default: 65536 */
+    capacity?: number;
+    /** Make encrypt() and seal() throw for reused nonces. Default: false */
+    reject?: boolean;
+}
+export interface KeyLimits {
+    /** Number of encryptions after which a "rotate" event is emitted */
+    softMessages?: number | bigint;
+    /**
+     * Number of encryptions after which encrypting throws.
+     * Default: 2^32 for GCM keys with random nonces, otherwise unlimited
+     */
+    hardMessages?: number | bigint;
+    /** Bytes (plaintext and additional data) after which a "rotate" event is emitted */
+    softBytes?: number | bigint;
+    /** Bytes (plaintext and additional data) after which encrypting throws */
+    hardBytes?: number | bigint;
+}
+/** 64 bit counters, BigInts where supported */
+export interface KeyUsage {
+    messages: bigint | number;
+    bytes: bigint | number;
+}
+export interface KeyOptions {
+    /** Usage limits, counted by encrypt() and seal() */
+    limits?: KeyLimits;
+    /** Detect reused nonces (probabilistically, with about 0.1% false positives) */
+    reuseDetection?: boolean | ReuseDetectionOptions;
+    /**
+     * How seal() generates nonces: "sequence" (requires fixedField) or "random".
+     * Default: "sequence" if a fixed field is given
+     */
+    nonce?: "sequence" | "random";
+    /** Length of random nonces: 12 to 16 (default 12) for GCM, 7 to 13 (default 13) for CCM keys */
+    nonceLength?: number;
+    /**
+     * Enables seal()/open() with deterministic nonces fixedField || 64 bit counter
+     * (RFC 5116, section 3.2). At most 8 bytes for GCM and 5 bytes for CCM keys.
+     */
+    fixedField?: Buffer;
+    /** Counter value for the first nonce, e.g. as persisted from getNonceCounter(). Default: 0 */
+    counter?: number | bigint;
+    /**
+     * The implementation used for this key, one of getBackends() or "auto" (the default).
+     * Operations the backend can't do, like libsodium with IVs other than 12 bytes,
+     * fall back to OpenSSL.
+     */
+    backend?: string;
+}
+export interface KeyringDecryptionResult {
+    /** null if the key ID is unknown or the IV / tag length doesn't fit the key */
+    plaintext: Buffer | null;
+    auth_ok: boolean;
+    /** Set if the replay window rejected the frame without decrypting it */
+    replayed?: boolean;
+}
+/**
+ * Native key store which keeps expanded key schedules for each key ID.
+ * Emits "rotate" (keyId, usage) from the encrypting call that reaches a soft limit,
+ * or shortly after a CryptoRing encryption reaches it.
+ */
+export class Keyring extends EventEmitter {
+    /** Pass the result of share() to use another thread's keyring */
+    constructor(shared?: SharedArrayBuffer);
+    readonly size: number;
+    /**
+     * Returns a handle which can be posted to worker threads. The keys are
+     * shared, not copied, and freed once no thread references them anymore.
+     * Requires Node.js 14+.
+     */
+    share(): SharedArrayBuffer;
+    /** Adds a key or replaces (rotates) the key with the same ID */
+    set(keyId: number, mode: KeyMode, key: Buffer, options?: KeyOptions): void;
+    delete(keyId: number): boolean;
+    has(keyId: number): boolean;
+    /** The auth tag length defaults to 16 and is required for CCM keys */
+    encrypt(keyId: number, iv: Buffer, plaintext: Buffer, aad: Buffer | null, authTagLength?: number): EncryptionResult;
+    decrypt(keyId: number, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer): DecryptionResult;
+    /** Like encrypt(), but runs on the crypto thread pool */
+    encryptAsync(keyId: number, iv: Buffer, plaintext: Buffer, aad: Buffer | null, callback: Callback<EncryptionResult>): void;
+    encryptAsync(keyId: number, iv: Buffer, plaintext: Buffer, aad: Buffer | null, authTagLength: number | undefined, callback: Callback<EncryptionResult>): void;
+    encryptAsync(keyId: number, iv: Buffer, plaintext: Buffer, aad: Buffer | null, options: ScheduleOptions, callback: Callback<EncryptionResult>): void;
+    encryptAsync(keyId: number, iv: Buffer, plaintext: Buffer, aad: Buffer | null, authTagLength: number | undefined, options: ScheduleOptions, callback: Callback<EncryptionResult>): void;
+    /** Like decrypt(), but runs on the crypto thread pool */
+    decryptAsync(keyId: number, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, callback: Callback<DecryptionResult>): void;
+    decryptAsync(keyId: number, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, options: ScheduleOptions, callback: Callback<DecryptionResult>): void;
+    /** Without a callback, calls with the same key are batched into one job */
+    encryptAsync(keyId: number, iv: Buffer, plaintext: Buffer, aad: Buffer | null, authTagLength?: number, options?: ScheduleOptions): Promise<EncryptionResult>;
+    encryptAsync(keyId: number, iv: Buffer, plaintext: Buffer, aad: Buffer | null, options: ScheduleOptions): Promise<EncryptionResult>;
+    decryptAsync(keyId: number, iv: Buffer, ciphertext: Buffer, aad: Buffer | null, authTag: Buffer, options?: ScheduleOptions): Promise<DecryptionResult>;
+    /** Runs several operations with one key as a single job on the crypto thread pool */
+    batchAsync(keyId: number, operations: BatchOperation[], callback: Callback<BatchResult>): void;
+    batchAsync(keyId: number, operations: BatchOperation[], options: ScheduleOptions, callback: Callback<BatchResult>): void;
+    decryptBatch(frames: KeyringFrame[]): KeyringDecryptionResult[];
+    /** Skips frames the window has seen and advances it with frames that pass authentication */
+    decryptBatch(frames: SequencedKeyringFrame[], replayWindow: ReplayWindow): KeyringDecryptionResult[];
+    /**
+     * Encrypts with the next nonce of the key and returns nonce || ciphertext || authTag.
+     * Throws once the nonce counter is exhausted.
+     */
+    seal(keyId: number, plaintext: Buffer, aad: Buffer | null, authTagLength?: number): Buffer;
+    /** Decrypts a frame created by seal() */
+    open(keyId: number, frame: Buffer, aad: Buffer | null, authTagLength?: number): DecryptionResult;
+    /** The counter the next nonce will use. A BigInt where supported. Throws for random nonces */
+    getNonceCounter(keyId: number): bigint | number;
+    /** The number of reused nonces detected for the key */
+    getNonceReuseCount(keyId: number): number;
+    /** The usage counters of the key; cheap enough to poll */
+    usage(keyId: number): KeyUsage;
+    on(event: "rotate", listener: (keyId: number, usage: KeyUsage) => void): this;
+}
+/** Anti-replay bitmap over the sequence numbers of a session (RFC 6479 style) */
+export class ReplayWindow {
+    /** The number of sequence numbers below the highest one to track: 64 (default) to 4096 */
+    constructor(size?: number);
+    readonly size: number;
+    /** The highest sequence number seen. A BigInt where supported */
+    readonly highest: bigint | number;
+    /** Whether the sequence number is new and not too old */
+    check(sequenceNumber: number | bigint): boolean;
+    /** Marks the sequence number as seen. Only call this for authenticated frames */
+    update(sequenceNumber: number | bigint): void;
+}
+export interface CryptoRingOptions {
+    /** Entries of each ring, a power of two from 2 to 65536. Default: 256 */
+    entries?: number;
+    /** Bytes in the data region requests point into. Default: 1048576 */
+    dataSize?: number;
+    /** Pin the poller thread to this CPU (Linux only) */
+    cpu?: number;
+    /** Microseconds the poller keeps spinning after the last request before it sleeps. Default: 50 */
+    idle?: number;
+}
+/**
+ * Submission and completion rings in shared memory, served by a dedicated poller thread
+ * which encrypts and decrypts with the keys of a keyring. Requires Node.js 14 or newer.
+ */
+export class CryptoRing {
+    static readonly ENCRYPT: 0;
+    static readonly DECRYPT: 1;
+    static readonly OK: 0;
+    static readonly AUTH_FAILED: 1;
+    static readonly INVALID: -1;
+    static readonly NO_KEY: -2;
+    static readonly BAD_PARAMS: -3;
+    static readonly LIMIT_REACHED: -4;
+    static readonly NONCE_REUSED: -5;
+
+    constructor(keyring: Keyring, options?: CryptoRingOptions);
+    readonly entries: number;
+    /** The data region; all offsets are relative to it */
+    readonly data: Buffer;
+    /**
+     * Queues an operation. The output has the length of the input; encryption writes the
+     * auth tag at tagOffset, decryption checks it. Returns false if the ring is full
+     */
+    submit(
+        op: 0 | 1, keyId: number, userData: number,
+        ivOffset: number, ivLength: number,
+        inputOffset: number, inputLength: number,
+        aadOffset: number, aadLength: number,
+        outputOffset: number,
+        tagOffset: number, tagLength: number,
+    ): boolean;
+    /** Calls the callback for each completed operation and returns how many there were */
+    reap(callback: (userData: number, status: number) => void): number;
+    /** The number of completed operations not reaped yet */
+    pending(): number;
+    /** Blocks until there are completions or the timeout (ms) has passed */
+    wait(timeout?: number): boolean;
+    /** Stops the poller */
+    close(): void;
+}
+export interface PoolOptions {
+    /** Number of worker threads. Unchanged if omitted; initially one per CPU */
+    threads?: number;
+    /** Pin each worker to one CPU (Linux only). Unchanged if omitted; initially false */
+    pin?: boolean;
+    /** The CPUs to pin the workers to, round robin. Implies pin. Default: all CPUs of the process */
+    cpus?: number[];
+    /**
+     * GCM messages are processed in slices of this many bytes, so other jobs can run in between.
+     * Unchanged if omitted; initially 262144
+     */
+    chunkSize?: number;
+    /**
+     * gcm.encrypt and gcm.decrypt split messages of at least this many bytes across the pool.
+     * ccm.encrypt and ccm.decrypt run the CTR keystream of such messages on the pool, while
+     * the calling thread computes the CBC-MAC. 0 disables splitting. Unchanged if omitted
+     * (configureTuning and autotune may have set it); initially 4194304
+     */
+    parallelThreshold?: number;
+}
+export interface PoolInfo {
+    threads: number;
+    pinned: boolean;
+    chunkSize: number;
+    parallelThreshold: number;
+}
+/**
+ * Configures the native thread pool used by the async functions. It is separate from
+ * libuv's thread pool and shared by all threads of the process. The workers are only
+ * restarted if threads, pin or cpus change.
+ */
+export function configurePool(options?: PoolOptions): PoolInfo;
+export interface CoalescingOptions {
+    /** Microseconds to wait for more calls before submitting a batch. Default: 0, the end of the event loop turn */
+    window?: number;
+    /** Batches are submitted right away once they reach this size. Default: 1024 */
+    maxBatch?: number;
+}
+/** Configures how promise-style async calls are batched */
+export function configureCoalescing(options?: CoalescingOptions): Required<CoalescingOptions>;
+export interface TenantStats {
+    /** Jobs started */
+    jobs: number;
+    /** Jobs failed because their timeout passed */
+    dropped: number;
+    /** Jobs waiting right now */
+    queued: number;
+    /** Average and maximum time from submission until a job started, in ms */
+    waitAvg: number;
+    waitMax: number;
+}
+/**
+ * Queueing statistics of the async jobs per tenant, optionally resetting them.
+ * Once 1024 tenants are known, idle tenants are dropped along with their statistics.
+ */
+export function getSchedulerStats(reset?: boolean): { [tenant: string]: TenantStats };
+export interface ModeEstimates {
+    /** Messages up to this many bytes (plaintext and aad) are processed inline */
+    cutoff: number;
+    fixedNs: number;
+    perByteNs: number;
+}
+/** The cost model behind the auto functions */
+export function getDispatchEstimates(): { dispatchNs: number; gcm: ModeEstimates; ccm: ModeEstimates };
+/**
+ * Chooses between OpenSSL and the built-in constant-time software AES, which is used by
+ * default where the CPU is known to lack AES instructions (e.g. the Raspberry Pi 1), since
+ * OpenSSL falls back to lookup tables there. true forces software AES, false forces OpenSSL,
+ * undefined restores the default. Returns whether software AES is used now.
+ */
+export function configureSoftwareAes(enabled?: boolean): boolean;
+/**
+ * gcm and ccm functions taking raw keys keep the expanded keys of the last 4 keys each
+ * thread used, including copies of the keys. This wipes the calling thread's copies;
+ * pool threads wipe theirs whenever they run out of work.
+ */
+export function clearKeyCache(): void;
+/**
+ * The backends compiled in, for the backend key option: "openssl" (OpenSSL's EVP interface),
+ * "builtin" (the built-in AES-NI and software kernels) and, in builds with
+ * with_libsodium=true, "libsodium" (AES-256-GCM only).
+ */
+export function getBackends(): string[];
+export interface CpuFeatures {
+    aesni: boolean;
+    pclmulqdq: boolean;
+    ssse3: boolean;
+    sse41: boolean;
+    /** The 256 and 512 bit extensions are only reported if the OS saves the wider registers */
+    avx: boolean;
+    avx2: boolean;
+    vaes: boolean;
+    vpclmulqdq: boolean;
+    avx512f: boolean;
+    /** Whether the CPU is known to lack AES instructions (x86 without AES-NI, ARM Linux without the crypto extension) */
+    aesMissing: boolean;
+}
+/**
+ * "software", "aesni" or "vaes" for the built-in kernels, or "openssl-aesni", "openssl-vpaes",
+ * "openssl-generic" (lookup tables) or "openssl-unknown"
+ */
+export type Implementation = string;
+export interface Capabilities {
+    cpu: CpuFeatures;
+    openssl: {
+        /** The OpenSSL the addon runs on, e.g. "OpenSSL 3.0.13 30 Jan 2024" */
+        version: string;
+        versionNumber: number;
+        /** The provider serving AES-GCM, e.g. "default" or "fips"; null before OpenSSL 3.0 */
+        provider: string | null;
+        /** OpenSSL's AES code path, as far as the CPU decides it */
+        aes: "aesni" | "vpaes" | "generic" | "unknown";
+        /** Whether Node.js uses the system's OpenSSL instead of its bundled copy */
+        system: boolean;
+    };
+    /** Whether the built-in software AES replaces OpenSSL, see configureSoftwareAes() */
+    softwareAes: boolean;
+    backends: string[];
+    /**
+     * What gcm.encrypt()/ccm.encrypt() and friends run, per message size bucket (see
+     * TuningInfo.buckets), with 12 byte IVs for GCM. All key sizes take the same path.
+     */
+    implementations: Record<"gcm" | "ccm", BucketImplementation[]>;
+}
+export interface BucketImplementation {
+    /** The largest message of the bucket; null for the last, unbounded one */
+    maxLength: number | null;
+    implementation: Implementation;
+    /**
+     * Messages of the bucket from minLength bytes on are split across the crypto thread pool
+     * (see parallelThreshold) and run on OpenSSL; null if none are
+     */
+    parallel: { minLength: number; implementation: Implementation } | null;
+}
+/** Reports the detected CPU features, the linked OpenSSL and the implementation each mode and message size uses */
+export function getCapabilities(): Capabilities;
+export type Kernel = "auto" | "builtin" | "openssl";
+export interface TuningOptions {
+    /** The kernel per message size bucket, see TuningInfo.buckets */
+    kernels?: { gcm?: Kernel[]; ccm?: Kernel[] };
+    /** Like the pool option, without restarting the pool */
+    parallelThreshold?: number;
+    /** The smallest chunk a large message is split into, at least 16384. Default: 262144 */
+    parallelChunkSize?: number;
+    /** Starting points for the cost model behind the auto functions, as from getDispatchEstimates() */
+    estimates?: { dispatchNs?: number; gcm?: Partial<ModeEstimates>; ccm?: Partial<ModeEstimates> };
+}
+export interface TuningInfo {
+    /** The largest message of each size bucket; null for the last, unbounded one */
+    buckets: (number | null)[];
+    kernels: { gcm: Kernel[]; ccm: Kernel[] };
+    parallelThreshold: number;
+    parallelChunkSize: number;
+}
+/**
+ * Sets the host-dependent settings the autotuner measures. "auto" kernels use the built-in
+ * kernels where they are known to beat OpenSSL. Forced software AES still takes precedence.
+ */
+export function configureTuning(options?: TuningOptions): TuningInfo;
+export interface TuningProfile {
+    version: number;
+    /** The kind of host the profile applies to */
+    host: { arch: string; cpu: string; cpus: number; modules: string; openssl: string };
+    created: string;
+    kernels: { gcm: Kernel[]; ccm: Kernel[] };
+    parallelThreshold: number;
+    parallelChunkSize: number;
+    maxBatch: number;
+    estimates: { dispatchNs: number; gcm: ModeEstimates; ccm: ModeEstimates };
+}
+export interface CalibrationOptions {
+    /** Milliseconds spent measuring each case. Default: 20 */
+    timePerCase?: number;
+}
+export interface AutotuneOptions extends CalibrationOptions {
+    /** Where the profile is loaded from and saved to */
+    profile?: string;
+    /** Measure again even if the saved profile fits this host */
+    recalibrate?: boolean;
+}
+/**
+ * Applies the saved profile if it was measured on this kind of host, otherwise measures the
+ * kernels, the parallel threshold and chunk size, the coalescing batch size and the dispatch
+ * costs (a few seconds), applies the result and saves it.
+ */
+export function autotune(options?: AutotuneOptions): Promise<TuningProfile>;
+/** Measures like autotune(), without applying or saving the result */
+export function calibrate(options?: CalibrationOptions): Promise<TuningProfile>;
+/** Returns false and changes nothing if the profile was measured on another kind of host */
+export function applyTuningProfile(profile: TuningProfile): boolean;
+/** Reads and applies a saved profile; null if there is none or it doesn't fit this host */
+export function loadTuningProfile(path: string): TuningProfile | null;
+export function saveTuningProfile(path: string, profile: TuningProfile): void;
+/** A frame for trial decryption, which doesn't say which key it belongs to: [iv, ciphertext, aad, authTag] */
+export type TrialFrame = [Buffer, Buffer, Buffer | null, Buffer];
+export interface TrialDecryptionResult {
+    /** Index of the first candidate that authenticates the frame, -1 if none does */
+    index: number;
+    /** Only the matching key decrypts; null if none matched */
+    plaintext: Buffer | null;
+    auth_ok: boolean;
+}
+/**
+ * Tries the candidate keys, all in one mode (default "gcm"), until one authenticates the frame.
+ * GCM candidates are only authenticated, several at a time; many candidates are split across
+ * the crypto thread pool. Candidates whose mode doesn't allow the IV and tag lengths are skipped.
+ */
+export function trialDecrypt(frame: TrialFrame, keys: Buffer[], options?: { mode?: KeyMode }): TrialDecryptionResult;
+/** Tries the keyring's keys with the given IDs, each in its own mode; unknown IDs are skipped */
+export function trialDecrypt(frame: TrialFrame, keyring: Keyring, options: { keyIds: number[] }): TrialDecryptionResult;
@@ -1,12 +1,124 @@
+var EventEmitter = require("events").EventEmitter;
 var binding = require("bindings")("node-aead-crypto.node");
+var coalesced = require("./lib/coalescer").create(binding);
+var CryptoRing = require("./lib/ring").create(binding);
+var tuner = require("./lib/tuner").create(binding, coalesced);
+
+// Keyrings emit "rotate" events when a key reaches a soft usage limit
+Object.setPrototypeOf(binding.Keyring.prototype, EventEmitter.prototype);
+
+// Without a callback, the async functions return a promise and are
+// batched with other calls using the same key
+function withPromise(callbackStyle, promiseStyle) {
+    return function () {
+        if (typeof arguments[arguments.length - 1] === "function") {
+            return callbackStyle.apply(this, arguments);
+        }
+        return promiseStyle.apply(this, arguments);
+    };
+}
+// The auto functions process small messages inline and return the result,
+// or submit them to the thread pool like the async functions. Either way
+// the result is delivered asynchronously, by callback or promise.
+function autoDispatch(native) {
+    return function () {
+        var args = Array.prototype.slice.call(arguments);
+        var callback = args[args.length - 1];
+        var promise;
+        if (typeof callback !== "function") {
+            promise = new Promise(function (resolve, reject) {
+                callback = function (err, result) {
+                    if (err) reject(err);
+                    else resolve(result);
+                };
+            });
+            args.push(callback);
+        }
+        var result;
+        try {
+            result = native.apply(this, args);
+        } catch (e) {
+            if (!promise) throw e;
+            callback(e);
+            return promise;
+        }
+        if (result !== undefined) process.nextTick(callback, null, result);
+        return promise;
+    };
+}
+
+// Adds what only Node.js knows: whether the OpenSSL it exports to the addon
+// is the system's instead of its bundled copy
+function getCapabilities() {
+    var capabilities = binding.GetCapabilities();
+    var shared = process.config.variables.node_shared_openssl;
+    capabilities.openssl.system = shared === true || shared === "true";
+    capabilities.backends = binding.GetBackends();
+    return capabilities;
+}
+
+// Decrypts a frame [iv, ciphertext, aad, authTag] that doesn't say which key
+// it belongs to with the first candidate that authenticates it: one of the
+// keys in an array, all in options.mode, or of the keyring's keys with the
+// IDs in options.keyIds
+function trialDecrypt(frame, candidates, options) {
+    if (!Array.isArray(frame) || frame.length < 4) {
+        throw new TypeError("The frame must be [iv, ciphertext, aad, authTag].");
+    }
+    options = options || {};
+    return binding.TrialDecrypt(frame[0], frame[1], frame[2], frame[3], candidates,
+        candidates instanceof binding.Keyring ? options.keyIds : options.mode);
+}
+
+binding.Keyring.prototype.encryptAsync = withPromise(binding.Keyring.prototype.encryptAsync, coalesced.keyring.encrypt);
+binding.Keyring.prototype.decryptAsync = withPromise(binding.Keyring.prototype.decryptAsync, coalesced.keyring.decrypt);
 
 module.exports = {
     ccm: {
         encrypt: binding.CcmEncrypt,
         decrypt: binding.CcmDecrypt,
+        encryptAsync: withPromise(binding.CcmEncryptAsync, coalesced.ccm.encrypt),
+        decryptAsync: withPromise(binding.CcmDecryptAsync, coalesced.ccm.decrypt),
+        batchAsync: binding.CcmBatchAsync,
+        encryptAuto: autoDispatch(binding.CcmEncryptAuto),
+        decryptAuto: autoDispatch(binding.CcmDecryptAuto),
+        // dedicated entry points for common configurations:
+        // aes<key bits>_<nonce bytes>_<tag bytes>
+        aes128_13_8: { encrypt: binding.CcmEncryptAes128_13_8, decrypt: binding.CcmDecryptAes128_13_8 },
+        aes128_12_16: { encrypt: binding.CcmEncryptAes128_12_16, decrypt: binding.CcmDecryptAes128_12_16 },
+        aes128_12_8: { encrypt: binding.CcmEncryptAes128_12_8, decrypt: binding.CcmDecryptAes128_12_8 },
     },
     gcm: {
         encrypt: binding.GcmEncrypt,
         decrypt: binding.GcmDecrypt,
-    }
+        // checks the tag before decrypting; no plaintext if it doesn't match
+        decryptVerified: binding.GcmDecryptVerified,
+        encryptAsync: withPromise(binding.GcmEncryptAsync, coalesced.gcm.encrypt),
+        decryptAsync: withPromise(binding.GcmDecryptAsync, coalesced.gcm.decrypt),
+        batchAsync: binding.GcmBatchAsync,
+        encryptAuto: autoDispatch(binding.GcmEncryptAuto),
+        decryptAuto: autoDispatch(binding.GcmDecryptAuto),
+        setNonceReuseDetection: binding.GcmSetNonceReuseDetection,
+        getNonceReuseCount: binding.GcmGetNonceReuseCount,
+        aes128_12_16: { encrypt: binding.GcmEncryptAes128_12_16, decrypt: binding.GcmDecryptAes128_12_16 },
+        aes256_12_16: { encrypt: binding.GcmEncryptAes256_12_16, decrypt: binding.GcmDecryptAes256_12_16 },
+    },
+    Keyring: binding.Keyring,
+    ReplayWindow: binding.ReplayWindow,
+    CryptoRing: CryptoRing,
+    configurePool: binding.ConfigurePool,
+    configureCoalescing: coalesced.configure,
+    getSchedulerStats: binding.GetSchedulerStats,
+    getDispatchEstimates: binding.GetDispatchEstimates,
+    configureSoftwareAes: binding.ConfigureSoftwareAes,
+    clearKeyCache: binding.ClearKeyCache,
+    getBackends: binding.GetBackends,
+    getCapabilities: getCapabilities,
+    configureTuning: binding.ConfigureTuning,
+    autotune: tuner.autotune,
+    calibrate: tuner.calibrate,
+    applyTuningProfile: tuner.apply,
+    loadTuningProfile: tuner.load,
+    saveTuningProfile: tuner.save,
+    trialDecrypt: trialDecrypt,
 }
\ No newline at end of file
@@ -0,0 +1,204 @@
+"use strict";
+
+// Packs the promise-returning async calls made close together into one
+// native batch job per key: calls made within the same event loop turn
+// (or within a configurable window) share one thread pool submission and
+// one completion callback instead of paying for them individually.
+
+const DEFAULT_MAX_BATCH = 1024;
+
+function Coalescer() {
+	// microseconds to wait for more calls; 0 flushes at the end of the turn
+	this.window = 0;
+	this.maxBatch = DEFAULT_MAX_BATCH;
+	this.groups = new Map();
+	this.keyringIds = new WeakMap();
+	this.nextKeyringId = 0;
+	this.bufferIds = new WeakMap();
+	this.nextBufferId = 0;
+	this.scheduled = false;
+}
+
+Coalescer.prototype.configure = function (options) {
+	options = options || {};
+	if (options.window !== undefined) {
+		if (typeof options.window !== "number" || !(options.window >= 0)) {
+			throw new TypeError("The coalescing window must be a non-negative number of microseconds.");
+		}
+		this.window = options.window;
+	}
+	if (options.maxBatch !== undefined) {
+		if (!Number.isInteger(options.maxBatch) || options.maxBatch < 1) {
+			throw new TypeError("The maximum batch size must be a positive integer.");
+		}
+		this.maxBatch = options.maxBatch;
+	}
+	return { window: this.window, maxBatch: this.maxBatch };
+};
+
+// Queues one operation [encrypt, iv, data, auth_data, auth_tag] for the batch
+// identified by id. submit(ops, callback) starts the native batch job.
+Coalescer.prototype.add = function (id, submit, op) {
+	const self = this;
+	return new Promise(function (resolve, reject) {
+		let group = self.groups.get(id);
+		if (group === undefined) {
+			group = { submit: submit, ops: [], resolvers: [] };
+			self.groups.set(id, group);
+		}
+		group.ops.push(op);
+		group.resolvers.push({ resolve: resolve, reject: reject });
+		if (group.ops.length >= self.maxBatch) {
+			self.groups.delete(id);
+			run(group);
+		} else {
+			self.schedule();
+		}
+	});
+};
+
+Coalescer.prototype.schedule = function () {
+	if (this.scheduled) return;
+	this.scheduled = true;
+	const self = this;
+	const flush = function () {
+		self.scheduled = false;
+		self.flush();
+	};
+	if (this.window === 0) {
+		setImmediate(flush);
+	} else if (this.window < 1000) {
+		// timers have millisecond resolution: keep yielding to the event
+		// loop until the window has passed
+		const start = process.hrtime();
+		const poll = function () {
+			const elapsed = process.hrtime(start);
+			if (elapsed[0] * 1e6 + elapsed[1] / 1e3 >= self.window) flush();
+			else setImmediate(poll);
+		};
+		setImmediate(poll);
+	} else {
+		setTimeout(flush, this.window / 1000);
+	}
+};
+
+Coalescer.prototype.flush = function () {
+	const groups = this.groups;
+	this.groups = new Map();
+	groups.forEach(run);
+};
+
+// Identifies a keyring object in batch IDs
+Coalescer.prototype.keyringId = function (keyring) {
+	let id = this.keyringIds.get(keyring);
+	if (id === undefined) {
+		id = this.nextKeyringId++;
+		this.keyringIds.set(keyring, id);
+	}
+	return id;
+};
+
+// Identifies a key in group IDs by the buffer object, so the key bytes
+// aren't copied into strings
+Coalescer.prototype.bufferId = function (key) {
+	if (!Buffer.isBuffer(key)) return "v" + String(key);
+	let id = this.bufferIds.get(key);
+	if (id === undefined) {
+		id = this.nextBufferId++;
+		this.bufferIds.set(key, id);
+	}
+	return "b" + id;
+};
+
+function run(group) {
+	const resolvers = group.resolvers;
+	const done = function (err, results) {
+		for (let i = 0; i < resolvers.length; i++) {
+			if (err) resolvers[i].reject(err);
+			else if (results[i] instanceof Error) resolvers[i].reject(results[i]);
+			else resolvers[i].resolve(results[i]);
+		}
+	};
+	try {
+		group.submit(group.ops, done);
+	} catch (e) {
+		done(e);
+	}
+}
+
+// Batches are split by the scheduling options, as those apply to a whole job
+function optionsId(options) {
+	return options ? options.tenant + "\u0000" + options.timeout : "";
+}
+
+// Returns the promise-based variants of the async functions, which are
+// used when no callback is passed
+function create(binding) {
+	const coalescer = new Coalescer();
+
+	function submitWithKey(batchAsync, key, options) {
+		return function (ops, callback) {
+			if (options === undefined) batchAsync(key, ops, callback);
+			else batchAsync(key, ops, options, callback);
+		};
+	}
+
+	return {
+		configure: coalescer.configure.bind(coalescer),
+		ccm: {
+			encrypt: function (key, iv, plaintext, aad, authTagLength, options) {
+				return coalescer.add(
+					"ccm\u0000" + coalescer.bufferId(key) + "\u0000" + optionsId(options),
+					submitWithKey(binding.CcmBatchAsync, key, options),
+					[true, iv, plaintext, aad, authTagLength]
+				);
+			},
+			decrypt: function (key, iv, ciphertext, aad, authTag, options) {
+				return coalescer.add(
+					"ccm\u0000" + coalescer.bufferId(key) + "\u0000" + optionsId(options),
+					submitWithKey(binding.CcmBatchAsync, key, options),
+					[false, iv, ciphertext, aad, authTag]
+				);
+			},
+		},
+		gcm: {
+			encrypt: function (key, iv, plaintext, aad, options) {
+				return coalescer.add(
+					"gcm\u0000" + coalescer.bufferId(key) + "\u0000" + optionsId(options),
+					submitWithKey(binding.GcmBatchAsync, key, options),
+					[true, iv, plaintext, aad, undefined]
+				);
+			},
+			decrypt: function (key, iv, ciphertext, aad, authTag, options) {
+				return coalescer.add(
+					"gcm\u0000" + coalescer.bufferId(key) + "\u0000" + optionsId(options),
+					submitWithKey(binding.GcmBatchAsync, key, options),
+					[false, iv, ciphertext, aad, authTag]
+				);
+			},
+		},
+		keyring: {
+			// called with the keyring as this
+			encrypt: function (keyId, iv, plaintext, aad, authTagLength, options) {
+				if (authTagLength !== null && typeof authTagLength === "object") {
+					options = authTagLength;
+					authTagLength = undefined;
+				}
+				return coalescer.add(
+					"keyring\u0000" + coalescer.keyringId(this) + "\u0000" + keyId + "\u0000" + optionsId(options),
+					submitWithKey(this.batchAsync.bind(this), keyId, options),
+					[true, iv, plaintext, aad, authTagLength]
+				);
+			},
+			decrypt: function (keyId, iv, ciphertext, aad, authTag, options) {
+				return coalescer.add(
+					"keyring\u0000" + coalescer.keyringId(this) + "\u0000" + keyId + "\u0000" + optionsId(options),
+					submitWithKey(this.batchAsync.bind(this), keyId, options),
+					[false, iv, ciphertext, aad, authTag]
+				);
+			},
+		},
+	};
+}
+
+module.exports = { create: create };
@@ -0,0 +1,140 @@
+"use strict";
+
+// JS side of the shared-memory crypto rings (see src/aead-ring.h).
+// Requests are written straight into the submission ring and results are
+// read from the completion ring, so the hot path makes no native calls and
+// allocates nothing. The addon is only called to wake up a sleeping poller.
+
+// Word indices of the header fields
+const SQ_HEAD = 0;
+const SQ_TAIL = 16;
+const CQ_HEAD = 32;
+const CQ_TAIL = 48;
+const FLAGS = 64;
+const HEADER_WORDS = 80;
+const FLAG_NEED_WAKEUP = 1;
+
+const SQE_WORDS = 16;
+const CQE_WORDS = 2;
+
+// The poller can't notify Atomics.wait() callers, so wait() sleeps in
+// growing steps between these bounds (in ms)
+const MIN_WAIT_STEP = 0.01;
+const MAX_WAIT_STEP = 1;
+
+function create(binding) {
+	function CryptoRing(keyring, options) {
+		const native = new binding.CryptoRing(keyring, options);
+		this.native = native;
+		this.entries = native.entries;
+		this.mask = native.entries - 1;
+		// Int32Array, because Atomics.wait() only accepts those
+		this.header = new Int32Array(native.buffer, 0, HEADER_WORDS);
+		this.sq = new Uint32Array(native.buffer, native.sqOffset, native.entries * SQE_WORDS);
+		this.cq = new Uint32Array(native.buffer, native.cqOffset, native.entries * CQE_WORDS);
+		// the region requests point into
+		this.data = Buffer.from(native.buffer, native.dataOffset, native.dataSize);
+		// local copies of the indices only we write
+		this.sqTail = 0;
+		this.cqHead = 0;
+	}
+
+	// Queues an operation on the data region and returns false if the
+	// submission ring is full. The output has the length of the input.
+	// Encryption writes the auth tag at tagOffset, decryption checks it.
+	CryptoRing.prototype.submit = function (
+		op, keyId, userData,
+		ivOffset, ivLength,
+		inputOffset, inputLength,
+		aadOffset, aadLength,
+		outputOffset,
+		tagOffset, tagLength
+	) {
+		const head = Atomics.load(this.header, SQ_HEAD) >>> 0;
+		if (((this.sqTail - head) >>> 0) >= this.entries) return false;
+
+		const sq = this.sq;
+		const i = (this.sqTail & this.mask) * SQE_WORDS;
+		sq[i] = op;
+		sq[i + 1] = keyId;
+		sq[i + 2] = userData;
+		sq[i + 3] = ivOffset;
+		sq[i + 4] = ivLength;
+		sq[i + 5] = inputOffset;
+		sq[i + 6] = inputLength;
+		sq[i + 7] = aadOffset;
+		sq[i + 8] = aadLength;
+		sq[i + 9] = outputOffset;
+		sq[i + 10] = tagOffset;
+		sq[i + 11] = tagLength;
+
+		// publishing the tail orders the writes above before it; reading the
+		// flag afterwards pairs with the poller setting it before it sleeps
+		this.sqTail = (this.sqTail + 1) >>> 0;
+		Atomics.store(this.header, SQ_TAIL, this.sqTail | 0);
+		if (Atomics.load(this.header, FLAGS) & FLAG_NEED_WAKEUP) this.native.wakeup();
+		return true;
+	};
+
+	// Calls callback(userData, status) for every completed operation and
+	// returns how many there were
+	CryptoRing.prototype.reap = function (callback) {
+		const tail = Atomics.load(this.header, CQ_TAIL) >>> 0;
+		const cq = this.cq;
+		let count = 0;
+		try {
+			while (this.cqHead !== tail) {
+				const i = (this.cqHead & this.mask) * CQE_WORDS;
+				const userData = cq[i];
+				const status = cq[i + 1] | 0;
+				this.cqHead = (this.cqHead + 1) >>> 0;
+				count++;
+				callback(userData, status);
+			}
+		} finally {
+			// frees the entries for the poller, even if the callback threw
+			Atomics.store(this.header, CQ_HEAD, this.cqHead | 0);
+		}
+		return count;
+	};
+
+	// Completed operations not reaped yet
+	CryptoRing.prototype.pending = function () {
+		return (Atomics.load(this.header, CQ_TAIL) - this.cqHead) >>> 0;
+	};
+
+	// Blocks until there are completions to reap or the timeout (in ms,
+	// optional) has passed. Returns whether there are completions.
+	CryptoRing.prototype.wait = function (timeout) {
+		const deadline = timeout === undefined ? Infinity : Date.now() + timeout;
+		let step = MIN_WAIT_STEP;
+		for (;;) {
+			const tail = Atomics.load(this.header, CQ_TAIL);
+			if ((tail >>> 0) !== this.cqHead) return true;
+			const remaining = deadline - Date.now();
+			if (remaining <= 0) return false;
+			Atomics.wait(this.header, CQ_TAIL, tail, Math.min(step, remaining));
+			step = Math.min(step * 2, MAX_WAIT_STEP);
+		}
+	};
+
+	// Stops the poller; operations it has not started are dropped
+	CryptoRing.prototype.close = function () {
+		this.native.close();
+	};
+
+	CryptoRing.ENCRYPT = 0;
+	CryptoRing.DECRYPT = 1;
+	// completion statuses
+	CryptoRing.OK = 0;
+	CryptoRing.AUTH_FAILED = 1;
+	CryptoRing.INVALID = -1;
+	CryptoRing.NO_KEY = -2;
+	CryptoRing.BAD_PARAMS = -3;
+	CryptoRing.LIMIT_REACHED = -4;
+	CryptoRing.NONCE_REUSED = -5;
+
+	return CryptoRing;
+}
+
+module.exports = { create: create };
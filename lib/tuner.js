@@ -0,0 +1,316 @@
+"use strict";
+
+// Opt-in calibration of the settings whose best values depend on the host:
+// the kernel per mode and message size bucket, when and how finely large
+// messages are split across the crypto thread pool, the batch size of the
+// promise-based async calls and the starting point of the inline/pool cost
+// model. The results form a profile, which can be saved as a JSON file and
+// applied by later starts without measuring again, as long as they run on
+// the same kind of host.
+
+const crypto = require("crypto");
+const fs = require("fs");
+const os = require("os");
+
+const PROFILE_VERSION = 1;
+// Representative message sizes of the kernel buckets (see src/aead-tuning.h)
+const BUCKET_SIZES = [64, 1 << 10, 16 << 10, 256 << 10, 1 << 20];
+// Candidates for the parallel threshold and chunk size
+const PARALLEL_SIZES = [256 << 10, 512 << 10, 1 << 20, 2 << 20, 4 << 20, 8 << 20, 16 << 20];
+const CHUNK_SIZES = [64 << 10, 128 << 10, 256 << 10, 512 << 10, 1 << 20];
+const CHUNK_MESSAGE = 8 << 20;
+// Candidates for the coalescer's maximum batch size
+const BATCH_SIZES = [16, 64, 256, 1024];
+const BATCH_MESSAGES = 4096;
+// Messages run through the pool one by one to train the cost model
+const TRAINING_SIZES = [64, 4096];
+const TRAINING_MESSAGES = 64;
+// An alternative must be this much faster to be chosen, so noise doesn't
+// flip the choice between otherwise equal options
+const MIN_GAIN = 0.05;
+// Default time spent measuring each case, in ms
+const DEFAULT_TIME_PER_CASE = 20;
+
+function now() {
+	const time = process.hrtime();
+	return time[0] * 1e9 + time[1];
+}
+
+// Returns the average ns per call of fn, called for at least ms milliseconds
+function measure(fn, ms) {
+	// warm up, then check the time every few calls
+	fn();
+	const budget = ms * 1e6;
+	const start = now();
+	let iterations = 0;
+	let elapsed;
+	do {
+		for (let i = 0; i < 4; i++) fn();
+		iterations += 4;
+		elapsed = now() - start;
+	} while (elapsed < budget);
+	return elapsed / iterations;
+}
+
+// Returns a function handing out a new IV per call: a random prefix and a
+// counter. Repeating one key/IV pair thousands of times would trip the
+// application's gcm.setNonceReuseDetection().
+function ivSequence(length) {
+	const prefix = crypto.randomBytes(length);
+	let counter = 0;
+	return () => {
+		const iv = Buffer.from(prefix);
+		iv.writeUInt32BE(counter, length - 4);
+		counter = (counter + 1) >>> 0;
+		return iv;
+	};
+}
+
+function faster(candidate, reference) {
+	return candidate < reference * (1 - MIN_GAIN);
+}
+
+// Identifies the kind of host a profile was measured on
+function describeHost(binding) {
+	const cpus = os.cpus();
+	return {
+		arch: process.arch,
+		cpu: cpus.length > 0 ? cpus[0].model : "",
+		cpus: cpus.length,
+		modules: process.versions.modules,
+		openssl: binding.GetCapabilities().openssl.version,
+	};
+}
+
+function sameHost(host, expected) {
+	return host !== null && typeof host === "object" &&
+		Object.keys(expected).every((name) => host[name] === expected[name]);
+}
+
+// Compares the built-in kernels with OpenSSL for each mode and size bucket
+function calibrateKernels(binding, ms) {
+	const kernels = { gcm: [], ccm: [] };
+	const backends = binding.GetBackends();
+	// forced software AES takes precedence over the kernel choice
+	const comparable = !binding.GetCapabilities().softwareAes &&
+		backends.indexOf("builtin") !== -1 && backends.indexOf("openssl") !== -1;
+	const key = crypto.randomBytes(16);
+	// 12 bytes leave CCM room for messages up to 16 MiB
+	const iv = crypto.randomBytes(12);
+	for (const mode of ["gcm", "ccm"]) {
+		const keyring = new binding.Keyring();
+		keyring.set(1, mode, key, { backend: "builtin" });
+		keyring.set(2, mode, key, { backend: "openssl" });
+		for (const size of BUCKET_SIZES) {
+			if (!comparable) {
+				kernels[mode].push("auto");
+				continue;
+			}
+			const plaintext = crypto.randomBytes(size);
+			const builtin = measure(() => keyring.encrypt(1, iv, plaintext, null, 16), ms);
+			const openssl = measure(() => keyring.encrypt(2, iv, plaintext, null, 16), ms);
+			kernels[mode].push(faster(builtin, openssl) ? "builtin" : faster(openssl, builtin) ? "openssl" : "auto");
+		}
+	}
+	return kernels;
+}
+
+// Finds the best chunk size for splitting large messages across the pool,
+// and the smallest message size from which splitting pays off
+function calibrateParallel(binding, ms) {
+	const previous = binding.ConfigureTuning();
+	const key = crypto.randomBytes(16);
+	const iv = ivSequence(12);
+	const data = crypto.randomBytes(PARALLEL_SIZES[PARALLEL_SIZES.length - 1]);
+	try {
+		let chunkSize = previous.parallelChunkSize;
+		let best = Infinity;
+		const message = data.slice(0, CHUNK_MESSAGE);
+		for (const size of CHUNK_SIZES) {
+			binding.ConfigureTuning({ parallelThreshold: 1, parallelChunkSize: size });
+			const time = measure(() => binding.GcmEncrypt(key, iv(), message, null), ms);
+			if (time < best) {
+				best = time;
+				chunkSize = size;
+			}
+		}
+
+		// from the largest size down, as long as splitting is faster
+		let threshold = 0;
+		binding.ConfigureTuning({ parallelChunkSize: chunkSize });
+		for (let i = PARALLEL_SIZES.length - 1; i >= 0; i--) {
+			const plaintext = data.slice(0, PARALLEL_SIZES[i]);
+			binding.ConfigureTuning({ parallelThreshold: 0 });
+			const serial = measure(() => binding.GcmEncrypt(key, iv(), plaintext, null), ms);
+			binding.ConfigureTuning({ parallelThreshold: 1 });
+			const split = measure(() => binding.GcmEncrypt(key, iv(), plaintext, null), ms);
+			if (!faster(split, serial)) break;
+			threshold = PARALLEL_SIZES[i];
+		}
+		return { parallelThreshold: threshold, parallelChunkSize: chunkSize };
+	} finally {
+		binding.ConfigureTuning({
+			parallelThreshold: previous.parallelThreshold,
+			parallelChunkSize: previous.parallelChunkSize,
+		});
+	}
+}
+
+// Runs a batch of promise-based encryptions per candidate batch size and
+// resolves to the fastest one
+function calibrateBatch(coalesced) {
+	const previous = coalesced.configure();
+	const key = crypto.randomBytes(16);
+	const iv = ivSequence(12);
+	const plaintext = crypto.randomBytes(64);
+
+	function run(maxBatch) {
+		coalesced.configure({ window: 0, maxBatch: maxBatch });
+		const start = now();
+		const promises = [];
+		for (let i = 0; i < BATCH_MESSAGES; i++) promises.push(coalesced.gcm.encrypt(key, iv(), plaintext, null));
+		return Promise.all(promises).then(() => now() - start);
+	}
+
+	let best = Infinity;
+	let maxBatch = previous.maxBatch;
+	// the first run warms up the pool
+	let chain = run(BATCH_SIZES[0]);
+	for (const size of BATCH_SIZES) {
+		chain = chain.then(() => run(size)).then((time) => {
+			if (time < best) {
+				best = time;
+				maxBatch = size;
+			}
+		});
+	}
+	return chain.then(
+		() => {
+			coalesced.configure(previous);
+			return maxBatch;
+		},
+		(err) => {
+			coalesced.configure(previous);
+			throw err;
+		}
+	);
+}
+
+// Sends messages through the pool one at a time, so the cost model learns
+// this host's dispatch latency and per-byte costs, and resolves to them
+function trainEstimates(binding) {
+	const key = crypto.randomBytes(16);
+	const gcmIv = ivSequence(12);
+	const ccmIv = ivSequence(13);
+	let chain = Promise.resolve();
+	for (const size of TRAINING_SIZES) {
+		const plaintext = crypto.randomBytes(size);
+		for (let i = 0; i < TRAINING_MESSAGES; i++) {
+			chain = chain.then(() => new Promise((resolve, reject) => {
+				binding.GcmEncryptAsync(key, gcmIv(), plaintext, null, (err) => err ? reject(err) : resolve());
+			})).then(() => new Promise((resolve, reject) => {
+				binding.CcmEncryptAsync(key, ccmIv(), plaintext, null, 16, (err) => err ? reject(err) : resolve());
+			}));
+		}
+	}
+	return chain.then(() => binding.GetDispatchEstimates());
+}
+
+function create(binding, coalesced) {
+	// Applies a profile measured on this kind of host; returns false and
+	// changes nothing otherwise
+	function apply(profile) {
+		if (profile === null || typeof profile !== "object" || profile.version !== PROFILE_VERSION ||
+			!sameHost(profile.host, describeHost(binding))
+		) {
+			return false;
+		}
+		binding.ConfigureTuning({
+			kernels: profile.kernels,
+			parallelThreshold: profile.parallelThreshold,
+			parallelChunkSize: profile.parallelChunkSize,
+			estimates: profile.estimates,
+		});
+		coalesced.configure({ maxBatch: profile.maxBatch });
+		return true;
+	}
+
+	// Measures all settings and resolves to a profile, without applying it
+	function calibrate(options) {
+		options = options || {};
+		const ms = options.timePerCase !== undefined ? options.timePerCase : DEFAULT_TIME_PER_CASE;
+		if (typeof ms !== "number" || !(ms > 0)) {
+			return Promise.reject(new TypeError("The time per case must be a positive number of milliseconds."));
+		}
+		const profile = {
+			version: PROFILE_VERSION,
+			host: describeHost(binding),
+			created: new Date().toISOString(),
+		};
+		try {
+			profile.kernels = calibrateKernels(binding, ms);
+			const parallel = calibrateParallel(binding, ms);
+			profile.parallelThreshold = parallel.parallelThreshold;
+			profile.parallelChunkSize = parallel.parallelChunkSize;
+		} catch (e) {
+			return Promise.reject(e);
+		}
+		return calibrateBatch(coalesced).then((maxBatch) => {
+			profile.maxBatch = maxBatch;
+			return trainEstimates(binding);
+		}).then((estimates) => {
+			profile.estimates = estimates;
+			return profile;
+		});
+	}
+
+	// Reads and applies a saved profile; returns it, or null if the file
+	// doesn't exist or was measured on another kind of host
+	function load(path) {
+		let profile;
+		try {
+			profile = JSON.parse(fs.readFileSync(path, "utf8"));
+		} catch (e) {
+			if (e.code === "ENOENT" || e instanceof SyntaxError) return null;
+			throw e;
+		}
+		return apply(profile) ? profile : null;
+	}
+
+	function save(path, profile) {
+		fs.writeFileSync(path, JSON.stringify(profile, null, "\t") + "\n");
+	}
+
+	// Applies the profile saved at options.profile if it fits this host, or
+	// calibrates, applies and saves a new one
+	function autotune(options) {
+		options = options || {};
+		if (options.profile !== undefined && typeof options.profile !== "string") {
+			return Promise.reject(new TypeError("The profile must be a file path."));
+		}
+		if (options.profile !== undefined && !options.recalibrate) {
+			let profile;
+			try {
+				profile = load(options.profile);
+			} catch (e) {
+				return Promise.reject(e);
+			}
+			if (profile !== null) return Promise.resolve(profile);
+		}
+		return calibrate(options).then((profile) => {
+			apply(profile);
+			if (options.profile !== undefined) save(options.profile, profile);
+			return profile;
+		});
+	}
+
+	return {
+		apply: apply,
+		calibrate: calibrate,
+		load: load,
+		save: save,
+		autotune: autotune,
+	};
+}
+
+module.exports = { create: create };
@@ -1,6 +1,11 @@
 #include <nan.h>
 #include "node-aes-ccm.h"
 #include "node-aes-gcm.h"
+#include "node-aead-keyring.h"
+#include "node-aead-async.h"
+#include "node-aead-fixed.h"
+#include "node-aead-ring.h"
+#include "node-aead-trial.h"
 
 using namespace v8;
 using namespace node;
@@ -16,6 +21,26 @@ NAN_MODULE_INIT(InitAll) {
         Nan::New<String>("CcmDecrypt").ToLocalChecked(),
         Nan::GetFunction(Nan::New<FunctionTemplate>(ccm::Decrypt)).ToLocalChecked()
     );
+	Nan::Set(target, 
+        Nan::New<String>("CcmEncryptAsync").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(ccm::EncryptAsync)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("CcmDecryptAsync").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(ccm::DecryptAsync)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("CcmBatchAsync").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(ccm::BatchAsync)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("CcmEncryptAuto").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(ccm::EncryptAuto)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("CcmDecryptAuto").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(ccm::DecryptAuto)).ToLocalChecked()
+    );
 
 	Nan::Set(target, 
         Nan::New<String>("GcmEncrypt").ToLocalChecked(),
@@ -25,6 +50,82 @@ NAN_MODULE_INIT(InitAll) {
         Nan::New<String>("GcmDecrypt").ToLocalChecked(),
         Nan::GetFunction(Nan::New<FunctionTemplate>(gcm::Decrypt)).ToLocalChecked()
     );
+	Nan::Set(target, 
+        Nan::New<String>("GcmDecryptVerified").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(gcm::DecryptVerified)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GcmEncryptAsync").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(gcm::EncryptAsync)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GcmDecryptAsync").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(gcm::DecryptAsync)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GcmBatchAsync").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(gcm::BatchAsync)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GcmEncryptAuto").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(gcm::EncryptAuto)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GcmDecryptAuto").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(gcm::DecryptAuto)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GcmSetNonceReuseDetection").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(gcm::SetNonceReuseDetection)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GcmGetNonceReuseCount").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(gcm::GetNonceReuseCount)).ToLocalChecked()
+    );
+
+	fixed::Init(target);
+
+	keyring::KeyringWrap::Init(target);
+	keyring::ReplayWindowWrap::Init(target);
+	ring::RingWrap::Init(target);
+
+	Nan::Set(target, 
+        Nan::New<String>("ConfigurePool").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(async::ConfigurePool)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GetSchedulerStats").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(async::GetSchedulerStats)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GetDispatchEstimates").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(async::GetDispatchEstimates)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("ConfigureSoftwareAes").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(async::ConfigureSoftwareAes)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("ClearKeyCache").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(async::ClearKeyCache)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GetBackends").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(async::GetBackends)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("GetCapabilities").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(async::GetCapabilities)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("ConfigureTuning").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(async::ConfigureTuning)).ToLocalChecked()
+    );
+	Nan::Set(target, 
+        Nan::New<String>("TrialDecrypt").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<FunctionTemplate>(trial::Decrypt)).ToLocalChecked()
+    );
 }
 
-NODE_MODULE(node_aead_crypto, InitAll)
\ No newline at end of file
+// Context-aware, so the addon can be loaded in worker threads
+NAN_MODULE_WORKER_ENABLED(node_aead_crypto, InitAll)
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include <string.h>
+#include <openssl/crypto.h>
+
+#include "aead-aesni.h"
+#include "aead-cpu.h"
+
+using namespace aead;
+
+bool Aesni::Supported() {
+#ifdef AEAD_HAVE_AESNI
+	const CpuFeatures &cpu = CpuFeatures::Get();
+	return cpu.aesni && cpu.pclmulqdq && cpu.ssse3 && cpu.sse41;
+#else
+	return false;
+#endif
+}
+
+#ifdef AEAD_HAVE_AESNI
+
+// SubWord of a key schedule word, through AESKEYGENASSIST's S-box, so the
+// expansion doesn't use lookup tables indexed by key bytes
+AEAD_TARGET_AESNI static uint32_t SubWord(uint32_t word) {
+	const __m128i assist = _mm_aeskeygenassist_si128(_mm_set_epi32(0, 0, (int)word, 0), 0);
+	return (uint32_t)_mm_cvtsi128_si32(assist);
+}
+
+// The key expansion of FIPS-197 for all key sizes, on little endian words
+AEAD_TARGET_AESNI static void Expand(const unsigned char *key, size_t key_len, AesniKey *out) {
+	uint32_t words[60];
+	const size_t nk = key_len / 4;
+	const size_t total = 4 * (nk + 7);
+	memcpy(words, key, key_len);
+	uint32_t rcon = 1;
+	for (size_t i = nk; i < total; i++) {
+		uint32_t t = words[i - 1];
+		if (i % nk == 0) {
+			// RotWord, then SubWord and Rcon
+			t = SubWord((t >> 8) | (t << 24)) ^ rcon;
+			rcon = (rcon << 1) ^ ((rcon >> 7) * 0x11b);
+		} else if (nk > 6 && i % nk == 4) {
+			t = SubWord(t);
+		}
+		words[i] = words[i - nk] ^ t;
+	}
+	out->rounds = (int)nk + 6;
+	memcpy(out->round_keys, words, total * 4);
+	OPENSSL_cleanse(words, sizeof(words));
+
+	// H * x in POLYVAL's field: a left shift, reduced by
+	// x^128 = x^127 + x^126 + x^121 + 1
+	const __m128i h = aesni::ByteSwap(aesni::EncryptBlock(*out, _mm_setzero_si128()));
+	uint64_t lo = (uint64_t)_mm_cvtsi128_si64(h);
+	uint64_t hi = (uint64_t)_mm_extract_epi64(h, 1);
+	const uint64_t carry = 0 - (hi >> 63);
+	hi = (hi << 1) | (lo >> 63);
+	lo <<= 1;
+	hi ^= 0xc200000000000000ULL & carry;
+	lo ^= 1 & carry;
+	const __m128i h_x = _mm_set_epi64x((long long)hi, (long long)lo);
+	_mm_store_si128((__m128i *)out->h, h_x);
+	const __m128i h2 = aesni::GfMul(h_x, h_x);
+	_mm_store_si128((__m128i *)out->h2, h2);
+	_mm_store_si128((__m128i *)out->h3, aesni::GfMul(h2, h_x));
+	_mm_store_si128((__m128i *)out->h4, aesni::GfMul(h2, h2));
+}
+
+#endif
+
+void Aesni::ExpandKey(const unsigned char *key, size_t key_len, AesniKey *out) {
+#ifdef AEAD_HAVE_AESNI
+	Expand(key, key_len, out);
+#else
+	(void)key;
+	(void)key_len;
+	memset(out, 0, sizeof(*out));
+#endif
+}
+
+// ==================
+
+// A few recently used keys of this thread, replaced round robin
+static const int CACHED_KEYS = 4;
+
+struct KeyCache {
+	struct Entry {
+		AesniKey schedule;
+		unsigned char key[32];
+		size_t key_len;
+	};
+	Entry entries[CACHED_KEYS];
+	int next;
+
+	~KeyCache() { OPENSSL_cleanse(entries, sizeof(entries)); }
+};
+
+static thread_local KeyCache key_cache;
+
+const AesniKey *Aesni::CachedKey(const unsigned char *key, size_t key_len) {
+	if (!Supported() || (key_len != 16 && key_len != 24 && key_len != 32)) return NULL;
+	for (int i = 0; i < CACHED_KEYS; i++) {
+		KeyCache::Entry &entry = key_cache.entries[i];
+		if (entry.key_len == key_len && CRYPTO_memcmp(entry.key, key, key_len) == 0) return &entry.schedule;
+	}
+	KeyCache::Entry &entry = key_cache.entries[key_cache.next];
+	key_cache.next = (key_cache.next + 1) % CACHED_KEYS;
+	// a shorter key wouldn't overwrite all of the evicted one
+	OPENSSL_cleanse(&entry, sizeof(entry));
+	ExpandKey(key, key_len, &entry.schedule);
+	memcpy(entry.key, key, key_len);
+	entry.key_len = key_len;
+	return &entry.schedule;
+}
+
+void Aesni::ClearCachedKeys() {
+	OPENSSL_cleanse(key_cache.entries, sizeof(key_cache.entries));
+	key_cache.next = 0;
+}
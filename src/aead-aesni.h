@@ -0,0 +1,164 @@
+#ifndef AEAD_AESNI_H_
+#define AEAD_AESNI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The kernels use compiler intrinsics with per-function target attributes,
+// so the addon still loads on CPUs without the extensions
+#if defined(__x86_64__) && defined(__GNUC__)
+#define AEAD_HAVE_AESNI 1
+#include <immintrin.h>
+#define AEAD_TARGET_AESNI __attribute__((target("aes,pclmul,ssse3,sse4.1")))
+#endif
+
+namespace aead {
+
+    // An AES key expanded for AES-NI, together with GCM's hash key
+    struct AesniKey {
+        alignas(16) unsigned char round_keys[15][16];
+        int rounds;
+        // H = E(K, 0^128), byte reversed and multiplied by x, as
+        // aesni::GfMul expects it, and its powers up to H^4
+        alignas(16) unsigned char h[16];
+        alignas(16) unsigned char h2[16];
+        alignas(16) unsigned char h3[16];
+        alignas(16) unsigned char h4[16];
+    };
+
+    class Aesni {
+    public:
+        // Whether this build and CPU can run the AES-NI kernels
+        static bool Supported();
+        // Expands a 16, 24 or 32 byte key; only valid if Supported()
+        static void ExpandKey(const unsigned char *key, size_t key_len, AesniKey *out);
+        // The expanded key, from a small per-thread cache for callers that
+        // pass raw keys with every call; valid until the thread's next call.
+        // The raw keys and schedules of the last 4 keys stay in memory
+        // until they are evicted (and wiped) or the cache is cleared. Pool
+        // workers clear theirs whenever they go to sleep; a JS thread keeps
+        // the last keys it passed to the one-shot functions, so keys that
+        // must be wiped belong in a Keyring.
+        // NULL if not Supported() or the key length is invalid.
+        static const AesniKey *CachedKey(const unsigned char *key, size_t key_len);
+        // Wipes the calling thread's cache
+        static void ClearCachedKeys();
+    };
+
+#ifdef AEAD_HAVE_AESNI
+    namespace aesni {
+
+        AEAD_TARGET_AESNI static inline __m128i Load(const unsigned char *p) {
+            return _mm_loadu_si128((const __m128i *)p);
+        }
+
+        AEAD_TARGET_AESNI static inline void Store(__m128i v, unsigned char *p) {
+            _mm_storeu_si128((__m128i *)p, v);
+        }
+
+        // Reverses the bytes of a block, between GCM's and PCLMULQDQ's bit order
+        AEAD_TARGET_AESNI static inline __m128i ByteSwap(__m128i v) {
+            return _mm_shuffle_epi8(v, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        }
+
+        // Loads up to 16 bytes, padded with zeroes
+        AEAD_TARGET_AESNI static inline __m128i LoadPartial(const unsigned char *p, size_t len) {
+            if (len >= 16) return Load(p);
+            alignas(16) unsigned char block[16] = { 0 };
+            for (size_t i = 0; i < len; i++) block[i] = p[i];
+            return _mm_load_si128((const __m128i *)block);
+        }
+
+        // Stores the first len (at most 16) bytes of a block
+        AEAD_TARGET_AESNI static inline void StorePartial(__m128i v, unsigned char *p, size_t len) {
+            if (len >= 16) {
+                Store(v, p);
+                return;
+            }
+            alignas(16) unsigned char block[16];
+            _mm_store_si128((__m128i *)block, v);
+            for (size_t i = 0; i < len; i++) p[i] = block[i];
+        }
+
+        // GHASH multiplication of a byte reversed block with the hash key as
+        // prepared by ExpandKey. Byte reversed, GHASH is POLYVAL of RFC 8452
+        // with the key multiplied by x, so this is POLYVAL's dot product:
+        // a schoolbook carry-less product and a Montgomery reduction with
+        // two more multiplications, as in Gueron's AES-GCM-SIV code.
+        AEAD_TARGET_AESNI static inline __m128i Reduce(__m128i lo, __m128i mid, __m128i hi) {
+            const __m128i poly = _mm_set_epi32((int)0xc2000000, 0, 0, 1);
+            lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+            hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+            lo = _mm_xor_si128(_mm_shuffle_epi32(lo, 0x4e), _mm_clmulepi64_si128(lo, poly, 0x10));
+            lo = _mm_xor_si128(_mm_shuffle_epi32(lo, 0x4e), _mm_clmulepi64_si128(lo, poly, 0x10));
+            return _mm_xor_si128(hi, lo);
+        }
+
+        AEAD_TARGET_AESNI static inline __m128i GfMul(__m128i a, __m128i h) {
+            const __m128i lo = _mm_clmulepi64_si128(a, h, 0x00);
+            const __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, h, 0x10), _mm_clmulepi64_si128(a, h, 0x01));
+            const __m128i hi = _mm_clmulepi64_si128(a, h, 0x11);
+            return Reduce(lo, mid, hi);
+        }
+
+        // Adds the unreduced product a * h to lo, mid and hi, for
+        // multiplications that share one Reduce
+        AEAD_TARGET_AESNI static inline void MulAdd(__m128i a, __m128i h, __m128i &lo, __m128i &mid, __m128i &hi) {
+            lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, h, 0x00));
+            mid = _mm_xor_si128(mid, _mm_xor_si128(_mm_clmulepi64_si128(a, h, 0x10), _mm_clmulepi64_si128(a, h, 0x01)));
+            hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, h, 0x11));
+        }
+
+        // a * h_a ^ b * h_b with a single reduction
+        AEAD_TARGET_AESNI static inline __m128i GfMul2(__m128i a, __m128i h_a, __m128i b, __m128i h_b) {
+            const __m128i lo = _mm_xor_si128(_mm_clmulepi64_si128(a, h_a, 0x00), _mm_clmulepi64_si128(b, h_b, 0x00));
+            const __m128i hi = _mm_xor_si128(_mm_clmulepi64_si128(a, h_a, 0x11), _mm_clmulepi64_si128(b, h_b, 0x11));
+            const __m128i mid = _mm_xor_si128(
+                _mm_xor_si128(_mm_clmulepi64_si128(a, h_a, 0x10), _mm_clmulepi64_si128(a, h_a, 0x01)),
+                _mm_xor_si128(_mm_clmulepi64_si128(b, h_b, 0x10), _mm_clmulepi64_si128(b, h_b, 0x01)));
+            return Reduce(lo, mid, hi);
+        }
+
+        // Encrypts a single block
+        AEAD_TARGET_AESNI static inline __m128i EncryptBlock(const AesniKey &key, __m128i block) {
+            block = _mm_xor_si128(block, _mm_load_si128((const __m128i *)key.round_keys[0]));
+            for (int r = 1; r < key.rounds; r++) {
+                block = _mm_aesenc_si128(block, _mm_load_si128((const __m128i *)key.round_keys[r]));
+            }
+            return _mm_aesenclast_si128(block, _mm_load_si128((const __m128i *)key.round_keys[key.rounds]));
+        }
+
+        // Encrypts n blocks with the rounds interleaved, so the AES unit's
+        // pipeline has n independent blocks in flight
+        template <int n>
+        AEAD_TARGET_AESNI static inline void EncryptBlocks(const AesniKey &key, __m128i *blocks) {
+            __m128i rk = _mm_load_si128((const __m128i *)key.round_keys[0]);
+            for (int i = 0; i < n; i++) blocks[i] = _mm_xor_si128(blocks[i], rk);
+            for (int r = 1; r < key.rounds; r++) {
+                rk = _mm_load_si128((const __m128i *)key.round_keys[r]);
+                for (int i = 0; i < n; i++) blocks[i] = _mm_aesenc_si128(blocks[i], rk);
+            }
+            rk = _mm_load_si128((const __m128i *)key.round_keys[key.rounds]);
+            for (int i = 0; i < n; i++) blocks[i] = _mm_aesenclast_si128(blocks[i], rk);
+        }
+
+        // EncryptBlocks for a number of rounds known at compile time, so
+        // both loops unroll completely
+        template <int rounds, int n>
+        AEAD_TARGET_AESNI static inline void EncryptRounds(const AesniKey &key, __m128i *blocks) {
+            __m128i rk = _mm_load_si128((const __m128i *)key.round_keys[0]);
+            for (int i = 0; i < n; i++) blocks[i] = _mm_xor_si128(blocks[i], rk);
+            for (int r = 1; r < rounds; r++) {
+                rk = _mm_load_si128((const __m128i *)key.round_keys[r]);
+                for (int i = 0; i < n; i++) blocks[i] = _mm_aesenc_si128(blocks[i], rk);
+            }
+            rk = _mm_load_si128((const __m128i *)key.round_keys[rounds]);
+            for (int i = 0; i < n; i++) blocks[i] = _mm_aesenclast_si128(blocks[i], rk);
+        }
+
+    }
+#endif
+
+}
+
+#endif
@@ -0,0 +1,222 @@
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <openssl/crypto.h>
+
+#include "aead-backend.h"
+#include "aead-aesni.h"
+#include "aead-ccm-format.h"
+#include "aead-ccm-multi.h"
+#include "aead-ccm-small.h"
+#include "aead-fixed.h"
+#include "aead-gcm-multi.h"
+#include "aead-gcm-small.h"
+#include "aead-gcm-wide.h"
+#include "aead-soft.h"
+
+using namespace aead;
+
+// A key for the built-in kernels: the AES-NI, VAES and multi-buffer
+// kernels where the CPU has them, and SoftAead where it doesn't or while
+// SoftAead is forced. OpenSSL is never used, for any parameters.
+class BuiltinKey : public BackendKey {
+public:
+	BuiltinKey(Mode mode, const unsigned char *key, size_t key_len)
+		: mode_(mode), key_len_(key_len), soft_key_(NULL)
+	{
+		memcpy(key_, key, key_len);
+		if (Aesni::Supported()) {
+			aesni_key_.reset(new AesniKey());
+			Aesni::ExpandKey(key, key_len, aesni_key_.get());
+		}
+	}
+
+	~BuiltinKey() {
+		OPENSSL_cleanse(key_, sizeof(key_));
+		if (aesni_key_) OPENSSL_cleanse(aesni_key_.get(), sizeof(AesniKey));
+		SoftKey *soft_key = soft_key_.load(std::memory_order_relaxed);
+		if (soft_key != NULL) {
+			OPENSSL_cleanse(soft_key, sizeof(SoftKey));
+			delete soft_key;
+		}
+	}
+
+	bool Accepts(size_t iv_len, size_t auth_tag_len) const {
+		(void)iv_len;
+		(void)auth_tag_len;
+		return true;
+	}
+
+	const AesniKey *aesni_key() const { return aesni_key_.get(); }
+
+	bool Seal(EVP_CIPHER_CTX *scratch,
+		const unsigned char *iv, size_t iv_len,
+		const unsigned char *aad, size_t aad_len,
+		const unsigned char *plaintext, size_t len,
+		unsigned char *ciphertext,
+		unsigned char *auth_tag, size_t auth_tag_len
+	) const {
+		(void)scratch;
+		if (mode_ == MODE_GCM) {
+			// the AES-NI kernels only derive J0 from 12 byte IVs
+			if (UseSoft() || iv_len != 12) {
+				SoftAead::GcmEncrypt(*Soft(), iv, iv_len, aad, aad_len, plaintext, len, ciphertext, auth_tag);
+			} else if (SmallGcm::Accepts(iv_len, len)) {
+				SmallGcm::Encrypt(*aesni_key_, iv, aad, aad_len, plaintext, len, ciphertext, auth_tag);
+			} else if (WideGcm::Supported()) {
+				WideGcm::Encrypt(*aesni_key_, iv, aad, aad_len, plaintext, len, ciphertext, auth_tag);
+			} else {
+				AesniAead::GcmEncrypt(*aesni_key_, iv, aad, aad_len, plaintext, len, ciphertext, auth_tag);
+			}
+			return true;
+		}
+
+		if (!CcmFormat::LengthFits(iv_len, len)) return false;
+		if (UseSoft()) {
+			SoftAead::CcmEncrypt(*Soft(), iv, iv_len, aad, aad_len, plaintext, len, ciphertext, auth_tag, auth_tag_len);
+		} else if (SmallCcm::Accepts(iv_len, len, auth_tag_len)) {
+			SmallCcm::Encrypt(*aesni_key_, iv, iv_len, aad, aad_len, plaintext, len, ciphertext, auth_tag, auth_tag_len);
+		} else {
+			AesniAead::CcmEncrypt(*aesni_key_, iv, iv_len, aad, aad_len, plaintext, len, ciphertext, auth_tag, auth_tag_len);
+		}
+		return true;
+	}
+
+	bool Open(EVP_CIPHER_CTX *scratch,
+		const unsigned char *iv, size_t iv_len,
+		const unsigned char *aad, size_t aad_len,
+		const unsigned char *ciphertext, size_t len,
+		unsigned char *plaintext,
+		const unsigned char *auth_tag, size_t auth_tag_len,
+		bool *auth_ok
+	) const {
+		(void)scratch;
+		if (mode_ == MODE_GCM) {
+			if (UseSoft() || iv_len != 12) {
+				*auth_ok = SoftAead::GcmDecrypt(*Soft(), iv, iv_len, aad, aad_len, ciphertext, len, plaintext, auth_tag);
+			} else if (SmallGcm::Accepts(iv_len, len)) {
+				*auth_ok = SmallGcm::Decrypt(*aesni_key_, iv, aad, aad_len, ciphertext, len, plaintext, auth_tag);
+			} else if (WideGcm::Supported()) {
+				*auth_ok = WideGcm::Decrypt(*aesni_key_, iv, aad, aad_len, ciphertext, len, plaintext, auth_tag);
+			} else {
+				*auth_ok = AesniAead::GcmDecrypt(*aesni_key_, iv, aad, aad_len, ciphertext, len, plaintext, auth_tag);
+			}
+			return true;
+		}
+
+		if (!CcmFormat::LengthFits(iv_len, len)) return false;
+		if (UseSoft()) {
+			*auth_ok = SoftAead::CcmDecrypt(*Soft(), iv, iv_len, aad, aad_len, ciphertext, len,
+				plaintext, auth_tag, auth_tag_len);
+		} else if (SmallCcm::Accepts(iv_len, len, auth_tag_len)) {
+			*auth_ok = SmallCcm::Decrypt(*aesni_key_, iv, iv_len, aad, aad_len, ciphertext, len,
+				plaintext, auth_tag, auth_tag_len);
+		} else {
+			return AesniAead::CcmDecrypt(*aesni_key_, iv, iv_len, aad, aad_len, ciphertext, len,
+				plaintext, auth_tag, auth_tag_len, auth_ok);
+		}
+		return true;
+	}
+
+	// Short messages go through the multi-buffer kernels together
+	void RunBatch(BackendOp *ops, size_t count) const {
+		if (UseSoft()) return;
+		std::vector<GcmMultiOp> gcm_ops;
+		std::vector<CcmMultiOp> ccm_ops;
+		std::vector<BackendOp *> multi;
+		for (size_t i = 0; i < count; i++) {
+			BackendOp &op = ops[i];
+			const bool accepted = !op.done && (mode_ == MODE_GCM
+				? MultiGcm::Accepts(op.iv_len, op.len, op.tag_len)
+				: MultiCcm::Accepts(op.iv_len, op.len, op.tag_len));
+			if (!accepted) continue;
+			if (mode_ == MODE_GCM) {
+				GcmMultiOp m;
+				m.encrypt = op.encrypt;
+				m.iv = op.iv;
+				m.aad = op.aad;
+				m.aad_len = op.aad_len;
+				m.in = op.in;
+				m.len = op.len;
+				m.out = op.out;
+				m.tag = op.tag;
+				m.auth_ok = false;
+				gcm_ops.push_back(m);
+			} else {
+				CcmMultiOp m;
+				m.encrypt = op.encrypt;
+				m.iv = op.iv;
+				m.iv_len = op.iv_len;
+				m.aad = op.aad;
+				m.aad_len = op.aad_len;
+				m.in = op.in;
+				m.len = op.len;
+				m.out = op.out;
+				m.tag = op.tag;
+				m.tag_len = op.tag_len;
+				m.auth_ok = false;
+				ccm_ops.push_back(m);
+			}
+			multi.push_back(&op);
+		}
+		if (multi.empty()) return;
+		if (mode_ == MODE_GCM) {
+			MultiGcm::Run(*aesni_key_, gcm_ops.data(), gcm_ops.size());
+			for (size_t i = 0; i < multi.size(); i++) multi[i]->auth_ok = gcm_ops[i].auth_ok;
+		} else {
+			MultiCcm::Run(*aesni_key_, ccm_ops.data(), ccm_ops.size());
+			for (size_t i = 0; i < multi.size(); i++) multi[i]->auth_ok = ccm_ops[i].auth_ok;
+		}
+		for (size_t i = 0; i < multi.size(); i++) multi[i]->done = multi[i]->ok = true;
+	}
+
+private:
+	// software AES replaces the AES-NI kernels too when forced
+	bool UseSoft() const { return !aesni_key_ || SoftAead::Enabled(); }
+
+	// Returns the SoftAead schedule, expanding it on first use
+	const SoftKey *Soft() const {
+		SoftKey *soft_key = soft_key_.load(std::memory_order_acquire);
+		if (soft_key != NULL) return soft_key;
+
+		soft_key = new SoftKey();
+		SoftAead::ExpandKey(key_, key_len_, soft_key);
+
+		// another thread may have been faster
+		SoftKey *expected = NULL;
+		if (!soft_key_.compare_exchange_strong(expected, soft_key, std::memory_order_acq_rel)) {
+			OPENSSL_cleanse(soft_key, sizeof(SoftKey));
+			delete soft_key;
+			soft_key = expected;
+		}
+		return soft_key;
+	}
+
+	const Mode mode_;
+	unsigned char key_[32];
+	const size_t key_len_;
+	std::unique_ptr<AesniKey> aesni_key_;
+	// The schedule for SoftAead, built lazily
+	mutable std::atomic<SoftKey *> soft_key_;
+};
+
+class BuiltinBackend : public Backend {
+public:
+	const char *name() const { return "builtin"; }
+
+	// SoftAead runs anywhere
+	bool Supports(Mode mode, size_t key_len) const {
+		(void)mode;
+		return key_len == 16 || key_len == 24 || key_len == 32;
+	}
+
+	BackendKey *InitKey(Mode mode, const unsigned char *key, size_t key_len) const {
+		return new BuiltinKey(mode, key, key_len);
+	}
+};
+
+const Backend &Backend::Builtin() {
+	static const BuiltinBackend backend;
+	return backend;
+}
@@ -0,0 +1,205 @@
+#include <string.h>
+#include <openssl/crypto.h>
+
+#include "aead-backend-openssl.h"
+
+// see https://wiki.openssl.org/index.php/EVP_Authenticated_Encryption_and_Decryption
+// for details on the implementation
+
+#ifndef EVP_CTRL_GCM_SET_IVLEN
+#define EVP_CTRL_GCM_SET_IVLEN    EVP_CTRL_AEAD_SET_IVLEN
+#endif
+
+using namespace aead;
+
+// OpenSSL treats NULL input or output pointers as "finalize" or "AAD",
+// so empty buffers are replaced with pointers to a dummy byte
+static const unsigned char empty_input[1] = { 0 };
+
+static const EVP_CIPHER *GetCipher(Mode mode, size_t key_len) {
+	switch (key_len) {
+		case 16:
+			return mode == MODE_GCM ? EVP_aes_128_gcm() : EVP_aes_128_ccm();
+		case 24:
+			return mode == MODE_GCM ? EVP_aes_192_gcm() : EVP_aes_192_ccm();
+		case 32:
+			return mode == MODE_GCM ? EVP_aes_256_gcm() : EVP_aes_256_ccm();
+		default:
+			return NULL;
+	}
+}
+
+// Encrypts with a context whose cipher, key and (for CCM) lengths are set
+static bool EvpSeal(EVP_CIPHER_CTX *ctx, Mode mode,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext,
+	unsigned char *auth_tag, size_t auth_tag_len
+) {
+	unsigned char empty_output[1];
+	if (len == 0) {
+		plaintext = empty_input;
+		ciphertext = empty_output;
+	}
+
+	int outl; // output length
+	if (mode == MODE_GCM) {
+		if (iv_len != 12) EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)iv_len, NULL);
+		EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv);
+		if (aad_len > 0) EVP_EncryptUpdate(ctx, NULL, &outl, aad, (int)aad_len);
+	} else {
+		EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv);
+		// CCM needs the plaintext length up front
+		if (!EVP_EncryptUpdate(ctx, NULL, &outl, NULL, (int)len)) return false;
+		if (aad_len > 0) EVP_EncryptUpdate(ctx, NULL, &outl, aad, (int)aad_len);
+	}
+
+	// Encrypt plaintext and finalize
+	if (!EVP_EncryptUpdate(ctx, ciphertext, &outl, plaintext, (int)len)) return false;
+	EVP_EncryptFinal_ex(ctx, ciphertext + outl, &outl);
+
+	// Get the authentication tag
+	return EVP_CIPHER_CTX_ctrl(ctx,
+		mode == MODE_GCM ? EVP_CTRL_GCM_GET_TAG : EVP_CTRL_CCM_GET_TAG,
+		(int)auth_tag_len, auth_tag) > 0;
+}
+
+// Decrypts like EvpSeal; for CCM, the tag must be set already
+static bool EvpOpen(EVP_CIPHER_CTX *ctx, Mode mode,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext,
+	const unsigned char *auth_tag, size_t auth_tag_len,
+	bool *auth_ok
+) {
+	unsigned char empty_output[1];
+	if (len == 0) {
+		ciphertext = empty_input;
+		plaintext = empty_output;
+	}
+
+	int outl; // output length
+	if (mode == MODE_GCM) {
+		if (iv_len != 12) EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)iv_len, NULL);
+		EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, iv);
+		if (aad_len > 0) EVP_DecryptUpdate(ctx, NULL, &outl, aad, (int)aad_len);
+
+		EVP_DecryptUpdate(ctx, plaintext, &outl, ciphertext, (int)len);
+		// Set the reference tag and finalize
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, (int)auth_tag_len, (void *)auth_tag);
+		*auth_ok = EVP_DecryptFinal_ex(ctx, plaintext + outl, &outl) > 0;
+	} else {
+		EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, iv);
+		if (!EVP_DecryptUpdate(ctx, NULL, &outl, NULL, (int)len)) return false;
+		if (aad_len > 0) EVP_DecryptUpdate(ctx, NULL, &outl, aad, (int)aad_len);
+
+		*auth_ok = EVP_DecryptUpdate(ctx, plaintext, &outl, ciphertext, (int)len) > 0;
+	}
+	return true;
+}
+
+// ==================
+
+OpenSslKey::OpenSslKey(Mode mode, const EVP_CIPHER *cipher, const unsigned char *key, size_t key_len)
+	: mode_(mode), cipher_(cipher)
+{
+	memcpy(key_, key, key_len);
+	for (int d = 0; d < 2; d++) {
+		for (int i = 0; i < 7; i++) {
+			for (int j = 0; j < 7; j++) {
+				templates_[d][i][j].store(NULL, std::memory_order_relaxed);
+			}
+		}
+	}
+}
+
+OpenSslKey::~OpenSslKey() {
+	for (int d = 0; d < 2; d++) {
+		for (int i = 0; i < 7; i++) {
+			for (int j = 0; j < 7; j++) {
+				EVP_CIPHER_CTX *tpl = templates_[d][i][j].load(std::memory_order_relaxed);
+				if (tpl != NULL) EVP_CIPHER_CTX_free(tpl);
+			}
+		}
+	}
+	OPENSSL_cleanse(key_, sizeof(key_));
+}
+
+bool OpenSslKey::Accepts(size_t iv_len, size_t auth_tag_len) const {
+	(void)iv_len;
+	(void)auth_tag_len;
+	return true;
+}
+
+// Some OpenSSL versions don't switch a key-initialized context's direction
+// when only a new IV is provided, hence the separate templates
+const EVP_CIPHER_CTX *OpenSslKey::Template(bool encrypt, size_t iv_len, size_t auth_tag_len) const {
+	std::atomic<EVP_CIPHER_CTX *> &slot = (mode_ == MODE_GCM)
+		? templates_[encrypt][0][0]
+		: templates_[encrypt][iv_len - 7][(auth_tag_len - 4) / 2];
+	EVP_CIPHER_CTX *tpl = slot.load(std::memory_order_acquire);
+	if (tpl != NULL) return tpl;
+
+	tpl = EVP_CIPHER_CTX_new();
+	EVP_CipherInit_ex(tpl, cipher_, NULL, NULL, NULL, encrypt);
+	if (mode_ == MODE_CCM) {
+		EVP_CIPHER_CTX_ctrl(tpl, EVP_CTRL_CCM_SET_IVLEN, (int)iv_len, NULL);
+		EVP_CIPHER_CTX_ctrl(tpl, EVP_CTRL_CCM_SET_TAG, (int)auth_tag_len, NULL);
+	}
+	EVP_CipherInit_ex(tpl, NULL, NULL, key_, NULL, encrypt);
+
+	// another thread may have been faster
+	EVP_CIPHER_CTX *expected = NULL;
+	if (!slot.compare_exchange_strong(expected, tpl, std::memory_order_acq_rel)) {
+		EVP_CIPHER_CTX_free(tpl);
+		tpl = expected;
+	}
+	return tpl;
+}
+
+bool OpenSslKey::Seal(EVP_CIPHER_CTX *scratch,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext,
+	unsigned char *auth_tag, size_t auth_tag_len
+) const {
+	// start from the expanded key schedule
+	if (!EVP_CIPHER_CTX_copy(scratch, Template(true, iv_len, auth_tag_len))) return false;
+	return EvpSeal(scratch, mode_, iv, iv_len, aad, aad_len, plaintext, len, ciphertext, auth_tag, auth_tag_len);
+}
+
+bool OpenSslKey::Open(EVP_CIPHER_CTX *scratch,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext,
+	const unsigned char *auth_tag, size_t auth_tag_len,
+	bool *auth_ok
+) const {
+	if (!EVP_CIPHER_CTX_copy(scratch, Template(false, iv_len, auth_tag_len))) return false;
+	if (mode_ == MODE_CCM) EVP_CIPHER_CTX_ctrl(scratch, EVP_CTRL_CCM_SET_TAG, (int)auth_tag_len, (void *)auth_tag);
+	return EvpOpen(scratch, mode_, iv, iv_len, aad, aad_len, ciphertext, len, plaintext, auth_tag, auth_tag_len, auth_ok);
+}
+
+// ==================
+
+class OpenSslBackend : public Backend {
+public:
+	const char *name() const { return "openssl"; }
+
+	bool Supports(Mode mode, size_t key_len) const {
+		return GetCipher(mode, key_len) != NULL;
+	}
+
+	BackendKey *InitKey(Mode mode, const unsigned char *key, size_t key_len) const {
+		return new OpenSslKey(mode, GetCipher(mode, key_len), key, key_len);
+	}
+};
+
+const Backend &Backend::OpenSsl() {
+	static const OpenSslBackend backend;
+	return backend;
+}
@@ -0,0 +1,51 @@
+#ifndef AEAD_BACKEND_OPENSSL_H_
+#define AEAD_BACKEND_OPENSSL_H_
+
+#include <atomic>
+#include <openssl/evp.h>
+
+#include "aead-backend.h"
+
+namespace aead {
+
+    // A key for OpenSSL's EVP interface. The key schedule is expanded once
+    // into template cipher contexts; every operation copies a template into
+    // the caller's scratch context.
+    class OpenSslKey : public BackendKey {
+    public:
+        OpenSslKey(Mode mode, const EVP_CIPHER *cipher, const unsigned char *key, size_t key_len);
+        ~OpenSslKey();
+
+        bool Accepts(size_t iv_len, size_t auth_tag_len) const;
+        bool Seal(EVP_CIPHER_CTX *scratch,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext,
+            unsigned char *auth_tag, size_t auth_tag_len) const;
+        bool Open(EVP_CIPHER_CTX *scratch,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext,
+            const unsigned char *auth_tag, size_t auth_tag_len,
+            bool *auth_ok) const;
+
+        // Returns the key-initialized context for the given parameters,
+        // expanding the key schedule the first time a combination is used
+        const EVP_CIPHER_CTX *Template(bool encrypt, size_t iv_len, size_t auth_tag_len) const;
+
+    private:
+        const Mode mode_;
+        const EVP_CIPHER *cipher_;
+        unsigned char key_[32];
+        // Templates are built lazily, separately for both directions.
+        // GCM needs a single template per direction. CCM fixes the nonce and
+        // tag length when the key is set, so there is one per combination of
+        // nonce length (7..13) and tag length (4..16, even).
+        mutable std::atomic<EVP_CIPHER_CTX *> templates_[2][7][7];
+    };
+
+}
+
+#endif
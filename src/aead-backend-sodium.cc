@@ -0,0 +1,82 @@
+// libsodium's AES-256-GCM, for builds with the with_libsodium variable set.
+// It only has the 256 bit key size, 12 byte IVs and 16 byte tags, and only
+// runs on CPUs with AES-NI and PCLMULQDQ.
+
+#ifdef AEAD_WITH_LIBSODIUM
+
+#include <string.h>
+#include <sodium.h>
+
+#include "aead-backend.h"
+
+using namespace aead;
+
+class SodiumKey : public BackendKey {
+public:
+	explicit SodiumKey(const unsigned char *key) {
+		crypto_aead_aes256gcm_beforenm(&state_, key);
+	}
+
+	~SodiumKey() {
+		sodium_memzero(&state_, sizeof(state_));
+	}
+
+	bool Accepts(size_t iv_len, size_t auth_tag_len) const {
+		return iv_len == crypto_aead_aes256gcm_NPUBBYTES && auth_tag_len == crypto_aead_aes256gcm_ABYTES;
+	}
+
+	bool Seal(EVP_CIPHER_CTX *scratch,
+		const unsigned char *iv, size_t iv_len,
+		const unsigned char *aad, size_t aad_len,
+		const unsigned char *plaintext, size_t len,
+		unsigned char *ciphertext,
+		unsigned char *auth_tag, size_t auth_tag_len
+	) const {
+		(void)scratch; (void)iv_len; (void)auth_tag_len;
+		return crypto_aead_aes256gcm_encrypt_detached_afternm(ciphertext, auth_tag, NULL,
+			plaintext, len, aad, aad_len, NULL, iv, &state_) == 0;
+	}
+
+	// libsodium checks the tag first and writes no plaintext if it fails;
+	// the caller's buffer is zeroed then, so it never returns uninitialized
+	// memory
+	bool Open(EVP_CIPHER_CTX *scratch,
+		const unsigned char *iv, size_t iv_len,
+		const unsigned char *aad, size_t aad_len,
+		const unsigned char *ciphertext, size_t len,
+		unsigned char *plaintext,
+		const unsigned char *auth_tag, size_t auth_tag_len,
+		bool *auth_ok
+	) const {
+		(void)scratch; (void)iv_len; (void)auth_tag_len;
+		*auth_ok = crypto_aead_aes256gcm_decrypt_detached_afternm(plaintext, NULL,
+			ciphertext, len, auth_tag, aad, aad_len, iv, &state_) == 0;
+		if (!*auth_ok && len > 0) memset(plaintext, 0, len);
+		return true;
+	}
+
+private:
+	crypto_aead_aes256gcm_state state_;
+};
+
+class SodiumBackend : public Backend {
+public:
+	const char *name() const { return "libsodium"; }
+
+	bool Supports(Mode mode, size_t key_len) const {
+		static const bool available = sodium_init() >= 0 && crypto_aead_aes256gcm_is_available();
+		return available && mode == MODE_GCM && key_len == crypto_aead_aes256gcm_KEYBYTES;
+	}
+
+	BackendKey *InitKey(Mode mode, const unsigned char *key, size_t key_len) const {
+		(void)mode; (void)key_len;
+		return new SodiumKey(key);
+	}
+};
+
+const Backend &Backend::Sodium() {
+	static const SodiumBackend backend;
+	return backend;
+}
+
+#endif
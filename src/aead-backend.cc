@@ -0,0 +1,30 @@
+#include <string.h>
+
+#include "aead-backend.h"
+
+using namespace aead;
+
+// The backends compiled in, in the order of Backend::At
+static const Backend &(*const backends[])() = {
+	&Backend::OpenSsl,
+	&Backend::Builtin,
+#ifdef AEAD_WITH_LIBSODIUM
+	&Backend::Sodium,
+#endif
+};
+
+size_t Backend::Count() {
+	return sizeof(backends) / sizeof(backends[0]);
+}
+
+const Backend &Backend::At(size_t i) {
+	return backends[i]();
+}
+
+const Backend *Backend::Find(const char *name) {
+	for (size_t i = 0; i < Count(); i++) {
+		const Backend &backend = At(i);
+		if (strcmp(backend.name(), name) == 0) return &backend;
+	}
+	return NULL;
+}
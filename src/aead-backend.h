@@ -0,0 +1,101 @@
+#ifndef AEAD_BACKEND_H_
+#define AEAD_BACKEND_H_
+
+#include <stddef.h>
+#include <openssl/evp.h>
+
+namespace aead {
+
+    struct AesniKey;
+
+    enum Mode {
+        MODE_GCM,
+        MODE_CCM
+    };
+
+    // One operation of BackendKey::RunBatch
+    struct BackendOp {
+        bool encrypt;
+        const unsigned char *iv;
+        size_t iv_len;
+        const unsigned char *aad;
+        size_t aad_len;
+        const unsigned char *in;
+        size_t len;
+        unsigned char *out;
+        // written when encrypting and checked when decrypting
+        unsigned char *tag;
+        size_t tag_len;
+        // set once the operation has run; ok is false if its parameters
+        // were invalid
+        bool done;
+        bool ok;
+        bool auth_ok;
+    };
+
+    // A key set up for one backend. Like KeyContext, it is immutable after
+    // creation and can be used from several threads at once.
+    class BackendKey {
+    public:
+        virtual ~BackendKey() {}
+
+        // Whether Seal and Open take these lengths, which are valid for the
+        // key's mode. Others need another backend.
+        virtual bool Accepts(size_t iv_len, size_t auth_tag_len) const = 0;
+
+        // The scratch context belongs to the caller, for backends built on
+        // EVP. Both return false if the operation failed, e.g. because a CCM
+        // message is too long for its nonce.
+        virtual bool Seal(EVP_CIPHER_CTX *scratch,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext,
+            unsigned char *auth_tag, size_t auth_tag_len) const = 0;
+        virtual bool Open(EVP_CIPHER_CTX *scratch,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext,
+            const unsigned char *auth_tag, size_t auth_tag_len,
+            bool *auth_ok) const = 0;
+
+        // Runs the operations that are faster together than one by one and
+        // marks them done; the caller runs the rest. By default, none.
+        virtual void RunBatch(BackendOp *ops, size_t count) const { (void)ops; (void)count; }
+
+        // The key's AES-NI schedule if the backend keeps one, for code that
+        // runs its own kernels over many keys. By default, NULL.
+        virtual const AesniKey *aesni_key() const { return NULL; }
+    };
+
+    // An implementation of GCM and CCM: OpenSSL's EVP interface, the
+    // built-in kernels or, if the addon was built with it, libsodium.
+    // The backends are stateless singletons.
+    class Backend {
+    public:
+        virtual ~Backend() {}
+
+        // The name keys select the backend by
+        virtual const char *name() const = 0;
+        // Whether the backend can run here with the mode and key length
+        virtual bool Supports(Mode mode, size_t key_len) const = 0;
+        // Only call if Supports()
+        virtual BackendKey *InitKey(Mode mode, const unsigned char *key, size_t key_len) const = 0;
+
+        // The backends compiled in, OpenSSL first
+        static size_t Count();
+        static const Backend &At(size_t i);
+        // NULL if no backend of that name was compiled in
+        static const Backend *Find(const char *name);
+
+        static const Backend &OpenSsl();
+        static const Backend &Builtin();
+#ifdef AEAD_WITH_LIBSODIUM
+        static const Backend &Sodium();
+#endif
+    };
+
+}
+
+#endif
@@ -0,0 +1,97 @@
+#include <string.h>
+#include <algorithm>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/provider.h>
+#endif
+
+#include "aead-capabilities.h"
+#include "aead-ccm-small.h"
+#include "aead-cpu.h"
+#include "aead-gcm-small.h"
+#include "aead-gcm-wide.h"
+#include "aead-parallel.h"
+#include "aead-soft.h"
+#include "aead-tuning.h"
+
+using namespace aead;
+
+const char *Capabilities::OpenSslVersion() {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	return OpenSSL_version(OPENSSL_VERSION);
+#else
+	return SSLeay_version(SSLEAY_VERSION);
+#endif
+}
+
+unsigned long Capabilities::OpenSslVersionNumber() {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	return OpenSSL_version_num();
+#else
+	return SSLeay();
+#endif
+}
+
+const char *Capabilities::OpenSslProvider() {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	// the provider name outlives the fetched cipher
+	EVP_CIPHER *cipher = EVP_CIPHER_fetch(NULL, "AES-128-GCM", NULL);
+	if (cipher == NULL) return NULL;
+	const OSSL_PROVIDER *provider = EVP_CIPHER_get0_provider(cipher);
+	const char *name = provider != NULL ? OSSL_PROVIDER_get0_name(provider) : NULL;
+	EVP_CIPHER_free(cipher);
+	return name;
+#else
+	return NULL;
+#endif
+}
+
+const char *Capabilities::OpenSslAes() {
+	const CpuFeatures &cpu = CpuFeatures::Get();
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	if (cpu.aesni) return "aesni";
+	if (cpu.ssse3) return "vpaes";
+	return "generic";
+#else
+	return cpu.aes_missing ? "generic" : "unknown";
+#endif
+}
+
+// The AES-GCM/CCM of OpenSSL, which also runs the chunks of split messages
+static const char *OpenSslImplementation() {
+	const char *aes = Capabilities::OpenSslAes();
+	if (strcmp(aes, "aesni") == 0) return "openssl-aesni";
+	if (strcmp(aes, "vpaes") == 0) return "openssl-vpaes";
+	if (strcmp(aes, "generic") == 0) return "openssl-generic";
+	return "openssl-unknown";
+}
+
+// Mirrors the dispatch of the synchronous functions, including Tuning
+const char *Capabilities::Implementation(Mode mode, size_t len) {
+	if (SoftAead::Enabled()) return "software";
+	const Kernel kernel = Tuning::Get(mode, len);
+	if (Aesni::Supported() && kernel != KERNEL_OPENSSL) {
+		if (mode == MODE_GCM ? SmallGcm::Accepts(12, len) : SmallCcm::Accepts(12, len, 16)) return "aesni";
+		if (mode == MODE_GCM && WideGcm::Supported()) return "vaes";
+		if (kernel == KERNEL_BUILTIN) return "aesni";
+	}
+	return OpenSslImplementation();
+}
+
+// Splitting comes after the software and short message paths
+size_t Capabilities::ParallelFrom(Mode mode, int bucket) {
+	const size_t threshold = ChunkedWork::threshold();
+	if (threshold == 0 || SoftAead::Enabled()) return 0;
+	const size_t first = bucket == 0 ? 0 : Tuning::BucketLimit(bucket - 1) + 1;
+	const size_t from = std::max(threshold, first);
+	if (from > Tuning::BucketLimit(bucket)) return 0;
+	// the short message kernels take all of the first bucket they accept
+	if (Aesni::Supported() && Tuning::GetBucket(mode, bucket) != KERNEL_OPENSSL &&
+		(mode == MODE_GCM ? SmallGcm::Accepts(12, from) : SmallCcm::Accepts(12, from, 16))) return 0;
+	return from;
+}
+
+const char *Capabilities::ParallelImplementation() {
+	return OpenSslImplementation();
+}
@@ -0,0 +1,41 @@
+#ifndef AEAD_CAPABILITIES_H_
+#define AEAD_CAPABILITIES_H_
+
+#include <stddef.h>
+
+#include "aead-backend.h"
+
+namespace aead {
+
+    // What the addon found at runtime, for getCapabilities(): the OpenSSL it
+    // is linked against, and which implementation the one-shot functions
+    // pick on this CPU
+    class Capabilities {
+    public:
+        // e.g. "OpenSSL 3.0.13 30 Jan 2024"
+        static const char *OpenSslVersion();
+        static unsigned long OpenSslVersionNumber();
+        // The provider serving AES-GCM, e.g. "default" or "fips"; NULL before
+        // OpenSSL 3.0, which had no providers
+        static const char *OpenSslProvider();
+        // OpenSSL's AES code path, as far as the CPU decides it: "aesni",
+        // "vpaes" (SSSE3 bitslicing), "generic" (lookup tables) or "unknown"
+        static const char *OpenSslAes();
+
+        // The implementation gcm.encrypt or ccm.encrypt runs for a message
+        // of len bytes that isn't split, with a 12 byte IV for GCM:
+        // "software", "aesni" or "vaes" for the built-in kernels, or
+        // "openssl-" followed by OpenSslAes(). It only depends on the Tuning
+        // bucket of len, not on the key size.
+        static const char *Implementation(Mode mode, size_t len);
+        // The smallest message of a Tuning bucket that the one-shot functions
+        // split across the crypto thread pool instead, or 0 if none is (see
+        // ChunkedWork). The chunks always run on OpenSSL, so split messages
+        // use ParallelImplementation().
+        static size_t ParallelFrom(Mode mode, int bucket);
+        static const char *ParallelImplementation();
+    };
+
+}
+
+#endif
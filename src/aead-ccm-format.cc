@@ -0,0 +1,49 @@
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#include "aead-ccm-format.h"
+
+using namespace aead;
+
+void CcmFormat::Init(const unsigned char *iv, size_t iv_len, size_t aad_len, size_t len, size_t tag_len) {
+	const size_t q = 15 - iv_len;
+	memset(ctr0, 0, sizeof(ctr0));
+	ctr0[0] = (unsigned char)(q - 1);
+	memcpy(ctr0 + 1, iv, iv_len);
+
+	memcpy(b0, ctr0, sizeof(b0));
+	b0[0] = (unsigned char)((aad_len > 0 ? 0x40 : 0) | ((tag_len - 2) / 2) << 3 | (q - 1));
+	uint64_t value = len;
+	for (size_t i = 16; i > 16 - q; value >>= 8) b0[--i] = (unsigned char)value;
+
+	this->aad_len = aad_len;
+	prefix_len = 0;
+	if (aad_len == 0) return;
+	size_t start = 0;
+	if (aad_len < 0xff00) {
+		prefix_len = 2;
+	} else if ((uint64_t)aad_len <= 0xffffffff) {
+		prefix[0] = 0xff; prefix[1] = 0xfe;
+		prefix_len = 6;
+		start = 2;
+	} else {
+		prefix[0] = 0xff; prefix[1] = 0xff;
+		prefix_len = 10;
+		start = 2;
+	}
+	value = aad_len;
+	for (size_t i = prefix_len; i > start; value >>= 8) prefix[--i] = (unsigned char)value;
+}
+
+void CcmFormat::AadBlock(const unsigned char *aad, size_t i, unsigned char *block) const {
+	memset(block, 0, 16);
+	size_t pos = i * 16, filled = 0;
+	if (pos < prefix_len) {
+		filled = std::min((size_t)16, prefix_len - pos);
+		memcpy(block, prefix + pos, filled);
+		pos += filled;
+	}
+	pos -= prefix_len;
+	if (pos < aad_len) memcpy(block + filled, aad + pos, std::min(16 - filled, aad_len - pos));
+}
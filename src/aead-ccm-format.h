@@ -0,0 +1,39 @@
+#ifndef AEAD_CCM_FORMAT_H_
+#define AEAD_CCM_FORMAT_H_
+
+#include <stddef.h>
+
+namespace aead {
+
+    // The blocks CCM derives from its parameters, as in NIST SP 800-38C,
+    // for the built-in kernels
+    struct CcmFormat {
+        // B_0 = flags || nonce || [len]q
+        unsigned char b0[16];
+        // Ctr_0 = flags || nonce || 0^8q
+        unsigned char ctr0[16];
+        // the length of the additional data, encoded in 2, 6 or 10 bytes;
+        // empty without additional data
+        unsigned char prefix[10];
+        size_t prefix_len;
+        size_t aad_len;
+
+        // Whether a message length fits into the 15 - iv_len bytes the
+        // nonce leaves for it
+        static bool LengthFits(size_t iv_len, size_t len) {
+            const size_t q = 15 - iv_len;
+            return q >= sizeof(size_t) || (len >> (8 * q)) == 0;
+        }
+
+        // The parameters must be valid for CCM
+        void Init(const unsigned char *iv, size_t iv_len, size_t aad_len, size_t len, size_t tag_len);
+
+        // The number of blocks of prefix || aad, padded with zeroes
+        size_t AadBlocks() const { return (prefix_len + aad_len + 15) / 16; }
+        // Block i of prefix || aad
+        void AadBlock(const unsigned char *aad, size_t i, unsigned char *block) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include <string.h>
+#include <algorithm>
+#include <openssl/crypto.h>
+
+#include "aead-ccm-multi.h"
+#include "aead-ccm-format.h"
+
+using namespace aead;
+
+#ifdef AEAD_HAVE_AESNI
+
+using namespace aead::aesni;
+
+struct CcmLane {
+	CcmMultiOp *op;
+	CcmFormat format;
+	// the CBC-MAC state
+	__m128i mac;
+	__m128i ctr0;
+	// E(K, Ctr_0), which masks the tag
+	__m128i s0;
+	bool s0_ready;
+	// The next block of the MAC input: B_0, the formatted additional data,
+	// then the payload
+	size_t mac_block;
+	size_t aad_blocks;
+	size_t data_blocks;
+	// the next counter of the payload, from 1
+	size_t counter;
+};
+
+AEAD_TARGET_AESNI static void StartLane(CcmLane &lane, CcmMultiOp *op) {
+	lane.op = op;
+	lane.format.Init(op->iv, op->iv_len, op->aad_len, op->len, op->tag_len);
+	lane.mac = _mm_setzero_si128();
+	lane.ctr0 = Load(lane.format.ctr0);
+	lane.s0 = _mm_setzero_si128();
+	lane.s0_ready = false;
+	lane.mac_block = 0;
+	lane.aad_blocks = lane.format.AadBlocks();
+	lane.data_blocks = (op->len + 15) / 16;
+	lane.counter = 1;
+}
+
+AEAD_TARGET_AESNI static __m128i NextMacBlock(CcmLane &lane) {
+	const CcmMultiOp *op = lane.op;
+	const size_t i = lane.mac_block++;
+	if (i == 0) return Load(lane.format.b0);
+	if (i <= lane.aad_blocks) {
+		alignas(16) unsigned char block[16];
+		lane.format.AadBlock(op->aad, i - 1, block);
+		return _mm_load_si128((const __m128i *)block);
+	}
+	// the MAC is over the plaintext; when decrypting, the keystream ran
+	// ahead and it is already in the output
+	const size_t pos = (i - 1 - lane.aad_blocks) * 16;
+	return LoadPartial((op->encrypt ? op->in : op->out) + pos, std::min((size_t)16, op->len - pos));
+}
+
+AEAD_TARGET_AESNI static __m128i NextCounterBlock(const CcmLane &lane) {
+	// Ctr_0 once the payload is done. At most MAX_LENGTH / 16 + 1 blocks
+	// are counted, and q is at least 2.
+	if (lane.counter > lane.data_blocks) return lane.ctr0;
+	return _mm_insert_epi16(lane.ctr0, __builtin_bswap16((uint16_t)lane.counter), 7);
+}
+
+AEAD_TARGET_AESNI static void AbsorbKeystream(CcmLane &lane, __m128i keystream) {
+	CcmMultiOp *op = lane.op;
+	if (lane.counter <= lane.data_blocks) {
+		const size_t pos = (lane.counter - 1) * 16;
+		const size_t n = std::min((size_t)16, op->len - pos);
+		StorePartial(_mm_xor_si128(LoadPartial(op->in + pos, n), keystream), op->out + pos, n);
+		lane.counter++;
+	} else if (!lane.s0_ready) {
+		lane.s0 = keystream;
+		lane.s0_ready = true;
+	}
+}
+
+static bool LaneDone(const CcmLane &lane) {
+	return lane.s0_ready && lane.mac_block == 1 + lane.aad_blocks + lane.data_blocks;
+}
+
+AEAD_TARGET_AESNI static void FinishLane(CcmLane &lane) {
+	CcmMultiOp *op = lane.op;
+	alignas(16) unsigned char tag[16];
+	_mm_store_si128((__m128i *)tag, _mm_xor_si128(lane.mac, lane.s0));
+	if (op->encrypt) {
+		memcpy(op->tag, tag, op->tag_len);
+	} else {
+		op->auth_ok = CRYPTO_memcmp(tag, op->tag, op->tag_len) == 0;
+		if (!op->auth_ok) OPENSSL_cleanse(op->out, op->len);
+	}
+	OPENSSL_cleanse(tag, sizeof(tag));
+}
+
+AEAD_TARGET_AESNI static void RunLanes(const AesniKey &key, CcmMultiOp *ops, size_t count) {
+	const int LANES = MultiCcm::LANES;
+	CcmLane lanes[LANES];
+	size_t next = 0;
+	int active = 0;
+	for (int l = 0; l < LANES; l++) {
+		lanes[l].op = NULL;
+		if (next < count) {
+			StartLane(lanes[l], &ops[next++]);
+			active++;
+		}
+	}
+
+	// one CBC-MAC block and one counter block per lane; idle lanes
+	// encrypt zeroes
+	__m128i blocks[2 * LANES];
+	while (active > 0) {
+		for (int l = 0; l < LANES; l++) {
+			if (lanes[l].op == NULL) {
+				blocks[2 * l] = blocks[2 * l + 1] = _mm_setzero_si128();
+				continue;
+			}
+			blocks[2 * l] = _mm_xor_si128(lanes[l].mac, NextMacBlock(lanes[l]));
+			blocks[2 * l + 1] = NextCounterBlock(lanes[l]);
+		}
+		EncryptBlocks<2 * LANES>(key, blocks);
+
+		for (int l = 0; l < LANES; l++) {
+			if (lanes[l].op == NULL) continue;
+			lanes[l].mac = blocks[2 * l];
+			AbsorbKeystream(lanes[l], blocks[2 * l + 1]);
+			if (!LaneDone(lanes[l])) continue;
+			FinishLane(lanes[l]);
+			if (next < count) {
+				StartLane(lanes[l], &ops[next++]);
+			} else {
+				lanes[l].op = NULL;
+				active--;
+			}
+		}
+	}
+}
+
+#endif
+
+void MultiCcm::Run(const AesniKey &key, CcmMultiOp *ops, size_t count) {
+#ifdef AEAD_HAVE_AESNI
+	RunLanes(key, ops, count);
+#else
+	(void)key;
+	(void)ops;
+	(void)count;
+#endif
+}
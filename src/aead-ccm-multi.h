@@ -0,0 +1,58 @@
+#ifndef AEAD_CCM_MULTI_H_
+#define AEAD_CCM_MULTI_H_
+
+#include <stddef.h>
+
+#include "aead-aesni.h"
+
+namespace aead {
+
+    // One message of a multi-buffer run
+    struct CcmMultiOp {
+        bool encrypt;
+        // 7 to 13 bytes
+        const unsigned char *iv;
+        size_t iv_len;
+        const unsigned char *aad;
+        size_t aad_len;
+        const unsigned char *in;
+        size_t len;
+        // must not overlap the input
+        unsigned char *out;
+        // written when encrypting and checked when decrypting
+        unsigned char *tag;
+        size_t tag_len;
+        // set when decrypting; a plaintext that failed authentication is zeroed
+        bool auth_ok;
+    };
+
+    // CCM over many independent messages with one key at once.
+    //
+    // Each block of a CBC-MAC waits for the encryption of the one before, so
+    // a single message leaves AES-NI's pipeline mostly empty. Here, LANES
+    // messages are processed side by side: each step runs one CBC-MAC block
+    // and one counter block of every lane, and all of them are encrypted
+    // together. The keystream runs one step ahead of the MAC, so decryption
+    // has the plaintext ready when the MAC needs it. A lane whose message is
+    // done picks up the next one.
+    class MultiCcm {
+    public:
+        static const int LANES = 8;
+        // Longer messages are left to OpenSSL, which streams them as fast
+        static const size_t MAX_LENGTH = 256;
+
+        // Whether the kernel can run here
+        static bool Supported() { return Aesni::Supported(); }
+        // Whether an operation fits the kernel; others need the generic path
+        static bool Accepts(size_t iv_len, size_t len, size_t auth_tag_len) {
+            return iv_len >= 7 && iv_len <= 13 && len <= MAX_LENGTH &&
+                auth_tag_len >= 4 && auth_tag_len <= 16 && auth_tag_len % 2 == 0;
+        }
+
+        // Processes all operations; only call if Supported()
+        static void Run(const AesniKey &key, CcmMultiOp *ops, size_t count);
+    };
+
+}
+
+#endif
@@ -0,0 +1,293 @@
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include "aead-ccm-parallel.h"
+#include "aead-parallel.h"
+
+using namespace aead;
+
+// Bytes fed through the CBC-MAC at a time
+static const size_t MAC_PIECE_SIZE = 64 << 10;
+// EVP_*Update takes int lengths
+static const size_t MAX_UPDATE = 1 << 30;
+
+// ==================
+
+static bool Ciphers(size_t key_len, const EVP_CIPHER **ctr, const EVP_CIPHER **cbc) {
+	switch (key_len) {
+		case 16:
+			*ctr = EVP_aes_128_ctr(); *cbc = EVP_aes_128_cbc();
+			return true;
+		case 24:
+			*ctr = EVP_aes_192_ctr(); *cbc = EVP_aes_192_cbc();
+			return true;
+		case 32:
+			*ctr = EVP_aes_256_ctr(); *cbc = EVP_aes_256_cbc();
+			return true;
+		default:
+			return false;
+	}
+}
+
+// Writes value big endian into the last len bytes of the block
+static void StoreCounter(uint64_t value, size_t len, unsigned char *block) {
+	for (size_t i = 0; i < len; i++, value >>= 8) block[15 - i] = (unsigned char)value;
+}
+
+static bool Overlaps(const unsigned char *a, const unsigned char *b, size_t len) {
+	return len > 0 && a < b + len && b < a + len;
+}
+
+// ==================
+
+// A CBC-MAC with a zero IV over data fed in arbitrary pieces, which are
+// padded with zeroes to whole blocks on request
+class ParallelCcm::Mac {
+public:
+	Mac() : ctx_(EVP_CIPHER_CTX_new()), partial_len_(0), ok_(ctx_ != NULL), scratch_(MAC_PIECE_SIZE) {
+		memset(last_, 0, sizeof(last_));
+	}
+
+	~Mac() {
+		EVP_CIPHER_CTX_free(ctx_);
+		OPENSSL_cleanse(partial_, sizeof(partial_));
+		OPENSSL_cleanse(last_, sizeof(last_));
+		OPENSSL_cleanse(scratch_.data(), scratch_.size());
+	}
+
+	bool Init(const EVP_CIPHER *cbc, const unsigned char *key) {
+		static const unsigned char zero_iv[16] = { 0 };
+		ok_ = ok_ && EVP_EncryptInit_ex(ctx_, cbc, NULL, key, zero_iv) == 1 &&
+			EVP_CIPHER_CTX_set_padding(ctx_, 0) == 1;
+		return ok_;
+	}
+
+	void Update(const unsigned char *data, size_t len) {
+		if (partial_len_ > 0) {
+			const size_t n = std::min(len, 16 - partial_len_);
+			memcpy(partial_ + partial_len_, data, n);
+			partial_len_ += n;
+			data += n;
+			len -= n;
+			if (partial_len_ < 16) return;
+			Blocks(partial_, 16);
+			partial_len_ = 0;
+		}
+		const size_t whole = len / 16 * 16;
+		for (size_t offset = 0; offset < whole; ) {
+			const size_t n = std::min(MAC_PIECE_SIZE, whole - offset);
+			Blocks(data + offset, n);
+			offset += n;
+		}
+		memcpy(partial_, data + whole, len - whole);
+		partial_len_ = len - whole;
+	}
+
+	// Completes the current block with zeroes
+	void Pad() {
+		if (partial_len_ == 0) return;
+		memset(partial_ + partial_len_, 0, 16 - partial_len_);
+		Blocks(partial_, 16);
+		partial_len_ = 0;
+	}
+
+	// The last cipher block is the MAC; the data must end on a block boundary
+	bool Final(unsigned char *mac) {
+		if (!ok_ || partial_len_ != 0) return false;
+		memcpy(mac, last_, 16);
+		return true;
+	}
+
+private:
+	void Blocks(const unsigned char *data, size_t len) {
+		int outl;
+		ok_ = ok_ && EVP_EncryptUpdate(ctx_, scratch_.data(), &outl, data, (int)len) == 1 && outl == (int)len;
+		if (ok_) memcpy(last_, scratch_.data() + len - 16, 16);
+	}
+
+	EVP_CIPHER_CTX *ctx_;
+	unsigned char partial_[16];
+	size_t partial_len_;
+	unsigned char last_[16];
+	bool ok_;
+	std::vector<unsigned char> scratch_;
+};
+
+// Runs the CTR keystream over one chunk
+class ParallelCcm::Work : public ChunkedWork {
+public:
+	const EVP_CIPHER *ctr;
+	const unsigned char *key;
+	const unsigned char *in;
+	unsigned char *out;
+	size_t len;
+	size_t chunk_size;
+	// Ctr_0, flags || nonce || 0^8q
+	unsigned char ctr0[16];
+	size_t q;
+
+protected:
+	bool ProcessChunk(size_t index) {
+		const size_t begin = index * chunk_size;
+		const size_t end = std::min(begin + chunk_size, len);
+		// the payload starts with Ctr_1; the counter fits into q bytes for
+		// any valid length, so OpenSSL's 128 bit increment gives the same
+		unsigned char counter[16];
+		memcpy(counter, ctr0, 16);
+		StoreCounter(1 + begin / 16, q, counter);
+
+		EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+		bool ok = ctx != NULL && EVP_EncryptInit_ex(ctx, ctr, NULL, key, counter) == 1;
+		for (size_t offset = begin; ok && offset < end; ) {
+			const size_t n = std::min(MAX_UPDATE, end - offset);
+			int outl;
+			ok = EVP_EncryptUpdate(ctx, out + offset, &outl, in + offset, (int)n) == 1;
+			offset += n;
+		}
+		EVP_CIPHER_CTX_free(ctx);
+		return ok;
+	}
+};
+
+// ==================
+
+bool ParallelCcm::Encrypt(const unsigned char *key, size_t key_len,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext,
+	unsigned char *auth_tag, size_t auth_tag_len
+) {
+	return Run(true, key, key_len, iv, iv_len, aad, aad_len, plaintext, len, ciphertext, auth_tag, auth_tag_len);
+}
+
+bool ParallelCcm::Decrypt(const unsigned char *key, size_t key_len,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext,
+	const unsigned char *auth_tag, size_t auth_tag_len,
+	bool *auth_ok
+) {
+	unsigned char expected[16];
+	if (!Run(false, key, key_len, iv, iv_len, aad, aad_len, ciphertext, len, plaintext, expected, auth_tag_len)) {
+		return false;
+	}
+	*auth_ok = CRYPTO_memcmp(expected, auth_tag, auth_tag_len) == 0;
+	// like OpenSSL, never hand out unauthenticated plaintext
+	if (!*auth_ok) OPENSSL_cleanse(plaintext, len);
+	OPENSSL_cleanse(expected, sizeof(expected));
+	return true;
+}
+
+bool ParallelCcm::Run(bool encrypt, const unsigned char *key, size_t key_len,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *in, size_t len, unsigned char *out,
+	unsigned char *tag, size_t tag_len
+) {
+	// the parameters allowed by SP 800-38C; the message length must fit
+	// into the q = 15 - n bytes left by the nonce
+	const size_t q = 15 - iv_len;
+	if (iv_len < 7 || iv_len > 13 || tag_len < 4 || tag_len > 16 || tag_len % 2 != 0 ||
+		(q < 8 && (uint64_t)len >> (8 * q) != 0) || Overlaps(in, out, len)
+	) {
+		return false;
+	}
+	std::shared_ptr<Work> work(new Work());
+	const EVP_CIPHER *cbc;
+	if (!Ciphers(key_len, &work->ctr, &cbc)) return false;
+	work->key = key;
+	work->in = in;
+	work->out = out;
+	work->len = len;
+	work->q = q;
+	memset(work->ctr0, 0, sizeof(work->ctr0));
+	work->ctr0[0] = (unsigned char)(q - 1);
+	memcpy(work->ctr0 + 1, iv, iv_len);
+
+	// split the message and let the pool run the keystream
+	work->chunk_size = ChunkedWork::ChunkSize(len);
+	work->Init(len == 0 ? 0 : (len + work->chunk_size - 1) / work->chunk_size);
+	work->StartHelpers();
+
+	// B_0 is flags || nonce || [len]q. The additional data follows,
+	// prefixed with its length encoded in 2, 6 or 10 bytes; the prefix and
+	// the start of the data fill the second block, zero padded if the data
+	// ends there. Whole blocks keep the partial block handling of the MAC
+	// out of this.
+	Mac mac;
+	bool ok = mac.Init(cbc, key);
+	unsigned char head[32];
+	memset(head, 0, sizeof(head));
+	head[0] = (unsigned char)((aad_len > 0 ? 0x40 : 0) | ((tag_len - 2) / 2) << 3 | (q - 1));
+	memcpy(head + 1, iv, iv_len);
+	StoreCounter(len, q, head);
+	size_t aad_head = 0;
+	if (aad_len > 0) {
+		unsigned char *prefix = head + 16;
+		size_t prefix_len;
+		if (aad_len < 0xff00) {
+			prefix_len = 2;
+		} else if ((uint64_t)aad_len <= 0xffffffff) {
+			prefix[0] = 0xff; prefix[1] = 0xfe;
+			prefix_len = 6;
+		} else {
+			prefix[0] = 0xff; prefix[1] = 0xff;
+			prefix_len = 10;
+		}
+		const size_t start = prefix_len == 2 ? 0 : 2;
+		uint64_t value = aad_len;
+		for (size_t i = prefix_len; i > start; value >>= 8) prefix[--i] = (unsigned char)value;
+		aad_head = std::min(aad_len, 16 - prefix_len);
+		memcpy(prefix + prefix_len, aad, aad_head);
+		mac.Update(head, 32);
+	} else {
+		mac.Update(head, 16);
+	}
+	if (aad_len > aad_head) {
+		mac.Update(aad + aad_head, aad_len - aad_head);
+		mac.Pad();
+	}
+
+	// The MAC covers the plaintext: the input when encrypting, and the
+	// helpers' output, chunk by chunk as it is done, when decrypting.
+	// Even if something failed, the chunks are run to the end: helpers may
+	// already be working on the caller's buffers.
+	if (encrypt) {
+		mac.Update(in, len);
+	} else {
+		for (size_t i = 0; i < work->chunks(); i++) {
+			work->WaitForChunk(i);
+			const size_t begin = i * work->chunk_size;
+			mac.Update(out + begin, std::min(work->chunk_size, len - begin));
+		}
+	}
+	ok = work->Finish() && ok;
+	mac.Pad();
+
+	// the tag is the MAC masked with the keystream block for Ctr_0
+	unsigned char block[16];
+	unsigned char mask[16];
+	ok = ok && mac.Final(block);
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int outl;
+	static const unsigned char zero_block[16] = { 0 };
+	ok = ok && ctx != NULL &&
+		EVP_EncryptInit_ex(ctx, work->ctr, NULL, key, work->ctr0) == 1 &&
+		EVP_EncryptUpdate(ctx, mask, &outl, zero_block, 16) == 1;
+	if (ok) {
+		for (size_t i = 0; i < tag_len; i++) tag[i] = block[i] ^ mask[i];
+	}
+	EVP_CIPHER_CTX_free(ctx);
+	// the plaintext of a failed decryption is not authenticated
+	if (!ok && !encrypt) OPENSSL_cleanse(out, len);
+	OPENSSL_cleanse(mask, sizeof(mask));
+	OPENSSL_cleanse(block, sizeof(block));
+	return ok;
+}
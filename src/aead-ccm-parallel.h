@@ -0,0 +1,51 @@
+#ifndef AEAD_CCM_PARALLEL_H_
+#define AEAD_CCM_PARALLEL_H_
+
+#include <stddef.h>
+
+namespace aead {
+
+    // CCM for single large messages, with the two passes over the message
+    // running at the same time (see ChunkedWork for when messages are split).
+    //
+    // CCM authenticates with a CBC-MAC, which is inherently serial, and
+    // encrypts with CTR, which is not. So the calling thread runs the
+    // CBC-MAC over the whole message while helpers on the crypto thread pool
+    // run the CTR keystream over its chunks; both join for the tag. When
+    // decrypting, the MAC is over the plaintext, so the caller follows the
+    // helpers chunk by chunk. The output and tag are bit-identical to CCM
+    // as in NIST SP 800-38C.
+    class ParallelCcm {
+    public:
+        // Both return false if OpenSSL fails, or the parameters are not valid
+        // for CCM or the input and output overlap. The caller should then
+        // use the sequential code. A plaintext that failed authentication
+        // is zeroed.
+        static bool Encrypt(const unsigned char *key, size_t key_len,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext,
+            unsigned char *auth_tag, size_t auth_tag_len);
+        static bool Decrypt(const unsigned char *key, size_t key_len,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext,
+            const unsigned char *auth_tag, size_t auth_tag_len,
+            bool *auth_ok);
+
+    private:
+        class Work;
+        class Mac;
+
+        static bool Run(bool encrypt, const unsigned char *key, size_t key_len,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *in, size_t len, unsigned char *out,
+            unsigned char *tag, size_t tag_len);
+    };
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include <string.h>
+#include <algorithm>
+#include <openssl/crypto.h>
+
+#include "aead-ccm-small.h"
+#include "aead-ccm-format.h"
+
+using namespace aead;
+
+#ifdef AEAD_HAVE_AESNI
+
+using namespace aead::aesni;
+
+// Encrypts or decrypts the message and returns the full 16 byte tag, of
+// which the caller uses the first tag_len bytes
+AEAD_TARGET_AESNI static __m128i Run(const AesniKey &key, bool encrypt,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *in, size_t len, unsigned char *out, size_t tag_len
+) {
+	CcmFormat format;
+	format.Init(iv, iv_len, aad_len, len, tag_len);
+
+	// Ctr_0 for the tag mask, Ctr_1 to Ctr_4 for the message (q is at
+	// least 2), and B_0 for the first CBC-MAC block
+	const __m128i ctr0 = Load(format.ctr0);
+	__m128i blocks[6];
+	for (int i = 0; i < 5; i++) blocks[i] = _mm_insert_epi16(ctr0, __builtin_bswap16((uint16_t)i), 7);
+	blocks[5] = Load(format.b0);
+	EncryptBlocks<6>(key, blocks);
+
+	for (size_t pos = 0, i = 1; pos < len; pos += 16, i++) {
+		const size_t n = std::min((size_t)16, len - pos);
+		StorePartial(_mm_xor_si128(LoadPartial(in + pos, n), blocks[i]), out + pos, n);
+	}
+
+	__m128i mac = blocks[5];
+	const size_t aad_blocks = format.AadBlocks();
+	for (size_t i = 0; i < aad_blocks; i++) {
+		alignas(16) unsigned char block[16];
+		format.AadBlock(aad, i, block);
+		mac = EncryptBlock(key, _mm_xor_si128(mac, _mm_load_si128((const __m128i *)block)));
+	}
+	// the MAC is over the plaintext
+	const unsigned char *plaintext = encrypt ? in : out;
+	for (size_t pos = 0; pos < len; pos += 16) {
+		const size_t n = std::min((size_t)16, len - pos);
+		mac = EncryptBlock(key, _mm_xor_si128(mac, LoadPartial(plaintext + pos, n)));
+	}
+	return _mm_xor_si128(mac, blocks[0]);
+}
+
+#endif
+
+void SmallCcm::Encrypt(const AesniKey &key,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext,
+	unsigned char *auth_tag, size_t auth_tag_len
+) {
+#ifdef AEAD_HAVE_AESNI
+	alignas(16) unsigned char tag[16];
+	_mm_store_si128((__m128i *)tag, Run(key, true, iv, iv_len, aad, aad_len, plaintext, len, ciphertext, auth_tag_len));
+	memcpy(auth_tag, tag, auth_tag_len);
+	OPENSSL_cleanse(tag, sizeof(tag));
+#else
+	(void)key; (void)iv; (void)iv_len; (void)aad; (void)aad_len;
+	(void)plaintext; (void)len; (void)ciphertext; (void)auth_tag; (void)auth_tag_len;
+#endif
+}
+
+bool SmallCcm::Decrypt(const AesniKey &key,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext,
+	const unsigned char *auth_tag, size_t auth_tag_len
+) {
+#ifdef AEAD_HAVE_AESNI
+	alignas(16) unsigned char tag[16];
+	_mm_store_si128((__m128i *)tag, Run(key, false, iv, iv_len, aad, aad_len, ciphertext, len, plaintext, auth_tag_len));
+	const bool auth_ok = CRYPTO_memcmp(tag, auth_tag, auth_tag_len) == 0;
+	OPENSSL_cleanse(tag, sizeof(tag));
+	if (!auth_ok) OPENSSL_cleanse(plaintext, len);
+	return auth_ok;
+#else
+	(void)key; (void)iv; (void)iv_len; (void)aad; (void)aad_len;
+	(void)ciphertext; (void)len; (void)plaintext; (void)auth_tag; (void)auth_tag_len;
+	return false;
+#endif
+}
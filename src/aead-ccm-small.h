@@ -0,0 +1,44 @@
+#ifndef AEAD_CCM_SMALL_H_
+#define AEAD_CCM_SMALL_H_
+
+#include <stddef.h>
+
+#include "aead-aesni.h"
+
+namespace aead {
+
+    // CCM for single short messages.
+    //
+    // The keystream, the tag mask and the first CBC-MAC block are encrypted
+    // in one interleaved pass; only the rest of the CBC-MAC is serial. When
+    // decrypting, the plaintext is thus ready before the MAC needs it. The
+    // output is identical to OpenSSL's.
+    class SmallCcm {
+    public:
+        static const size_t MAX_LENGTH = 64;
+
+        // Whether a message fits; the key must come from Aesni
+        static bool Accepts(size_t iv_len, size_t len, size_t auth_tag_len) {
+            return iv_len >= 7 && iv_len <= 13 && len <= MAX_LENGTH &&
+                auth_tag_len >= 4 && auth_tag_len <= 16 && auth_tag_len % 2 == 0;
+        }
+
+        static void Encrypt(const AesniKey &key,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext,
+            unsigned char *auth_tag, size_t auth_tag_len);
+        // Returns whether the tag matched; a plaintext that failed
+        // authentication is zeroed
+        static bool Decrypt(const AesniKey &key,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext,
+            const unsigned char *auth_tag, size_t auth_tag_len);
+    };
+
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include <stdint.h>
+#include <string.h>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <cpuid.h>
+#define AEAD_CPUID_GNUC
+#endif
+#if defined(__linux__) && (defined(__aarch64__) || defined(__arm__))
+#include <sys/auxv.h>
+#define AEAD_AUXV_ARM
+#endif
+
+#include "aead-cpu.h"
+
+using namespace aead;
+
+// Runs CPUID for the given leaf; returns false if the leaf doesn't exist
+static bool Cpuid(unsigned int leaf, unsigned int regs[4]) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 0);
+	if ((unsigned int)info[0] < leaf) return false;
+	__cpuidex(info, (int)leaf, 0);
+	for (int i = 0; i < 4; i++) regs[i] = (unsigned int)info[i];
+	return true;
+#elif defined(AEAD_CPUID_GNUC)
+	if ((unsigned int)__get_cpuid_max(0, NULL) < leaf) return false;
+	__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+	return true;
+#else
+	(void)leaf;
+	(void)regs;
+	return false;
+#endif
+}
+
+// The register state the OS saves on context switches (XCR0)
+static uint64_t Xgetbv() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	return _xgetbv(0);
+#elif defined(AEAD_CPUID_GNUC)
+	unsigned int eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#else
+	return 0;
+#endif
+}
+
+static CpuFeatures Detect() {
+	CpuFeatures features;
+	memset(&features, 0, sizeof(features));
+	unsigned int regs[4];
+	if (Cpuid(1, regs)) {
+		const unsigned int ecx = regs[2];
+		features.pclmulqdq = (ecx >> 1) & 1;
+		features.ssse3 = (ecx >> 9) & 1;
+		features.sse41 = (ecx >> 19) & 1;
+		features.aesni = (ecx >> 25) & 1;
+		features.aes_missing = !features.aesni;
+
+		// OSXSAVE, then SSE and AVX state (and the AVX-512 state) in XCR0
+		const uint64_t xcr0 = ((ecx >> 27) & 1) ? Xgetbv() : 0;
+		const bool ymm = (xcr0 & 0x06) == 0x06;
+		const bool zmm = (xcr0 & 0xe6) == 0xe6;
+		features.avx = ymm && ((ecx >> 28) & 1);
+		if (features.avx && Cpuid(7, regs)) {
+			const unsigned int ebx7 = regs[1], ecx7 = regs[2];
+			features.avx2 = (ebx7 >> 5) & 1;
+			features.avx512f = zmm && ((ebx7 >> 16) & 1);
+			features.vaes = (ecx7 >> 9) & 1;
+			features.vpclmulqdq = (ecx7 >> 10) & 1;
+		}
+	}
+#if defined(AEAD_AUXV_ARM) && defined(__aarch64__)
+	// HWCAP_AES
+	features.aes_missing = !((getauxval(AT_HWCAP) >> 3) & 1);
+#elif defined(AEAD_AUXV_ARM)
+	// HWCAP2_AES, only set by 64 bit CPUs running 32 bit code
+	features.aes_missing = !(getauxval(AT_HWCAP2) & 1);
+#endif
+	return features;
+}
+
+const CpuFeatures &CpuFeatures::Get() {
+	static const CpuFeatures features = Detect();
+	return features;
+}
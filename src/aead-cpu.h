@@ -0,0 +1,32 @@
+#ifndef AEAD_CPU_H_
+#define AEAD_CPU_H_
+
+namespace aead {
+
+    // Instruction set extensions of the CPU, detected once through CPUID,
+    // for choosing between the built-in kernels and OpenSSL. All false on
+    // other architectures.
+    struct CpuFeatures {
+        bool aesni;
+        bool pclmulqdq;
+        bool ssse3;
+        bool sse41;
+        // The 256 bit extensions are only set if the OS saves the YMM
+        // registers, and avx512f only if it saves the ZMM registers too
+        bool avx;
+        bool avx2;
+        bool vaes;
+        bool vpclmulqdq;
+        bool avx512f;
+        // Whether the CPU is known to lack AES instructions, so OpenSSL
+        // falls back to lookup tables: x86 without AES-NI, or ARM Linux
+        // without the ARMv8 crypto extension (from the ELF auxiliary
+        // vector). False where that can't be told.
+        bool aes_missing;
+
+        static const CpuFeatures &Get();
+    };
+
+}
+
+#endif
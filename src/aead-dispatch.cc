@@ -0,0 +1,67 @@
+#include <algorithm>
+
+#include "aead-dispatch.h"
+
+using namespace aead;
+
+// Weight of a new sample in the moving averages
+static const double EWMA_WEIGHT = 1.0 / 16;
+// Samples are capped at this multiple of the current estimate, so a thread
+// that was preempted while it was being timed doesn't skew the model
+static const double MAX_SAMPLE_RATIO = 4;
+// Messages up to this size update the fixed cost, larger ones the per-byte cost
+static const size_t SMALL_MESSAGE = 256;
+
+DispatchEstimator &DispatchEstimator::Get() {
+	static DispatchEstimator *estimator = new DispatchEstimator();
+	return *estimator;
+}
+
+// Conservative starting points until the first measurements come in:
+// about 4 KiB messages are processed inline
+DispatchEstimator::DispatchEstimator() : dispatch_(5000) {
+	fixed_[MODE_GCM].store(500);
+	per_byte_[MODE_GCM].store(1);
+	fixed_[MODE_CCM].store(500);
+	per_byte_[MODE_CCM].store(2);
+}
+
+static void Update(std::atomic<double> &average, double sample) {
+	const double current = average.load(std::memory_order_relaxed);
+	// the slack lets an estimate that has reached zero recover
+	sample = std::min(sample, current * MAX_SAMPLE_RATIO + 1);
+	average.store(current + (sample - current) * EWMA_WEIGHT, std::memory_order_relaxed);
+}
+
+size_t DispatchEstimator::Cutoff(Mode mode) const {
+	const double fixed = fixed_ns(mode);
+	const double per_byte = std::max(per_byte_ns(mode), 1e-3);
+	const double budget = std::min(dispatch_ns(), (double)MAX_INLINE_NS);
+	if (budget <= fixed) return 0;
+	return (size_t)((budget - fixed) / per_byte);
+}
+
+bool DispatchEstimator::ShouldInline(Mode mode, size_t bytes) const {
+	return bytes <= Cutoff(mode);
+}
+
+void DispatchEstimator::RecordRun(Mode mode, size_t bytes, uint64_t ns) {
+	if (bytes <= SMALL_MESSAGE) {
+		Update(fixed_[mode], std::max(0.0, ns - per_byte_ns(mode) * bytes));
+	} else {
+		Update(per_byte_[mode], std::max(0.0, ns - fixed_ns(mode)) / bytes);
+	}
+}
+
+void DispatchEstimator::RecordDispatch(uint64_t ns) {
+	Update(dispatch_, (double)ns);
+}
+
+void DispatchEstimator::Seed(Mode mode, double fixed_ns, double per_byte_ns) {
+	fixed_[mode].store(fixed_ns, std::memory_order_relaxed);
+	per_byte_[mode].store(per_byte_ns, std::memory_order_relaxed);
+}
+
+void DispatchEstimator::SeedDispatch(double dispatch_ns) {
+	dispatch_.store(dispatch_ns, std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#ifndef AEAD_DISPATCH_H_
+#define AEAD_DISPATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "aead-key.h"
+
+namespace aead {
+
+    // Online cost model for choosing between running an operation inline on
+    // the JS thread and handing it to the thread pool. Processing a message
+    // is modeled as fixed + per_byte * bytes; the pool adds the latency of
+    // queueing, waking a worker and getting back to the event loop, which
+    // grows with load. All three are exponentially weighted moving averages
+    // fed by the operations themselves, so the cutoff adapts to the CPU
+    // and the current load. Shared by all threads; lost updates are harmless.
+    class DispatchEstimator {
+    public:
+        // Nothing runs inline for longer than this, to keep the event loop responsive
+        static const uint64_t MAX_INLINE_NS = 100000;
+
+        static DispatchEstimator &Get();
+
+        // Whether processing the message inline is faster than the pool
+        bool ShouldInline(Mode mode, size_t bytes) const;
+        // The largest message that is processed inline
+        size_t Cutoff(Mode mode) const;
+
+        // Processing a message of the given size took ns
+        void RecordRun(Mode mode, size_t bytes, uint64_t ns);
+        // A pool job took ns longer than processing it inline would have
+        void RecordDispatch(uint64_t ns);
+
+        // Replaces the estimates, e.g. with those of a tuning profile, so the
+        // cutoff is right before the first measurements come in
+        void Seed(Mode mode, double fixed_ns, double per_byte_ns);
+        void SeedDispatch(double dispatch_ns);
+
+        double fixed_ns(Mode mode) const { return fixed_[mode].load(std::memory_order_relaxed); }
+        double per_byte_ns(Mode mode) const { return per_byte_[mode].load(std::memory_order_relaxed); }
+        double dispatch_ns() const { return dispatch_.load(std::memory_order_relaxed); }
+
+    private:
+        DispatchEstimator();
+
+        std::atomic<double> fixed_[2];
+        std::atomic<double> per_byte_[2];
+        std::atomic<double> dispatch_;
+    };
+
+}
+
+#endif
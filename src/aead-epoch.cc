@@ -0,0 +1,45 @@
+#include <thread>
+
+#include "aead-epoch.h"
+
+using namespace aead;
+
+// Threads take the stripes in turn, so up to STRIPES of them read without sharing one
+static size_t ThreadStripe(size_t stripes) {
+	static std::atomic<size_t> next(0);
+	static thread_local size_t stripe = next.fetch_add(1, std::memory_order_relaxed);
+	return stripe % stripes;
+}
+
+ReaderEpoch::ReaderEpoch() : epoch_(0) {
+	for (size_t i = 0; i < STRIPES; i++) {
+		stripes_[i].readers[0].store(0, std::memory_order_relaxed);
+		stripes_[i].readers[1].store(0, std::memory_order_relaxed);
+	}
+}
+
+// Announces the reader before it loads anything. With sequentially
+// consistent ordering, a writer either sees us and waits for us before
+// freeing what it replaced, or we see the state after its update.
+ReaderEpoch::Reader::Reader(ReaderEpoch &epoch) {
+	Stripe &stripe = epoch.stripes_[ThreadStripe(STRIPES)];
+	count_ = &stripe.readers[epoch.epoch_.load() & 1];
+	count_->fetch_add(1);
+}
+
+ReaderEpoch::Reader::~Reader() {
+	count_->fetch_sub(1, std::memory_order_release);
+}
+
+// Readers may have loaded the epoch long before they counted themselves,
+// in either phase, so both phases are flipped and drained in turn; each
+// one only gets such late readers after its flip, and drains within a
+// read.
+void ReaderEpoch::Synchronize() {
+	for (int flip = 0; flip < 2; flip++) {
+		const size_t phase = epoch_.fetch_add(1) & 1;
+		for (size_t i = 0; i < STRIPES; i++) {
+			while (stripes_[i].readers[phase].load() != 0) std::this_thread::yield();
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#ifndef AEAD_EPOCH_H_
+#define AEAD_EPOCH_H_
+
+#include <stddef.h>
+#include <atomic>
+
+namespace aead {
+
+    // Lets lock-free readers use objects that a writer may unpublish, and the
+    // writer wait until no reader can still use them before freeing them.
+    //
+    // Readers announce themselves on one of several counter stripes, picked
+    // per thread and each on its own cache line, so threads reading at the
+    // same time don't contend. Each stripe counts the readers of the two
+    // phases of an epoch separately. Synchronize flips the epoch and waits
+    // until the readers of the old phase are gone, which takes no longer
+    // than one read, since new readers count in the other phase.
+    class ReaderEpoch {
+    public:
+        // Counts the calling thread as a reader while in scope. Whatever the
+        // reader loads after the constructor stays valid until it is
+        // destroyed.
+        class Reader {
+        public:
+            explicit Reader(ReaderEpoch &epoch);
+            ~Reader();
+
+        private:
+            Reader(const Reader &);
+            Reader &operator=(const Reader &);
+
+            std::atomic<size_t> *count_;
+        };
+
+        ReaderEpoch();
+
+        // Waits until no reader can still use what was unpublished before
+        // the call. Writers must not call it concurrently.
+        void Synchronize();
+
+    private:
+        // Reader counts of both phases, padded to a cache line
+        struct Stripe {
+            std::atomic<size_t> readers[2];
+            char padding[64 - 2 * sizeof(std::atomic<size_t>)];
+        };
+        static const size_t STRIPES = 32;
+
+        std::atomic<size_t> epoch_;
+        Stripe stripes_[STRIPES];
+    };
+
+}
+
+#endif
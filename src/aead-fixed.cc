@@ -0,0 +1,593 @@
+#include <string.h>
+#include <algorithm>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include "aead-fixed.h"
+#include "aead-ccm-format.h"
+#include "aead-gcm-small.h"
+#include "aead-gcm-wide.h"
+#include "aead-soft.h"
+
+using namespace aead;
+
+// The OpenSSL cipher for each key length, resolved at compile time
+template <size_t KeyLen> struct FixedCipher;
+template <> struct FixedCipher<16> {
+	static const EVP_CIPHER *Gcm() { return EVP_aes_128_gcm(); }
+	static const EVP_CIPHER *Ccm() { return EVP_aes_128_ccm(); }
+};
+template <> struct FixedCipher<24> {
+	static const EVP_CIPHER *Gcm() { return EVP_aes_192_gcm(); }
+	static const EVP_CIPHER *Ccm() { return EVP_aes_192_ccm(); }
+};
+template <> struct FixedCipher<32> {
+	static const EVP_CIPHER *Gcm() { return EVP_aes_256_gcm(); }
+	static const EVP_CIPHER *Ccm() { return EVP_aes_256_ccm(); }
+};
+
+#ifdef AEAD_HAVE_AESNI
+
+using namespace aead::aesni;
+
+// counter blocks per iteration
+static const int BLOCKS = 8;
+static const size_t CHUNK = 16 * BLOCKS;
+
+struct GhashPowers {
+	// H^1 .. H^4
+	__m128i h[4];
+};
+
+AEAD_TARGET_AESNI static inline void LoadPowers(const AesniKey &key, GhashPowers &powers) {
+	powers.h[0] = _mm_load_si128((const __m128i *)key.h);
+	powers.h[1] = _mm_load_si128((const __m128i *)key.h2);
+	powers.h[2] = _mm_load_si128((const __m128i *)key.h3);
+	powers.h[3] = _mm_load_si128((const __m128i *)key.h4);
+}
+
+// Hashes four whole blocks with one reduction:
+// (x ^ B1) * H^4 ^ B2 * H^3 ^ B3 * H^2 ^ B4 * H
+AEAD_TARGET_AESNI static inline __m128i Hash4(const GhashPowers &powers, __m128i x, const unsigned char *p) {
+	__m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+	for (int i = 0; i < 4; i++) {
+		__m128i block = ByteSwap(Load(p + 16 * i));
+		if (i == 0) block = _mm_xor_si128(block, x);
+		MulAdd(block, powers.h[3 - i], lo, mid, hi);
+	}
+	return Reduce(lo, mid, hi);
+}
+
+// Hashes data of any length, padded with zeroes to whole blocks
+AEAD_TARGET_AESNI static __m128i Ghash(const GhashPowers &powers, __m128i x, const unsigned char *p, size_t len) {
+	for (; len >= 64; p += 64, len -= 64) x = Hash4(powers, x, p);
+	if (len == 0) return x;
+	const size_t n = (len + 15) / 16;
+	__m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+	for (size_t i = 0; i < n; i++) {
+		__m128i block = ByteSwap(LoadPartial(p + 16 * i, std::min((size_t)16, len - 16 * i)));
+		if (i == 0) block = _mm_xor_si128(block, x);
+		MulAdd(block, powers.h[n - 1 - i], lo, mid, hi);
+	}
+	return Reduce(lo, mid, hi);
+}
+
+// Encrypts or decrypts a GCM message with a 12 byte IV and returns the tag
+template <int Rounds>
+AEAD_TARGET_AESNI static __m128i GcmCrypt(const AesniKey &key, bool encrypt, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *in, size_t len, unsigned char *out
+) {
+	GhashPowers powers;
+	LoadPowers(key, powers);
+	// J0 = IV || 1 masks the tag, the message starts at counter 2
+	const __m128i j0 = LoadPartial(iv, 12);
+	__m128i mask = _mm_insert_epi32(j0, (int)__builtin_bswap32(1), 3);
+	EncryptRounds<Rounds, 1>(key, &mask);
+	__m128i x = Ghash(powers, _mm_setzero_si128(), aad, aad_len);
+
+	uint32_t counter = 2;
+	__m128i keystream[BLOCKS];
+	size_t pos = 0;
+	for (; len - pos >= CHUNK; pos += CHUNK) {
+		for (int i = 0; i < BLOCKS; i++) keystream[i] = _mm_insert_epi32(j0, (int)__builtin_bswap32(counter++), 3);
+		EncryptRounds<Rounds, BLOCKS>(key, keystream);
+		// before the output, which may be the input
+		if (!encrypt) {
+			x = Hash4(powers, x, in + pos);
+			x = Hash4(powers, x, in + pos + 64);
+		}
+		for (int i = 0; i < BLOCKS; i++) {
+			Store(_mm_xor_si128(Load(in + pos + 16 * i), keystream[i]), out + pos + 16 * i);
+		}
+		if (encrypt) {
+			x = Hash4(powers, x, out + pos);
+			x = Hash4(powers, x, out + pos + 64);
+		}
+	}
+	if (pos < len) {
+		const size_t rest = len - pos;
+		for (int i = 0; i < BLOCKS; i++) keystream[i] = _mm_insert_epi32(j0, (int)__builtin_bswap32(counter++), 3);
+		EncryptRounds<Rounds, BLOCKS>(key, keystream);
+		if (!encrypt) x = Ghash(powers, x, in + pos, rest);
+		for (size_t i = 0; 16 * i < rest; i++) {
+			const size_t n = std::min((size_t)16, rest - 16 * i);
+			StorePartial(_mm_xor_si128(LoadPartial(in + pos + 16 * i, n), keystream[i]), out + pos + 16 * i, n);
+		}
+		if (encrypt) x = Ghash(powers, x, out + pos, rest);
+	}
+
+	// [8 * aad_len]64 || [8 * len]64, byte reversed
+	const __m128i lengths = _mm_set_epi64x((long long)((uint64_t)aad_len * 8), (long long)((uint64_t)len * 8));
+	x = GfMul(_mm_xor_si128(x, lengths), powers.h[0]);
+	const __m128i tag = _mm_xor_si128(ByteSwap(x), mask);
+	OPENSSL_cleanse(keystream, sizeof(keystream));
+	return tag;
+}
+
+// Hashes a ciphertext with an IV of any length without decrypting it.
+// Returns the tag and sets J0, the block before the first counter block.
+template <int Rounds>
+AEAD_TARGET_AESNI static __m128i GcmHashOnly(const AesniKey &key, const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len, __m128i *j0
+) {
+	GhashPowers powers;
+	LoadPowers(key, powers);
+	if (iv_len == 12) {
+		*j0 = _mm_insert_epi32(LoadPartial(iv, 12), (int)__builtin_bswap32(1), 3);
+	} else {
+		// J0 = GHASH(IV || [0]64 || [8 * iv_len]64)
+		const __m128i x = Ghash(powers, _mm_setzero_si128(), iv, iv_len);
+		const __m128i lengths = _mm_set_epi64x(0, (long long)((uint64_t)iv_len * 8));
+		*j0 = ByteSwap(GfMul(_mm_xor_si128(x, lengths), powers.h[0]));
+	}
+	__m128i mask = *j0;
+	EncryptRounds<Rounds, 1>(key, &mask);
+	__m128i x = Ghash(powers, _mm_setzero_si128(), aad, aad_len);
+	x = Ghash(powers, x, ciphertext, len);
+	const __m128i lengths = _mm_set_epi64x((long long)((uint64_t)aad_len * 8), (long long)((uint64_t)len * 8));
+	x = GfMul(_mm_xor_si128(x, lengths), powers.h[0]);
+	return _mm_xor_si128(ByteSwap(x), mask);
+}
+
+// Hashes the same data into the states of several keys. The keys' chains
+// are independent, so their multiplications overlap in the pipeline.
+template <int Lanes>
+AEAD_TARGET_AESNI static inline void HashLanes(const GhashPowers *powers, __m128i *x, const unsigned char *p, size_t len) {
+	for (; len >= 64; p += 64, len -= 64) {
+		for (int l = 0; l < Lanes; l++) x[l] = Hash4(powers[l], x[l], p);
+	}
+	if (len == 0) return;
+	for (int l = 0; l < Lanes; l++) x[l] = Ghash(powers[l], x[l], p, len);
+}
+
+// The tags of one ciphertext under Lanes keys, which may differ in length
+template <int Lanes>
+AEAD_TARGET_AESNI static void GcmHashLanes(const AesniKey *const *keys, const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len, unsigned char *tags
+) {
+	GhashPowers powers[Lanes];
+	__m128i mask[Lanes], x[Lanes];
+	for (int l = 0; l < Lanes; l++) {
+		LoadPowers(*keys[l], powers[l]);
+		if (iv_len == 12) {
+			mask[l] = _mm_insert_epi32(LoadPartial(iv, 12), (int)__builtin_bswap32(1), 3);
+		} else {
+			const __m128i iv_hash = Ghash(powers[l], _mm_setzero_si128(), iv, iv_len);
+			const __m128i lengths = _mm_set_epi64x(0, (long long)((uint64_t)iv_len * 8));
+			mask[l] = ByteSwap(GfMul(_mm_xor_si128(iv_hash, lengths), powers[l].h[0]));
+		}
+		mask[l] = EncryptBlock(*keys[l], mask[l]);
+		x[l] = _mm_setzero_si128();
+	}
+	HashLanes<Lanes>(powers, x, aad, aad_len);
+	HashLanes<Lanes>(powers, x, ciphertext, len);
+	const __m128i lengths = _mm_set_epi64x((long long)((uint64_t)aad_len * 8), (long long)((uint64_t)len * 8));
+	for (int l = 0; l < Lanes; l++) {
+		x[l] = GfMul(_mm_xor_si128(x[l], lengths), powers[l].h[0]);
+		Store(_mm_xor_si128(ByteSwap(x[l]), mask[l]), tags + 16 * l);
+	}
+}
+
+// GCM's counter mode alone, starting at the block after J0
+template <int Rounds>
+AEAD_TARGET_AESNI static void GcmCounter(const AesniKey &key, __m128i j0,
+	const unsigned char *in, size_t len, unsigned char *out
+) {
+	// only the last 32 bits count, wrapping around
+	uint32_t counter = __builtin_bswap32((uint32_t)_mm_extract_epi32(j0, 3)) + 1;
+	__m128i keystream[BLOCKS];
+	size_t pos = 0;
+	for (; len - pos >= CHUNK; pos += CHUNK) {
+		for (int i = 0; i < BLOCKS; i++) keystream[i] = _mm_insert_epi32(j0, (int)__builtin_bswap32(counter++), 3);
+		EncryptRounds<Rounds, BLOCKS>(key, keystream);
+		for (int i = 0; i < BLOCKS; i++) {
+			Store(_mm_xor_si128(Load(in + pos + 16 * i), keystream[i]), out + pos + 16 * i);
+		}
+	}
+	if (pos < len) {
+		const size_t rest = len - pos;
+		for (int i = 0; i < BLOCKS; i++) keystream[i] = _mm_insert_epi32(j0, (int)__builtin_bswap32(counter++), 3);
+		EncryptRounds<Rounds, BLOCKS>(key, keystream);
+		for (size_t i = 0; 16 * i < rest; i++) {
+			const size_t n = std::min((size_t)16, rest - 16 * i);
+			StorePartial(_mm_xor_si128(LoadPartial(in + pos + 16 * i, n), keystream[i]), out + pos + 16 * i, n);
+		}
+	}
+	OPENSSL_cleanse(keystream, sizeof(keystream));
+}
+
+// Encrypts or decrypts a CCM message and returns the full 16 byte tag, of
+// which the caller uses the first tag_len bytes.
+//
+// The CBC-MAC of each block is encrypted together with the counter block
+// for the next one, so both share a pass through the rounds. This also
+// makes in-place decryption work: the MAC needs the plaintext, which is
+// only known once the keystream is.
+template <int Rounds>
+AEAD_TARGET_AESNI static __m128i CcmCrypt(const AesniKey &key, bool encrypt, const CcmFormat &format,
+	const unsigned char *aad, const unsigned char *in, size_t len, unsigned char *out
+) {
+	const __m128i ctr0 = Load(format.ctr0);
+
+	// the next block to encrypt for the CBC-MAC
+	__m128i mac = Load(format.b0);
+	const size_t aad_blocks = format.AadBlocks();
+	for (size_t i = 0; i < aad_blocks; i++) {
+		alignas(16) unsigned char block[16];
+		format.AadBlock(aad, i, block);
+		EncryptRounds<Rounds, 1>(key, &mac);
+		mac = _mm_xor_si128(mac, _mm_load_si128((const __m128i *)block));
+	}
+
+	__m128i blocks[2];
+	uint64_t counter = 1;
+	for (size_t pos = 0; pos < len; pos += 16) {
+		const size_t n = std::min((size_t)16, len - pos);
+		// the counter is at most 15 - iv_len bytes long, so it fits
+		// into Ctr_0's zeroes
+		blocks[0] = mac;
+		blocks[1] = _mm_or_si128(ctr0, _mm_set_epi64x((long long)__builtin_bswap64(counter++), 0));
+		EncryptRounds<Rounds, 2>(key, blocks);
+		const __m128i x = LoadPartial(in + pos, n);
+		StorePartial(_mm_xor_si128(x, blocks[1]), out + pos, n);
+		// the MAC is over the plaintext, padded with zeroes
+		mac = _mm_xor_si128(blocks[0], encrypt ? x : LoadPartial(out + pos, n));
+	}
+
+	blocks[0] = mac;
+	blocks[1] = ctr0;
+	EncryptRounds<Rounds, 2>(key, blocks);
+	const __m128i tag = _mm_xor_si128(blocks[0], blocks[1]);
+	OPENSSL_cleanse(blocks, sizeof(blocks));
+	return tag;
+}
+
+#endif
+
+// ==================
+
+template <size_t KeyLen>
+bool FixedGcm<KeyLen>::Encrypt(const unsigned char *key, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext, unsigned char *auth_tag
+) {
+	if (SoftAead::Enabled()) {
+		const SoftKey *soft_key = SoftAead::CachedKey(key, KEY_LEN);
+		SoftAead::GcmEncrypt(*soft_key, iv, IV_LEN, aad, aad_len, plaintext, len, ciphertext, auth_tag);
+		return true;
+	}
+#ifdef AEAD_HAVE_AESNI
+	const AesniKey *aesni_key = Aesni::CachedKey(key, KEY_LEN);
+	if (aesni_key != NULL) {
+		if (len > SmallGcm::MAX_LENGTH && WideGcm::Supported()) {
+			WideGcm::Encrypt(*aesni_key, iv, aad, aad_len, plaintext, len, ciphertext, auth_tag);
+		} else {
+			Store(GcmCrypt<ROUNDS>(*aesni_key, true, iv, aad, aad_len, plaintext, len, ciphertext), auth_tag);
+		}
+		return true;
+	}
+#endif
+
+	// 12 bytes is OpenSSL's default IV length
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int outl;
+	const bool ok = ctx != NULL &&
+		EVP_EncryptInit_ex(ctx, FixedCipher<KeyLen>::Gcm(), NULL, key, iv) == 1 &&
+		(aad_len == 0 || EVP_EncryptUpdate(ctx, NULL, &outl, aad, (int)aad_len) == 1) &&
+		EVP_EncryptUpdate(ctx, ciphertext, &outl, plaintext, (int)len) == 1 &&
+		EVP_EncryptFinal_ex(ctx, ciphertext + outl, &outl) == 1 &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, (int)TAG_LEN, auth_tag) == 1;
+	EVP_CIPHER_CTX_free(ctx);
+	return ok;
+}
+
+template <size_t KeyLen>
+bool FixedGcm<KeyLen>::Decrypt(const unsigned char *key, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext, const unsigned char *auth_tag,
+	bool *auth_ok
+) {
+	if (SoftAead::Enabled()) {
+		const SoftKey *soft_key = SoftAead::CachedKey(key, KEY_LEN);
+		*auth_ok = SoftAead::GcmDecrypt(*soft_key, iv, IV_LEN, aad, aad_len, ciphertext, len, plaintext, auth_tag);
+		return true;
+	}
+#ifdef AEAD_HAVE_AESNI
+	const AesniKey *aesni_key = Aesni::CachedKey(key, KEY_LEN);
+	if (aesni_key != NULL) {
+		if (len > SmallGcm::MAX_LENGTH && WideGcm::Supported()) {
+			*auth_ok = WideGcm::Decrypt(*aesni_key, iv, aad, aad_len, ciphertext, len, plaintext, auth_tag);
+		} else {
+			alignas(16) unsigned char tag[16];
+			_mm_store_si128((__m128i *)tag, GcmCrypt<ROUNDS>(*aesni_key, false, iv, aad, aad_len, ciphertext, len, plaintext));
+			*auth_ok = CRYPTO_memcmp(tag, auth_tag, TAG_LEN) == 0;
+			OPENSSL_cleanse(tag, sizeof(tag));
+		}
+		return true;
+	}
+#endif
+
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int outl;
+	const bool ok = ctx != NULL &&
+		EVP_DecryptInit_ex(ctx, FixedCipher<KeyLen>::Gcm(), NULL, key, iv) == 1 &&
+		(aad_len == 0 || EVP_DecryptUpdate(ctx, NULL, &outl, aad, (int)aad_len) == 1) &&
+		EVP_DecryptUpdate(ctx, plaintext, &outl, ciphertext, (int)len) == 1 &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, (int)TAG_LEN, (void *)auth_tag) == 1;
+	if (ok) *auth_ok = EVP_DecryptFinal_ex(ctx, plaintext + outl, &outl) == 1;
+	EVP_CIPHER_CTX_free(ctx);
+	return ok;
+}
+
+template <size_t KeyLen, size_t IvLen, size_t TagLen>
+bool FixedCcm<KeyLen, IvLen, TagLen>::Encrypt(const unsigned char *key, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext, unsigned char *auth_tag
+) {
+	if (len > MAX_LENGTH) return false;
+	if (SoftAead::Enabled()) {
+		const SoftKey *soft_key = SoftAead::CachedKey(key, KEY_LEN);
+		SoftAead::CcmEncrypt(*soft_key, iv, IV_LEN, aad, aad_len, plaintext, len, ciphertext, auth_tag, TAG_LEN);
+		return true;
+	}
+#ifdef AEAD_HAVE_AESNI
+	const AesniKey *aesni_key = Aesni::CachedKey(key, KEY_LEN);
+	if (aesni_key != NULL) {
+		CcmFormat format;
+		format.Init(iv, IV_LEN, aad_len, len, TAG_LEN);
+		alignas(16) unsigned char tag[16];
+		_mm_store_si128((__m128i *)tag, CcmCrypt<ROUNDS>(*aesni_key, true, format, aad, plaintext, len, ciphertext));
+		memcpy(auth_tag, tag, TAG_LEN);
+		OPENSSL_cleanse(tag, sizeof(tag));
+		return true;
+	}
+#endif
+
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int outl;
+	const bool ok = ctx != NULL &&
+		EVP_EncryptInit_ex(ctx, FixedCipher<KeyLen>::Ccm(), NULL, NULL, NULL) == 1 &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, (int)IV_LEN, NULL) == 1 &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, (int)TAG_LEN, NULL) == 1 &&
+		EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv) == 1 &&
+		// CCM needs the message length before the additional data
+		EVP_EncryptUpdate(ctx, NULL, &outl, NULL, (int)len) == 1 &&
+		(aad_len == 0 || EVP_EncryptUpdate(ctx, NULL, &outl, aad, (int)aad_len) == 1) &&
+		EVP_EncryptUpdate(ctx, ciphertext, &outl, plaintext, (int)len) == 1 &&
+		EVP_EncryptFinal_ex(ctx, ciphertext + outl, &outl) == 1 &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_GET_TAG, (int)TAG_LEN, auth_tag) == 1;
+	EVP_CIPHER_CTX_free(ctx);
+	return ok;
+}
+
+template <size_t KeyLen, size_t IvLen, size_t TagLen>
+bool FixedCcm<KeyLen, IvLen, TagLen>::Decrypt(const unsigned char *key, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext, const unsigned char *auth_tag,
+	bool *auth_ok
+) {
+	if (len > MAX_LENGTH) return false;
+	if (SoftAead::Enabled()) {
+		const SoftKey *soft_key = SoftAead::CachedKey(key, KEY_LEN);
+		*auth_ok = SoftAead::CcmDecrypt(*soft_key, iv, IV_LEN, aad, aad_len, ciphertext, len, plaintext, auth_tag, TAG_LEN);
+		return true;
+	}
+#ifdef AEAD_HAVE_AESNI
+	const AesniKey *aesni_key = Aesni::CachedKey(key, KEY_LEN);
+	if (aesni_key != NULL) {
+		CcmFormat format;
+		format.Init(iv, IV_LEN, aad_len, len, TAG_LEN);
+		alignas(16) unsigned char tag[16];
+		_mm_store_si128((__m128i *)tag, CcmCrypt<ROUNDS>(*aesni_key, false, format, aad, ciphertext, len, plaintext));
+		*auth_ok = CRYPTO_memcmp(tag, auth_tag, TAG_LEN) == 0;
+		OPENSSL_cleanse(tag, sizeof(tag));
+		if (!*auth_ok) OPENSSL_cleanse(plaintext, len);
+		return true;
+	}
+#endif
+
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int outl;
+	const bool ok = ctx != NULL &&
+		EVP_DecryptInit_ex(ctx, FixedCipher<KeyLen>::Ccm(), NULL, NULL, NULL) == 1 &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, (int)IV_LEN, NULL) == 1 &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, (int)TAG_LEN, (void *)auth_tag) == 1 &&
+		EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv) == 1 &&
+		EVP_DecryptUpdate(ctx, NULL, &outl, NULL, (int)len) == 1 &&
+		(aad_len == 0 || EVP_DecryptUpdate(ctx, NULL, &outl, aad, (int)aad_len) == 1);
+	if (ok) {
+		// with CCM, the tag is checked by the update on the message
+		*auth_ok = EVP_DecryptUpdate(ctx, plaintext, &outl, ciphertext, (int)len) == 1;
+		if (!*auth_ok) OPENSSL_cleanse(plaintext, len);
+	}
+	EVP_CIPHER_CTX_free(ctx);
+	return ok;
+}
+
+// ==================
+
+void AesniAead::GcmEncrypt(const AesniKey &key, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext, unsigned char *auth_tag
+) {
+#ifdef AEAD_HAVE_AESNI
+	__m128i tag;
+	switch (key.rounds) {
+		case 10: tag = GcmCrypt<10>(key, true, iv, aad, aad_len, plaintext, len, ciphertext); break;
+		case 12: tag = GcmCrypt<12>(key, true, iv, aad, aad_len, plaintext, len, ciphertext); break;
+		default: tag = GcmCrypt<14>(key, true, iv, aad, aad_len, plaintext, len, ciphertext); break;
+	}
+	Store(tag, auth_tag);
+#else
+	(void)key; (void)iv; (void)aad; (void)aad_len;
+	(void)plaintext; (void)len; (void)ciphertext; (void)auth_tag;
+#endif
+}
+
+bool AesniAead::GcmDecrypt(const AesniKey &key, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext, const unsigned char *auth_tag
+) {
+#ifdef AEAD_HAVE_AESNI
+	alignas(16) unsigned char tag[16];
+	switch (key.rounds) {
+		case 10: Store(GcmCrypt<10>(key, false, iv, aad, aad_len, ciphertext, len, plaintext), tag); break;
+		case 12: Store(GcmCrypt<12>(key, false, iv, aad, aad_len, ciphertext, len, plaintext), tag); break;
+		default: Store(GcmCrypt<14>(key, false, iv, aad, aad_len, ciphertext, len, plaintext), tag); break;
+	}
+	const bool auth_ok = CRYPTO_memcmp(tag, auth_tag, 16) == 0;
+	OPENSSL_cleanse(tag, sizeof(tag));
+	return auth_ok;
+#else
+	(void)key; (void)iv; (void)aad; (void)aad_len;
+	(void)ciphertext; (void)len; (void)plaintext; (void)auth_tag;
+	return false;
+#endif
+}
+
+void AesniAead::GcmHash(const AesniKey &key, const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *auth_tag, unsigned char *j0
+) {
+#ifdef AEAD_HAVE_AESNI
+	__m128i tag, counter;
+	switch (key.rounds) {
+		case 10: tag = GcmHashOnly<10>(key, iv, iv_len, aad, aad_len, ciphertext, len, &counter); break;
+		case 12: tag = GcmHashOnly<12>(key, iv, iv_len, aad, aad_len, ciphertext, len, &counter); break;
+		default: tag = GcmHashOnly<14>(key, iv, iv_len, aad, aad_len, ciphertext, len, &counter); break;
+	}
+	Store(tag, auth_tag);
+	Store(counter, j0);
+#else
+	(void)key; (void)iv; (void)iv_len; (void)aad; (void)aad_len;
+	(void)ciphertext; (void)len; (void)auth_tag; (void)j0;
+#endif
+}
+
+void AesniAead::GcmHashKeys(const AesniKey *const *keys, size_t count,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *auth_tags
+) {
+#ifdef AEAD_HAVE_AESNI
+	switch (count) {
+		case 1: GcmHashLanes<1>(keys, iv, iv_len, aad, aad_len, ciphertext, len, auth_tags); break;
+		case 2: GcmHashLanes<2>(keys, iv, iv_len, aad, aad_len, ciphertext, len, auth_tags); break;
+		case 3: GcmHashLanes<3>(keys, iv, iv_len, aad, aad_len, ciphertext, len, auth_tags); break;
+		case 4: GcmHashLanes<4>(keys, iv, iv_len, aad, aad_len, ciphertext, len, auth_tags); break;
+		default: break;
+	}
+#else
+	(void)keys; (void)count; (void)iv; (void)iv_len; (void)aad; (void)aad_len;
+	(void)ciphertext; (void)len; (void)auth_tags;
+#endif
+}
+
+void AesniAead::GcmCtr(const AesniKey &key, const unsigned char *j0,
+	const unsigned char *in, size_t len, unsigned char *out
+) {
+#ifdef AEAD_HAVE_AESNI
+	const __m128i counter = Load(j0);
+	switch (key.rounds) {
+		case 10: GcmCounter<10>(key, counter, in, len, out); break;
+		case 12: GcmCounter<12>(key, counter, in, len, out); break;
+		default: GcmCounter<14>(key, counter, in, len, out); break;
+	}
+#else
+	(void)key; (void)j0; (void)in; (void)len; (void)out;
+#endif
+}
+
+bool AesniAead::CcmEncrypt(const AesniKey &key,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext,
+	unsigned char *auth_tag, size_t auth_tag_len
+) {
+#ifdef AEAD_HAVE_AESNI
+	if (!CcmFormat::LengthFits(iv_len, len)) return false;
+	CcmFormat format;
+	format.Init(iv, iv_len, aad_len, len, auth_tag_len);
+	alignas(16) unsigned char tag[16];
+	switch (key.rounds) {
+		case 10: Store(CcmCrypt<10>(key, true, format, aad, plaintext, len, ciphertext), tag); break;
+		case 12: Store(CcmCrypt<12>(key, true, format, aad, plaintext, len, ciphertext), tag); break;
+		default: Store(CcmCrypt<14>(key, true, format, aad, plaintext, len, ciphertext), tag); break;
+	}
+	memcpy(auth_tag, tag, auth_tag_len);
+	OPENSSL_cleanse(tag, sizeof(tag));
+	return true;
+#else
+	(void)key; (void)iv; (void)iv_len; (void)aad; (void)aad_len;
+	(void)plaintext; (void)len; (void)ciphertext; (void)auth_tag; (void)auth_tag_len;
+	return false;
+#endif
+}
+
+bool AesniAead::CcmDecrypt(const AesniKey &key,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext,
+	const unsigned char *auth_tag, size_t auth_tag_len,
+	bool *auth_ok
+) {
+#ifdef AEAD_HAVE_AESNI
+	if (!CcmFormat::LengthFits(iv_len, len)) return false;
+	CcmFormat format;
+	format.Init(iv, iv_len, aad_len, len, auth_tag_len);
+	alignas(16) unsigned char tag[16];
+	switch (key.rounds) {
+		case 10: Store(CcmCrypt<10>(key, false, format, aad, ciphertext, len, plaintext), tag); break;
+		case 12: Store(CcmCrypt<12>(key, false, format, aad, ciphertext, len, plaintext), tag); break;
+		default: Store(CcmCrypt<14>(key, false, format, aad, ciphertext, len, plaintext), tag); break;
+	}
+	*auth_ok = CRYPTO_memcmp(tag, auth_tag, auth_tag_len) == 0;
+	OPENSSL_cleanse(tag, sizeof(tag));
+	if (!*auth_ok) OPENSSL_cleanse(plaintext, len);
+	return true;
+#else
+	(void)key; (void)iv; (void)iv_len; (void)aad; (void)aad_len;
+	(void)ciphertext; (void)len; (void)plaintext; (void)auth_tag; (void)auth_tag_len; (void)auth_ok;
+	return false;
+#endif
+}
+
+// The configurations with dedicated entry points
+template class aead::FixedGcm<16>;
+template class aead::FixedGcm<32>;
+template class aead::FixedCcm<16, 13, 8>;
+template class aead::FixedCcm<16, 12, 16>;
+template class aead::FixedCcm<16, 12, 8>;
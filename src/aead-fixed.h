@@ -0,0 +1,128 @@
+#ifndef AEAD_FIXED_H_
+#define AEAD_FIXED_H_
+
+#include <stddef.h>
+
+#include "aead-aesni.h"
+
+namespace aead {
+
+    // GCM for one key size with a 12 byte IV and a 16 byte tag, behind the
+    // dedicated entry points like gcm.aes128_12_16.
+    //
+    // Nothing is dispatched on the parameters at runtime: the number of
+    // rounds, the block counts and all lengths but the message's are
+    // compile-time constants, and OpenSSL is only used without AES-NI,
+    // with its cipher fixed too. Only the instantiations in aead-fixed.cc
+    // exist.
+    template <size_t KeyLen>
+    class FixedGcm {
+    public:
+        static const size_t KEY_LEN = KeyLen;
+        static const size_t IV_LEN = 12;
+        static const size_t TAG_LEN = 16;
+        static const int ROUNDS = (int)KeyLen / 4 + 6;
+        // Node.js buffers stay far below GCM's limit of 2^36 - 32 bytes
+        static const size_t MAX_LENGTH = (size_t)-1;
+
+        // The key, IV and tag have the lengths above. Returns false if
+        // OpenSSL failed.
+        static bool Encrypt(const unsigned char *key, const unsigned char *iv,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext, unsigned char *auth_tag);
+        // The plaintext is written even if the tag doesn't match
+        static bool Decrypt(const unsigned char *key, const unsigned char *iv,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext, const unsigned char *auth_tag,
+            bool *auth_ok);
+    };
+
+    // CCM for one combination of key size, nonce and tag length, like
+    // FixedGcm
+    template <size_t KeyLen, size_t IvLen, size_t TagLen>
+    class FixedCcm {
+        static_assert(IvLen >= 7 && IvLen <= 13, "CCM nonces are 7 to 13 bytes long");
+        static_assert(TagLen >= 4 && TagLen <= 16 && TagLen % 2 == 0, "CCM tags are 4 to 16 bytes long");
+
+    public:
+        static const size_t KEY_LEN = KeyLen;
+        static const size_t IV_LEN = IvLen;
+        static const size_t TAG_LEN = TagLen;
+        static const int ROUNDS = (int)KeyLen / 4 + 6;
+        // the message length is encoded in the 15 - IvLen bytes left
+        static const size_t MAX_LENGTH = IvLen >= 8 ? ((size_t)1 << (8 * (15 - IvLen))) - 1 : (size_t)-1;
+
+        // Both return false if the message is longer than MAX_LENGTH or
+        // OpenSSL failed
+        static bool Encrypt(const unsigned char *key, const unsigned char *iv,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext, unsigned char *auth_tag);
+        // A plaintext that failed authentication is zeroed
+        static bool Decrypt(const unsigned char *key, const unsigned char *iv,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext, const unsigned char *auth_tag,
+            bool *auth_ok);
+    };
+
+    // The AES-NI kernels of FixedGcm and FixedCcm with the key size and
+    // lengths chosen at runtime, for the built-in backend. The rounds are
+    // still compile-time constants, one instantiation per key size. The key
+    // must come from Aesni.
+    class AesniAead {
+    public:
+        // With a 12 byte IV and a 16 byte tag. Decrypt returns whether the
+        // tag matched; the plaintext is written either way.
+        static void GcmEncrypt(const AesniKey &key, const unsigned char *iv,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext, unsigned char *auth_tag);
+        static bool GcmDecrypt(const AesniKey &key, const unsigned char *iv,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext, const unsigned char *auth_tag);
+
+        // GCM in two passes, for VerifiedGcm, with any IV length. GcmHash
+        // computes the 16 byte tag of a ciphertext without decrypting it,
+        // and J0, the block before the first counter block. GcmCtr then
+        // decrypts (or encrypts) with the counter blocks after J0 alone.
+        static void GcmHash(const AesniKey &key, const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *auth_tag, unsigned char *j0);
+        static void GcmCtr(const AesniKey &key, const unsigned char *j0,
+            const unsigned char *in, size_t len, unsigned char *out);
+        // Like GcmHash for one ciphertext under up to HASH_LANES keys at
+        // once, for trial decryption. The 16 byte tags follow each other in
+        // the order of the keys.
+        static const size_t HASH_LANES = 4;
+        static void GcmHashKeys(const AesniKey *const *keys, size_t count,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *auth_tags);
+
+        // The parameters must be valid for CCM. Both return false if the
+        // message is too long for the nonce length. A plaintext that failed
+        // authentication is zeroed.
+        static bool CcmEncrypt(const AesniKey &key,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext,
+            unsigned char *auth_tag, size_t auth_tag_len);
+        static bool CcmDecrypt(const AesniKey &key,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext,
+            const unsigned char *auth_tag, size_t auth_tag_len,
+            bool *auth_ok);
+    };
+
+}
+
+#endif
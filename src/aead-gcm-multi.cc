@@ -0,0 +1,206 @@
+#include <string.h>
+#include <algorithm>
+#include <openssl/crypto.h>
+
+#include "aead-gcm-multi.h"
+
+using namespace aead;
+
+#ifdef AEAD_HAVE_AESNI
+
+using namespace aead::aesni;
+
+// What a lane does in the next step. Every step encrypts two counter blocks
+// and hashes two blocks per lane, even if the lane needs fewer, so the
+// lanes never diverge.
+enum GcmPhase {
+	GCM_IDLE,
+	// E(K, J0) for the tag, and the start of the additional data
+	GCM_START,
+	GCM_AAD,
+	GCM_DATA,
+	// the length block
+	GCM_LENGTHS,
+	// the tag is ready
+	GCM_DONE
+};
+
+struct GcmLane {
+	GcmMultiOp *op;
+	GcmPhase phase;
+	// IV || 0^32; the counter is inserted per block
+	__m128i j0;
+	uint32_t counter;
+	// the GHASH state, byte reversed
+	__m128i hash;
+	__m128i mask;
+	size_t aad_pos;
+	size_t pos;
+};
+
+AEAD_TARGET_AESNI static void StartLane(GcmLane &lane, GcmMultiOp *op) {
+	lane.op = op;
+	lane.phase = GCM_START;
+	lane.j0 = LoadPartial(op->iv, 12);
+	lane.counter = 1;
+	lane.hash = _mm_setzero_si128();
+	lane.mask = _mm_setzero_si128();
+	lane.aad_pos = 0;
+	lane.pos = 0;
+}
+
+static void StopLane(GcmLane &lane) {
+	lane.op = NULL;
+	lane.phase = GCM_IDLE;
+}
+
+AEAD_TARGET_AESNI static GcmPhase NextPhase(const GcmLane &lane) {
+	if (lane.aad_pos < lane.op->aad_len) return GCM_AAD;
+	return lane.pos < lane.op->len ? GCM_DATA : GCM_LENGTHS;
+}
+
+AEAD_TARGET_AESNI static __m128i CounterBlock(const GcmLane &lane, uint32_t offset) {
+	return _mm_insert_epi32(lane.j0, (int)__builtin_bswap32(lane.counter + offset), 3);
+}
+
+// Hashing two blocks at once: with the state X, the hash becomes
+// (X ^ B1) * H^2 ^ B2 * H. A single block B is hashed as the pair
+// (0, X ^ B).
+struct GcmPair {
+	__m128i first;
+	__m128i second;
+};
+
+// Hashes the next (up to 16 byte) piece of the additional data
+AEAD_TARGET_AESNI static __m128i NextAad(GcmLane &lane) {
+	const GcmMultiOp *op = lane.op;
+	const size_t n = std::min((size_t)16, op->aad_len - std::min(op->aad_len, lane.aad_pos));
+	const __m128i block = ByteSwap(LoadPartial(op->aad + lane.aad_pos, n));
+	lane.aad_pos += 16;
+	return block;
+}
+
+// Encrypts or decrypts the next (up to 16 byte) piece of the message and
+// returns the ciphertext block to hash
+AEAD_TARGET_AESNI static __m128i NextData(GcmLane &lane, __m128i keystream) {
+	const GcmMultiOp *op = lane.op;
+	const size_t n = std::min((size_t)16, op->len - lane.pos);
+	const __m128i in = LoadPartial(op->in + lane.pos, n);
+	const __m128i out = _mm_xor_si128(in, keystream);
+	StorePartial(out, op->out + lane.pos, n);
+	// a partial ciphertext block is hashed without the keystream beyond its end
+	const __m128i block = op->encrypt ? (n == 16 ? out : LoadPartial(op->out + lane.pos, n)) : in;
+	lane.pos += n;
+	lane.counter++;
+	return ByteSwap(block);
+}
+
+// Consumes the lane's keystream blocks and returns the blocks to hash
+AEAD_TARGET_AESNI static GcmPair Absorb(GcmLane &lane, __m128i keystream0, __m128i keystream1) {
+	const GcmMultiOp *op = lane.op;
+	GcmPair pair;
+	pair.first = _mm_setzero_si128();
+	switch (lane.phase) {
+		case GCM_START:
+			lane.mask = keystream0;
+			lane.counter = 2;
+			// fall through
+		case GCM_AAD:
+			pair.second = NextAad(lane);
+			if (lane.aad_pos < op->aad_len) {
+				pair.first = _mm_xor_si128(lane.hash, pair.second);
+				pair.second = NextAad(lane);
+				lane.phase = NextPhase(lane);
+				return pair;
+			}
+			break;
+		case GCM_DATA:
+			pair.second = NextData(lane, keystream0);
+			if (lane.pos < op->len) {
+				pair.first = _mm_xor_si128(lane.hash, pair.second);
+				pair.second = NextData(lane, keystream1);
+				lane.phase = NextPhase(lane);
+				return pair;
+			}
+			break;
+		case GCM_LENGTHS:
+			// [8 * aad_len]64 || [8 * len]64, byte reversed
+			pair.second = _mm_set_epi64x((long long)((uint64_t)op->aad_len * 8), (long long)((uint64_t)op->len * 8));
+			lane.phase = GCM_DONE;
+			break;
+		default:
+			pair.second = _mm_setzero_si128();
+			return pair;
+	}
+	if (lane.phase != GCM_DONE) lane.phase = NextPhase(lane);
+	pair.second = _mm_xor_si128(lane.hash, pair.second);
+	return pair;
+}
+
+AEAD_TARGET_AESNI static void FinishLane(GcmLane &lane) {
+	GcmMultiOp *op = lane.op;
+	alignas(16) unsigned char tag[16];
+	_mm_store_si128((__m128i *)tag, _mm_xor_si128(ByteSwap(lane.hash), lane.mask));
+	if (op->encrypt) {
+		memcpy(op->tag, tag, 16);
+	} else {
+		op->auth_ok = CRYPTO_memcmp(tag, op->tag, 16) == 0;
+	}
+	OPENSSL_cleanse(tag, sizeof(tag));
+}
+
+AEAD_TARGET_AESNI static void RunLanes(const AesniKey &key, GcmMultiOp *ops, size_t count) {
+	const int LANES = MultiGcm::LANES;
+	GcmLane lanes[LANES];
+	size_t next = 0;
+	int active = 0;
+	for (int l = 0; l < LANES; l++) {
+		// idle lanes encrypt and hash zeroes
+		lanes[l].j0 = lanes[l].hash = _mm_setzero_si128();
+		lanes[l].counter = 0;
+		if (next < count) {
+			StartLane(lanes[l], &ops[next++]);
+			active++;
+		} else {
+			StopLane(lanes[l]);
+		}
+	}
+
+	const __m128i h = _mm_load_si128((const __m128i *)key.h);
+	const __m128i h2 = _mm_load_si128((const __m128i *)key.h2);
+	__m128i blocks[2 * LANES];
+	while (active > 0) {
+		for (int l = 0; l < LANES; l++) {
+			blocks[2 * l] = CounterBlock(lanes[l], 0);
+			blocks[2 * l + 1] = CounterBlock(lanes[l], 1);
+		}
+		EncryptBlocks<2 * LANES>(key, blocks);
+		for (int l = 0; l < LANES; l++) {
+			const GcmPair pair = Absorb(lanes[l], blocks[2 * l], blocks[2 * l + 1]);
+			lanes[l].hash = GfMul2(pair.first, h2, pair.second, h);
+		}
+
+		for (int l = 0; l < LANES; l++) {
+			if (lanes[l].phase != GCM_DONE) continue;
+			FinishLane(lanes[l]);
+			if (next < count) {
+				StartLane(lanes[l], &ops[next++]);
+			} else {
+				StopLane(lanes[l]);
+				active--;
+			}
+		}
+	}
+}
+
+#endif
+
+void MultiGcm::Run(const AesniKey &key, GcmMultiOp *ops, size_t count) {
+#ifdef AEAD_HAVE_AESNI
+	RunLanes(key, ops, count);
+#else
+	(void)key;
+	(void)ops;
+	(void)count;
+#endif
+}
@@ -0,0 +1,56 @@
+#ifndef AEAD_GCM_MULTI_H_
+#define AEAD_GCM_MULTI_H_
+
+#include <stddef.h>
+
+#include "aead-aesni.h"
+
+namespace aead {
+
+    // One message of a multi-buffer run
+    struct GcmMultiOp {
+        bool encrypt;
+        // 12 bytes
+        const unsigned char *iv;
+        const unsigned char *aad;
+        size_t aad_len;
+        const unsigned char *in;
+        size_t len;
+        unsigned char *out;
+        // 16 bytes, written when encrypting and checked when decrypting
+        unsigned char *tag;
+        // set when decrypting
+        bool auth_ok;
+    };
+
+    // GCM over many independent messages with one key at once.
+    //
+    // A single message keeps AES-NI mostly idle: each block waits for the
+    // latency of its AESENC chain, and each GHASH multiplication for the one
+    // before. Here, LANES messages are processed side by side, two blocks
+    // each per step, so the AES rounds and carry-less multiplications of
+    // all lanes are interleaved. A lane whose message is done picks up the
+    // next one, so messages of different lengths keep all lanes busy.
+    //
+    // Long messages already keep the pipeline busy by themselves, where
+    // OpenSSL's stitched single-message code is faster, so only messages of
+    // up to MAX_LENGTH bytes are worth batching.
+    class MultiGcm {
+    public:
+        static const int LANES = 8;
+        static const size_t MAX_LENGTH = 512;
+
+        // Whether the kernel can run here
+        static bool Supported() { return Aesni::Supported(); }
+        // Whether an operation fits the kernel; others need the generic path
+        static bool Accepts(size_t iv_len, size_t len, size_t auth_tag_len) {
+            return iv_len == 12 && len <= MAX_LENGTH && auth_tag_len == 16;
+        }
+
+        // Processes all operations; only call if Supported()
+        static void Run(const AesniKey &key, GcmMultiOp *ops, size_t count);
+    };
+
+}
+
+#endif
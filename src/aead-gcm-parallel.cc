@@ -0,0 +1,353 @@
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include "aead-gcm-parallel.h"
+#include "aead-parallel.h"
+
+using namespace aead;
+
+// Bytes encrypted and then hashed at a time within a chunk, so the
+// ciphertext is still in the cache when it is hashed
+static const size_t PIECE_SIZE = 64 << 10;
+// EVP_*Update takes int lengths
+static const size_t MAX_UPDATE = 1 << 30;
+
+// ==================
+
+// An element of GF(2^128) in GCM's bit order; hi holds bytes 0..7 big endian
+struct Block {
+	uint64_t hi;
+	uint64_t lo;
+};
+
+static const Block ZERO = { 0, 0 };
+// The polynomial 1
+static const Block ONE = { (uint64_t)1 << 63, 0 };
+
+static uint64_t Load64(const unsigned char *p) {
+	uint64_t v = 0;
+	for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+	return v;
+}
+
+static void Store64(uint64_t v, unsigned char *p) {
+	for (int i = 7; i >= 0; i--, v >>= 8) p[i] = (unsigned char)v;
+}
+
+static Block Load(const unsigned char *p) {
+	Block b = { Load64(p), Load64(p + 8) };
+	return b;
+}
+
+static void Store(const Block &b, unsigned char *p) {
+	Store64(b.hi, p);
+	Store64(b.lo, p + 8);
+}
+
+static Block Xor(const Block &a, const Block &b) {
+	Block r = { a.hi ^ b.hi, a.lo ^ b.lo };
+	return r;
+}
+
+// Multiplication in GF(2^128) as in NIST SP 800-38D, without branches on
+// the operands. Only used a few times per chunk, so the bitwise loop is fast enough.
+static Block Multiply(const Block &x, const Block &y) {
+	Block z = ZERO;
+	Block v = y;
+	for (int i = 0; i < 128; i++) {
+		const uint64_t bit = (i < 64 ? x.hi >> (63 - i) : x.lo >> (127 - i)) & 1;
+		z.hi ^= v.hi & (0 - bit);
+		z.lo ^= v.lo & (0 - bit);
+		const uint64_t carry = 0 - (v.lo & 1);
+		v.lo = (v.lo >> 1) | (v.hi << 63);
+		v.hi = (v.hi >> 1) ^ (0xe100000000000000ULL & carry);
+	}
+	return z;
+}
+
+// n is the public block count, so its bits may steer the loop
+static Block Power(Block h, uint64_t n) {
+	Block result = ONE;
+	for (; n > 0; n >>= 1) {
+		if (n & 1) result = Multiply(result, h);
+		h = Multiply(h, h);
+	}
+	return result;
+}
+
+// The GHASH length block [a]64 || [c]64 for byte lengths a and c
+static Block Lengths(uint64_t a_len, uint64_t c_len) {
+	Block b = { a_len * 8, c_len * 8 };
+	return b;
+}
+
+static uint64_t Blocks(size_t len) {
+	return ((uint64_t)len + 15) / 16;
+}
+
+// ==================
+
+static bool Ciphers(size_t key_len, const EVP_CIPHER **gcm, const EVP_CIPHER **ctr, const EVP_CIPHER **ecb) {
+	switch (key_len) {
+		case 16:
+			*gcm = EVP_aes_128_gcm(); *ctr = EVP_aes_128_ctr(); *ecb = EVP_aes_128_ecb();
+			return true;
+		case 24:
+			*gcm = EVP_aes_192_gcm(); *ctr = EVP_aes_192_ctr(); *ecb = EVP_aes_192_ecb();
+			return true;
+		case 32:
+			*gcm = EVP_aes_256_gcm(); *ctr = EVP_aes_256_ctr(); *ecb = EVP_aes_256_ecb();
+			return true;
+		default:
+			return false;
+	}
+}
+
+// Encrypts a single block
+static bool EncryptBlock(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *ecb, const unsigned char *key,
+	const unsigned char *in, unsigned char *out
+) {
+	int outl;
+	return EVP_EncryptInit_ex(ctx, ecb, NULL, key, NULL) == 1 &&
+		EVP_CIPHER_CTX_set_padding(ctx, 0) == 1 &&
+		EVP_EncryptUpdate(ctx, out, &outl, in, 16) == 1;
+}
+
+// Hashing a segment through OpenSSL: GCM with the all-zero 96 bit IV over
+// an empty message, with the segment as additional data, outputs
+//   E(K, 0^96 || 1) ^ (S ^ L) * H
+// where S is the GHASH state after the segment's blocks and L its length
+// block [8 * len]64 || 0^64. HashFinal removes the mask, the rest is
+// accounted for when the segments are combined.
+static bool HashInit(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *gcm, const unsigned char *key) {
+	static const unsigned char zero_iv[12] = { 0 };
+	return EVP_EncryptInit_ex(ctx, gcm, NULL, key, zero_iv) == 1;
+}
+
+static bool HashUpdate(EVP_CIPHER_CTX *ctx, const unsigned char *data, size_t len) {
+	int outl;
+	while (len > 0) {
+		const size_t n = std::min(len, MAX_UPDATE);
+		if (EVP_EncryptUpdate(ctx, NULL, &outl, data, (int)n) != 1) return false;
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+static bool HashFinal(EVP_CIPHER_CTX *ctx, const Block &mask, Block *result) {
+	unsigned char tag[16];
+	int outl;
+	if (EVP_EncryptFinal_ex(ctx, tag, &outl) != 1 ||
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag) != 1
+	) {
+		return false;
+	}
+	*result = Xor(Load(tag), mask);
+	return true;
+}
+
+// Turns a segment result from HashFinal into its share of S * H, where S
+// is the GHASH state after all blocks and rest the number of blocks after
+// the segment: S_seg * H^(rest + 1) = (result ^ L * H) * H^rest.
+// Computing S * H rather than S avoids dividing by H for the last segment.
+static Block Share(const Block &result, size_t len, const Block &h, const Block &h_rest) {
+	return Multiply(Xor(result, Multiply(Lengths(len, 0), h)), h_rest);
+}
+
+// ==================
+
+// Encrypts or decrypts one chunk and hashes its ciphertext
+class ParallelGcm::Work : public ChunkedWork {
+public:
+	bool encrypt;
+	const EVP_CIPHER *gcm;
+	const EVP_CIPHER *ctr;
+	const unsigned char *key;
+	const unsigned char *in;
+	unsigned char *out;
+	size_t len;
+	size_t chunk_size;
+	// the upper 96 bits of J0 and its low word
+	unsigned char j0[16];
+	uint32_t j0_low;
+	Block mask;
+	std::vector<Block> results;
+
+protected:
+	bool ProcessChunk(size_t index);
+
+private:
+	bool StartCounter(EVP_CIPHER_CTX *ctx, uint32_t low);
+	bool Process(size_t index, EVP_CIPHER_CTX *ctr_ctx, EVP_CIPHER_CTX *hash_ctx);
+};
+
+bool ParallelGcm::Work::ProcessChunk(size_t index) {
+	EVP_CIPHER_CTX *ctr_ctx = EVP_CIPHER_CTX_new();
+	EVP_CIPHER_CTX *hash_ctx = EVP_CIPHER_CTX_new();
+	const bool ok = ctr_ctx != NULL && hash_ctx != NULL && Process(index, ctr_ctx, hash_ctx);
+	EVP_CIPHER_CTX_free(ctr_ctx);
+	EVP_CIPHER_CTX_free(hash_ctx);
+	return ok;
+}
+
+bool ParallelGcm::Work::StartCounter(EVP_CIPHER_CTX *ctx, uint32_t low) {
+	unsigned char counter[16];
+	memcpy(counter, j0, 12);
+	for (int i = 15; i >= 12; i--, low >>= 8) counter[i] = (unsigned char)low;
+	return EVP_EncryptInit_ex(ctx, ctr, NULL, key, counter) == 1;
+}
+
+bool ParallelGcm::Work::Process(size_t index, EVP_CIPHER_CTX *ctr_ctx, EVP_CIPHER_CTX *hash_ctx) {
+	const size_t begin = index * chunk_size;
+	const size_t end = std::min(begin + chunk_size, len);
+	// GCM only increments the low 32 bits of the counter, while OpenSSL's
+	// CTR mode carries into the upper ones, so restart when they wrap
+	uint32_t low = (uint32_t)(j0_low + 1 + begin / 16);
+	uint64_t until_wrap = ((uint64_t)1 << 32) - low;
+	if (!StartCounter(ctr_ctx, low) || !HashInit(hash_ctx, gcm, key)) return false;
+
+	for (size_t offset = begin; offset < end; ) {
+		size_t n = std::min(PIECE_SIZE, end - offset);
+		if (until_wrap * 16 < n) n = (size_t)until_wrap * 16;
+
+		int outl;
+		// the ciphertext is hashed: the input when decrypting, the output
+		// when encrypting
+		if (!encrypt && !HashUpdate(hash_ctx, in + offset, n)) return false;
+		if (EVP_EncryptUpdate(ctr_ctx, out + offset, &outl, in + offset, (int)n) != 1) return false;
+		if (encrypt && !HashUpdate(hash_ctx, out + offset, n)) return false;
+
+		offset += n;
+		until_wrap -= n / 16;
+		if (until_wrap == 0) {
+			until_wrap = (uint64_t)1 << 32;
+			if (!StartCounter(ctr_ctx, 0)) return false;
+		}
+	}
+	return HashFinal(hash_ctx, mask, &results[index]);
+}
+
+// ==================
+
+bool ParallelGcm::Encrypt(const unsigned char *key, size_t key_len,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext,
+	unsigned char *auth_tag, size_t auth_tag_len
+) {
+	return Run(true, key, key_len, iv, iv_len, aad, aad_len, plaintext, len, ciphertext, auth_tag, auth_tag_len);
+}
+
+bool ParallelGcm::Decrypt(const unsigned char *key, size_t key_len,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext,
+	const unsigned char *auth_tag, size_t auth_tag_len,
+	bool *auth_ok
+) {
+	unsigned char expected[16];
+	if (auth_tag_len > sizeof(expected) ||
+		!Run(false, key, key_len, iv, iv_len, aad, aad_len, ciphertext, len, plaintext, expected, auth_tag_len)
+	) {
+		return false;
+	}
+	*auth_ok = CRYPTO_memcmp(expected, auth_tag, auth_tag_len) == 0;
+	OPENSSL_cleanse(expected, sizeof(expected));
+	return true;
+}
+
+bool ParallelGcm::Run(bool encrypt, const unsigned char *key, size_t key_len,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *in, size_t len, unsigned char *out,
+	unsigned char *tag, size_t tag_len
+) {
+	std::shared_ptr<Work> work(new Work());
+	const EVP_CIPHER *ecb;
+	if (iv_len == 0 || tag_len > 16 || !Ciphers(key_len, &work->gcm, &work->ctr, &ecb)) return false;
+	work->encrypt = encrypt;
+	work->key = key;
+	work->in = in;
+	work->out = out;
+	work->len = len;
+
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	if (ctx == NULL) return false;
+	bool ok = true;
+
+	// H = E(K, 0^128) and the mask of the segment hashes, E(K, 0^96 || 1)
+	static const unsigned char zero_block[16] = { 0 };
+	static const unsigned char one_block[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+	unsigned char block[16];
+	ok = ok && EncryptBlock(ctx, ecb, key, zero_block, block);
+	const Block h = Load(block);
+	ok = ok && EncryptBlock(ctx, ecb, key, one_block, block);
+	work->mask = Load(block);
+
+	// J0 is IV || 0^31 || 1 for 96 bit IVs, otherwise
+	// GHASH(IV || padding || 0^64 || [8 * len(IV)]64)
+	if (iv_len == 12) {
+		memcpy(work->j0, iv, 12);
+		memcpy(work->j0 + 12, one_block + 12, 4);
+	} else {
+		Block result = ZERO;
+		ok = ok && HashInit(ctx, work->gcm, key) && HashUpdate(ctx, iv, iv_len) && HashFinal(ctx, work->mask, &result);
+		// (S ^ [len]64 || 0) * H  ->  (S ^ 0 || [len]64) * H
+		const Block fix = Multiply(Xor(Lengths(iv_len, 0), Lengths(0, iv_len)), h);
+		Store(Xor(result, fix), work->j0);
+	}
+	work->j0_low = (uint32_t)(Load64(work->j0 + 8) & 0xffffffff);
+	if (!ok) {
+		// nothing has touched the caller's buffers yet
+		OPENSSL_cleanse(block, sizeof(block));
+		EVP_CIPHER_CTX_free(ctx);
+		return false;
+	}
+
+	// split the message and let the pool help
+	work->chunk_size = ChunkedWork::ChunkSize(len);
+	work->Init(len == 0 ? 0 : (len + work->chunk_size - 1) / work->chunk_size);
+	work->results.resize(work->chunks());
+	work->StartHelpers();
+
+	// the additional data is hashed here while the helpers start up
+	Block aad_result = ZERO;
+	if (aad_len > 0) {
+		ok = ok && HashInit(ctx, work->gcm, key) && HashUpdate(ctx, aad, aad_len) && HashFinal(ctx, work->mask, &aad_result);
+	}
+	// Even if hashing the additional data failed, the chunks are run to the
+	// end: helpers are already working on the caller's buffers
+	ok = work->Finish() && ok;
+
+	if (ok) {
+		// Combine the segments from the last one back, so H^rest can be
+		// kept up to date with one multiplication per segment
+		Block state = ZERO;
+		Block h_rest = ONE;
+		const Block h_chunk = Power(h, Blocks(work->chunk_size));
+		for (size_t i = work->chunks(); i-- > 0; ) {
+			const size_t chunk_len = std::min(work->chunk_size, len - i * work->chunk_size);
+			state = Xor(state, Share(work->results[i], chunk_len, h, h_rest));
+			h_rest = Multiply(h_rest, chunk_len == work->chunk_size ? h_chunk : Power(h, Blocks(chunk_len)));
+		}
+		if (aad_len > 0) state = Xor(state, Share(aad_result, aad_len, h, h_rest));
+		// the tag's GHASH is (S ^ L) * H
+		const Block ghash = Xor(state, Multiply(Lengths(aad_len, len), h));
+
+		unsigned char mask[16];
+		ok = EncryptBlock(ctx, ecb, key, work->j0, mask);
+		Store(Xor(ghash, Load(mask)), block);
+		memcpy(tag, block, tag_len);
+		OPENSSL_cleanse(mask, sizeof(mask));
+	}
+	OPENSSL_cleanse(block, sizeof(block));
+	EVP_CIPHER_CTX_free(ctx);
+	return ok;
+}
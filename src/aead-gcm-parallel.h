@@ -0,0 +1,53 @@
+#ifndef AEAD_GCM_PARALLEL_H_
+#define AEAD_GCM_PARALLEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace aead {
+
+    // GCM for single large messages, split across the crypto thread pool
+    // (see ChunkedWork for when messages are split).
+    //
+    // The message is cut into chunks of whole blocks. For each chunk, a
+    // worker runs the CTR keystream from the chunk's counter value and
+    // hashes the ciphertext on its own. GHASH is a polynomial in H, so the
+    // per-chunk results are combined into the hash of the whole message by
+    // multiplying each with the power of H matching the number of blocks
+    // after it. The output and tag are bit-identical to sequential GCM.
+    //
+    // The chunk hashes reuse OpenSSL's GHASH: GCM over an empty message with
+    // the chunk as additional data yields the chunk's hash (plus a length
+    // block and a known mask), so no GHASH code of our own runs per byte.
+    class ParallelGcm {
+    public:
+        // Both return false if OpenSSL fails or the key length is invalid.
+        // The caller's thread processes chunks as well and returns once the
+        // whole message is done.
+        static bool Encrypt(const unsigned char *key, size_t key_len,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext,
+            unsigned char *auth_tag, size_t auth_tag_len);
+        static bool Decrypt(const unsigned char *key, size_t key_len,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext,
+            const unsigned char *auth_tag, size_t auth_tag_len,
+            bool *auth_ok);
+
+    private:
+        class Work;
+
+        static bool Run(bool encrypt, const unsigned char *key, size_t key_len,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *in, size_t len, unsigned char *out,
+            unsigned char *tag, size_t tag_len);
+    };
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include <string.h>
+#include <algorithm>
+#include <openssl/crypto.h>
+
+#include "aead-gcm-small.h"
+
+using namespace aead;
+
+#ifdef AEAD_HAVE_AESNI
+
+using namespace aead::aesni;
+
+// Hashes data, padded with zeroes to whole blocks, into the byte reversed
+// state x. Up to four blocks share a reduction:
+// (x ^ B1) * H^4 ^ B2 * H^3 ^ B3 * H^2 ^ B4 * H.
+AEAD_TARGET_AESNI static __m128i Ghash(const AesniKey &key, __m128i x, const unsigned char *data, size_t len) {
+	const __m128i powers[4] = {
+		_mm_load_si128((const __m128i *)key.h),
+		_mm_load_si128((const __m128i *)key.h2),
+		_mm_load_si128((const __m128i *)key.h3),
+		_mm_load_si128((const __m128i *)key.h4)
+	};
+	while (len > 0) {
+		const size_t blocks = std::min((size_t)4, (len + 15) / 16);
+		__m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+		for (size_t i = 0; i < blocks; i++) {
+			const size_t n = std::min((size_t)16, len);
+			__m128i block = ByteSwap(LoadPartial(data, n));
+			if (i == 0) block = _mm_xor_si128(block, x);
+			MulAdd(block, powers[blocks - 1 - i], lo, mid, hi);
+			data += n;
+			len -= n;
+		}
+		x = Reduce(lo, mid, hi);
+	}
+	return x;
+}
+
+// Encrypts or decrypts the message and returns the tag
+AEAD_TARGET_AESNI static __m128i Run(const AesniKey &key, bool encrypt, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *in, size_t len, unsigned char *out
+) {
+	// J0 = IV || 1 masks the tag, the message starts at counter 2
+	const __m128i j0 = LoadPartial(iv, 12);
+	__m128i blocks[5];
+	for (int i = 0; i < 5; i++) blocks[i] = _mm_insert_epi32(j0, (int)__builtin_bswap32(i + 1), 3);
+	EncryptBlocks<5>(key, blocks);
+
+	for (size_t pos = 0, i = 1; pos < len; pos += 16, i++) {
+		const size_t n = std::min((size_t)16, len - pos);
+		StorePartial(_mm_xor_si128(LoadPartial(in + pos, n), blocks[i]), out + pos, n);
+	}
+
+	__m128i x = Ghash(key, _mm_setzero_si128(), aad, aad_len);
+	x = Ghash(key, x, encrypt ? out : in, len);
+	// [8 * aad_len]64 || [8 * len]64, byte reversed
+	const __m128i lengths = _mm_set_epi64x((long long)((uint64_t)aad_len * 8), (long long)((uint64_t)len * 8));
+	x = GfMul(_mm_xor_si128(x, lengths), _mm_load_si128((const __m128i *)key.h));
+	return _mm_xor_si128(ByteSwap(x), blocks[0]);
+}
+
+#endif
+
+void SmallGcm::Encrypt(const AesniKey &key, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext, unsigned char *auth_tag
+) {
+#ifdef AEAD_HAVE_AESNI
+	Store(Run(key, true, iv, aad, aad_len, plaintext, len, ciphertext), auth_tag);
+#else
+	(void)key; (void)iv; (void)aad; (void)aad_len;
+	(void)plaintext; (void)len; (void)ciphertext; (void)auth_tag;
+#endif
+}
+
+bool SmallGcm::Decrypt(const AesniKey &key, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext, const unsigned char *auth_tag
+) {
+#ifdef AEAD_HAVE_AESNI
+	alignas(16) unsigned char tag[16];
+	_mm_store_si128((__m128i *)tag, Run(key, false, iv, aad, aad_len, ciphertext, len, plaintext));
+	const bool auth_ok = CRYPTO_memcmp(tag, auth_tag, 16) == 0;
+	OPENSSL_cleanse(tag, sizeof(tag));
+	return auth_ok;
+#else
+	(void)key; (void)iv; (void)aad; (void)aad_len;
+	(void)ciphertext; (void)len; (void)plaintext; (void)auth_tag;
+	return false;
+#endif
+}
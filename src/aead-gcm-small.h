@@ -0,0 +1,36 @@
+#ifndef AEAD_GCM_SMALL_H_
+#define AEAD_GCM_SMALL_H_
+
+#include <stddef.h>
+
+#include "aead-aesni.h"
+
+namespace aead {
+
+    // GCM for single short messages with a 12 byte IV and a 16 byte tag.
+    //
+    // For a few blocks, setting up an EVP context costs more than the
+    // cipher itself. Here, all counter blocks and E(K, J0) are encrypted
+    // in one interleaved pass, and the hash runs over up to four blocks
+    // with one reduction. The output is identical to OpenSSL's.
+    class SmallGcm {
+    public:
+        static const size_t MAX_LENGTH = 64;
+
+        // Whether a message fits; the key must come from Aesni
+        static bool Accepts(size_t iv_len, size_t len) { return iv_len == 12 && len <= MAX_LENGTH; }
+
+        static void Encrypt(const AesniKey &key, const unsigned char *iv,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext, unsigned char *auth_tag);
+        // Returns whether the tag matched; the plaintext is written either way
+        static bool Decrypt(const AesniKey &key, const unsigned char *iv,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext, const unsigned char *auth_tag);
+    };
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include <string.h>
+#include <algorithm>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include "aead-gcm-verify.h"
+#include "aead-fixed.h"
+#include "aead-soft-aes.h"
+
+using namespace aead;
+
+#ifndef EVP_CTRL_GCM_SET_IVLEN
+#define EVP_CTRL_GCM_SET_IVLEN    EVP_CTRL_AEAD_SET_IVLEN
+#endif
+
+// The scratch buffer the OpenSSL fallback decrypts into while verifying
+static const size_t SCRATCH_LEN = 4096;
+
+static const EVP_CIPHER *GcmCipher(size_t key_len) {
+	switch (key_len) {
+		case 16: return EVP_aes_128_gcm();
+		case 24: return EVP_aes_192_gcm();
+		default: return EVP_aes_256_gcm();
+	}
+}
+
+static inline void Store32BE(uint32_t v, unsigned char *p) {
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+static inline uint32_t Load32BE(const unsigned char *p) {
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+// Software AES: J0 and the tag of a ciphertext, as SoftAead computes them
+static void SoftHash(const SoftKey &key, const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *tag, unsigned char *j0
+) {
+	if (iv_len == 12) {
+		memcpy(j0, iv, 12);
+		Store32BE(1, j0 + 12);
+	} else {
+		SoftGhash iv_hash(key.h);
+		iv_hash.Update(iv, iv_len);
+		iv_hash.Lengths(0, iv_len);
+		iv_hash.Final(j0);
+	}
+	SoftGhash ghash(key.h);
+	if (aad_len > 0) ghash.Update(aad, aad_len);
+	if (len > 0) ghash.Update(ciphertext, len);
+	ghash.Lengths(aad_len, len);
+	ghash.Final(tag);
+
+	unsigned char blocks[16 * SoftAes::PARALLEL] = { 0 };
+	memcpy(blocks, j0, 16);
+	SoftAes::EncryptBlocks(key.aes, blocks);
+	for (int i = 0; i < 16; i++) tag[i] ^= blocks[i];
+	OPENSSL_cleanse(blocks, sizeof(blocks));
+}
+
+// Software AES: the counter blocks after J0
+static void SoftCtr(const SoftKey &key, const unsigned char *j0,
+	const unsigned char *in, size_t len, unsigned char *out
+) {
+	unsigned char blocks[16 * SoftAes::PARALLEL];
+	uint32_t counter = Load32BE(j0 + 12);
+	for (size_t pos = 0; pos < len;) {
+		for (size_t slot = 0; slot < SoftAes::PARALLEL; slot++) {
+			memcpy(blocks + 16 * slot, j0, 12);
+			Store32BE(++counter, blocks + 16 * slot + 12);
+		}
+		SoftAes::EncryptBlocks(key.aes, blocks);
+		const size_t n = std::min(len - pos, sizeof(blocks));
+		for (size_t i = 0; i < n; i++) out[pos + i] = in[pos + i] ^ blocks[i];
+		pos += n;
+	}
+	OPENSSL_cleanse(blocks, sizeof(blocks));
+}
+
+// ==================
+
+VerifiedGcm::VerifiedGcm(const unsigned char *key, size_t key_len, const unsigned char *iv, size_t iv_len)
+	: key_(key), key_len_(key_len), iv_(iv), iv_len_(iv_len), soft_key_(NULL), aesni_key_(NULL)
+{
+	if (SoftAead::Enabled()) {
+		soft_key_ = SoftAead::CachedKey(key, key_len);
+	} else {
+		aesni_key_ = Aesni::CachedKey(key, key_len);
+	}
+	memset(j0_, 0, sizeof(j0_));
+}
+
+VerifiedGcm::~VerifiedGcm() {
+	OPENSSL_cleanse(j0_, sizeof(j0_));
+}
+
+bool VerifiedGcm::Verify(const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	const unsigned char *auth_tag, size_t auth_tag_len
+) {
+	if (auth_tag_len < 1 || auth_tag_len > 16) return false;
+	if (soft_key_ != NULL || aesni_key_ != NULL) {
+		unsigned char tag[16];
+		if (soft_key_ != NULL) {
+			SoftHash(*soft_key_, iv_, iv_len_, aad, aad_len, ciphertext, len, tag, j0_);
+		} else {
+			AesniAead::GcmHash(*aesni_key_, iv_, iv_len_, aad, aad_len, ciphertext, len, tag, j0_);
+		}
+		const bool auth_ok = CRYPTO_memcmp(tag, auth_tag, auth_tag_len) == 0;
+		OPENSSL_cleanse(tag, sizeof(tag));
+		return auth_ok;
+	}
+
+	// OpenSSL only verifies while decrypting
+	unsigned char scratch[SCRATCH_LEN];
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int outl;
+	bool ok = ctx != NULL &&
+		EVP_DecryptInit_ex(ctx, GcmCipher(key_len_), NULL, NULL, NULL) &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)iv_len_, NULL) &&
+		EVP_DecryptInit_ex(ctx, NULL, NULL, key_, iv_) &&
+		(aad_len == 0 || EVP_DecryptUpdate(ctx, NULL, &outl, aad, (int)aad_len));
+	for (size_t pos = 0; ok && pos < len; pos += SCRATCH_LEN) {
+		ok = EVP_DecryptUpdate(ctx, scratch, &outl, ciphertext + pos, (int)std::min(SCRATCH_LEN, len - pos));
+	}
+	ok = ok &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, (int)auth_tag_len, (void *)auth_tag) &&
+		EVP_DecryptFinal_ex(ctx, scratch, &outl) > 0;
+	EVP_CIPHER_CTX_free(ctx);
+	OPENSSL_cleanse(scratch, std::min(SCRATCH_LEN, len));
+	return ok;
+}
+
+void VerifiedGcm::Decrypt(const unsigned char *ciphertext, size_t len, unsigned char *plaintext) const {
+	if (soft_key_ != NULL) {
+		SoftCtr(*soft_key_, j0_, ciphertext, len, plaintext);
+		return;
+	}
+	if (aesni_key_ != NULL) {
+		AesniAead::GcmCtr(*aesni_key_, j0_, ciphertext, len, plaintext);
+		return;
+	}
+
+	// OpenSSL hashes again, but the tag is known to match
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int outl;
+	EVP_DecryptInit_ex(ctx, GcmCipher(key_len_), NULL, NULL, NULL);
+	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)iv_len_, NULL);
+	EVP_DecryptInit_ex(ctx, NULL, NULL, key_, iv_);
+	EVP_DecryptUpdate(ctx, plaintext, &outl, ciphertext, (int)len);
+	EVP_CIPHER_CTX_free(ctx);
+}
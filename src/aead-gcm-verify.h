@@ -0,0 +1,59 @@
+#ifndef AEAD_GCM_VERIFY_H_
+#define AEAD_GCM_VERIFY_H_
+
+#include <stddef.h>
+
+#include "aead-aesni.h"
+#include "aead-soft.h"
+
+namespace aead {
+
+    // GCM decryption that authenticates before it decrypts, behind
+    // gcm.decryptVerified.
+    //
+    // GCM hashes the ciphertext, not the plaintext, so the tag can be
+    // checked first, by a pass that only hashes, and the counter mode
+    // pass runs only for messages that are authentic. Forged messages
+    // cost the hash alone, and the caller needs no plaintext buffer until
+    // Verify succeeded. With AES-NI and in software AES mode, the second
+    // pass doesn't hash again. Elsewhere OpenSSL is the only carry-less
+    // multiplication at hand: Verify decrypts into a small scratch buffer
+    // and throws it away, and Decrypt runs OpenSSL's GCM again.
+    //
+    // An instance covers one message and holds the per-thread cached key,
+    // so it must not outlive the calling function or share its thread
+    // with other cached key lookups.
+    class VerifiedGcm {
+    public:
+        // The key is 16, 24 or 32 bytes long and the IV not empty
+        VerifiedGcm(const unsigned char *key, size_t key_len, const unsigned char *iv, size_t iv_len);
+        ~VerifiedGcm();
+
+        // Hashes the AAD and ciphertext and compares the tag with the
+        // first auth_tag_len (1 to 16) bytes of the expected one in
+        // constant time. Returns whether they matched.
+        bool Verify(const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            const unsigned char *auth_tag, size_t auth_tag_len);
+        // Only after Verify returned true for the same ciphertext. The
+        // plaintext may be the ciphertext.
+        void Decrypt(const unsigned char *ciphertext, size_t len, unsigned char *plaintext) const;
+
+    private:
+        VerifiedGcm(const VerifiedGcm &);
+        VerifiedGcm &operator=(const VerifiedGcm &);
+
+        const unsigned char *key_;
+        size_t key_len_;
+        const unsigned char *iv_;
+        size_t iv_len_;
+        // at most one is set; neither means OpenSSL
+        const SoftKey *soft_key_;
+        const AesniKey *aesni_key_;
+        // J0, the block before the first counter block, once verified
+        unsigned char j0_[16];
+    };
+
+}
+
+#endif
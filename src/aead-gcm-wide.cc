@@ -0,0 +1,208 @@
+#include <string.h>
+#include <algorithm>
+#include <openssl/crypto.h>
+
+#include "aead-gcm-wide.h"
+#include "aead-cpu.h"
+
+using namespace aead;
+
+bool WideGcm::Supported() {
+#ifdef AEAD_HAVE_AESNI
+	const CpuFeatures &cpu = CpuFeatures::Get();
+	return Aesni::Supported() && cpu.avx2 && cpu.vaes && cpu.vpclmulqdq;
+#else
+	return false;
+#endif
+}
+
+#ifdef AEAD_HAVE_AESNI
+
+#define AEAD_TARGET_VAES __attribute__((target("aes,pclmul,ssse3,sse4.1,avx,avx2,vaes,vpclmulqdq")))
+
+using namespace aead::aesni;
+
+// blocks per iteration, two per vector
+static const int BLOCKS = 16;
+static const int VECTORS = BLOCKS / 2;
+static const size_t CHUNK = 16 * BLOCKS;
+
+// The key material of one call, in vector form
+struct WideState {
+	__m256i round_keys[15];
+	int rounds;
+	// H^1 .. H^16
+	__m128i powers[BLOCKS];
+	// the powers the blocks of vector i are multiplied with in Hash16:
+	// H^(16 - 2i) in the low lane and H^(15 - 2i) in the high lane
+	__m256i pairs[VECTORS];
+};
+
+AEAD_TARGET_VAES static inline __m256i ByteSwap2(__m256i v) {
+	return _mm256_shuffle_epi8(v, _mm256_broadcastsi128_si256(
+		_mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)));
+}
+
+AEAD_TARGET_VAES static void Setup(const AesniKey &key, WideState &state) {
+	state.rounds = key.rounds;
+	for (int r = 0; r <= key.rounds; r++) {
+		state.round_keys[r] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)key.round_keys[r]));
+	}
+	const __m128i h = _mm_load_si128((const __m128i *)key.h);
+	state.powers[0] = h;
+	for (int i = 1; i < BLOCKS; i++) state.powers[i] = GfMul(state.powers[i - 1], h);
+	for (int i = 0; i < VECTORS; i++) {
+		state.pairs[i] = _mm256_set_m128i(state.powers[BLOCKS - 2 - 2 * i], state.powers[BLOCKS - 1 - 2 * i]);
+	}
+}
+
+// Hashes CHUNK bytes: (X ^ B_1) * H^16 ^ B_2 * H^15 ^ ... ^ B_16 * H
+AEAD_TARGET_VAES static inline __m128i Hash16(const WideState &state, __m128i hash, const unsigned char *p) {
+	__m256i lo = _mm256_setzero_si256();
+	__m256i mid = _mm256_setzero_si256();
+	__m256i hi = _mm256_setzero_si256();
+	for (int i = 0; i < VECTORS; i++) {
+		__m256i x = ByteSwap2(_mm256_loadu_si256((const __m256i *)(p + 32 * i)));
+		if (i == 0) x = _mm256_xor_si256(x, _mm256_set_m128i(_mm_setzero_si128(), hash));
+		const __m256i h = state.pairs[i];
+		lo = _mm256_xor_si256(lo, _mm256_clmulepi64_epi128(x, h, 0x00));
+		hi = _mm256_xor_si256(hi, _mm256_clmulepi64_epi128(x, h, 0x11));
+		mid = _mm256_xor_si256(mid, _mm256_xor_si256(
+			_mm256_clmulepi64_epi128(x, h, 0x10), _mm256_clmulepi64_epi128(x, h, 0x01)));
+	}
+	// add up the lanes, then reduce once
+	return Reduce(
+		_mm_xor_si128(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1)),
+		_mm_xor_si128(_mm256_castsi256_si128(mid), _mm256_extracti128_si256(mid, 1)),
+		_mm_xor_si128(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1)));
+}
+
+// Hashes less than CHUNK bytes, padded with zeroes to whole blocks
+AEAD_TARGET_VAES static __m128i HashTail(const WideState &state, __m128i hash, const unsigned char *p, size_t len) {
+	if (len == 0) return hash;
+	const size_t n = (len + 15) / 16;
+	__m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+	for (size_t j = 0; j < n; j++) {
+		__m128i x = ByteSwap(LoadPartial(p + 16 * j, std::min((size_t)16, len - 16 * j)));
+		if (j == 0) x = _mm_xor_si128(x, hash);
+		MulAdd(x, state.powers[n - 1 - j], lo, mid, hi);
+	}
+	return Reduce(lo, mid, hi);
+}
+
+AEAD_TARGET_VAES static __m128i Hash(const WideState &state, __m128i hash, const unsigned char *p, size_t len) {
+	for (; len >= CHUNK; p += CHUNK, len -= CHUNK) hash = Hash16(state, hash, p);
+	return HashTail(state, hash, p, len);
+}
+
+// Encrypts the next BLOCKS counter blocks. The counters are kept byte
+// reversed, so GCM's 32 bit increment is an addition to the low dword.
+AEAD_TARGET_VAES static inline void EncryptCounters(const WideState &state, __m256i &counters, __m256i *keystream) {
+	const __m256i two = _mm256_set_epi32(0, 0, 0, 2, 0, 0, 0, 2);
+	__m256i rk = state.round_keys[0];
+	for (int i = 0; i < VECTORS; i++) {
+		keystream[i] = _mm256_xor_si256(ByteSwap2(counters), rk);
+		counters = _mm256_add_epi32(counters, two);
+	}
+	for (int r = 1; r < state.rounds; r++) {
+		rk = state.round_keys[r];
+		for (int i = 0; i < VECTORS; i++) keystream[i] = _mm256_aesenc_epi128(keystream[i], rk);
+	}
+	rk = state.round_keys[state.rounds];
+	for (int i = 0; i < VECTORS; i++) keystream[i] = _mm256_aesenclast_epi128(keystream[i], rk);
+}
+
+AEAD_TARGET_VAES static inline void XorChunk(const unsigned char *in, const __m256i *keystream, unsigned char *out) {
+	for (int i = 0; i < VECTORS; i++) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(in + 32 * i));
+		_mm256_storeu_si256((__m256i *)(out + 32 * i), _mm256_xor_si256(x, keystream[i]));
+	}
+}
+
+// Encrypts or decrypts a message and writes the expected tag
+AEAD_TARGET_VAES static void Crypt(const AesniKey &key, bool encrypt, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *in, size_t len,
+	unsigned char *out, unsigned char *tag
+) {
+	WideState state;
+	Setup(key, state);
+	const __m128i j0 = _mm_insert_epi32(LoadPartial(iv, 12), (int)__builtin_bswap32(1), 3);
+	const __m128i mask = EncryptBlock(key, j0);
+	__m128i hash = _mm_setzero_si128();
+	if (aad_len > 0) hash = Hash(state, hash, aad, aad_len);
+
+	// the payload starts at J0 + 1
+	__m256i counters = _mm256_add_epi32(_mm256_broadcastsi128_si256(ByteSwap(j0)),
+		_mm256_set_epi32(0, 0, 0, 2, 0, 0, 0, 1));
+	__m256i keystream[VECTORS];
+	size_t pos = 0;
+	if (encrypt) {
+		// the hash trails the encryption by one chunk, so the two overlap
+		for (; len - pos >= CHUNK; pos += CHUNK) {
+			EncryptCounters(state, counters, keystream);
+			XorChunk(in + pos, keystream, out + pos);
+			if (pos > 0) hash = Hash16(state, hash, out + pos - CHUNK);
+		}
+		if (pos > 0) hash = Hash16(state, hash, out + pos - CHUNK);
+	} else {
+		for (; len - pos >= CHUNK; pos += CHUNK) {
+			EncryptCounters(state, counters, keystream);
+			// before the output, which may be the input
+			hash = Hash16(state, hash, in + pos);
+			XorChunk(in + pos, keystream, out + pos);
+		}
+	}
+
+	if (pos < len) {
+		const size_t rest = len - pos;
+		EncryptCounters(state, counters, keystream);
+		if (!encrypt) hash = HashTail(state, hash, in + pos, rest);
+		alignas(32) unsigned char buffer[CHUNK];
+		for (int i = 0; i < VECTORS; i++) _mm256_store_si256((__m256i *)(buffer + 32 * i), keystream[i]);
+		for (size_t i = 0; i < rest; i++) out[pos + i] = in[pos + i] ^ buffer[i];
+		if (encrypt) hash = HashTail(state, hash, out + pos, rest);
+		OPENSSL_cleanse(buffer, sizeof(buffer));
+	}
+
+	// [8 * aad_len]64 || [8 * len]64, byte reversed
+	const __m128i lengths = _mm_set_epi64x((long long)((uint64_t)aad_len * 8), (long long)((uint64_t)len * 8));
+	hash = GfMul(_mm_xor_si128(hash, lengths), state.powers[0]);
+	Store(_mm_xor_si128(ByteSwap(hash), mask), tag);
+
+	OPENSSL_cleanse(keystream, sizeof(keystream));
+	OPENSSL_cleanse(&state, sizeof(state));
+}
+
+#endif
+
+void WideGcm::Encrypt(const AesniKey &key, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext, unsigned char *auth_tag
+) {
+#ifdef AEAD_HAVE_AESNI
+	Crypt(key, true, iv, aad, aad_len, plaintext, len, ciphertext, auth_tag);
+#else
+	(void)key; (void)iv; (void)aad; (void)aad_len;
+	(void)plaintext; (void)len; (void)ciphertext; (void)auth_tag;
+#endif
+}
+
+bool WideGcm::Decrypt(const AesniKey &key, const unsigned char *iv,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext, const unsigned char *auth_tag
+) {
+#ifdef AEAD_HAVE_AESNI
+	unsigned char tag[16];
+	Crypt(key, false, iv, aad, aad_len, ciphertext, len, plaintext, tag);
+	const bool auth_ok = CRYPTO_memcmp(tag, auth_tag, 16) == 0;
+	OPENSSL_cleanse(tag, sizeof(tag));
+	return auth_ok;
+#else
+	(void)key; (void)iv; (void)aad; (void)aad_len;
+	(void)ciphertext; (void)len; (void)plaintext; (void)auth_tag;
+	return false;
+#endif
+}
@@ -0,0 +1,44 @@
+#ifndef AEAD_GCM_WIDE_H_
+#define AEAD_GCM_WIDE_H_
+
+#include <stddef.h>
+
+#include "aead-aesni.h"
+
+namespace aead {
+
+    // GCM for bulk messages with VAES and VPCLMULQDQ on 256 bit vectors,
+    // with a 12 byte IV and a 16 byte tag.
+    //
+    // Each instruction encrypts or multiplies two blocks. Every iteration
+    // encrypts 16 counter blocks and hashes 16 blocks against H^16 .. H^1
+    // with a single reduction, so the throughput no longer depends on how
+    // the linked OpenSSL was built. 512 bit vectors are left out on
+    // purpose: they lower the clock of many CPUs that have them, and every
+    // CPU with VAES supports the 256 bit forms. Without VAES, the callers
+    // run the AES-NI kernels of AesniAead where the tuning picks the
+    // built-in kernel (and the built-in backend always does), and OpenSSL
+    // otherwise. The output is identical to OpenSSL's.
+    class WideGcm {
+    public:
+        // Whether the kernel can run here
+        static bool Supported();
+        // Whether a message fits. Even a few blocks are faster than with
+        // EVP, though SmallGcm is faster still for those.
+        static bool Accepts(size_t iv_len) { return iv_len == 12; }
+
+        // The key must come from Aesni; only call if Supported()
+        static void Encrypt(const AesniKey &key, const unsigned char *iv,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext, unsigned char *auth_tag);
+        // Returns whether the tag matched; the plaintext is written either way
+        static bool Decrypt(const AesniKey &key, const unsigned char *iv,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext, const unsigned char *auth_tag);
+    };
+
+}
+
+#endif
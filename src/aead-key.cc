@@ -0,0 +1,172 @@
+#include <string.h>
+#include <openssl/crypto.h>
+
+#include "aead-key.h"
+#include "aead-gcm-wide.h"
+#include "aead-soft.h"
+#include "aead-tuning.h"
+
+using namespace aead;
+
+std::shared_ptr<KeyContext> KeyContext::Create(Mode mode, const unsigned char *key, size_t key_len) {
+	if (!Backend::OpenSsl().Supports(mode, key_len)) return std::shared_ptr<KeyContext>();
+	return std::shared_ptr<KeyContext>(new KeyContext(mode, key, key_len));
+}
+
+KeyContext::KeyContext(Mode mode, const unsigned char *key, size_t key_len)
+	: mode_(mode), key_len_(key_len), messages_(0), bytes_(0),
+	openssl_(static_cast<OpenSslKey *>(Backend::OpenSsl().InitKey(mode, key, key_len))),
+	builtin_(Backend::Builtin().InitKey(mode, key, key_len)),
+	backend_(NULL), selected_(NULL)
+{
+	memcpy(key_, key, key_len);
+}
+
+KeyContext::~KeyContext() {
+	OPENSSL_cleanse(key_, sizeof(key_));
+}
+
+bool KeyContext::set_backend(const Backend *backend) {
+	if (backend != NULL && !backend->Supports(mode_, key_len_)) return false;
+	other_.reset();
+	backend_ = backend;
+	if (backend == NULL) {
+		selected_ = NULL;
+	} else if (backend == &Backend::OpenSsl()) {
+		selected_ = openssl_.get();
+	} else if (backend == &Backend::Builtin()) {
+		selected_ = builtin_.get();
+	} else {
+		other_.reset(backend->InitKey(mode_, key_, key_len_));
+		selected_ = other_.get();
+	}
+	return true;
+}
+
+UsageResult KeyContext::Use(size_t bytes) {
+	const uint64_t messages = messages_.fetch_add(1, std::memory_order_relaxed) + 1;
+	const uint64_t total = bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	if (messages > limits_.hard_messages || total > limits_.hard_bytes) {
+		// undo, so refused calls don't count
+		messages_.fetch_sub(1, std::memory_order_relaxed);
+		bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+		return USAGE_HARD_LIMIT;
+	}
+	// only the call which reaches a soft limit sees the crossing
+	if (messages == limits_.soft_messages ||
+		(total >= limits_.soft_bytes && total - bytes < limits_.soft_bytes)
+	) {
+		return USAGE_SOFT_LIMIT;
+	}
+	return USAGE_OK;
+}
+
+void KeyContext::Refund(uint64_t messages, size_t bytes) {
+	messages_.fetch_sub(messages, std::memory_order_relaxed);
+	bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool KeyContext::ValidParams(Mode mode, size_t iv_len, size_t auth_tag_len) {
+	if (mode == MODE_GCM) {
+		return iv_len > 0 && auth_tag_len == 16;
+	} else {
+		return iv_len >= 7 && iv_len <= 13 &&
+			auth_tag_len >= 4 && auth_tag_len <= 16 && (auth_tag_len & 1) == 0;
+	}
+}
+
+const BackendKey &KeyContext::Select(size_t iv_len, size_t auth_tag_len, size_t len) const {
+	if (selected_ != NULL) {
+		return selected_->Accepts(iv_len, auth_tag_len) ? *selected_ : *openssl_;
+	}
+	if (SoftAead::Enabled()) return *builtin_;
+	switch (Tuning::Get(mode_, len)) {
+		case KERNEL_BUILTIN:
+			return *builtin_;
+		case KERNEL_OPENSSL:
+			return *openssl_;
+		default:
+			break;
+	}
+	if (mode_ == MODE_GCM && WideGcm::Accepts(iv_len) && WideGcm::Supported()) return *builtin_;
+	return *openssl_;
+}
+
+bool KeyContext::Encrypt(EVP_CIPHER_CTX *ctx,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t plaintext_len,
+	unsigned char *ciphertext,
+	unsigned char *auth_tag, size_t auth_tag_len
+) const {
+	if (!ValidParams(mode_, iv_len, auth_tag_len)) return false;
+	return Select(iv_len, auth_tag_len, plaintext_len).Seal(ctx, iv, iv_len, aad, aad_len,
+		plaintext, plaintext_len, ciphertext, auth_tag, auth_tag_len);
+}
+
+bool KeyContext::Decrypt(EVP_CIPHER_CTX *ctx,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t ciphertext_len,
+	unsigned char *plaintext,
+	const unsigned char *auth_tag, size_t auth_tag_len,
+	bool *auth_ok
+) const {
+	if (!ValidParams(mode_, iv_len, auth_tag_len)) return false;
+	return Select(iv_len, auth_tag_len, ciphertext_len).Open(ctx, iv, iv_len, aad, aad_len,
+		ciphertext, ciphertext_len, plaintext, auth_tag, auth_tag_len, auth_ok);
+}
+
+void KeyContext::RunBatch(EVP_CIPHER_CTX *ctx, BackendOp *ops, size_t count) const {
+	for (size_t i = 0; i < count; i++) {
+		// invalid operations are done right away
+		ops[i].done = !ValidParams(mode_, ops[i].iv_len, ops[i].tag_len);
+		ops[i].ok = false;
+		ops[i].auth_ok = false;
+	}
+	// the multi-buffer kernels are part of the automatic choice too
+	const BackendKey &batched = selected_ != NULL ? *selected_ : *builtin_;
+	batched.RunBatch(ops, count);
+	for (size_t i = 0; i < count; i++) {
+		BackendOp &op = ops[i];
+		if (op.done) continue;
+		op.ok = op.encrypt
+			? Encrypt(ctx, op.iv, op.iv_len, op.aad, op.aad_len, op.in, op.len, op.out, op.tag, op.tag_len)
+			: Decrypt(ctx, op.iv, op.iv_len, op.aad, op.aad_len, op.in, op.len, op.out, op.tag, op.tag_len, &op.auth_ok);
+		op.done = true;
+	}
+}
+
+bool KeyContext::Start(EVP_CIPHER_CTX *ctx, bool encrypt,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len
+) const {
+	if (mode_ != MODE_GCM || !ValidParams(mode_, iv_len, 16)) return false;
+	if (!EVP_CIPHER_CTX_copy(ctx, openssl_->Template(encrypt, iv_len, 16))) return false;
+
+	int outl; // output length
+	if (iv_len != 12) EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)iv_len, NULL);
+	if (!EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, encrypt)) return false;
+	if (aad_len > 0 && !EVP_CipherUpdate(ctx, NULL, &outl, aad, (int)aad_len)) return false;
+	return true;
+}
+
+bool KeyContext::Update(EVP_CIPHER_CTX *ctx, const unsigned char *in, size_t len, unsigned char *out) {
+	int outl; // output length
+	if (len == 0) return true;
+	return EVP_CipherUpdate(ctx, out, &outl, in, (int)len) > 0;
+}
+
+bool KeyContext::Finish(EVP_CIPHER_CTX *ctx, bool encrypt,
+	unsigned char *auth_tag, size_t auth_tag_len, bool *auth_ok
+) {
+	int outl; // output length
+	unsigned char final_output[16];
+	if (encrypt) {
+		EVP_EncryptFinal_ex(ctx, final_output, &outl);
+		return EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, (int)auth_tag_len, auth_tag) > 0;
+	}
+	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, (int)auth_tag_len, auth_tag);
+	*auth_ok = EVP_DecryptFinal_ex(ctx, final_output, &outl) > 0;
+	return true;
+}
@@ -0,0 +1,143 @@
+#ifndef AEAD_KEY_H_
+#define AEAD_KEY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <openssl/evp.h>
+
+#include "aead-backend.h"
+#include "aead-backend-openssl.h"
+#include "aead-nonce.h"
+#include "aead-reuse.h"
+
+namespace aead {
+
+    // Usage limits of a key; all unlimited by default
+    struct KeyLimits {
+        uint64_t soft_messages;
+        uint64_t hard_messages;
+        uint64_t soft_bytes;
+        uint64_t hard_bytes;
+
+        KeyLimits() : soft_messages(UINT64_MAX), hard_messages(UINT64_MAX),
+            soft_bytes(UINT64_MAX), hard_bytes(UINT64_MAX) {}
+    };
+
+    enum UsageResult {
+        USAGE_OK,
+        // this use crossed a soft limit, the key should be rotated
+        USAGE_SOFT_LIMIT,
+        // a hard limit would be exceeded, the use was not counted
+        USAGE_HARD_LIMIT
+    };
+
+    // An AES key bound to one AEAD mode. The key is set up once for OpenSSL
+    // and the built-in kernels, and for another backend if one is selected.
+    // Apart from its atomic nonce and usage state, a KeyContext is immutable
+    // after creation and can be used from several threads at once.
+    class KeyContext {
+    public:
+        // Returns NULL if the key length is not 16, 24 or 32 bytes
+        static std::shared_ptr<KeyContext> Create(Mode mode, const unsigned char *key, size_t key_len);
+        ~KeyContext();
+
+        Mode mode() const { return mode_; }
+        size_t key_len() const { return key_len_; }
+        // The raw key and its AES-NI schedule (NULL without AES-NI), for
+        // trial decryption, which runs its own kernels over many keys
+        const unsigned char *key() const { return key_; }
+        const AesniKey *aesni_key() const { return builtin_ ? builtin_->aesni_key() : NULL; }
+
+        // Nonce generation for seal(); NULL if not configured.
+        // Must only be set before the context is shared.
+        NonceGenerator *nonce_generator() const { return nonce_generator_.get(); }
+        void set_nonce_generator(NonceGenerator *generator) { nonce_generator_.reset(generator); }
+        // Detection of reused nonces; NULL if disabled. Set like the generator.
+        NonceReuseDetector *reuse_detector() const { return reuse_detector_.get(); }
+        void set_reuse_detector(NonceReuseDetector *detector) { reuse_detector_.reset(detector); }
+        // Usage limits; also only set before the context is shared
+        const KeyLimits &limits() const { return limits_; }
+        void set_limits(const KeyLimits &limits) { limits_ = limits; }
+        // The backend all operations use where it accepts their parameters;
+        // NULL (the default) picks one per operation. Returns false if the
+        // backend doesn't support the mode and key length here. Also only set
+        // before the context is shared.
+        const Backend *backend() const { return backend_; }
+        bool set_backend(const Backend *backend);
+
+        // Counts one encryption of the given number of bytes against the
+        // limits. Exactly one caller is told about crossing each soft limit.
+        UsageResult Use(size_t bytes);
+        // Takes back Use calls that weren't followed by an encryption, like
+        // those of a job the thread pool refused
+        void Refund(uint64_t messages, size_t bytes);
+        // Encryptions and bytes (plaintext and additional data) counted so far
+        uint64_t messages() const { return messages_.load(std::memory_order_relaxed); }
+        uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+        // Both return false if the parameters are invalid for the mode.
+        // Decrypt additionally reports whether the auth tag matched.
+        // Without a selected backend, they use the built-in kernels while
+        // SoftAead is enabled, then follow Tuning, and by default use them
+        // for GCM with 12 byte IVs where the CPU has VAES, and OpenSSL
+        // otherwise.
+        bool Encrypt(EVP_CIPHER_CTX *ctx,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t plaintext_len,
+            unsigned char *ciphertext,
+            unsigned char *auth_tag, size_t auth_tag_len) const;
+        bool Decrypt(EVP_CIPHER_CTX *ctx,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t ciphertext_len,
+            unsigned char *plaintext,
+            const unsigned char *auth_tag, size_t auth_tag_len,
+            bool *auth_ok) const;
+
+        // Runs a batch of operations, each like Encrypt or Decrypt, letting
+        // the backend process some of them together. Sets done on all.
+        void RunBatch(EVP_CIPHER_CTX *ctx, BackendOp *ops, size_t count) const;
+
+        // Incremental GCM, so long messages can be processed in slices:
+        // Start once, Update any number of times, then Finish. Only valid for
+        // GCM keys; CCM needs the whole message in one call. Always runs on
+        // OpenSSL, so only use it if CanStream().
+        bool CanStream() const { return backend_ == NULL || backend_ == &Backend::OpenSsl(); }
+        bool Start(EVP_CIPHER_CTX *ctx, bool encrypt,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len) const;
+        static bool Update(EVP_CIPHER_CTX *ctx, const unsigned char *in, size_t len, unsigned char *out);
+        // Encryption writes the auth tag, decryption checks it and sets auth_ok
+        static bool Finish(EVP_CIPHER_CTX *ctx, bool encrypt,
+            unsigned char *auth_tag, size_t auth_tag_len, bool *auth_ok);
+
+        static bool ValidParams(Mode mode, size_t iv_len, size_t auth_tag_len);
+
+    private:
+        KeyContext(Mode mode, const unsigned char *key, size_t key_len);
+        // The backend key for an operation with valid parameters
+        const BackendKey &Select(size_t iv_len, size_t auth_tag_len, size_t len) const;
+
+        const Mode mode_;
+        unsigned char key_[32];
+        const size_t key_len_;
+        std::unique_ptr<NonceGenerator> nonce_generator_;
+        std::unique_ptr<NonceReuseDetector> reuse_detector_;
+        KeyLimits limits_;
+        std::atomic<uint64_t> messages_;
+        std::atomic<uint64_t> bytes_;
+        // OpenSSL also serves what other backends don't accept
+        std::unique_ptr<OpenSslKey> openssl_;
+        std::unique_ptr<BackendKey> builtin_;
+        const Backend *backend_;
+        // The key of the selected backend; one of the above or other_
+        const BackendKey *selected_;
+        std::unique_ptr<BackendKey> other_;
+    };
+
+}
+
+#endif
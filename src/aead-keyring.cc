@@ -0,0 +1,124 @@
+#include "aead-keyring.h"
+
+using namespace aead;
+
+// keep the load factor of the tables at or below 1/2
+static size_t CapacityFor(size_t count) {
+	size_t capacity = 16;
+	while (capacity < count * 2) capacity <<= 1;
+	return capacity;
+}
+
+// Fibonacci hashing spreads sequential IDs over the whole table
+static inline size_t Hash(uint32_t id, size_t mask) {
+	return (size_t)(((uint64_t)id * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+Keyring::Table::Table(size_t capacity)
+	: slots(new Slot[capacity]), mask(capacity - 1), used(0)
+{
+	for (size_t i = 0; i < capacity; i++) {
+		slots[i].used.store(false, std::memory_order_relaxed);
+		slots[i].id = 0;
+		slots[i].entry.store(NULL, std::memory_order_relaxed);
+	}
+}
+
+// Entries are shared between a table and its successor, so they are not freed here
+Keyring::Table::~Table() {
+	delete[] slots;
+}
+
+Keyring::Slot *Keyring::Table::Find(uint32_t id) const {
+	for (size_t i = Hash(id, mask); slots[i].used.load(); i = (i + 1) & mask) {
+		if (slots[i].id == id) return &slots[i];
+	}
+	return NULL;
+}
+
+// ==================
+
+Keyring::Keyring()
+	: table_(new Table(CapacityFor(0))), size_(0)
+{}
+
+Keyring::~Keyring() {
+	Table *table = table_.load();
+	for (size_t i = 0; i <= table->mask; i++) delete table->slots[i].entry.load();
+	delete table;
+}
+
+std::shared_ptr<KeyContext> Keyring::Get(uint32_t id) const {
+	// the table and entry stay valid while we are counted as a reader
+	ReaderEpoch::Reader reader(epoch_);
+	std::shared_ptr<KeyContext> ret;
+	Slot *slot = table_.load()->Find(id);
+	if (slot != NULL) {
+		Entry *entry = slot->entry.load();
+		if (entry != NULL) ret = entry->key;
+	}
+	return ret;
+}
+
+void Keyring::Set(uint32_t id, const std::shared_ptr<KeyContext> &key) {
+	std::lock_guard<std::mutex> lock(write_mutex_);
+	Entry *entry = new Entry(key);
+	Entry *old = NULL;
+	Table *old_table = NULL;
+
+	Table *table = table_.load();
+	Slot *slot = table->Find(id);
+	if (slot != NULL) {
+		// replace the key in place (or revive a deleted slot)
+		old = slot->entry.exchange(entry);
+		if (old == NULL) size_++;
+	} else {
+		if ((table->used + 1) * 2 > table->mask + 1) {
+			old_table = Grow();
+			table = table_.load();
+		}
+		size_t i = Hash(id, table->mask);
+		while (table->slots[i].used.load()) i = (i + 1) & table->mask;
+		table->slots[i].id = id;
+		table->slots[i].entry.store(entry);
+		table->slots[i].used.store(true);
+		table->used++;
+		size_++;
+	}
+	if (old == NULL && old_table == NULL) return;
+	epoch_.Synchronize();
+	delete old;
+	delete old_table;
+}
+
+bool Keyring::Delete(uint32_t id) {
+	std::lock_guard<std::mutex> lock(write_mutex_);
+	Slot *slot = table_.load()->Find(id);
+	if (slot == NULL) return false;
+	Entry *old = slot->entry.exchange(NULL);
+	if (old == NULL) return false;
+	size_--;
+	epoch_.Synchronize();
+	delete old;
+	return true;
+}
+
+// Copies all live keys into a new table with room for more and returns
+// the old one. Must be called with the write mutex held.
+Keyring::Table *Keyring::Grow() {
+	Table *current = table_.load();
+	Table *next = new Table(CapacityFor(size_.load() + 1));
+	for (size_t i = 0; i <= current->mask; i++) {
+		const Slot &slot = current->slots[i];
+		Entry *entry = slot.entry.load();
+		if (!slot.used.load() || entry == NULL) continue;
+		size_t j = Hash(slot.id, next->mask);
+		while (next->slots[j].used.load(std::memory_order_relaxed)) j = (j + 1) & next->mask;
+		next->slots[j].id = slot.id;
+		next->slots[j].entry.store(entry, std::memory_order_relaxed);
+		next->slots[j].used.store(true, std::memory_order_relaxed);
+		next->used++;
+	}
+	table_.store(next);
+	return current;
+}
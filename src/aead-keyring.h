@@ -0,0 +1,66 @@
+#ifndef AEAD_KEYRING_H_
+#define AEAD_KEYRING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "aead-epoch.h"
+#include "aead-key.h"
+
+namespace aead {
+
+    // Maps key IDs to key contexts. Lookups never take a lock.
+    //
+    // Keys live in an open-addressing (linear probing) hash table whose slots
+    // are published atomically. Adding, replacing or removing a key swaps a
+    // single slot entry; only growing the table copies it.
+    //
+    // Lookups count as readers of a ReaderEpoch. A writer that unpublished
+    // an entry or table waits for the lookups that may still use it, which
+    // take no longer than one lookup each. So replaced entries, and the key
+    // material of deleted keys, are freed before Set or Delete returns.
+    class Keyring {
+    public:
+        Keyring();
+        ~Keyring();
+
+        std::shared_ptr<KeyContext> Get(uint32_t id) const;
+        void Set(uint32_t id, const std::shared_ptr<KeyContext> &key);
+        bool Delete(uint32_t id);
+        size_t Size() const { return size_.load(); }
+
+    private:
+        struct Entry {
+            explicit Entry(const std::shared_ptr<KeyContext> &key) : key(key) {}
+            std::shared_ptr<KeyContext> key;
+        };
+        struct Slot {
+            // id is written once before used is set and never changes afterwards.
+            // Deleted keys leave their slot behind with a NULL entry.
+            std::atomic<bool> used;
+            uint32_t id;
+            std::atomic<Entry *> entry;
+        };
+        struct Table {
+            explicit Table(size_t capacity);
+            ~Table();
+            Slot *Find(uint32_t id) const;
+            Slot *slots;
+            size_t mask;
+            size_t used; // including deleted slots
+        };
+
+        Table *Grow();
+
+        std::atomic<Table *> table_;
+        std::atomic<size_t> size_;
+        mutable ReaderEpoch epoch_;
+        std::mutex write_mutex_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,39 @@
+#include <string.h>
+
+#include "aead-nonce.h"
+#include "aead-random.h"
+
+using namespace aead;
+
+NonceGenerator::NonceGenerator(bool random, size_t nonce_len, uint64_t next)
+	: random_(random), nonce_len_(nonce_len), next_(next)
+{}
+
+NonceGenerator *NonceGenerator::Sequence(const unsigned char *fixed, size_t fixed_len, uint64_t next) {
+	NonceGenerator *ret = new NonceGenerator(false, fixed_len + 8, next);
+	memcpy(ret->fixed_, fixed, fixed_len);
+	return ret;
+}
+
+NonceGenerator *NonceGenerator::Random(size_t nonce_len) {
+	return new NonceGenerator(true, nonce_len, 0);
+}
+
+bool NonceGenerator::Next(unsigned char *out) {
+	if (random_) return RandomBytes(out, nonce_len_);
+
+	// The last counter value is reserved to mark the sequence as used up,
+	// so the counter can never wrap around to a value that was used before
+	uint64_t counter = next_.load(std::memory_order_relaxed);
+	do {
+		if (counter == EXHAUSTED) return false;
+	} while (!next_.compare_exchange_weak(counter, counter + 1, std::memory_order_relaxed));
+
+	const size_t fixed_len = nonce_len_ - 8;
+	memcpy(out, fixed_, fixed_len);
+	for (int i = 7; i >= 0; i--) {
+		out[fixed_len + i] = (unsigned char)counter;
+		counter >>= 8;
+	}
+	return true;
+}
@@ -0,0 +1,42 @@
+#ifndef AEAD_NONCE_H_
+#define AEAD_NONCE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+namespace aead {
+
+    // Generates the nonces for seal(), either
+    // - deterministically in the style of RFC 5116, section 3.2: a fixed field
+    //   followed by a 64 bit big-endian invocation counter. The counter is
+    //   shared by all threads using the key and never wraps.
+    // - or randomly, from the buffered per-thread CSPRNG.
+    class NonceGenerator {
+    public:
+        static const size_t MAX_FIXED_LEN = 8;
+        static const uint64_t EXHAUSTED = UINT64_MAX;
+
+        static NonceGenerator *Sequence(const unsigned char *fixed, size_t fixed_len, uint64_t next);
+        static NonceGenerator *Random(size_t nonce_len);
+
+        size_t nonce_len() const { return nonce_len_; }
+        bool is_random() const { return random_; }
+        // Writes the next nonce to out. Returns false once the counter is
+        // exhausted or if no random bytes could be generated.
+        bool Next(unsigned char *out);
+        // The counter value the next nonce will use, for persisting the position
+        uint64_t Position() const { return next_.load(); }
+
+    private:
+        NonceGenerator(bool random, size_t nonce_len, uint64_t next);
+
+        const bool random_;
+        const size_t nonce_len_;
+        unsigned char fixed_[MAX_FIXED_LEN];
+        std::atomic<uint64_t> next_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include <algorithm>
+
+#include "aead-parallel.h"
+#include "aead-pool.h"
+
+using namespace aead;
+
+// Chunks per participating thread, so threads finishing early can help out
+static const size_t CHUNKS_PER_THREAD = 4;
+
+std::atomic<size_t> ChunkedWork::threshold_(ChunkedWork::DEFAULT_THRESHOLD);
+std::atomic<size_t> ChunkedWork::min_chunk_size_(ChunkedWork::DEFAULT_MIN_CHUNK_SIZE);
+
+class ChunkedWork::HelperJob : public Job {
+public:
+	explicit HelperJob(const std::shared_ptr<ChunkedWork> &work) : work_(work) {}
+	void Run(WorkerContext &worker) { work_->RunChunks(); }
+	void Done() { delete this; }
+
+private:
+	std::shared_ptr<ChunkedWork> work_;
+};
+
+void ChunkedWork::Configure(size_t threshold) {
+	threshold_.store(threshold);
+}
+
+size_t ChunkedWork::threshold() {
+	return threshold_.load();
+}
+
+bool ChunkedWork::ShouldSplit(size_t len) {
+	const size_t threshold = threshold_.load(std::memory_order_relaxed);
+	return threshold != 0 && len >= threshold;
+}
+
+void ChunkedWork::ConfigureChunkSize(size_t min_chunk_size) {
+	min_chunk_size_.store(std::max(min_chunk_size, (size_t)MIN_CHUNK_SIZE));
+}
+
+size_t ChunkedWork::min_chunk_size() {
+	return min_chunk_size_.load();
+}
+
+size_t ChunkedWork::ChunkSize(size_t len) {
+	const size_t parts = (ThreadPool::Get().threads() + 1) * CHUNKS_PER_THREAD;
+	const size_t size = std::max(min_chunk_size_.load(std::memory_order_relaxed), (len + parts - 1) / parts);
+	return (size + 15) / 16 * 16;
+}
+
+ChunkedWork::ChunkedWork() : chunks_(0), next_(0), done_count_(0), ok_(true) {}
+
+void ChunkedWork::Init(size_t chunks) {
+	chunks_ = chunks;
+	done_.assign(chunks, false);
+}
+
+void ChunkedWork::StartHelpers() {
+	ThreadPool &pool = ThreadPool::Get();
+	const size_t helpers = std::min((size_t)pool.threads(), chunks_ > 0 ? chunks_ - 1 : 0);
+	for (size_t i = 0; i < helpers; i++) {
+		HelperJob *job = new HelperJob(shared_from_this());
+		// with a full queue, the caller does more of the work itself
+		if (!pool.Submit(job)) {
+			delete job;
+			break;
+		}
+	}
+}
+
+bool ChunkedWork::RunNextChunk() {
+	const size_t index = next_.fetch_add(1);
+	if (index >= chunks_) return false;
+	const bool chunk_ok = ProcessChunk(index);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!chunk_ok) ok_ = false;
+	done_[index] = true;
+	done_count_++;
+	finished_.notify_all();
+	return true;
+}
+
+void ChunkedWork::RunChunks() {
+	while (RunNextChunk()) {}
+}
+
+void ChunkedWork::WaitForChunk(size_t index) {
+	while (next_.load() <= index && RunNextChunk()) {}
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (!done_[index]) finished_.wait(lock);
+}
+
+bool ChunkedWork::Finish() {
+	RunChunks();
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (done_count_ < chunks_) finished_.wait(lock);
+	return ok_;
+}
@@ -0,0 +1,78 @@
+#ifndef AEAD_PARALLEL_H_
+#define AEAD_PARALLEL_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace aead {
+
+    // One operation split into numbered chunks, which the calling thread
+    // processes together with helper jobs on the crypto thread pool.
+    // Helpers may start after the operation has finished, so the work is
+    // reference counted; late helpers find no chunks left to claim and never
+    // touch the caller's buffers.
+    class ChunkedWork : public std::enable_shared_from_this<ChunkedWork> {
+    public:
+        static const size_t DEFAULT_THRESHOLD = 4 << 20;
+        static const size_t DEFAULT_MIN_CHUNK_SIZE = 256 << 10;
+        static const size_t MIN_CHUNK_SIZE = 16 << 10;
+
+        // Messages of at least threshold bytes are split; 0 disables splitting
+        static void Configure(size_t threshold);
+        static size_t threshold();
+        static bool ShouldSplit(size_t len);
+        // The smallest chunk a message is split into, at least MIN_CHUNK_SIZE
+        static void ConfigureChunkSize(size_t min_chunk_size);
+        static size_t min_chunk_size();
+        // A chunk size (a multiple of 16) giving every thread that can take
+        // part a few chunks of the message
+        static size_t ChunkSize(size_t len);
+
+        virtual ~ChunkedWork() {}
+
+        // Sets the number of chunks; call once before anything else
+        void Init(size_t chunks);
+        size_t chunks() const { return chunks_; }
+
+        // Submits a helper job for each pool thread, but not more than there
+        // are chunks besides the caller's
+        void StartHelpers();
+        // Claims and processes chunks until there are none left
+        void RunChunks();
+        // Claims and processes chunks until the given one is claimed, then
+        // waits until it is finished. For callers consuming chunks in order.
+        void WaitForChunk(size_t index);
+        // Processes the remaining chunks and waits for all of them.
+        // Returns false if any failed.
+        bool Finish();
+
+    protected:
+        ChunkedWork();
+        // Runs on the caller's thread or a pool thread
+        virtual bool ProcessChunk(size_t index) = 0;
+
+    private:
+        class HelperJob;
+
+        // Returns false if no chunk is left
+        bool RunNextChunk();
+
+        size_t chunks_;
+        std::atomic<size_t> next_;
+        std::mutex mutex_;
+        std::condition_variable finished_;
+        std::vector<bool> done_;
+        size_t done_count_;
+        bool ok_;
+
+        static std::atomic<size_t> threshold_;
+        static std::atomic<size_t> min_chunk_size_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "aead-pool.h"
+#include "aead-aesni.h"
+#include "aead-soft.h"
+
+using namespace aead;
+
+// Idle workers poll the queue this many times before going to sleep
+static const int SPIN_COUNT = 64;
+
+ThreadPool &ThreadPool::Get() {
+	// Never destroyed: worker threads may still be running at exit
+	static ThreadPool *pool = new ThreadPool();
+	return *pool;
+}
+
+ThreadPool::ThreadPool() : queue_(QUEUE_CAPACITY), thread_count_(0), sleepers_(0), stopping_(false) {
+	Start(Resolve(PoolOptions()));
+}
+
+// Returns the CPUs the process may run on, in order
+static std::vector<int> AvailableCpus() {
+	std::vector<int> cpus;
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for (int i = 0; i < CPU_SETSIZE; i++) {
+			if (CPU_ISSET(i, &set)) cpus.push_back(i);
+		}
+	}
+#endif
+	return cpus;
+}
+
+// Fills in the defaults, so equal configurations compare equal
+PoolOptions ThreadPool::Resolve(const PoolOptions &options) {
+	PoolOptions resolved = options;
+	if (resolved.threads == 0) {
+		resolved.threads = std::thread::hardware_concurrency();
+		if (resolved.threads == 0) resolved.threads = 4;
+	}
+#ifdef __linux__
+	if (resolved.pin && resolved.cpus.empty()) resolved.cpus = AvailableCpus();
+#else
+	resolved.pin = false;
+#endif
+	if (resolved.cpus.empty()) resolved.pin = false;
+	if (!resolved.pin) resolved.cpus.clear();
+	return resolved;
+}
+
+void ThreadPool::Start(const PoolOptions &options) {
+	options_ = options;
+	thread_count_.store(options_.threads);
+
+	for (unsigned i = 0; i < options_.threads; i++) {
+		const int cpu = options_.pin ? options_.cpus[i % options_.cpus.size()] : -1;
+		workers_.push_back(std::thread(&ThreadPool::WorkerMain, this, i, cpu));
+	}
+}
+
+void ThreadPool::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		stopping_.store(true);
+	}
+	wakeup_.notify_all();
+	for (size_t i = 0; i < workers_.size(); i++) workers_[i].join();
+	workers_.clear();
+	stopping_.store(false);
+}
+
+void ThreadPool::Configure(const PoolOptions &options) {
+	const PoolOptions resolved = Resolve(options);
+	std::lock_guard<std::mutex> lock(config_mutex_);
+	if (resolved.threads == options_.threads && resolved.pin == options_.pin && resolved.cpus == options_.cpus) return;
+	Stop();
+	Start(resolved);
+}
+
+PoolOptions ThreadPool::options() const {
+	std::lock_guard<std::mutex> lock(config_mutex_);
+	return options_;
+}
+
+unsigned ThreadPool::threads() const {
+	return thread_count_.load(std::memory_order_relaxed);
+}
+
+bool ThreadPool::pinned() const {
+	std::lock_guard<std::mutex> lock(config_mutex_);
+	return options_.pin;
+}
+
+bool ThreadPool::Submit(Job *job) {
+	if (!queue_.Push(job)) return false;
+	// Pairs with the fence in WaitForJob: either the sleeper sees the job,
+	// or we see the sleeper
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleepers_.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		wakeup_.notify_one();
+	}
+	return true;
+}
+
+// Returns the next job, or NULL once the pool is stopping and the queue is empty
+Job *ThreadPool::WaitForJob() {
+	Job *job;
+	for (int i = 0; i < SPIN_COUNT; i++) {
+		if (queue_.Pop(&job)) return job;
+	}
+
+	// don't keep the keys of finished jobs around while idle
+	Aesni::ClearCachedKeys();
+	SoftAead::ClearCachedKeys();
+
+	std::unique_lock<std::mutex> lock(sleep_mutex_);
+	for (;;) {
+		sleepers_.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (queue_.Pop(&job)) {
+			sleepers_.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+		if (stopping_.load()) {
+			sleepers_.fetch_sub(1, std::memory_order_relaxed);
+			return NULL;
+		}
+		wakeup_.wait(lock);
+		sleepers_.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
+
+void ThreadPool::WorkerMain(unsigned index, int cpu) {
+#ifdef __linux__
+	if (cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+#endif
+	// created after pinning, so first-touch puts it on the CPU's NUMA node
+	WorkerContext worker;
+	worker.index = index;
+	worker.scratch = EVP_CIPHER_CTX_new();
+
+	while (Job *job = WaitForJob()) {
+		job->Run(worker);
+		job->Done();
+	}
+
+	EVP_CIPHER_CTX_free(worker.scratch);
+}
@@ -0,0 +1,103 @@
+#ifndef AEAD_POOL_H_
+#define AEAD_POOL_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <openssl/evp.h>
+
+#include "aead-queue.h"
+
+namespace aead {
+
+    // Per-thread state of a pool worker: its index and a reusable OpenSSL
+    // context, so jobs don't allocate one per message. The context is
+    // created by the worker after pinning. Job inputs and outputs are not
+    // placed per worker; they live wherever the JS thread allocated them.
+    struct WorkerContext {
+        unsigned index;
+        EVP_CIPHER_CTX *scratch;
+    };
+
+    // A unit of work for the pool
+    class Job {
+    public:
+        virtual ~Job() {}
+        // Does the work on a pool thread
+        virtual void Run(WorkerContext &worker) = 0;
+        // Called on the pool thread after Run; the job must not be touched
+        // by the pool afterwards
+        virtual void Done() = 0;
+
+        // Bytes left to process, for the scheduler's fair sharing
+        virtual size_t Cost() const { return 0; }
+        // Processes about budget bytes, so the scheduler can preempt long
+        // jobs between slices. Returns true once the job is finished.
+        virtual bool RunSlice(WorkerContext &worker, size_t budget) {
+            Run(worker);
+            return true;
+        }
+        // The job's deadline passed before it finished; Done follows
+        virtual void Expire() {}
+    };
+
+    struct PoolOptions {
+        // 0: one thread per CPU
+        unsigned threads;
+        // Pin worker i to the i-th CPU in cpus (or of the process' affinity
+        // mask if empty). Only supported on Linux.
+        bool pin;
+        std::vector<int> cpus;
+
+        PoolOptions() : threads(0), pin(false) {}
+    };
+
+    // Crypto thread pool, separate from libuv's, so crypto work neither
+    // competes with fs/dns requests nor is limited to UV_THREADPOOL_SIZE.
+    // Jobs are handed out through a lock-free queue; idle workers sleep on
+    // a condition variable which is only signaled if someone is asleep.
+    class ThreadPool {
+    public:
+        static const size_t QUEUE_CAPACITY = 1 << 16;
+
+        // The process-wide pool, started with default options on first use
+        static ThreadPool &Get();
+
+        // Restarts the workers with new options, unless they are the same.
+        // Queued jobs are kept.
+        void Configure(const PoolOptions &options);
+        // The options the workers run with, defaults filled in
+        PoolOptions options() const;
+        // Returns false if the queue is full
+        bool Submit(Job *job);
+
+        unsigned threads() const;
+        bool pinned() const;
+
+    private:
+        ThreadPool();
+        static PoolOptions Resolve(const PoolOptions &options);
+        // Takes resolved options
+        void Start(const PoolOptions &options);
+        void Stop();
+        void WorkerMain(unsigned index, int cpu);
+        Job *WaitForJob();
+
+        MpmcQueue<Job *> queue_;
+        mutable std::mutex config_mutex_;
+        std::vector<std::thread> workers_;
+        PoolOptions options_;
+
+        std::mutex sleep_mutex_;
+        std::condition_variable wakeup_;
+        std::atomic<unsigned> thread_count_;
+        std::atomic<unsigned> sleepers_;
+        std::atomic<bool> stopping_;
+    };
+
+}
+
+#endif
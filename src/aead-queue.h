@@ -0,0 +1,100 @@
+#ifndef AEAD_QUEUE_H_
+#define AEAD_QUEUE_H_
+
+#include <stddef.h>
+#include <atomic>
+
+namespace aead {
+
+    // Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's
+    // design). Every cell carries a sequence number which tells producers and
+    // consumers whether it is free or filled for their lap of the ring, so
+    // each operation is a single CAS on the head or tail position.
+    template <typename T>
+    class MpmcQueue {
+    public:
+        // capacity is rounded up to a power of two
+        explicit MpmcQueue(size_t capacity) {
+            size_t size = 2;
+            while (size < capacity) size <<= 1;
+            mask_ = size - 1;
+            cells_ = new Cell[size];
+            for (size_t i = 0; i < size; i++) cells_[i].sequence.store(i, std::memory_order_relaxed);
+            enqueue_pos_.store(0, std::memory_order_relaxed);
+            dequeue_pos_.store(0, std::memory_order_relaxed);
+        }
+        ~MpmcQueue() { delete[] cells_; }
+
+        // Returns false if the queue is full
+        bool Push(const T &value) {
+            Cell *cell;
+            size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+            for (;;) {
+                cell = &cells_[pos & mask_];
+                const size_t seq = cell->sequence.load(std::memory_order_acquire);
+                const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                if (diff == 0) {
+                    if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+            cell->value = value;
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Returns false if the queue is empty
+        bool Pop(T *value) {
+            Cell *cell;
+            size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+            for (;;) {
+                cell = &cells_[pos & mask_];
+                const size_t seq = cell->sequence.load(std::memory_order_acquire);
+                const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+                if (diff == 0) {
+                    if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = dequeue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+            *value = cell->value;
+            cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Approximate, for scheduling decisions only
+        size_t Size() const {
+            const size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+            const size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+
+    private:
+        MpmcQueue(const MpmcQueue &);
+        MpmcQueue &operator=(const MpmcQueue &);
+
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        // the positions live on separate cache lines,
+        // so producers and consumers don't invalidate each other
+        char pad0_[64];
+        Cell *cells_;
+        size_t mask_;
+        char pad1_[64];
+        std::atomic<size_t> enqueue_pos_;
+        char pad2_[64];
+        std::atomic<size_t> dequeue_pos_;
+        char pad3_[64];
+    };
+
+}
+
+#endif
@@ -0,0 +1,69 @@
+#include <string.h>
+#include <atomic>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "aead-random.h"
+
+// Drawing nonces one at a time from RAND_bytes costs a trip through the DRBG
+// (and its lock) per message. Instead, each thread keeps a block of random
+// bytes and refills it in bulk; the DRBG still reseeds itself as usual.
+static const size_t POOL_SIZE = 4096;
+
+struct RandomPool {
+	unsigned char bytes[POOL_SIZE];
+	size_t pos;
+	unsigned long generation;
+};
+
+static thread_local RandomPool pool = { { 0 }, POOL_SIZE, 0 };
+
+// Bumped in the child after every fork. Asking for the PID instead would
+// be a system call per nonce, since glibc stopped caching it.
+static std::atomic<unsigned long> fork_generation(0);
+
+#ifndef _WIN32
+static void OnForkChild() {
+	fork_generation.fetch_add(1, std::memory_order_relaxed);
+}
+#endif
+
+static bool WatchForks() {
+#ifndef _WIN32
+	pthread_atfork(NULL, NULL, OnForkChild);
+#endif
+	return true;
+}
+
+bool aead::RandomBytes(unsigned char *out, size_t len) {
+	// large requests don't benefit from buffering
+	if (len > POOL_SIZE / 16) return RAND_bytes(out, (int)len) == 1;
+
+	// A forked child must not hand out the same bytes as its parent. The
+	// handler is in place before any pool is filled.
+	static const bool watching = WatchForks();
+	(void)watching;
+	const unsigned long generation = fork_generation.load(std::memory_order_relaxed);
+	if (pool.generation != generation) {
+		OPENSSL_cleanse(pool.bytes, POOL_SIZE);
+		pool.pos = POOL_SIZE;
+		pool.generation = generation;
+	}
+
+	if (pool.pos + len > POOL_SIZE) {
+		if (RAND_bytes(pool.bytes, (int)POOL_SIZE) != 1) {
+			pool.pos = POOL_SIZE;
+			return false;
+		}
+		pool.pos = 0;
+	}
+
+	// bytes are never handed out twice
+	memcpy(out, pool.bytes + pool.pos, len);
+	OPENSSL_cleanse(pool.bytes + pool.pos, len);
+	pool.pos += len;
+	return true;
+}
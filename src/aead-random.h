@@ -0,0 +1,15 @@
+#ifndef AEAD_RANDOM_H_
+#define AEAD_RANDOM_H_
+
+#include <stddef.h>
+
+namespace aead {
+
+    // Fills out with cryptographically secure random bytes. Small requests are
+    // served from a per-thread buffer that is refilled from OpenSSL's DRBG in
+    // blocks and discarded after a fork. Returns false if OpenSSL fails.
+    bool RandomBytes(unsigned char *out, size_t len);
+
+}
+
+#endif
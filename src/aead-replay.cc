@@ -0,0 +1,38 @@
+#include "aead-replay.h"
+
+using namespace aead;
+
+ReplayWindow::ReplayWindow(size_t size)
+	: size_((size + 63) & ~(size_t)63),
+	bitmap_(size_ / 64 + 1, 0),
+	highest_(0), empty_(true)
+{}
+
+bool ReplayWindow::Check(uint64_t seq) const {
+	if (empty_ || seq > highest_) return true;
+	if (highest_ - seq >= size_) return false; // too old
+	const uint64_t word = bitmap_[(seq >> 6) % bitmap_.size()];
+	return (word & ((uint64_t)1 << (seq & 63))) == 0;
+}
+
+void ReplayWindow::Update(uint64_t seq) {
+	const size_t words = bitmap_.size();
+	if (empty_) {
+		empty_ = false;
+		highest_ = seq;
+	} else if (seq > highest_) {
+		// clear the words the window slides over, at most all of them
+		const uint64_t first = (highest_ >> 6) + 1;
+		const uint64_t last = seq >> 6;
+		if (last >= first) {
+			const uint64_t count = last - first + 1;
+			for (uint64_t i = 0; i < count && i < words; i++) {
+				bitmap_[(first + i) % words] = 0;
+			}
+		}
+		highest_ = seq;
+	} else if (highest_ - seq >= size_) {
+		return;
+	}
+	bitmap_[(seq >> 6) % words] |= (uint64_t)1 << (seq & 63);
+}
@@ -0,0 +1,41 @@
+#ifndef AEAD_REPLAY_H_
+#define AEAD_REPLAY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace aead {
+
+    // Anti-replay window over 64 bit sequence numbers, in the style of
+    // RFC 6479: a ring of 64 bit words which slides by clearing whole words
+    // instead of shifting the bitmap. One extra word is kept so the window
+    // always covers at least `size` sequence numbers below the highest one.
+    //
+    // Not thread-safe; a window belongs to a single session.
+    class ReplayWindow {
+    public:
+        static const size_t MIN_SIZE = 64;
+        static const size_t MAX_SIZE = 4096;
+
+        // size is rounded up to a multiple of 64 and must be within the limits
+        explicit ReplayWindow(size_t size);
+
+        size_t size() const { return size_; }
+        // Whether a sequence number is new and within the window
+        bool Check(uint64_t seq) const;
+        // Marks a sequence number as seen; only call it for authenticated frames
+        void Update(uint64_t seq);
+        // The highest sequence number seen; 0 if none was
+        uint64_t Highest() const { return highest_; }
+
+    private:
+        const size_t size_;
+        std::vector<uint64_t> bitmap_;
+        uint64_t highest_;
+        bool empty_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include <string.h>
+
+#include "aead-reuse.h"
+#include "aead-random.h"
+
+using namespace aead;
+
+// At least 20 filter bits per nonce, 6 of which are set. This keeps false
+// positives around 0.1% with both generations full
+static const size_t BITS_PER_NONCE = 20;
+static const int BITS_SET = 6;
+static const uint64_t SAMPLE_RATE = 16;
+
+NonceReuseDetector::NonceReuseDetector(size_t capacity, bool reject)
+	: capacity_(capacity > 0 ? capacity : 1), reject_(reject),
+	rotate_after_(capacity_ / SAMPLE_RATE > 0 ? capacity_ / SAMPLE_RATE : 1),
+	current_(0), recorded_(0), hits_(0)
+{
+	// round the number of words up to a power of two, so they can be masked
+	size_t words = 1;
+	while (words * 64 < capacity_ * BITS_PER_NONCE) words <<= 1;
+	words_mask_ = words - 1;
+	for (int g = 0; g < 2; g++) {
+		generations_[g] = new std::atomic<uint64_t>[words];
+		for (size_t i = 0; i < words; i++) generations_[g][i].store(0, std::memory_order_relaxed);
+	}
+	// a random seed keeps the filter positions unpredictable
+	if (!RandomBytes((unsigned char *)seed_, sizeof(seed_))) {
+		seed_[0] = (uint64_t)(uintptr_t)this;
+		seed_[1] = 0x9e3779b97f4a7c15ULL;
+	}
+}
+
+NonceReuseDetector::~NonceReuseDetector() {
+	delete[] generations_[0];
+	delete[] generations_[1];
+}
+
+static inline uint64_t Load64(const unsigned char *p, size_t len) {
+	uint64_t v = 0;
+	memcpy(&v, p, len < 8 ? len : 8);
+	return v;
+}
+
+static inline uint64_t Mix(uint64_t h, uint64_t v) {
+	return (h ^ v) * 0x9e3779b97f4a7c15ULL;
+}
+
+// A multiplicative hash under a random seed; the inputs aren't chosen by an
+// attacker who could see the filter, so this needn't be a keyed PRF
+uint64_t NonceReuseDetector::Hash(const unsigned char *nonce, size_t nonce_len,
+	const unsigned char *key, size_t key_len
+) const {
+	uint64_t h = seed_[0] ^ ((uint64_t)nonce_len << 56) ^ ((uint64_t)key_len << 48);
+	for (size_t i = 0; i < key_len; i += 8) h = Mix(h, Load64(key + i, key_len - i));
+	for (size_t i = 0; i < nonce_len; i += 8) h = Mix(h ^ (h >> 29), Load64(nonce + i, nonce_len - i));
+	h = (h ^ (h >> 32) ^ seed_[1]) * 0xc4ceb9fe1a85ec53ULL;
+	return h ^ (h >> 29);
+}
+
+bool NonceReuseDetector::Record(const unsigned char *nonce, size_t nonce_len,
+	const unsigned char *key, size_t key_len
+) {
+	const uint64_t h = Hash(nonce, nonce_len, key, key_len);
+
+	// The low bits pick the word. Large filters use more than 32 of them,
+	// so the bits within it come from 6 bit slices of a remix of the hash,
+	// whose top 36 bits don't follow from the word.
+	const uint64_t bits = (h ^ (h >> 32)) * 0xd6e8feb86659fd93ULL;
+	uint64_t mask = 0;
+	for (int i = 0; i < BITS_SET; i++) {
+		mask |= (uint64_t)1 << ((bits >> (28 + 6 * i)) & 63);
+	}
+	const size_t word = (size_t)h & words_mask_;
+
+	const unsigned current = current_.load(std::memory_order_relaxed);
+	std::atomic<uint64_t> &slot = generations_[current][word];
+	const bool in_previous = (generations_[current ^ 1][word].load(std::memory_order_relaxed) & mask) == mask;
+	uint64_t old = slot.load(std::memory_order_relaxed);
+	// only write if bits are missing, so repeated nonces don't contend
+	if ((old & mask) != mask) old = slot.fetch_or(mask, std::memory_order_relaxed);
+	const bool seen = in_previous || (old & mask) == mask;
+
+	// Counting every nonce would put a second contended atomic on the hot
+	// path, so only a (hash-selected) sixteenth of them is counted
+	if ((h & (SAMPLE_RATE - 1) << 16) == 0 &&
+		recorded_.fetch_add(1, std::memory_order_relaxed) + 1 == rotate_after_
+	) {
+		Rotate();
+	}
+	if (seen) hits_.fetch_add(1, std::memory_order_relaxed);
+	return seen;
+}
+
+// Called by exactly one thread per generation: the one which filled it
+void NonceReuseDetector::Rotate() {
+	const unsigned current = current_.load(std::memory_order_relaxed);
+	std::atomic<uint64_t> *previous = generations_[current ^ 1];
+	for (size_t i = 0; i <= words_mask_; i++) previous[i].store(0, std::memory_order_relaxed);
+	current_.store(current ^ 1, std::memory_order_relaxed);
+	recorded_.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,53 @@
+#ifndef AEAD_REUSE_H_
+#define AEAD_REUSE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+namespace aead {
+
+    // Probabilistic detector for reused nonces.
+    //
+    // Nonces are recorded in a blocked Bloom filter: all bits of a nonce lie
+    // in a single 64 bit word, so recording one costs a load and at most one
+    // atomic fetch_or on a single cache line. The filter has two generations
+    // of `capacity` nonces each. Once the current one is full, the older one
+    // is cleared and takes its place, so the detector remembers (roughly) at
+    // least the last `capacity` nonces in bounded memory.
+    //
+    // Hits may be false positives (around 0.1%); nonces are never missed
+    // within the window, except while a generation is being cleared.
+    class NonceReuseDetector {
+    public:
+        NonceReuseDetector(size_t capacity, bool reject);
+        ~NonceReuseDetector();
+
+        // Records a nonce, optionally scoped to a key, and returns true
+        // if it was (probably) used before.
+        bool Record(const unsigned char *nonce, size_t nonce_len,
+            const unsigned char *key = NULL, size_t key_len = 0);
+
+        bool reject() const { return reject_; }
+        uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+        size_t capacity() const { return capacity_; }
+
+    private:
+        uint64_t Hash(const unsigned char *nonce, size_t nonce_len,
+            const unsigned char *key, size_t key_len) const;
+        void Rotate();
+
+        const size_t capacity_;
+        const bool reject_;
+        const size_t rotate_after_;
+        size_t words_mask_;
+        std::atomic<uint64_t> *generations_[2];
+        std::atomic<unsigned> current_;
+        std::atomic<size_t> recorded_;
+        std::atomic<uint64_t> hits_;
+        uint64_t seed_[2];
+    };
+
+}
+
+#endif
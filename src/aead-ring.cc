@@ -0,0 +1,198 @@
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <string.h>
+#include <chrono>
+#include <openssl/crypto.h>
+
+#include "aead-ring.h"
+#include "aead-ccm-format.h"
+#include "aead-scheduler.h"
+
+using namespace aead;
+
+static const size_t CACHE_LINE = 64;
+
+CryptoRing::CryptoRing(const std::shared_ptr<Keyring> &keyring, uint32_t entries, size_t data_size)
+	: keyring_(keyring), entries_(entries), data_size_(data_size), listener_(NULL), stopping_(false)
+{
+	size_ = data_offset() + data_size_;
+	// zeroed, so all indices start at 0; aligned, so the header fields
+	// sit on their own cache lines
+	allocation_ = new unsigned char[size_ + CACHE_LINE]();
+	memory_ = allocation_ + (CACHE_LINE - (uintptr_t)allocation_ % CACHE_LINE) % CACHE_LINE;
+}
+
+CryptoRing::~CryptoRing() {
+	Stop();
+	delete[] allocation_;
+}
+
+std::atomic<uint32_t> &CryptoRing::Header(HeaderField field) const {
+	return ((std::atomic<uint32_t> *)memory_)[field];
+}
+
+void CryptoRing::Start(int cpu, uint64_t idle_ns) {
+	poller_ = std::thread(&CryptoRing::PollerMain, this, cpu, idle_ns);
+}
+
+void CryptoRing::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_.store(true);
+	}
+	wakeup_.notify_one();
+	if (poller_.joinable()) poller_.join();
+}
+
+void CryptoRing::Wakeup() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	wakeup_.notify_one();
+}
+
+void CryptoRing::SetListener(Listener *listener) {
+	std::lock_guard<std::mutex> lock(listener_mutex_);
+	listener_ = listener;
+}
+
+void CryptoRing::PollerMain(int cpu, uint64_t idle_ns) {
+#ifdef __linux__
+	if (cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+#endif
+	EVP_CIPHER_CTX *scratch = EVP_CIPHER_CTX_new();
+	const uint32_t mask = entries_ - 1;
+	const uint32_t *sq = (const uint32_t *)(memory_ + sq_offset());
+	uint32_t *cq = (uint32_t *)(memory_ + cq_offset());
+	uint32_t head = Header(SQ_HEAD).load(std::memory_order_relaxed);
+	uint32_t cq_tail = Header(CQ_TAIL).load(std::memory_order_relaxed);
+
+	for (;;) {
+		const uint32_t tail = WaitForSubmissions(head, idle_ns);
+		if (tail == head) break;
+
+		for (; head != tail; head++) {
+			// copy the entry, so a misbehaving producer can't change it halfway
+			uint32_t sqe[SQE_WORDS];
+			memcpy(sqe, sq + (head & mask) * SQE_WORDS, sizeof(sqe));
+			const int32_t status = Process(sqe, scratch);
+
+			if (!WaitForCompletionSpace(cq_tail)) break;
+			uint32_t *cqe = cq + (cq_tail & mask) * CQE_WORDS;
+			cqe[CQE_USER_DATA] = sqe[SQE_USER_DATA];
+			cqe[CQE_STATUS] = (uint32_t)status;
+			cq_tail++;
+			Header(CQ_TAIL).store(cq_tail, std::memory_order_release);
+			Header(SQ_HEAD).store(head + 1, std::memory_order_release);
+		}
+		if (stopping_.load(std::memory_order_relaxed)) break;
+	}
+	EVP_CIPHER_CTX_free(scratch);
+}
+
+uint32_t CryptoRing::WaitForSubmissions(uint32_t head, uint64_t idle_ns) {
+	std::atomic<uint32_t> &sq_tail = Header(SQ_TAIL);
+	const uint64_t idle_until = Scheduler::Now() + idle_ns;
+	for (unsigned spins = 0; ; spins++) {
+		const uint32_t tail = sq_tail.load(std::memory_order_acquire);
+		if (tail != head || stopping_.load(std::memory_order_relaxed)) return tail;
+		// the clock is only read every now and then while spinning
+		if (spins % 64 == 63 && Scheduler::Now() >= idle_until) break;
+	}
+
+	// The producer stores its tail before it reads the flag, and we set the
+	// flag before reading the tail, so at least one of us sees the other
+	std::unique_lock<std::mutex> lock(mutex_);
+	Header(FLAGS).fetch_or(FLAG_NEED_WAKEUP);
+	uint32_t tail;
+	while ((tail = sq_tail.load()) == head && !stopping_.load()) {
+		wakeup_.wait(lock);
+	}
+	Header(FLAGS).fetch_and(~FLAG_NEED_WAKEUP);
+	return tail;
+}
+
+bool CryptoRing::WaitForCompletionSpace(uint32_t tail) {
+	std::atomic<uint32_t> &cq_head = Header(CQ_HEAD);
+	while (tail - cq_head.load(std::memory_order_acquire) >= entries_) {
+		// The consumer is behind. Nothing wakes us when it catches up, so
+		// back off instead of sleeping.
+		if (stopping_.load(std::memory_order_relaxed)) return false;
+		std::this_thread::sleep_for(std::chrono::microseconds(10));
+	}
+	return true;
+}
+
+unsigned char *CryptoRing::Data(uint32_t offset, uint32_t length) const {
+	if ((uint64_t)offset + length > data_size_) return NULL;
+	return memory_ + data_offset() + offset;
+}
+
+static bool Overlaps(const unsigned char *a, size_t a_len, const unsigned char *b, size_t b_len) {
+	return a < b + b_len && b < a + a_len;
+}
+
+int32_t CryptoRing::Process(const uint32_t *sqe, EVP_CIPHER_CTX *scratch) {
+	const uint32_t op = sqe[SQE_OP];
+	const uint32_t iv_len = sqe[SQE_IV_LENGTH];
+	const uint32_t input_len = sqe[SQE_INPUT_LENGTH];
+	const uint32_t aad_len = sqe[SQE_AAD_LENGTH];
+	const uint32_t tag_len = sqe[SQE_TAG_LENGTH];
+	const unsigned char *iv = Data(sqe[SQE_IV_OFFSET], iv_len);
+	const unsigned char *input = Data(sqe[SQE_INPUT_OFFSET], input_len);
+	const unsigned char *aad = Data(sqe[SQE_AAD_OFFSET], aad_len);
+	unsigned char *output = Data(sqe[SQE_OUTPUT_OFFSET], input_len);
+	unsigned char *tag = Data(sqe[SQE_TAG_OFFSET], tag_len);
+	if ((op != OP_ENCRYPT && op != OP_DECRYPT) ||
+		iv == NULL || input == NULL || aad == NULL || output == NULL || tag == NULL ||
+		// in place is fine, a partial overlap is not
+		(input != output && Overlaps(input, input_len, output, input_len)) ||
+		Overlaps(output, input_len, tag, tag_len)
+	) {
+		return STATUS_INVALID;
+	}
+
+	std::shared_ptr<KeyContext> key = keyring_->Get(sqe[SQE_KEY_ID]);
+	if (!key) return STATUS_NO_KEY;
+	if (!KeyContext::ValidParams(key->mode(), iv_len, tag_len)) return STATUS_BAD_PARAMS;
+
+	if (op == OP_ENCRYPT) {
+		// only encryptions that can succeed record their nonce
+		if (key->mode() == MODE_CCM && !CcmFormat::LengthFits(iv_len, input_len)) return STATUS_BAD_PARAMS;
+		NonceReuseDetector *detector = key->reuse_detector();
+		if (detector != NULL && detector->Record(iv, iv_len) && detector->reject()) {
+			return STATUS_NONCE_REUSED;
+		}
+		const UsageResult usage = key->Use((size_t)input_len + aad_len);
+		if (usage == USAGE_HARD_LIMIT) return STATUS_LIMIT_REACHED;
+		if (!key->Encrypt(scratch, iv, iv_len, aad, aad_len, input, input_len, output, tag, tag_len)) {
+			return STATUS_BAD_PARAMS;
+		}
+		// the keyring's "rotate" event is emitted on its JS thread
+		if (usage == USAGE_SOFT_LIMIT) {
+			std::lock_guard<std::mutex> lock(listener_mutex_);
+			if (listener_ != NULL) listener_->SoftLimitReached(sqe[SQE_KEY_ID]);
+		}
+		return STATUS_OK;
+	}
+
+	bool auth_ok;
+	if (!key->Decrypt(scratch, iv, iv_len, aad, aad_len, input, input_len, output, tag, tag_len, &auth_ok)) {
+		return STATUS_BAD_PARAMS;
+	}
+	if (!auth_ok) {
+		// never leave unauthenticated plaintext behind
+		OPENSSL_cleanse(output, input_len);
+		return STATUS_AUTH_FAILED;
+	}
+	return STATUS_OK;
+}
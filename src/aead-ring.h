@@ -0,0 +1,147 @@
+#ifndef AEAD_RING_H_
+#define AEAD_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <openssl/evp.h>
+
+#include "aead-keyring.h"
+
+namespace aead {
+
+    // Submission and completion rings in one block of memory shared with JS,
+    // in the style of io_uring. JS is the only producer of the submission
+    // ring and the only consumer of the completion ring; a dedicated poller
+    // thread is the other side of both. Requests refer to offsets in the
+    // data region of the same memory, so nothing is allocated or copied per
+    // message and no native function is called while the poller is busy.
+    //
+    // Layout: header | submission entries | completion entries | data
+    // All fields are 32 bit words in native byte order.
+    class CryptoRing {
+    public:
+        // Word indices of the header fields, one cache line apart so the
+        // two sides don't write to the same line
+        enum HeaderField {
+            SQ_HEAD = 0,   // written by the poller
+            SQ_TAIL = 16,  // written by JS
+            CQ_HEAD = 32,  // written by JS
+            CQ_TAIL = 48,  // written by the poller
+            FLAGS = 64     // written by the poller
+        };
+        static const size_t HEADER_SIZE = 80 * 4;
+        // Set while the poller sleeps; JS must then call Wakeup after submitting
+        static const uint32_t FLAG_NEED_WAKEUP = 1;
+
+        // A submission entry, 64 bytes. Offsets are relative to the data region.
+        enum SubmissionField {
+            SQE_OP,
+            SQE_KEY_ID,
+            SQE_USER_DATA,
+            SQE_IV_OFFSET,
+            SQE_IV_LENGTH,
+            SQE_INPUT_OFFSET,
+            SQE_INPUT_LENGTH,
+            SQE_AAD_OFFSET,
+            SQE_AAD_LENGTH,
+            SQE_OUTPUT_OFFSET,
+            SQE_TAG_OFFSET,
+            SQE_TAG_LENGTH
+        };
+        static const size_t SQE_WORDS = 16;
+        // A completion entry, 8 bytes: the submission's user data and a status
+        enum CompletionField {
+            CQE_USER_DATA,
+            CQE_STATUS
+        };
+        static const size_t CQE_WORDS = 2;
+
+        enum Op {
+            OP_ENCRYPT = 0,
+            OP_DECRYPT = 1
+        };
+        enum Status {
+            STATUS_OK = 0,
+            STATUS_AUTH_FAILED = 1,
+            // offsets or lengths outside of the data region, or an unknown op
+            STATUS_INVALID = -1,
+            STATUS_NO_KEY = -2,
+            // IV or tag length not valid for the key
+            STATUS_BAD_PARAMS = -3,
+            STATUS_LIMIT_REACHED = -4,
+            STATUS_NONCE_REUSED = -5
+        };
+
+        // Told on the poller thread about encryptions that made their key
+        // cross a soft usage limit, which the completion status doesn't show
+        class Listener {
+        public:
+            virtual ~Listener() {}
+            virtual void SoftLimitReached(uint32_t key_id) = 0;
+        };
+
+        static const uint32_t MIN_ENTRIES = 2;
+        static const uint32_t MAX_ENTRIES = 1 << 16;
+        static const uint32_t MAX_DATA_SIZE = 1 << 30;
+        static const uint64_t DEFAULT_IDLE_NS = 50000;
+
+        // entries must be a power of two, both rings have that many
+        CryptoRing(const std::shared_ptr<Keyring> &keyring, uint32_t entries, size_t data_size);
+        ~CryptoRing();
+
+        unsigned char *memory() const { return memory_; }
+        size_t size() const { return size_; }
+        uint32_t entries() const { return entries_; }
+        size_t sq_offset() const { return HEADER_SIZE; }
+        size_t cq_offset() const { return HEADER_SIZE + entries_ * SQE_WORDS * 4; }
+        size_t data_offset() const { return cq_offset() + entries_ * CQE_WORDS * 4; }
+        size_t data_size() const { return data_size_; }
+
+        // Starts the poller, pinned to the given CPU unless it is negative.
+        // It keeps spinning for idle_ns after the last submission before it
+        // goes to sleep.
+        void Start(int cpu, uint64_t idle_ns);
+        // Stops the poller after the submissions it has already taken
+        void Stop();
+        // Wakes the poller if it sleeps
+        void Wakeup();
+        // Sets the listener, or removes it with NULL. Once this returns, the
+        // previous one isn't called anymore.
+        void SetListener(Listener *listener);
+
+    private:
+        std::atomic<uint32_t> &Header(HeaderField field) const;
+        void PollerMain(int cpu, uint64_t idle_ns);
+        // Waits until the submission ring is non-empty or the poller stops;
+        // returns the new tail
+        uint32_t WaitForSubmissions(uint32_t head, uint64_t idle_ns);
+        // Waits until the completion ring has room; false if the poller stops
+        bool WaitForCompletionSpace(uint32_t tail);
+        int32_t Process(const uint32_t *sqe, EVP_CIPHER_CTX *scratch);
+        // Returns NULL if the range is not within the data region
+        unsigned char *Data(uint32_t offset, uint32_t length) const;
+
+        std::shared_ptr<Keyring> keyring_;
+        const uint32_t entries_;
+        const size_t data_size_;
+        size_t size_;
+        unsigned char *allocation_;
+        unsigned char *memory_;
+
+        std::mutex listener_mutex_;
+        Listener *listener_;
+
+        std::thread poller_;
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::atomic<bool> stopping_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <chrono>
+
+#include "aead-scheduler.h"
+
+using namespace aead;
+
+// Fixed cost charged per slice on top of its bytes, so tenants sending
+// many tiny messages are charged for the per-job overhead too
+static const size_t SLICE_COST = 512;
+
+// Fetches a pool worker for the scheduler. It carries no state, so one
+// instance can sit in the pool queue any number of times.
+class Scheduler::DispatchJob : public Job {
+public:
+	void Run(WorkerContext &worker) { Scheduler::Get().Dispatch(worker); }
+	void Done() {}
+};
+
+Scheduler &Scheduler::Get() {
+	// Never destroyed, like the pool it feeds
+	static Scheduler *scheduler = new Scheduler();
+	return *scheduler;
+}
+
+uint64_t Scheduler::Now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count();
+}
+
+Scheduler::Scheduler()
+	: sweep_at_(MAX_TENANTS), queued_(0), sequence_(0), chunk_size_(DEFAULT_CHUNK_SIZE), dispatchers_(0)
+{}
+
+void Scheduler::Configure(size_t chunk_size) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	chunk_size_ = std::max(chunk_size, (size_t)MIN_CHUNK_SIZE);
+}
+
+size_t Scheduler::chunk_size() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return chunk_size_;
+}
+
+bool Scheduler::Submit(Job *job, const ScheduleOptions &options) {
+	static DispatchJob dispatch;
+	ThreadPool &pool = ThreadPool::Get();
+	Entry entry;
+	entry.job = job;
+	entry.deadline = options.deadline;
+	entry.submitted = Now();
+	entry.started = false;
+
+	bool fetch_worker = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (queued_ >= MAX_QUEUED) return false;
+
+		entry.tenant = FindTenant(options.tenant);
+		Enqueue(entry);
+
+		if (dispatchers_ < pool.threads()) {
+			dispatchers_++;
+			fetch_worker = true;
+		}
+	}
+	// If the pool queue is full, the workers already dispatching pick the job up
+	if (fetch_worker && !pool.Submit(&dispatch)) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		dispatchers_--;
+	}
+	return true;
+}
+
+// Looks a tenant up, creating it if needed, and makes room for it by
+// dropping the idle tenants once the table is full. Called with the mutex
+// held.
+Scheduler::Tenant *Scheduler::FindTenant(const std::string &name) {
+	std::unordered_map<std::string, Tenant *>::iterator it = tenants_.find(name);
+	if (it != tenants_.end()) return it->second;
+
+	if (tenants_.size() >= sweep_at_) {
+		for (it = tenants_.begin(); it != tenants_.end();) {
+			if (!it->second->active && it->second->running == 0) {
+				delete it->second;
+				it = tenants_.erase(it);
+			} else {
+				++it;
+			}
+		}
+		sweep_at_ = std::max((size_t)MAX_TENANTS, 2 * tenants_.size());
+	}
+	Tenant *tenant = new Tenant();
+	tenants_[name] = tenant;
+	return tenant;
+}
+
+bool Scheduler::RunsLater(const Entry &a, const Entry &b) {
+	if (a.deadline != b.deadline) return a.deadline > b.deadline;
+	return a.sequence > b.sequence;
+}
+
+// Called with the mutex held
+void Scheduler::Enqueue(const Entry &entry) {
+	Tenant *tenant = entry.tenant;
+	tenant->queue.push_back(entry);
+	tenant->queue.back().sequence = sequence_++;
+	std::push_heap(tenant->queue.begin(), tenant->queue.end(), RunsLater);
+	tenant->stats.queued++;
+	queued_++;
+	if (!tenant->active) {
+		tenant->active = true;
+		tenant->deficit = 0;
+		active_.push_back(tenant);
+	}
+}
+
+// Picks the next slice to run by deficit round robin over the active
+// tenants. Expired jobs found on the way are removed and collected.
+// Called with the mutex held.
+bool Scheduler::Next(uint64_t now, Entry *entry, std::vector<Job *> *expired) {
+	while (!active_.empty()) {
+		Tenant *tenant = active_.front();
+		std::vector<Entry> &queue = tenant->queue;
+
+		// the heap's top has the earliest deadline, so once it's still
+		// valid, all others are too
+		while (!queue.empty() && queue.front().deadline <= now) {
+			expired->push_back(queue.front().job);
+			std::pop_heap(queue.begin(), queue.end(), RunsLater);
+			queue.pop_back();
+			tenant->stats.dropped++;
+			tenant->stats.queued--;
+			queued_--;
+		}
+		if (queue.empty()) {
+			tenant->active = false;
+			active_.pop_front();
+			continue;
+		}
+
+		const size_t cost = std::min(queue.front().job->Cost(), chunk_size_) + SLICE_COST;
+		if (tenant->deficit < cost) {
+			// the tenant's turn is over: top up its deficit for the next round
+			tenant->deficit += chunk_size_;
+			active_.pop_front();
+			active_.push_back(tenant);
+			continue;
+		}
+		tenant->deficit -= cost;
+
+		*entry = queue.front();
+		std::pop_heap(queue.begin(), queue.end(), RunsLater);
+		queue.pop_back();
+		tenant->stats.queued--;
+		tenant->running++;
+		queued_--;
+		if (!entry->started) {
+			const uint64_t wait = now - std::min(now, entry->submitted);
+			tenant->stats.jobs++;
+			tenant->stats.wait_total += wait;
+			tenant->stats.wait_max = std::max(tenant->stats.wait_max, wait);
+			entry->started = true;
+		}
+		return true;
+	}
+	return false;
+}
+
+// Runs on a pool worker until no jobs are left
+void Scheduler::Dispatch(WorkerContext &worker) {
+	std::vector<Job *> expired;
+	// the tenant of the slice that ran last, not counted as running anymore
+	// once the mutex is taken again
+	Tenant *finished = NULL;
+	for (;;) {
+		Entry entry;
+		size_t budget;
+		bool found;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (finished != NULL) finished->running--;
+			found = Next(Now(), &entry, &expired);
+			budget = chunk_size_;
+			if (!found) dispatchers_--;
+		}
+
+		for (size_t i = 0; i < expired.size(); i++) {
+			expired[i]->Expire();
+			expired[i]->Done();
+		}
+		expired.clear();
+		if (!found) return;
+
+		if (entry.job->RunSlice(worker, budget)) {
+			entry.job->Done();
+			finished = entry.tenant;
+		} else {
+			// let other jobs run before the next slice
+			std::lock_guard<std::mutex> lock(mutex_);
+			entry.tenant->running--;
+			Enqueue(entry);
+			finished = NULL;
+		}
+	}
+}
+
+std::map<std::string, TenantStats> Scheduler::Stats(bool reset) {
+	std::map<std::string, TenantStats> result;
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (std::unordered_map<std::string, Tenant *>::iterator it = tenants_.begin(); it != tenants_.end(); ++it) {
+		TenantStats &stats = it->second->stats;
+		result[it->first] = stats;
+		if (reset) {
+			const size_t queued = stats.queued;
+			stats = TenantStats();
+			stats.queued = queued;
+		}
+	}
+	return result;
+}
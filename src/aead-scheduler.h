@@ -0,0 +1,128 @@
+#ifndef AEAD_SCHEDULER_H_
+#define AEAD_SCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "aead-pool.h"
+
+namespace aead {
+
+    static const uint64_t NO_DEADLINE = UINT64_MAX;
+
+    struct ScheduleOptions {
+        std::string tenant;
+        // Steady clock time in ns after which the job is dropped instead of
+        // run; NO_DEADLINE if it should always run
+        uint64_t deadline;
+
+        ScheduleOptions() : deadline(NO_DEADLINE) {}
+    };
+
+    struct TenantStats {
+        // jobs started and jobs dropped because their deadline passed
+        uint64_t jobs;
+        uint64_t dropped;
+        // time from submission until a job started, in ns
+        uint64_t wait_total;
+        uint64_t wait_max;
+        // jobs (or remaining slices of started jobs) waiting right now
+        size_t queued;
+
+        TenantStats() : jobs(0), dropped(0), wait_total(0), wait_max(0), queued(0) {}
+    };
+
+    // Orders the async jobs before they reach the thread pool:
+    // - tenants share the pool by deficit round robin, weighted by bytes, so
+    //   a tenant queueing huge messages cannot starve one with small ones
+    // - within a tenant, the job with the earliest deadline runs first
+    // - jobs whose deadline has passed are dropped without running
+    // - long jobs run in slices of chunk_size bytes and go back to the queue
+    //   in between, so they can be preempted
+    // Workers are fetched through the pool queue, at most one per pool thread;
+    // each keeps running queued jobs until there are none left.
+    class Scheduler {
+    public:
+        static const size_t DEFAULT_CHUNK_SIZE = 256 << 10;
+        static const size_t MIN_CHUNK_SIZE = 4 << 10;
+        // jobs queued in total before Submit fails
+        static const size_t MAX_QUEUED = ThreadPool::QUEUE_CAPACITY;
+        // Tenants are arbitrary strings, so once this many have been seen,
+        // the idle ones (nothing queued or running) are forgotten along
+        // with their statistics. Tenants with queued jobs are kept, so the
+        // table may grow beyond this while the queue is long.
+        static const size_t MAX_TENANTS = 1024;
+
+        // The process-wide scheduler feeding ThreadPool::Get()
+        static Scheduler &Get();
+        // Steady clock in ns, the time base of deadlines
+        static uint64_t Now();
+
+        // Queues a job. Returns false if too many jobs are queued.
+        bool Submit(Job *job, const ScheduleOptions &options);
+
+        // Sets the slice size; the round robin quantum is the same number of bytes
+        void Configure(size_t chunk_size);
+        size_t chunk_size() const;
+
+        // Copies the statistics of every tenant seen so far (see
+        // MAX_TENANTS), optionally resetting them
+        std::map<std::string, TenantStats> Stats(bool reset);
+
+    private:
+        struct Tenant;
+        struct Entry {
+            Job *job;
+            Tenant *tenant;
+            uint64_t deadline;
+            // submission order, for FIFO order among equal deadlines
+            uint64_t sequence;
+            uint64_t submitted;
+            bool started;
+        };
+        struct Tenant {
+            // a min-heap by deadline and sequence
+            std::vector<Entry> queue;
+            size_t deficit;
+            bool active;
+            // slices taken off the queue that haven't finished yet
+            size_t running;
+            TenantStats stats;
+
+            Tenant() : deficit(0), active(false), running(0) {}
+        };
+        class DispatchJob;
+
+        // Orders the per-tenant heaps: earliest deadline first, then FIFO
+        static bool RunsLater(const Entry &a, const Entry &b);
+
+        Scheduler();
+        void Enqueue(const Entry &entry);
+        Tenant *FindTenant(const std::string &name);
+        bool Next(uint64_t now, Entry *entry, std::vector<Job *> *expired);
+        void Dispatch(WorkerContext &worker);
+
+        mutable std::mutex mutex_;
+        // Tenants are only removed while idle, so entries can point to them
+        std::unordered_map<std::string, Tenant *> tenants_;
+        // the table size at which idle tenants are dropped next; doubles
+        // while busy tenants fill it, so sweeps stay rare
+        size_t sweep_at_;
+        // tenants with queued jobs, in round robin order
+        std::deque<Tenant *> active_;
+        size_t queued_;
+        uint64_t sequence_;
+        size_t chunk_size_;
+        // workers fetched from the pool that have not run out of jobs yet
+        unsigned dispatchers_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,472 @@
+#include <string.h>
+#include <openssl/crypto.h>
+
+#include "aead-soft-aes.h"
+
+using namespace aead;
+
+// ==================
+
+// The bitsliced representation: q[i] holds bit i of every byte of four
+// blocks. See BearSSL's aes_ct64.c for the derivation.
+
+// The AES S-box on all bytes at once, as a circuit of 113 gates
+// (Boyar and Peralta, "A depth-16 circuit for the AES S-box")
+static void SubBytes(uint64_t *q) {
+	uint64_t x0, x1, x2, x3, x4, x5, x6, x7;
+	uint64_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+	uint64_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+	uint64_t y20, y21;
+	uint64_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+	uint64_t z10, z11, z12, z13, z14, z15, z16, z17;
+	uint64_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+	uint64_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+	uint64_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+	uint64_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+	uint64_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+	uint64_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+	uint64_t t60, t61, t62, t63, t64, t65, t66, t67;
+	uint64_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+	x0 = q[7];
+	x1 = q[6];
+	x2 = q[5];
+	x3 = q[4];
+	x4 = q[3];
+	x5 = q[2];
+	x6 = q[1];
+	x7 = q[0];
+
+	// top linear transformation
+	y14 = x3 ^ x5;
+	y13 = x0 ^ x6;
+	y9 = x0 ^ x3;
+	y8 = x0 ^ x5;
+	t0 = x1 ^ x2;
+	y1 = t0 ^ x7;
+	y4 = y1 ^ x3;
+	y12 = y13 ^ y14;
+	y2 = y1 ^ x0;
+	y5 = y1 ^ x6;
+	y3 = y5 ^ y8;
+	t1 = x4 ^ y12;
+	y15 = t1 ^ x5;
+	y20 = t1 ^ x1;
+	y6 = y15 ^ x7;
+	y10 = y15 ^ t0;
+	y11 = y20 ^ y9;
+	y7 = x7 ^ y11;
+	y17 = y10 ^ y11;
+	y19 = y10 ^ y8;
+	y16 = t0 ^ y11;
+	y21 = y13 ^ y16;
+	y18 = x0 ^ y16;
+
+	// non-linear section
+	t2 = y12 & y15;
+	t3 = y3 & y6;
+	t4 = t3 ^ t2;
+	t5 = y4 & x7;
+	t6 = t5 ^ t2;
+	t7 = y13 & y16;
+	t8 = y5 & y1;
+	t9 = t8 ^ t7;
+	t10 = y2 & y7;
+	t11 = t10 ^ t7;
+	t12 = y9 & y11;
+	t13 = y14 & y17;
+	t14 = t13 ^ t12;
+	t15 = y8 & y10;
+	t16 = t15 ^ t12;
+	t17 = t4 ^ t14;
+	t18 = t6 ^ t16;
+	t19 = t9 ^ t14;
+	t20 = t11 ^ t16;
+	t21 = t17 ^ y20;
+	t22 = t18 ^ y19;
+	t23 = t19 ^ y21;
+	t24 = t20 ^ y18;
+
+	t25 = t21 ^ t22;
+	t26 = t21 & t23;
+	t27 = t24 ^ t26;
+	t28 = t25 & t27;
+	t29 = t28 ^ t22;
+	t30 = t23 ^ t24;
+	t31 = t22 ^ t26;
+	t32 = t31 & t30;
+	t33 = t32 ^ t24;
+	t34 = t23 ^ t33;
+	t35 = t27 ^ t33;
+	t36 = t24 & t35;
+	t37 = t36 ^ t34;
+	t38 = t27 ^ t36;
+	t39 = t29 & t38;
+	t40 = t25 ^ t39;
+
+	t41 = t40 ^ t37;
+	t42 = t29 ^ t33;
+	t43 = t29 ^ t40;
+	t44 = t33 ^ t37;
+	t45 = t42 ^ t41;
+	z0 = t44 & y15;
+	z1 = t37 & y6;
+	z2 = t33 & x7;
+	z3 = t43 & y16;
+	z4 = t40 & y1;
+	z5 = t29 & y7;
+	z6 = t42 & y11;
+	z7 = t45 & y17;
+	z8 = t41 & y10;
+	z9 = t44 & y12;
+	z10 = t37 & y3;
+	z11 = t33 & y4;
+	z12 = t43 & y13;
+	z13 = t40 & y5;
+	z14 = t29 & y2;
+	z15 = t42 & y9;
+	z16 = t45 & y14;
+	z17 = t41 & y8;
+
+	// bottom linear transformation
+	t46 = z15 ^ z16;
+	t47 = z10 ^ z11;
+	t48 = z5 ^ z13;
+	t49 = z9 ^ z10;
+	t50 = z2 ^ z12;
+	t51 = z2 ^ z5;
+	t52 = z7 ^ z8;
+	t53 = z0 ^ z3;
+	t54 = z6 ^ z7;
+	t55 = z16 ^ z17;
+	t56 = z12 ^ t48;
+	t57 = t50 ^ t53;
+	t58 = z4 ^ t46;
+	t59 = z3 ^ t54;
+	t60 = t46 ^ t57;
+	t61 = z14 ^ t57;
+	t62 = t52 ^ t58;
+	t63 = t49 ^ t58;
+	t64 = z4 ^ t59;
+	t65 = t61 ^ t62;
+	t66 = z1 ^ t63;
+	s0 = t59 ^ t63;
+	s6 = t56 ^ ~t62;
+	s7 = t48 ^ ~t60;
+	t67 = t64 ^ t65;
+	s3 = t53 ^ t66;
+	s4 = t51 ^ t66;
+	s5 = t47 ^ t65;
+	s1 = t64 ^ ~s3;
+	s2 = t55 ^ ~t67;
+
+	q[7] = s0;
+	q[6] = s1;
+	q[5] = s2;
+	q[4] = s3;
+	q[3] = s4;
+	q[2] = s5;
+	q[1] = s6;
+	q[0] = s7;
+}
+
+// Transposes between words holding whole bytes and words holding one bit
+// of each byte; its own inverse
+static void Ortho(uint64_t *q) {
+#define AEAD_SWAPN(cl, ch, s, x, y) do { \
+		const uint64_t a = (x), b = (y); \
+		(x) = (a & (uint64_t)(cl)) | ((b & (uint64_t)(cl)) << (s)); \
+		(y) = ((a & (uint64_t)(ch)) >> (s)) | (b & (uint64_t)(ch)); \
+	} while (0)
+#define AEAD_SWAP2(x, y) AEAD_SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, x, y)
+#define AEAD_SWAP4(x, y) AEAD_SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, x, y)
+#define AEAD_SWAP8(x, y) AEAD_SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, x, y)
+	AEAD_SWAP2(q[0], q[1]);
+	AEAD_SWAP2(q[2], q[3]);
+	AEAD_SWAP2(q[4], q[5]);
+	AEAD_SWAP2(q[6], q[7]);
+
+	AEAD_SWAP4(q[0], q[2]);
+	AEAD_SWAP4(q[1], q[3]);
+	AEAD_SWAP4(q[4], q[6]);
+	AEAD_SWAP4(q[5], q[7]);
+
+	AEAD_SWAP8(q[0], q[4]);
+	AEAD_SWAP8(q[1], q[5]);
+	AEAD_SWAP8(q[2], q[6]);
+	AEAD_SWAP8(q[3], q[7]);
+#undef AEAD_SWAP8
+#undef AEAD_SWAP4
+#undef AEAD_SWAP2
+#undef AEAD_SWAPN
+}
+
+// Spreads the four little endian words of a block over two words, so
+// Ortho can bitslice them together with three other blocks
+static void InterleaveIn(uint64_t *q0, uint64_t *q1, const uint32_t *w) {
+	uint64_t x0 = w[0], x1 = w[1], x2 = w[2], x3 = w[3];
+	x0 |= (x0 << 16);
+	x1 |= (x1 << 16);
+	x2 |= (x2 << 16);
+	x3 |= (x3 << 16);
+	x0 &= 0x0000FFFF0000FFFFULL;
+	x1 &= 0x0000FFFF0000FFFFULL;
+	x2 &= 0x0000FFFF0000FFFFULL;
+	x3 &= 0x0000FFFF0000FFFFULL;
+	x0 |= (x0 << 8);
+	x1 |= (x1 << 8);
+	x2 |= (x2 << 8);
+	x3 |= (x3 << 8);
+	x0 &= 0x00FF00FF00FF00FFULL;
+	x1 &= 0x00FF00FF00FF00FFULL;
+	x2 &= 0x00FF00FF00FF00FFULL;
+	x3 &= 0x00FF00FF00FF00FFULL;
+	*q0 = x0 | (x2 << 8);
+	*q1 = x1 | (x3 << 8);
+}
+
+static void InterleaveOut(uint32_t *w, uint64_t q0, uint64_t q1) {
+	uint64_t x0 = q0 & 0x00FF00FF00FF00FFULL;
+	uint64_t x1 = q1 & 0x00FF00FF00FF00FFULL;
+	uint64_t x2 = (q0 >> 8) & 0x00FF00FF00FF00FFULL;
+	uint64_t x3 = (q1 >> 8) & 0x00FF00FF00FF00FFULL;
+	x0 |= (x0 >> 8);
+	x1 |= (x1 >> 8);
+	x2 |= (x2 >> 8);
+	x3 |= (x3 >> 8);
+	x0 &= 0x0000FFFF0000FFFFULL;
+	x1 &= 0x0000FFFF0000FFFFULL;
+	x2 &= 0x0000FFFF0000FFFFULL;
+	x3 &= 0x0000FFFF0000FFFFULL;
+	w[0] = (uint32_t)x0 | (uint32_t)(x0 >> 16);
+	w[1] = (uint32_t)x1 | (uint32_t)(x1 >> 16);
+	w[2] = (uint32_t)x2 | (uint32_t)(x2 >> 16);
+	w[3] = (uint32_t)x3 | (uint32_t)(x3 >> 16);
+}
+
+static void ShiftRows(uint64_t *q) {
+	for (int i = 0; i < 8; i++) {
+		const uint64_t x = q[i];
+		q[i] = (x & 0x000000000000FFFFULL)
+			| ((x & 0x00000000FFF00000ULL) >> 4)
+			| ((x & 0x00000000000F0000ULL) << 12)
+			| ((x & 0x0000FF0000000000ULL) >> 8)
+			| ((x & 0x000000FF00000000ULL) << 8)
+			| ((x & 0xF000000000000000ULL) >> 12)
+			| ((x & 0x0FFF000000000000ULL) << 4);
+	}
+}
+
+static inline uint64_t Rotr32(uint64_t x) {
+	return (x << 32) | (x >> 32);
+}
+
+static void MixColumns(uint64_t *q) {
+	const uint64_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+	const uint64_t q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+	const uint64_t r0 = (q0 >> 16) | (q0 << 48);
+	const uint64_t r1 = (q1 >> 16) | (q1 << 48);
+	const uint64_t r2 = (q2 >> 16) | (q2 << 48);
+	const uint64_t r3 = (q3 >> 16) | (q3 << 48);
+	const uint64_t r4 = (q4 >> 16) | (q4 << 48);
+	const uint64_t r5 = (q5 >> 16) | (q5 << 48);
+	const uint64_t r6 = (q6 >> 16) | (q6 << 48);
+	const uint64_t r7 = (q7 >> 16) | (q7 << 48);
+
+	q[0] = q7 ^ r7 ^ r0 ^ Rotr32(q0 ^ r0);
+	q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ Rotr32(q1 ^ r1);
+	q[2] = q1 ^ r1 ^ r2 ^ Rotr32(q2 ^ r2);
+	q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ Rotr32(q3 ^ r3);
+	q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ Rotr32(q4 ^ r4);
+	q[5] = q4 ^ r4 ^ r5 ^ Rotr32(q5 ^ r5);
+	q[6] = q5 ^ r5 ^ r6 ^ Rotr32(q6 ^ r6);
+	q[7] = q6 ^ r6 ^ r7 ^ Rotr32(q7 ^ r7);
+}
+
+static inline void AddRoundKey(uint64_t *q, const uint64_t *sk) {
+	for (int i = 0; i < 8; i++) q[i] ^= sk[i];
+}
+
+static inline uint32_t Load32(const unsigned char *p) {
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void Store32(uint32_t v, unsigned char *p) {
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+// SubWord of the key schedule, through the bitsliced S-box
+static uint32_t SubWord(uint32_t x) {
+	uint64_t q[8];
+	memset(q, 0, sizeof(q));
+	q[0] = x;
+	Ortho(q);
+	SubBytes(q);
+	Ortho(q);
+	const uint32_t result = (uint32_t)q[0];
+	OPENSSL_cleanse(q, sizeof(q));
+	return result;
+}
+
+void SoftAes::ExpandKey(const unsigned char *key, size_t key_len, SoftAesKey *out) {
+	// the key expansion of FIPS-197 on little endian words
+	uint32_t words[60];
+	const size_t nk = key_len / 4;
+	const size_t total = 4 * (nk + 7);
+	for (size_t i = 0; i < nk; i++) words[i] = Load32(key + 4 * i);
+	uint32_t rcon = 1;
+	for (size_t i = nk; i < total; i++) {
+		uint32_t t = words[i - 1];
+		if (i % nk == 0) {
+			t = SubWord((t >> 8) | (t << 24)) ^ rcon;
+			rcon = (rcon << 1) ^ ((rcon >> 7) * 0x11b);
+		} else if (nk > 6 && i % nk == 4) {
+			t = SubWord(t);
+		}
+		words[i] = words[i - nk] ^ t;
+	}
+	out->rounds = (int)nk + 6;
+
+	// every round key, bitsliced as if it were the same for all four blocks
+	for (size_t i = 0; i < total; i += 4) {
+		uint64_t q[8];
+		InterleaveIn(&q[0], &q[4], words + i);
+		q[1] = q[2] = q[3] = q[0];
+		q[5] = q[6] = q[7] = q[4];
+		Ortho(q);
+		memcpy(out->round_keys + 2 * i, q, sizeof(q));
+		OPENSSL_cleanse(q, sizeof(q));
+	}
+	OPENSSL_cleanse(words, sizeof(words));
+}
+
+void SoftAes::EncryptBlocks(const SoftAesKey &key, unsigned char *blocks) {
+	uint32_t w[16];
+	uint64_t q[8];
+	for (int i = 0; i < 16; i++) w[i] = Load32(blocks + 4 * i);
+	for (int i = 0; i < 4; i++) InterleaveIn(&q[i], &q[i + 4], w + 4 * i);
+	Ortho(q);
+
+	AddRoundKey(q, key.round_keys);
+	for (int r = 1; r < key.rounds; r++) {
+		SubBytes(q);
+		ShiftRows(q);
+		MixColumns(q);
+		AddRoundKey(q, key.round_keys + 8 * r);
+	}
+	SubBytes(q);
+	ShiftRows(q);
+	AddRoundKey(q, key.round_keys + 8 * key.rounds);
+
+	Ortho(q);
+	for (int i = 0; i < 4; i++) InterleaveOut(w + 4 * i, q[i], q[i + 4]);
+	for (int i = 0; i < 16; i++) Store32(w[i], blocks + 4 * i);
+	OPENSSL_cleanse(q, sizeof(q));
+	OPENSSL_cleanse(w, sizeof(w));
+}
+
+// ==================
+
+static inline uint64_t Load64(const unsigned char *p) {
+	uint64_t v = 0;
+	for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+	return v;
+}
+
+static inline void Store64(uint64_t v, unsigned char *p) {
+	for (int i = 7; i >= 0; i--, v >>= 8) p[i] = (unsigned char)v;
+}
+
+// The low 64 bits of the carry-less product. Only every fourth bit of
+// each operand takes part in an integer multiplication, so the carries of
+// at most 16 terms can't reach the next bit that is kept.
+static inline uint64_t Bmul64(uint64_t x, uint64_t y) {
+	const uint64_t m0 = 0x1111111111111111ULL, m1 = 0x2222222222222222ULL;
+	const uint64_t m2 = 0x4444444444444444ULL, m3 = 0x8888888888888888ULL;
+	const uint64_t x0 = x & m0, x1 = x & m1, x2 = x & m2, x3 = x & m3;
+	const uint64_t y0 = y & m0, y1 = y & m1, y2 = y & m2, y3 = y & m3;
+	uint64_t z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+	uint64_t z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+	uint64_t z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+	uint64_t z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+	z0 &= m0;
+	z1 &= m1;
+	z2 &= m2;
+	z3 &= m3;
+	return z0 | z1 | z2 | z3;
+}
+
+static inline uint64_t Rev64(uint64_t x) {
+#define AEAD_RMS(m, s) x = ((x & (uint64_t)(m)) << (s)) | ((x >> (s)) & (uint64_t)(m))
+	AEAD_RMS(0x5555555555555555ULL, 1);
+	AEAD_RMS(0x3333333333333333ULL, 2);
+	AEAD_RMS(0x0F0F0F0F0F0F0F0FULL, 4);
+	AEAD_RMS(0x00FF00FF00FF00FFULL, 8);
+	AEAD_RMS(0x0000FFFF0000FFFFULL, 16);
+#undef AEAD_RMS
+	return (x << 32) | (x >> 32);
+}
+
+SoftGhash::SoftGhash(const unsigned char *h) : y1_(0), y0_(0) {
+	h1_ = Load64(h);
+	h0_ = Load64(h + 8);
+}
+
+void SoftGhash::Block(uint64_t hi, uint64_t lo) {
+	// GCM's bits are reflected: the product of the reversed operands is
+	// the reversed product, shifted by one. The high halves of the
+	// 64 bit products come from multiplying the bit reversed operands.
+	const uint64_t y1 = y1_ ^ hi, y0 = y0_ ^ lo;
+	const uint64_t h0 = h0_, h1 = h1_, h2 = h0 ^ h1;
+	const uint64_t h0r = Rev64(h0), h1r = Rev64(h1), h2r = h0r ^ h1r;
+	const uint64_t y2 = y0 ^ y1;
+	const uint64_t y0r = Rev64(y0), y1r = Rev64(y1), y2r = y0r ^ y1r;
+
+	// Karatsuba
+	const uint64_t z0 = Bmul64(y0, h0);
+	const uint64_t z1 = Bmul64(y1, h1);
+	uint64_t z2 = Bmul64(y2, h2);
+	uint64_t z0h = Bmul64(y0r, h0r);
+	uint64_t z1h = Bmul64(y1r, h1r);
+	uint64_t z2h = Bmul64(y2r, h2r);
+	z2 ^= z0 ^ z1;
+	z2h ^= z0h ^ z1h;
+	z0h = Rev64(z0h) >> 1;
+	z1h = Rev64(z1h) >> 1;
+	z2h = Rev64(z2h) >> 1;
+
+	uint64_t v0 = z0, v1 = z0h ^ z2, v2 = z1 ^ z2h, v3 = z1h;
+	v3 = (v3 << 1) | (v2 >> 63);
+	v2 = (v2 << 1) | (v1 >> 63);
+	v1 = (v1 << 1) | (v0 >> 63);
+	v0 = (v0 << 1);
+
+	// reduction modulo x^128 + x^7 + x^2 + x + 1
+	v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+	v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+	v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+	v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+	y0_ = v2;
+	y1_ = v3;
+}
+
+void SoftGhash::Update(const unsigned char *data, size_t len) {
+	for (; len >= 16; data += 16, len -= 16) Block(Load64(data), Load64(data + 8));
+	if (len > 0) {
+		unsigned char block[16] = { 0 };
+		memcpy(block, data, len);
+		Block(Load64(block), Load64(block + 8));
+	}
+}
+
+void SoftGhash::Lengths(uint64_t aad_len, uint64_t len) {
+	Block(aad_len * 8, len * 8);
+}
+
+void SoftGhash::Final(unsigned char *out) const {
+	Store64(y1_, out);
+	Store64(y0_, out + 8);
+}
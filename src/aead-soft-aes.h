@@ -0,0 +1,57 @@
+#ifndef AEAD_SOFT_AES_H_
+#define AEAD_SOFT_AES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace aead {
+
+    // An AES key expanded for SoftAes, in bitsliced form
+    struct SoftAesKey {
+        uint64_t round_keys[15 * 8];
+        int rounds;
+    };
+
+    // AES in portable, constant-time code, for CPUs without AES
+    // instructions, where OpenSSL's generic code uses lookup tables indexed
+    // by secret data.
+    //
+    // The cipher is bitsliced as in BearSSL's aes_ct64: four blocks are
+    // spread over eight 64 bit words, one per bit of each byte, and the
+    // S-box is the Boyar-Peralta circuit of 113 logic gates. There are no
+    // secret-dependent branches or memory accesses.
+    class SoftAes {
+    public:
+        static const size_t PARALLEL = 4;
+
+        // Expands a 16, 24 or 32 byte key
+        static void ExpandKey(const unsigned char *key, size_t key_len, SoftAesKey *out);
+        // Encrypts PARALLEL consecutive blocks in place. Encrypting fewer
+        // costs the same.
+        static void EncryptBlocks(const SoftAesKey &key, unsigned char *blocks);
+    };
+
+    // GHASH in constant time, with integer multiplications whose operands
+    // are masked so no carries can spill between the bits that matter
+    // (BearSSL's ghash_ctmul64), and Karatsuba for the 128 bit product
+    class SoftGhash {
+    public:
+        // h = E(K, 0^128)
+        explicit SoftGhash(const unsigned char *h);
+
+        // Absorbs data, padded with zeroes to whole blocks
+        void Update(const unsigned char *data, size_t len);
+        // Absorbs the length block
+        void Lengths(uint64_t aad_len, uint64_t len);
+        void Final(unsigned char *out) const;
+
+    private:
+        void Block(uint64_t hi, uint64_t lo);
+
+        uint64_t h1_, h0_;
+        uint64_t y1_, y0_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <openssl/crypto.h>
+
+#include "aead-soft.h"
+#include "aead-ccm-format.h"
+#include "aead-cpu.h"
+
+using namespace aead;
+
+static std::atomic<int> selection(SOFT_AUTO);
+
+bool SoftAead::Enabled() {
+	switch (selection.load(std::memory_order_relaxed)) {
+		case SOFT_ALWAYS:
+			return true;
+		case SOFT_NEVER:
+			return false;
+		default:
+			return CpuFeatures::Get().aes_missing;
+	}
+}
+
+void SoftAead::Select(SoftSelection value) {
+	selection.store(value, std::memory_order_relaxed);
+}
+
+void SoftAead::ExpandKey(const unsigned char *key, size_t key_len, SoftKey *out) {
+	SoftAes::ExpandKey(key, key_len, &out->aes);
+	unsigned char blocks[16 * SoftAes::PARALLEL] = { 0 };
+	SoftAes::EncryptBlocks(out->aes, blocks);
+	memcpy(out->h, blocks, 16);
+	OPENSSL_cleanse(blocks, sizeof(blocks));
+}
+
+// ==================
+
+// A few recently used keys of this thread, replaced round robin
+static const int CACHED_KEYS = 4;
+
+struct SoftKeyCache {
+	struct Entry {
+		SoftKey schedule;
+		unsigned char key[32];
+		size_t key_len;
+	};
+	Entry entries[CACHED_KEYS];
+	int next;
+
+	~SoftKeyCache() { OPENSSL_cleanse(entries, sizeof(entries)); }
+};
+
+static thread_local SoftKeyCache key_cache;
+
+const SoftKey *SoftAead::CachedKey(const unsigned char *key, size_t key_len) {
+	if (key_len != 16 && key_len != 24 && key_len != 32) return NULL;
+	for (int i = 0; i < CACHED_KEYS; i++) {
+		SoftKeyCache::Entry &entry = key_cache.entries[i];
+		if (entry.key_len == key_len && CRYPTO_memcmp(entry.key, key, key_len) == 0) return &entry.schedule;
+	}
+	SoftKeyCache::Entry &entry = key_cache.entries[key_cache.next];
+	key_cache.next = (key_cache.next + 1) % CACHED_KEYS;
+	// a shorter key wouldn't overwrite all of the evicted one
+	OPENSSL_cleanse(&entry, sizeof(entry));
+	ExpandKey(key, key_len, &entry.schedule);
+	memcpy(entry.key, key, key_len);
+	entry.key_len = key_len;
+	return &entry.schedule;
+}
+
+void SoftAead::ClearCachedKeys() {
+	OPENSSL_cleanse(key_cache.entries, sizeof(key_cache.entries));
+	key_cache.next = 0;
+}
+
+// ==================
+
+static inline void Store32BE(uint32_t v, unsigned char *p) {
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+static inline uint32_t Load32BE(const unsigned char *p) {
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+// Encrypts or decrypts a GCM message and writes the expected tag
+static void GcmCrypt(const SoftKey &key, bool encrypt,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *in, size_t len,
+	unsigned char *out, unsigned char *tag
+) {
+	// J0 = IV || 0^31 || 1 for 12 byte IVs, the hash of the IV otherwise
+	unsigned char j0[16];
+	if (iv_len == 12) {
+		memcpy(j0, iv, 12);
+		Store32BE(1, j0 + 12);
+	} else {
+		SoftGhash iv_hash(key.h);
+		iv_hash.Update(iv, iv_len);
+		iv_hash.Lengths(0, iv_len);
+		iv_hash.Final(j0);
+	}
+	SoftGhash ghash(key.h);
+	if (aad_len > 0) ghash.Update(aad, aad_len);
+
+	// E(K, J0) comes with the first three counter blocks; the hash is
+	// updated with whole blocks until the last piece
+	unsigned char blocks[16 * SoftAes::PARALLEL];
+	unsigned char mask[16];
+	uint32_t counter = Load32BE(j0 + 12);
+	size_t pos = 0;
+	bool first = true;
+	do {
+		size_t slot = 0;
+		if (first) {
+			memcpy(blocks, j0, 16);
+			slot = 1;
+		}
+		for (; slot < SoftAes::PARALLEL; slot++) {
+			memcpy(blocks + 16 * slot, j0, 12);
+			Store32BE(++counter, blocks + 16 * slot + 12);
+		}
+		SoftAes::EncryptBlocks(key.aes, blocks);
+
+		const unsigned char *keystream = blocks;
+		if (first) {
+			memcpy(mask, blocks, 16);
+			keystream += 16;
+			first = false;
+		}
+		const size_t n = std::min(len - pos, (size_t)(blocks + sizeof(blocks) - keystream));
+		if (!encrypt) ghash.Update(in + pos, n);
+		for (size_t i = 0; i < n; i++) out[pos + i] = in[pos + i] ^ keystream[i];
+		if (encrypt) ghash.Update(out + pos, n);
+		pos += n;
+	} while (pos < len);
+
+	ghash.Lengths(aad_len, len);
+	ghash.Final(tag);
+	for (int i = 0; i < 16; i++) tag[i] ^= mask[i];
+	OPENSSL_cleanse(blocks, sizeof(blocks));
+	OPENSSL_cleanse(mask, sizeof(mask));
+}
+
+void SoftAead::GcmEncrypt(const SoftKey &key,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext, unsigned char *auth_tag
+) {
+	GcmCrypt(key, true, iv, iv_len, aad, aad_len, plaintext, len, ciphertext, auth_tag);
+}
+
+bool SoftAead::GcmDecrypt(const SoftKey &key,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext, const unsigned char *auth_tag
+) {
+	unsigned char tag[16];
+	GcmCrypt(key, false, iv, iv_len, aad, aad_len, ciphertext, len, plaintext, tag);
+	const bool auth_ok = CRYPTO_memcmp(tag, auth_tag, 16) == 0;
+	OPENSSL_cleanse(tag, sizeof(tag));
+	return auth_ok;
+}
+
+// ==================
+
+// Encrypts or decrypts a CCM message and writes the full CBC-MAC tag.
+//
+// The CBC-MAC is serial, so every step encrypts one MAC block, and the
+// counter blocks ride along in the other slots: Ctr_0 in the first step,
+// then one counter block per payload block. When encrypting, a payload
+// block is encrypted in the step that MACs it, after it was read; when
+// decrypting, one step earlier, so the MAC finds the plaintext. Either way
+// the output may be the input.
+static void CcmCrypt(const SoftKey &key, bool encrypt,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *in, size_t len,
+	unsigned char *out, unsigned char *tag, size_t tag_len
+) {
+	CcmFormat format;
+	format.Init(iv, iv_len, aad_len, len, tag_len);
+	const size_t aad_blocks = format.AadBlocks();
+	const size_t data_blocks = (len + 15) / 16;
+	const size_t lead = encrypt ? 0 : 1;
+	const size_t q = 15 - iv_len;
+
+	unsigned char blocks[16 * SoftAes::PARALLEL];
+	unsigned char mac[16] = { 0 };
+	unsigned char mask[16];
+	for (size_t step = 0; step < 1 + aad_blocks + data_blocks; step++) {
+		unsigned char input[16];
+		if (step == 0) {
+			memcpy(input, format.b0, 16);
+		} else if (step <= aad_blocks) {
+			format.AadBlock(aad, step - 1, input);
+		} else {
+			const size_t pos = (step - 1 - aad_blocks) * 16;
+			const size_t n = std::min((size_t)16, len - pos);
+			memset(input, 0, sizeof(input));
+			memcpy(input, (encrypt ? in : out) + pos, n);
+		}
+		for (int i = 0; i < 16; i++) blocks[i] = mac[i] ^ input[i];
+
+		memcpy(blocks + 16, format.ctr0, 16);
+		// the counter block of this step, from 1, if any
+		const size_t counter = step + lead > aad_blocks ? step + lead - aad_blocks : 0;
+		const bool has_counter = counter >= 1 && counter <= data_blocks;
+		memcpy(blocks + 32, format.ctr0, 16);
+		for (size_t i = 0, c = counter; i < q && i < sizeof(size_t); i++, c >>= 8) {
+			blocks[47 - i] = (unsigned char)c;
+		}
+		SoftAes::EncryptBlocks(key.aes, blocks);
+
+		memcpy(mac, blocks, 16);
+		if (step == 0) memcpy(mask, blocks + 16, 16);
+		if (has_counter) {
+			const size_t pos = (counter - 1) * 16;
+			const size_t n = std::min((size_t)16, len - pos);
+			for (size_t i = 0; i < n; i++) out[pos + i] = in[pos + i] ^ blocks[32 + i];
+		}
+	}
+
+	for (int i = 0; i < 16; i++) mac[i] ^= mask[i];
+	memcpy(tag, mac, tag_len);
+	OPENSSL_cleanse(blocks, sizeof(blocks));
+	OPENSSL_cleanse(mac, sizeof(mac));
+	OPENSSL_cleanse(mask, sizeof(mask));
+}
+
+void SoftAead::CcmEncrypt(const SoftKey &key,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *plaintext, size_t len,
+	unsigned char *ciphertext,
+	unsigned char *auth_tag, size_t auth_tag_len
+) {
+	CcmCrypt(key, true, iv, iv_len, aad, aad_len, plaintext, len, ciphertext, auth_tag, auth_tag_len);
+}
+
+bool SoftAead::CcmDecrypt(const SoftKey &key,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext,
+	const unsigned char *auth_tag, size_t auth_tag_len
+) {
+	unsigned char tag[16];
+	CcmCrypt(key, false, iv, iv_len, aad, aad_len, ciphertext, len, plaintext, tag, auth_tag_len);
+	const bool auth_ok = CRYPTO_memcmp(tag, auth_tag, auth_tag_len) == 0;
+	OPENSSL_cleanse(tag, sizeof(tag));
+	if (!auth_ok) OPENSSL_cleanse(plaintext, len);
+	return auth_ok;
+}
@@ -0,0 +1,76 @@
+#ifndef AEAD_SOFT_H_
+#define AEAD_SOFT_H_
+
+#include <stddef.h>
+
+#include "aead-soft-aes.h"
+
+namespace aead {
+
+    // A key schedule for SoftAead
+    struct SoftKey {
+        SoftAesKey aes;
+        // E(K, 0^128), the GHASH key
+        unsigned char h[16];
+    };
+
+    enum SoftSelection {
+        // software AES where the CPU is known to lack AES instructions
+        SOFT_AUTO,
+        SOFT_ALWAYS,
+        SOFT_NEVER
+    };
+
+    // GCM and CCM on top of SoftAes and SoftGhash, replacing OpenSSL where
+    // it would use table-based AES (e.g. the ARMv6 of the Raspberry Pi 1),
+    // which is slow and leaks the key through cache timing. The output is
+    // identical to OpenSSL's.
+    class SoftAead {
+    public:
+        // Whether operations should use SoftAead instead of OpenSSL
+        static bool Enabled();
+        // Chooses when Enabled() is true; SOFT_ALWAYS is meant for tests
+        // and benchmarks on CPUs with AES instructions
+        static void Select(SoftSelection selection);
+
+        static void ExpandKey(const unsigned char *key, size_t key_len, SoftKey *out);
+        // The expanded key for callers that pass raw keys with every call,
+        // cached per thread like Aesni::CachedKey. NULL if the key length
+        // is invalid.
+        static const SoftKey *CachedKey(const unsigned char *key, size_t key_len);
+        static void ClearCachedKeys();
+
+        // GCM with any IV length and a 16 byte tag. The output may be the
+        // input, but must not partially overlap it.
+        static void GcmEncrypt(const SoftKey &key,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext, unsigned char *auth_tag);
+        // Returns whether the tag matched; the plaintext is written either way
+        static bool GcmDecrypt(const SoftKey &key,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext, const unsigned char *auth_tag);
+
+        // CCM; the parameters must be valid for it. In place works as above.
+        static void CcmEncrypt(const SoftKey &key,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *plaintext, size_t len,
+            unsigned char *ciphertext,
+            unsigned char *auth_tag, size_t auth_tag_len);
+        // Returns whether the tag matched; a plaintext that failed
+        // authentication is zeroed
+        static bool CcmDecrypt(const SoftKey &key,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext,
+            const unsigned char *auth_tag, size_t auth_tag_len);
+    };
+
+}
+
+#endif
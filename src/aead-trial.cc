@@ -0,0 +1,245 @@
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include "aead-trial.h"
+#include "aead-aesni.h"
+#include "aead-ccm-format.h"
+#include "aead-fixed.h"
+#include "aead-gcm-verify.h"
+#include "aead-key.h"
+#include "aead-parallel.h"
+#include "aead-soft.h"
+
+using namespace aead;
+
+// What trying a key costs besides hashing the message, in hashed bytes,
+// when weighing candidates for splitting
+static const size_t KEY_COST = 256;
+
+static const EVP_CIPHER *CcmCipher(size_t key_len) {
+	switch (key_len) {
+		case 16: return EVP_aes_128_ccm();
+		case 24: return EVP_aes_192_ccm();
+		default: return EVP_aes_256_ccm();
+	}
+}
+
+static bool Valid(const TrialKey &key, size_t iv_len, size_t auth_tag_len, size_t len) {
+	if (key.key == NULL || (key.key_len != 16 && key.key_len != 24 && key.key_len != 32)) return false;
+	if (!KeyContext::ValidParams(key.mode, iv_len, auth_tag_len)) return false;
+	return key.mode == MODE_GCM || CcmFormat::LengthFits(iv_len, len);
+}
+
+// Decrypts a CCM message with the kernel the sync functions default to.
+// The context is created on first use and reused.
+static bool CcmOpen(const TrialKey &key, EVP_CIPHER_CTX **ctx,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext,
+	const unsigned char *auth_tag, size_t auth_tag_len
+) {
+	if (SoftAead::Enabled()) {
+		const SoftKey *soft_key = SoftAead::CachedKey(key.key, key.key_len);
+		return SoftAead::CcmDecrypt(*soft_key, iv, iv_len, aad, aad_len,
+			ciphertext, len, plaintext, auth_tag, auth_tag_len);
+	}
+	if (key.schedule != NULL || Aesni::Supported()) {
+		AesniKey schedule;
+		if (key.schedule == NULL) Aesni::ExpandKey(key.key, key.key_len, &schedule);
+		bool auth_ok = false;
+		AesniAead::CcmDecrypt(key.schedule != NULL ? *key.schedule : schedule, iv, iv_len, aad, aad_len,
+			ciphertext, len, plaintext, auth_tag, auth_tag_len, &auth_ok);
+		if (key.schedule == NULL) OPENSSL_cleanse(&schedule, sizeof(schedule));
+		return auth_ok;
+	}
+
+	if (*ctx == NULL && (*ctx = EVP_CIPHER_CTX_new()) == NULL) return false;
+	int outl;
+	const bool auth_ok =
+		EVP_DecryptInit_ex(*ctx, CcmCipher(key.key_len), NULL, NULL, NULL) &&
+		EVP_CIPHER_CTX_ctrl(*ctx, EVP_CTRL_CCM_SET_IVLEN, (int)iv_len, NULL) &&
+		EVP_CIPHER_CTX_ctrl(*ctx, EVP_CTRL_CCM_SET_TAG, (int)auth_tag_len, (void *)auth_tag) &&
+		EVP_DecryptInit_ex(*ctx, NULL, NULL, key.key, iv) &&
+		(aad_len == 0 || (
+			EVP_DecryptUpdate(*ctx, NULL, &outl, NULL, (int)len) &&
+			EVP_DecryptUpdate(*ctx, NULL, &outl, aad, (int)aad_len)
+		)) &&
+		EVP_DecryptUpdate(*ctx, plaintext, &outl, ciphertext, (int)len) > 0;
+	if (!auth_ok) OPENSSL_cleanse(plaintext, len);
+	return auth_ok;
+}
+
+// ==================
+
+// Scans a range of candidates per chunk
+class TrialDecryption::Work : public ChunkedWork {
+public:
+	const TrialKey *keys;
+	size_t count;
+	size_t chunk_keys;
+	const unsigned char *iv;
+	size_t iv_len;
+	const unsigned char *aad;
+	size_t aad_len;
+	const unsigned char *ciphertext;
+	size_t len;
+	const unsigned char *auth_tag;
+	size_t auth_tag_len;
+	// the first match so far, count if none
+	std::atomic<size_t> found;
+
+	Work() : found(0) {}
+
+	void Scan(size_t begin, size_t end);
+
+protected:
+	bool ProcessChunk(size_t index) {
+		Scan(index * chunk_keys, std::min(count, (index + 1) * chunk_keys));
+		return true;
+	}
+
+private:
+	void Report(size_t index);
+	// Hashes the message under the GCM candidates from *next on, up to
+	// HASH_LANES of them, and advances *next past them
+	void ScanLanes(size_t *next, size_t end);
+};
+
+void TrialDecryption::Work::Report(size_t index) {
+	size_t current = found.load();
+	while (index < current && !found.compare_exchange_weak(current, index)) {}
+}
+
+void TrialDecryption::Work::ScanLanes(size_t *next, size_t end) {
+	AesniKey schedules[AesniAead::HASH_LANES];
+	const AesniKey *lanes[AesniAead::HASH_LANES];
+	size_t indices[AesniAead::HASH_LANES];
+	size_t n = 0;
+	size_t i = *next;
+	for (; i < end && n < AesniAead::HASH_LANES; i++) {
+		if (!Valid(keys[i], iv_len, auth_tag_len, len)) continue;
+		if (keys[i].mode != MODE_GCM) break;
+		if (keys[i].schedule != NULL) {
+			lanes[n] = keys[i].schedule;
+		} else {
+			Aesni::ExpandKey(keys[i].key, keys[i].key_len, &schedules[n]);
+			lanes[n] = &schedules[n];
+		}
+		indices[n++] = i;
+	}
+	*next = i;
+	if (n == 0) return;
+
+	unsigned char tags[16 * AesniAead::HASH_LANES];
+	AesniAead::GcmHashKeys(lanes, n, iv, iv_len, aad, aad_len, ciphertext, len, tags);
+	for (size_t l = 0; l < n; l++) {
+		if (CRYPTO_memcmp(tags + 16 * l, auth_tag, auth_tag_len) == 0) {
+			Report(indices[l]);
+			break;
+		}
+	}
+	OPENSSL_cleanse(schedules, sizeof(schedules));
+	OPENSSL_cleanse(tags, sizeof(tags));
+}
+
+void TrialDecryption::Work::Scan(size_t begin, size_t end) {
+	const bool lanes = !SoftAead::Enabled() && Aesni::Supported();
+	std::vector<unsigned char> scratch;
+	EVP_CIPHER_CTX *ctx = NULL;
+	size_t i = begin;
+	// candidates after a match don't matter anymore
+	while (i < end && i < found.load()) {
+		const TrialKey &key = keys[i];
+		if (!Valid(key, iv_len, auth_tag_len, len)) {
+			i++;
+		} else if (key.mode == MODE_GCM && lanes) {
+			ScanLanes(&i, end);
+		} else if (key.mode == MODE_GCM) {
+			VerifiedGcm gcm(key.key, key.key_len, iv, iv_len);
+			if (gcm.Verify(aad, aad_len, ciphertext, len, auth_tag, auth_tag_len)) Report(i);
+			i++;
+		} else {
+			if (scratch.size() < len) scratch.resize(len);
+			// a failed candidate leaves the scratch buffer zeroed
+			if (CcmOpen(key, &ctx, iv, iv_len, aad, aad_len, ciphertext, len, scratch.data(),
+				auth_tag, auth_tag_len)
+			) {
+				OPENSSL_cleanse(scratch.data(), len);
+				Report(i);
+			}
+			i++;
+		}
+	}
+	EVP_CIPHER_CTX_free(ctx);
+}
+
+// ==================
+
+size_t TrialDecryption::Find(const TrialKey *keys, size_t count,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	const unsigned char *auth_tag, size_t auth_tag_len
+) {
+	std::shared_ptr<Work> work(new Work());
+	work->keys = keys;
+	work->count = count;
+	work->iv = iv;
+	work->iv_len = iv_len;
+	work->aad = aad;
+	work->aad_len = aad_len;
+	work->ciphertext = ciphertext;
+	work->len = len;
+	work->auth_tag = auth_tag;
+	work->auth_tag_len = auth_tag_len;
+	work->found.store(count);
+
+	// candidates are split like a message of the bytes they hash, in
+	// whole groups of lanes
+	const size_t key_cost = aad_len + len + KEY_COST;
+	const size_t total = count > (size_t)-1 / key_cost ? (size_t)-1 : count * key_cost;
+	work->chunk_keys = count;
+	if (ChunkedWork::ShouldSplit(total)) {
+		const size_t lanes = AesniAead::HASH_LANES;
+		work->chunk_keys = std::max(lanes, ChunkedWork::ChunkSize(total) / key_cost);
+		work->chunk_keys = (work->chunk_keys + lanes - 1) / lanes * lanes;
+	}
+	const size_t chunks = count == 0 ? 0 : (count + work->chunk_keys - 1) / work->chunk_keys;
+	work->Init(chunks);
+	if (chunks > 1) work->StartHelpers();
+	work->Finish();
+	return work->found.load();
+}
+
+bool TrialDecryption::Decrypt(const TrialKey &key,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *aad, size_t aad_len,
+	const unsigned char *ciphertext, size_t len,
+	unsigned char *plaintext,
+	const unsigned char *auth_tag, size_t auth_tag_len
+) {
+	if (!Valid(key, iv_len, auth_tag_len, len)) {
+		OPENSSL_cleanse(plaintext, len);
+		return false;
+	}
+	if (key.mode == MODE_CCM) {
+		EVP_CIPHER_CTX *ctx = NULL;
+		const bool auth_ok = CcmOpen(key, &ctx, iv, iv_len, aad, aad_len, ciphertext, len, plaintext,
+			auth_tag, auth_tag_len);
+		EVP_CIPHER_CTX_free(ctx);
+		return auth_ok;
+	}
+	VerifiedGcm gcm(key.key, key.key_len, iv, iv_len);
+	if (!gcm.Verify(aad, aad_len, ciphertext, len, auth_tag, auth_tag_len)) {
+		OPENSSL_cleanse(plaintext, len);
+		return false;
+	}
+	gcm.Decrypt(ciphertext, len, plaintext);
+	return true;
+}
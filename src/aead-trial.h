@@ -0,0 +1,57 @@
+#ifndef AEAD_TRIAL_H_
+#define AEAD_TRIAL_H_
+
+#include <stddef.h>
+
+#include "aead-aesni.h"
+#include "aead-backend.h"
+
+namespace aead {
+
+    // A candidate key of a trial decryption
+    struct TrialKey {
+        Mode mode;
+        // NULL for candidates to skip, like unknown key IDs
+        const unsigned char *key;
+        size_t key_len;
+        // the expanded key if the caller has one, NULL to expand it here
+        const AesniKey *schedule;
+    };
+
+    // Finds which of several candidate keys a message was encrypted with,
+    // for frames that don't say.
+    //
+    // GCM candidates are only authenticated, and with AES-NI, up to
+    // AesniAead::HASH_LANES of them hash the message side by side, so the
+    // carry-less multiplications of all lanes overlap. CCM authenticates
+    // the plaintext, so CCM candidates decrypt into a scratch buffer that
+    // is wiped afterwards. Many candidates are split across the crypto
+    // thread pool like long messages (see ChunkedWork); each worker stops
+    // as soon as a candidate before its next one matched. Only the
+    // matching key decrypts into the caller's buffer.
+    class TrialDecryption {
+    public:
+        // Returns the index of the first candidate whose tag matches, or
+        // count if none does. Candidates whose mode doesn't allow the IV
+        // and tag lengths never match.
+        static size_t Find(const TrialKey *keys, size_t count,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            const unsigned char *auth_tag, size_t auth_tag_len);
+        // Decrypts with the candidate Find returned; returns whether the
+        // tag matched. A plaintext that failed authentication is zeroed.
+        static bool Decrypt(const TrialKey &key,
+            const unsigned char *iv, size_t iv_len,
+            const unsigned char *aad, size_t aad_len,
+            const unsigned char *ciphertext, size_t len,
+            unsigned char *plaintext,
+            const unsigned char *auth_tag, size_t auth_tag_len);
+
+    private:
+        class Work;
+    };
+
+}
+
+#endif
@@ -0,0 +1,36 @@
+#include <stdint.h>
+#include <atomic>
+
+#include "aead-tuning.h"
+
+using namespace aead;
+
+// 64 bytes is the limit of the short message kernels
+static const size_t bucket_limits[Tuning::BUCKETS] = {
+	64, 1 << 10, 16 << 10, 256 << 10, SIZE_MAX
+};
+
+// Zero-initialized as static storage, i.e. KERNEL_AUTO
+static std::atomic<int> kernels[2][Tuning::BUCKETS];
+
+size_t Tuning::BucketLimit(int bucket) {
+	return bucket_limits[bucket];
+}
+
+int Tuning::Bucket(size_t len) {
+	int bucket = 0;
+	while (len > bucket_limits[bucket]) bucket++;
+	return bucket;
+}
+
+Kernel Tuning::Get(Mode mode, size_t len) {
+	return GetBucket(mode, Bucket(len));
+}
+
+Kernel Tuning::GetBucket(Mode mode, int bucket) {
+	return (Kernel)kernels[mode][bucket].load(std::memory_order_relaxed);
+}
+
+void Tuning::Set(Mode mode, int bucket, Kernel kernel) {
+	kernels[mode][bucket].store(kernel, std::memory_order_relaxed);
+}
@@ -0,0 +1,36 @@
+#ifndef AEAD_TUNING_H_
+#define AEAD_TUNING_H_
+
+#include <stddef.h>
+
+#include "aead-backend.h"
+
+namespace aead {
+
+    enum Kernel {
+        // the built-in heuristics: built-in kernels where they are known to
+        // beat OpenSSL, OpenSSL otherwise
+        KERNEL_AUTO,
+        KERNEL_BUILTIN,
+        KERNEL_OPENSSL
+    };
+
+    // The kernel choice per mode and message size bucket, as measured by
+    // the autotuner. Consulted by the one-shot functions and by keys without
+    // a selected backend. Forced software AES still takes precedence.
+    class Tuning {
+    public:
+        static const int BUCKETS = 5;
+
+        // The largest message of a bucket; SIZE_MAX for the last one
+        static size_t BucketLimit(int bucket);
+        static int Bucket(size_t len);
+
+        static Kernel Get(Mode mode, size_t len);
+        static Kernel GetBucket(Mode mode, int bucket);
+        static void Set(Mode mode, int bucket, Kernel kernel);
+    };
+
+}
+
+#endif
@@ -0,0 +1,939 @@
+#include <node.h>
+#include <nan.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <uv.h>
+#include <openssl/crypto.h>
+
+#include "node-aead-async.h"
+#include "aead-aesni.h"
+#include "aead-capabilities.h"
+#include "aead-cpu.h"
+#include "aead-parallel.h"
+#include "aead-soft.h"
+#include "aead-tuning.h"
+
+using namespace v8;
+using namespace node;
+using namespace async;
+
+// ==================
+
+// Every JS thread (main thread or worker) gets a completion port: finished
+// jobs are queued on it by the pool threads and handed back to the thread's
+// event loop through a uv_async_t. The handle only keeps the loop alive
+// while jobs are pending.
+
+class async::CompletionPort {
+public:
+	// The port of the calling JS thread
+	static CompletionPort *Current();
+
+	// JS thread: a job has been submitted
+	void Submitted();
+	// JS thread: the job could not be queued after all
+	void Withdrawn();
+	// Pool thread: a job has finished
+	void Post(AsyncJob *job);
+
+private:
+	CompletionPort();
+	static void OnAsync(uv_async_t *handle);
+	static void OnClose(uv_handle_t *handle);
+	static void Cleanup(void *arg);
+	void Drain();
+
+	uv_async_t async_;
+	std::mutex mutex_;
+	std::condition_variable posted_;
+	std::vector<AsyncJob *> completed_;
+	// jobs submitted but not completed yet; only used on the JS thread
+	size_t pending_;
+};
+
+static thread_local CompletionPort *current_port = NULL;
+
+CompletionPort::CompletionPort() : pending_(0) {
+	uv_async_init(Nan::GetCurrentEventLoop(), &async_, OnAsync);
+	async_.data = this;
+	uv_unref((uv_handle_t *)&async_);
+}
+
+CompletionPort *CompletionPort::Current() {
+	if (current_port == NULL) {
+		current_port = new CompletionPort();
+		// Environment cleanup hooks exist since Node.js 10
+#if NODE_MODULE_VERSION >= 64
+		AddEnvironmentCleanupHook(Isolate::GetCurrent(), Cleanup, current_port);
+#endif
+	}
+	return current_port;
+}
+
+void CompletionPort::Submitted() {
+	if (pending_++ == 0) uv_ref((uv_handle_t *)&async_);
+}
+
+void CompletionPort::Withdrawn() {
+	if (--pending_ == 0) uv_unref((uv_handle_t *)&async_);
+}
+
+void CompletionPort::Post(AsyncJob *job) {
+	// signal while holding the lock, so Cleanup can't close the handle in between
+	std::lock_guard<std::mutex> lock(mutex_);
+	completed_.push_back(job);
+	uv_async_send(&async_);
+	posted_.notify_one();
+}
+
+void CompletionPort::OnAsync(uv_async_t *handle) {
+	((CompletionPort *)handle->data)->Drain();
+}
+
+void CompletionPort::Drain() {
+	std::vector<AsyncJob *> jobs;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		jobs.swap(completed_);
+	}
+	for (size_t i = 0; i < jobs.size(); i++) {
+		Withdrawn();
+		jobs[i]->Complete();
+		delete jobs[i];
+	}
+}
+
+void CompletionPort::OnClose(uv_handle_t *handle) {
+	delete (CompletionPort *)handle->data;
+}
+
+// The thread's environment is going away: wait for its jobs still on the
+// pool, drop them without calling back and close the handle
+void CompletionPort::Cleanup(void *arg) {
+	CompletionPort *port = (CompletionPort *)arg;
+	{
+		std::unique_lock<std::mutex> lock(port->mutex_);
+		while (port->completed_.size() < port->pending_) port->posted_.wait(lock);
+		for (size_t i = 0; i < port->completed_.size(); i++) delete port->completed_[i];
+		port->completed_.clear();
+	}
+	if (current_port == port) current_port = NULL;
+	uv_close((uv_handle_t *)&port->async_, OnClose);
+}
+
+// ==================
+
+AsyncJob::AsyncJob(Local<Function> callback)
+	: callback_(callback), async_resource_("aead:crypto"),
+	retained_(Nan::New<Array>()), retained_count_(0), error_(NULL), port_(NULL),
+	created_(aead::Scheduler::Now()), run_ns_(0), timed_(false)
+{}
+
+AsyncJob::~AsyncJob() {
+	retained_.Reset();
+#if V8_MAJOR_VERSION < 8
+	for (size_t i = 0; i < copies_.size(); i++) {
+		OPENSSL_cleanse(copies_[i].first, copies_[i].second);
+		free(copies_[i].first);
+	}
+#endif
+}
+
+void AsyncJob::Retain(Local<Value> value) {
+	Nan::Set(Nan::New(retained_), retained_count_++, value);
+}
+
+const unsigned char *AsyncJob::Pin(Local<Value> buf, size_t *len) {
+	if (!Buffer::HasInstance(buf)) {
+		*len = 0;
+		return NULL;
+	}
+	*len = Buffer::Length(buf);
+#if V8_MAJOR_VERSION >= 8
+	// the pool threads share ownership of the memory with the ArrayBuffer
+	Local<ArrayBufferView> view = buf.As<ArrayBufferView>();
+	std::shared_ptr<BackingStore> store = view->Buffer()->GetBackingStore();
+	pinned_.push_back(store);
+	return (const unsigned char *)store->Data() + view->ByteOffset();
+#else
+	unsigned char *copy = (unsigned char *)malloc(*len > 0 ? *len : 1);
+	memcpy(copy, Buffer::Data(buf), *len);
+	copies_.push_back(std::make_pair(copy, *len));
+	return copy;
+#endif
+}
+
+void AsyncJob::Done() {
+	port_->Post(this);
+}
+
+void AsyncJob::Expire() {
+	SetError("The deadline of the job passed before it was finished.");
+}
+
+void AsyncJob::Complete() {
+	Nan::HandleScope scope;
+	Local<Value> argv[2];
+	if (error_ != NULL) {
+		argv[0] = Nan::Error(error_);
+		argv[1] = Nan::Undefined();
+	} else {
+		argv[0] = Nan::Null();
+		argv[1] = Result();
+	}
+	if (timed_) {
+		const uint64_t elapsed = aead::Scheduler::Now() - created_;
+		aead::DispatchEstimator::Get().RecordDispatch(elapsed > run_ns_ ? elapsed - run_ns_ : 0);
+	}
+	callback_.Call(2, argv, &async_resource_);
+}
+
+bool async::GetScheduleOptions(Local<Value> value, aead::ScheduleOptions *options) {
+	options->tenant = "default";
+	if (value->IsUndefined()) return true;
+	if (!value->IsObject()) {
+		Nan::ThrowTypeError("The scheduling options must be an object.");
+		return false;
+	}
+	Local<Object> obj = value.As<Object>();
+	Local<Value> tenant = Nan::Get(obj, Nan::New<String>("tenant").ToLocalChecked()).ToLocalChecked();
+	Local<Value> timeout = Nan::Get(obj, Nan::New<String>("timeout").ToLocalChecked()).ToLocalChecked();
+
+	if (!tenant->IsUndefined()) {
+		if (!tenant->IsString() && !tenant->IsNumber()) {
+			Nan::ThrowTypeError("The tenant must be a string or a number.");
+			return false;
+		}
+		options->tenant = *Nan::Utf8String(tenant);
+	}
+	if (!timeout->IsUndefined()) {
+		const double ms = timeout->IsNumber() ? Nan::To<double>(timeout).FromJust() : -1;
+		// more than a year is as good as no deadline
+		if (!(ms > 0 && ms <= 365 * 86400e3)) {
+			Nan::ThrowError("The timeout must be a positive number of milliseconds.");
+			return false;
+		}
+		options->deadline = aead::Scheduler::Now() + (uint64_t)(ms * 1e6);
+	}
+	return true;
+}
+
+bool async::Submit(AsyncJob *job, const aead::ScheduleOptions &options) {
+	job->port_ = CompletionPort::Current();
+	job->port_->Submitted();
+	if (!aead::Scheduler::Get().Submit(job, options)) {
+		job->port_->Withdrawn();
+		delete job;
+		Nan::ThrowError("The crypto thread pool is overloaded.");
+		return false;
+	}
+	return true;
+}
+
+// ==================
+
+// Buffers handed to Nan::NewBuffer are freed with free()
+static char *AllocOutput(size_t len) {
+	return (char *)malloc(len > 0 ? len : 1);
+}
+
+EncryptJob::EncryptJob(Local<Function> callback,
+	const std::shared_ptr<aead::KeyContext> &key,
+	Local<Value> iv, Local<Value> plaintext, Local<Value> aad,
+	size_t auth_tag_len
+) : AsyncJob(callback), key_(key), auth_tag_len_(auth_tag_len), stream_(NULL), offset_(0) {
+	Retain(iv);
+	Retain(plaintext);
+	Retain(aad);
+	iv_ = Pin(iv, &iv_len_);
+	plaintext_ = Pin(plaintext, &plaintext_len_);
+	aad_ = Pin(aad, &aad_len_);
+	ciphertext_ = AllocOutput(plaintext_len_);
+	auth_tag_ = AllocOutput(auth_tag_len_);
+}
+
+EncryptJob::~EncryptJob() {
+	free(ciphertext_);
+	free(auth_tag_);
+	if (stream_ != NULL) EVP_CIPHER_CTX_free(stream_);
+}
+
+void EncryptJob::Run(aead::WorkerContext &worker) {
+	const uint64_t start = aead::Scheduler::Now();
+	if (!key_->Encrypt(worker.scratch,
+		iv_, iv_len_,
+		aad_, aad_len_,
+		plaintext_, plaintext_len_,
+		(unsigned char *)ciphertext_,
+		(unsigned char *)auth_tag_, auth_tag_len_
+	)) {
+		SetError("Invalid IV or auth tag length for this key.");
+		return;
+	}
+	const uint64_t elapsed = aead::Scheduler::Now() - start;
+	aead::DispatchEstimator::Get().RecordRun(key_->mode(), plaintext_len_ + aad_len_, elapsed);
+	SetRunTime(elapsed);
+}
+
+bool EncryptJob::RunSlice(aead::WorkerContext &worker, size_t budget) {
+	if (stream_ == NULL) {
+		// CCM can't be split, and short messages needn't be. Neither can
+		// SoftAead or a backend other than OpenSSL, which have no
+		// incremental interface.
+		if (key_->mode() != aead::MODE_GCM || plaintext_len_ <= budget || aead::SoftAead::Enabled() ||
+			!key_->CanStream()
+		) {
+			Run(worker);
+			return true;
+		}
+		stream_ = EVP_CIPHER_CTX_new();
+		if (!key_->Start(stream_, true, iv_, iv_len_, aad_, aad_len_)) {
+			SetError("Invalid IV or auth tag length for this key.");
+			return true;
+		}
+	}
+
+	const size_t len = std::min(budget, plaintext_len_ - offset_);
+	if (!aead::KeyContext::Update(stream_, plaintext_ + offset_, len, (unsigned char *)ciphertext_ + offset_)) {
+		SetError("Encryption failed.");
+		return true;
+	}
+	offset_ += len;
+	if (offset_ < plaintext_len_) return false;
+
+	if (!aead::KeyContext::Finish(stream_, true, (unsigned char *)auth_tag_, auth_tag_len_, NULL)) {
+		SetError("Invalid IV or auth tag length for this key.");
+	}
+	return true;
+}
+
+Local<Value> EncryptJob::Result() {
+	Local<Object> result = Nan::New<Object>();
+	Nan::Set(result, Nan::New<String>("ciphertext").ToLocalChecked(),
+		Nan::NewBuffer(ciphertext_, (uint32_t)plaintext_len_).ToLocalChecked());
+	Nan::Set(result, Nan::New<String>("auth_tag").ToLocalChecked(),
+		Nan::NewBuffer(auth_tag_, (uint32_t)auth_tag_len_).ToLocalChecked());
+	// the buffers own the memory now
+	ciphertext_ = auth_tag_ = NULL;
+	return result;
+}
+
+DecryptJob::DecryptJob(Local<Function> callback,
+	const std::shared_ptr<aead::KeyContext> &key,
+	Local<Value> iv, Local<Value> ciphertext, Local<Value> aad,
+	Local<Value> auth_tag
+) : AsyncJob(callback), key_(key), auth_ok_(false), stream_(NULL), offset_(0) {
+	Retain(iv);
+	Retain(ciphertext);
+	Retain(aad);
+	Retain(auth_tag);
+	iv_ = Pin(iv, &iv_len_);
+	ciphertext_ = Pin(ciphertext, &ciphertext_len_);
+	aad_ = Pin(aad, &aad_len_);
+	auth_tag_ = Pin(auth_tag, &auth_tag_len_);
+	plaintext_ = AllocOutput(ciphertext_len_);
+}
+
+DecryptJob::~DecryptJob() {
+	free(plaintext_);
+	if (stream_ != NULL) EVP_CIPHER_CTX_free(stream_);
+}
+
+void DecryptJob::Run(aead::WorkerContext &worker) {
+	const uint64_t start = aead::Scheduler::Now();
+	if (!key_->Decrypt(worker.scratch,
+		iv_, iv_len_,
+		aad_, aad_len_,
+		ciphertext_, ciphertext_len_,
+		(unsigned char *)plaintext_,
+		auth_tag_, auth_tag_len_,
+		&auth_ok_
+	)) {
+		SetError("Invalid IV or auth tag length for this key.");
+		return;
+	}
+	const uint64_t elapsed = aead::Scheduler::Now() - start;
+	aead::DispatchEstimator::Get().RecordRun(key_->mode(), ciphertext_len_ + aad_len_, elapsed);
+	SetRunTime(elapsed);
+}
+
+bool DecryptJob::RunSlice(aead::WorkerContext &worker, size_t budget) {
+	if (stream_ == NULL) {
+		if (key_->mode() != aead::MODE_GCM || ciphertext_len_ <= budget || aead::SoftAead::Enabled() ||
+			!key_->CanStream()
+		) {
+			Run(worker);
+			return true;
+		}
+		stream_ = EVP_CIPHER_CTX_new();
+		if (!key_->Start(stream_, false, iv_, iv_len_, aad_, aad_len_)) {
+			SetError("Invalid IV or auth tag length for this key.");
+			return true;
+		}
+	}
+
+	const size_t len = std::min(budget, ciphertext_len_ - offset_);
+	if (!aead::KeyContext::Update(stream_, ciphertext_ + offset_, len, (unsigned char *)plaintext_ + offset_)) {
+		SetError("Decryption failed.");
+		return true;
+	}
+	offset_ += len;
+	if (offset_ < ciphertext_len_) return false;
+
+	aead::KeyContext::Finish(stream_, false, (unsigned char *)auth_tag_, auth_tag_len_, &auth_ok_);
+	return true;
+}
+
+Local<Value> DecryptJob::Result() {
+	Local<Object> result = Nan::New<Object>();
+	Nan::Set(result, Nan::New<String>("plaintext").ToLocalChecked(),
+		Nan::NewBuffer(plaintext_, (uint32_t)ciphertext_len_).ToLocalChecked());
+	Nan::Set(result, Nan::New<String>("auth_ok").ToLocalChecked(), Nan::New<Boolean>(auth_ok_));
+	plaintext_ = NULL;
+	return result;
+}
+
+bool async::ReadBatchOp(Local<Value> value, BatchOp *op) {
+	if (!value->IsArray()) return false;
+	Local<Array> arr = value.As<Array>();
+	Local<Value> encrypt = Nan::Get(arr, 0).ToLocalChecked();
+	op->iv = Nan::Get(arr, 1).ToLocalChecked();
+	op->data = Nan::Get(arr, 2).ToLocalChecked();
+	op->aad = Nan::Get(arr, 3).ToLocalChecked();
+	op->auth_tag = Nan::Get(arr, 4).ToLocalChecked();
+	if (!encrypt->IsBoolean() ||
+		!Buffer::HasInstance(op->iv) ||
+		!Buffer::HasInstance(op->data) ||
+		!(op->aad->IsUndefined() || op->aad->IsNull() || Buffer::HasInstance(op->aad))
+	) {
+		return false;
+	}
+	op->encrypt = Nan::To<bool>(encrypt).FromJust();
+	return op->encrypt
+		? op->auth_tag->IsUndefined() || op->auth_tag->IsUint32()
+		: Buffer::HasInstance(op->auth_tag);
+}
+
+BatchJob::BatchJob(Local<Function> callback,
+	const std::shared_ptr<aead::KeyContext> &key, Local<Array> ops
+) : AsyncJob(callback), key_(key), next_(0), remaining_(0) {
+	Retain(ops);
+	ops_.reserve(ops->Length());
+}
+
+BatchJob::~BatchJob() {
+	for (size_t i = 0; i < ops_.size(); i++) {
+		free(ops_[i].output);
+		free(ops_[i].auth_tag_out);
+	}
+}
+
+void BatchJob::AddEncrypt(Local<Value> iv, Local<Value> plaintext, Local<Value> aad, size_t auth_tag_len) {
+	Op op = Op();
+	op.encrypt = true;
+	op.iv = Pin(iv, &op.iv_len);
+	op.input = Pin(plaintext, &op.input_len);
+	op.aad = Pin(aad, &op.aad_len);
+	op.auth_tag_len = auth_tag_len;
+	op.output = AllocOutput(op.input_len);
+	op.auth_tag_out = AllocOutput(auth_tag_len);
+	remaining_ += op.input_len;
+	ops_.push_back(op);
+}
+
+void BatchJob::AddDecrypt(Local<Value> iv, Local<Value> ciphertext, Local<Value> aad, Local<Value> auth_tag) {
+	Op op = Op();
+	op.encrypt = false;
+	op.iv = Pin(iv, &op.iv_len);
+	op.input = Pin(ciphertext, &op.input_len);
+	op.aad = Pin(aad, &op.aad_len);
+	op.auth_tag_in = Pin(auth_tag, &op.auth_tag_len);
+	op.output = AllocOutput(op.input_len);
+	remaining_ += op.input_len;
+	ops_.push_back(op);
+}
+
+void BatchJob::AddError(const char *message) {
+	Op op = Op();
+	op.error = message;
+	ops_.push_back(op);
+}
+
+void BatchJob::RunOps(size_t begin, size_t end, EVP_CIPHER_CTX *scratch) {
+	std::vector<aead::BackendOp> backend_ops;
+	std::vector<size_t> index;
+	for (size_t i = begin; i < end; i++) {
+		const Op &op = ops_[i];
+		if (op.error != NULL) continue;
+		aead::BackendOp b;
+		b.encrypt = op.encrypt;
+		b.iv = op.iv;
+		b.iv_len = op.iv_len;
+		b.aad = op.aad;
+		b.aad_len = op.aad_len;
+		b.in = op.input;
+		b.len = op.input_len;
+		b.out = (unsigned char *)op.output;
+		b.tag = op.encrypt ? (unsigned char *)op.auth_tag_out : (unsigned char *)op.auth_tag_in;
+		b.tag_len = op.auth_tag_len;
+		backend_ops.push_back(b);
+		index.push_back(i);
+	}
+	if (backend_ops.empty()) return;
+	key_->RunBatch(scratch, backend_ops.data(), backend_ops.size());
+	for (size_t i = 0; i < backend_ops.size(); i++) {
+		Op &op = ops_[index[i]];
+		op.auth_ok = backend_ops[i].auth_ok;
+		if (!backend_ops[i].ok) op.error = "Invalid IV or auth tag length for this key.";
+	}
+}
+
+void BatchJob::Run(aead::WorkerContext &worker) {
+	RunOps(next_, ops_.size(), worker.scratch);
+	next_ = ops_.size();
+	remaining_ = 0;
+}
+
+bool BatchJob::RunSlice(aead::WorkerContext &worker, size_t budget) {
+	const size_t begin = next_;
+	size_t done = 0;
+	while (next_ < ops_.size() && done < budget) {
+		const Op &op = ops_[next_++];
+		if (op.error == NULL) done += op.input_len;
+	}
+	RunOps(begin, next_, worker.scratch);
+	remaining_ -= std::min(remaining_, done);
+	return next_ == ops_.size();
+}
+
+Local<Value> BatchJob::Result() {
+	Local<Array> results = Nan::New<Array>((int)ops_.size());
+	for (size_t i = 0; i < ops_.size(); i++) {
+		Op &op = ops_[i];
+		if (op.error != NULL) {
+			Nan::Set(results, (uint32_t)i, Nan::Error(op.error));
+			continue;
+		}
+		Local<Object> result = Nan::New<Object>();
+		if (op.encrypt) {
+			Nan::Set(result, Nan::New<String>("ciphertext").ToLocalChecked(),
+				Nan::NewBuffer(op.output, (uint32_t)op.input_len).ToLocalChecked());
+			Nan::Set(result, Nan::New<String>("auth_tag").ToLocalChecked(),
+				Nan::NewBuffer(op.auth_tag_out, (uint32_t)op.auth_tag_len).ToLocalChecked());
+		} else {
+			Nan::Set(result, Nan::New<String>("plaintext").ToLocalChecked(),
+				Nan::NewBuffer(op.output, (uint32_t)op.input_len).ToLocalChecked());
+			Nan::Set(result, Nan::New<String>("auth_ok").ToLocalChecked(), Nan::New<Boolean>(op.auth_ok));
+		}
+		// the buffers own the memory now
+		op.output = op.auth_tag_out = NULL;
+		Nan::Set(results, (uint32_t)i, result);
+	}
+	return results;
+}
+
+// ==================
+
+bool async::ShouldInline(aead::Mode mode, size_t bytes) {
+	return aead::DispatchEstimator::Get().ShouldInline(mode, bytes);
+}
+
+void async::RecordInline(aead::Mode mode, size_t bytes, uint64_t ns) {
+	aead::DispatchEstimator::Get().RecordRun(mode, bytes, ns);
+}
+
+// ==================
+
+// Restarts the crypto thread pool with the given options and returns the
+// effective { threads, pinned, chunkSize, parallelThreshold } configuration.
+// The pool is only restarted if its options change.
+// Arguments: options ({ threads, pin, cpus, chunkSize, parallelThreshold }, optional)
+NAN_METHOD(async::ConfigurePool) {
+	aead::ThreadPool &pool = aead::ThreadPool::Get();
+	// like configureTuning, only what is passed changes
+	aead::PoolOptions options = pool.options();
+	size_t chunk_size = aead::Scheduler::Get().chunk_size();
+	size_t parallel_threshold = aead::ChunkedWork::threshold();
+	if (info.Length() > 0 && !info[0]->IsUndefined()) {
+		if (!info[0]->IsObject()) {
+			Nan::ThrowTypeError("The pool options must be an object.");
+			return;
+		}
+		Local<Object> obj = info[0].As<Object>();
+		Local<Value> threads = Nan::Get(obj, Nan::New<String>("threads").ToLocalChecked()).ToLocalChecked();
+		Local<Value> pin = Nan::Get(obj, Nan::New<String>("pin").ToLocalChecked()).ToLocalChecked();
+		Local<Value> cpus = Nan::Get(obj, Nan::New<String>("cpus").ToLocalChecked()).ToLocalChecked();
+		Local<Value> chunk = Nan::Get(obj, Nan::New<String>("chunkSize").ToLocalChecked()).ToLocalChecked();
+		Local<Value> threshold = Nan::Get(obj, Nan::New<String>("parallelThreshold").ToLocalChecked()).ToLocalChecked();
+
+		if (!threads->IsUndefined()) {
+			if (!threads->IsUint32() || Nan::To<uint32_t>(threads).FromJust() == 0 ||
+				Nan::To<uint32_t>(threads).FromJust() > 1024
+			) {
+				Nan::ThrowError("The number of threads must be between 1 and 1024.");
+				return;
+			}
+			options.threads = Nan::To<uint32_t>(threads).FromJust();
+		}
+		if (!pin->IsUndefined()) {
+			options.pin = Nan::To<bool>(pin).FromJust();
+			// the CPUs of the process, unless given below
+			options.cpus.clear();
+		}
+		if (!cpus->IsUndefined()) {
+			if (!cpus->IsArray()) {
+				Nan::ThrowTypeError("The CPU list must be an array of CPU numbers.");
+				return;
+			}
+			Local<Array> list = cpus.As<Array>();
+			options.cpus.clear();
+			for (uint32_t i = 0; i < list->Length(); i++) {
+				Local<Value> cpu = Nan::Get(list, i).ToLocalChecked();
+				if (!cpu->IsUint32()) {
+					Nan::ThrowTypeError("The CPU list must be an array of CPU numbers.");
+					return;
+				}
+				options.cpus.push_back((int)Nan::To<uint32_t>(cpu).FromJust());
+			}
+			options.pin = true;
+		}
+		if (!chunk->IsUndefined()) {
+			if (!chunk->IsUint32() || Nan::To<uint32_t>(chunk).FromJust() < aead::Scheduler::MIN_CHUNK_SIZE) {
+				Nan::ThrowError("The chunk size must be an integer of at least 4096.");
+				return;
+			}
+			chunk_size = Nan::To<uint32_t>(chunk).FromJust();
+		}
+		if (!threshold->IsUndefined()) {
+			if (!threshold->IsNumber() || !(Nan::To<double>(threshold).FromJust() >= 0)) {
+				Nan::ThrowError("The parallel threshold must be a non-negative number of bytes.");
+				return;
+			}
+			const double bytes = Nan::To<double>(threshold).FromJust();
+			parallel_threshold = bytes >= (double)SIZE_MAX ? SIZE_MAX : (size_t)bytes;
+		}
+	}
+
+	pool.Configure(options);
+	aead::Scheduler::Get().Configure(chunk_size);
+	aead::ChunkedWork::Configure(parallel_threshold);
+
+	Local<Object> result = Nan::New<Object>();
+	Nan::Set(result, Nan::New<String>("threads").ToLocalChecked(), Nan::New<Number>(pool.threads()));
+	Nan::Set(result, Nan::New<String>("pinned").ToLocalChecked(), Nan::New<Boolean>(pool.pinned()));
+	Nan::Set(result, Nan::New<String>("chunkSize").ToLocalChecked(),
+		Nan::New<Number>((double)aead::Scheduler::Get().chunk_size()));
+	Nan::Set(result, Nan::New<String>("parallelThreshold").ToLocalChecked(),
+		Nan::New<Number>((double)aead::ChunkedWork::threshold()));
+	info.GetReturnValue().Set(result);
+}
+
+// Returns the queueing statistics of each tenant as
+// { [tenant]: { jobs, dropped, queued, waitAvg, waitMax } }, times in ms.
+// Arguments: reset (boolean, optional)
+NAN_METHOD(async::GetSchedulerStats) {
+	const bool reset = info.Length() > 0 && Nan::To<bool>(info[0]).FromJust();
+	std::map<std::string, aead::TenantStats> stats = aead::Scheduler::Get().Stats(reset);
+
+	Local<Object> result = Nan::New<Object>();
+	for (std::map<std::string, aead::TenantStats>::iterator it = stats.begin(); it != stats.end(); ++it) {
+		const aead::TenantStats &tenant = it->second;
+		Local<Object> obj = Nan::New<Object>();
+		Nan::Set(obj, Nan::New<String>("jobs").ToLocalChecked(), Nan::New<Number>((double)tenant.jobs));
+		Nan::Set(obj, Nan::New<String>("dropped").ToLocalChecked(), Nan::New<Number>((double)tenant.dropped));
+		Nan::Set(obj, Nan::New<String>("queued").ToLocalChecked(), Nan::New<Number>((double)tenant.queued));
+		Nan::Set(obj, Nan::New<String>("waitAvg").ToLocalChecked(),
+			Nan::New<Number>(tenant.jobs > 0 ? tenant.wait_total / 1e6 / tenant.jobs : 0));
+		Nan::Set(obj, Nan::New<String>("waitMax").ToLocalChecked(), Nan::New<Number>(tenant.wait_max / 1e6));
+		Nan::Set(result, Nan::New<String>(it->first).ToLocalChecked(), obj);
+	}
+	info.GetReturnValue().Set(result);
+}
+
+// Returns the current cost model of the auto dispatch as
+// { dispatchNs, gcm: { cutoff, fixedNs, perByteNs }, ccm: { ... } }
+NAN_METHOD(async::GetDispatchEstimates) {
+	aead::DispatchEstimator &estimator = aead::DispatchEstimator::Get();
+	Local<Object> result = Nan::New<Object>();
+	Nan::Set(result, Nan::New<String>("dispatchNs").ToLocalChecked(), Nan::New<Number>(estimator.dispatch_ns()));
+
+	const aead::Mode modes[] = { aead::MODE_GCM, aead::MODE_CCM };
+	const char *names[] = { "gcm", "ccm" };
+	for (int i = 0; i < 2; i++) {
+		Local<Object> mode = Nan::New<Object>();
+		Nan::Set(mode, Nan::New<String>("cutoff").ToLocalChecked(), Nan::New<Number>((double)estimator.Cutoff(modes[i])));
+		Nan::Set(mode, Nan::New<String>("fixedNs").ToLocalChecked(), Nan::New<Number>(estimator.fixed_ns(modes[i])));
+		Nan::Set(mode, Nan::New<String>("perByteNs").ToLocalChecked(), Nan::New<Number>(estimator.per_byte_ns(modes[i])));
+		Nan::Set(result, Nan::New<String>(names[i]).ToLocalChecked(), mode);
+	}
+	info.GetReturnValue().Set(result);
+}
+
+// Chooses between OpenSSL and the built-in constant-time software AES:
+// true forces software AES, false forces OpenSSL, undefined restores the
+// default of software AES where the CPU lacks AES instructions. Returns
+// whether software AES is used now.
+// Arguments: enabled (boolean, optional)
+NAN_METHOD(async::ConfigureSoftwareAes) {
+	if (info.Length() > 0 && !info[0]->IsUndefined()) {
+		if (!info[0]->IsBoolean()) {
+			Nan::ThrowTypeError("The argument must be a boolean or undefined.");
+			return;
+		}
+		aead::SoftAead::Select(Nan::To<bool>(info[0]).FromJust() ? aead::SOFT_ALWAYS : aead::SOFT_NEVER);
+	} else {
+		aead::SoftAead::Select(aead::SOFT_AUTO);
+	}
+	info.GetReturnValue().Set(Nan::New<Boolean>(aead::SoftAead::Enabled()));
+}
+
+// Wipes the expanded keys the calling thread cached for the one-shot
+// functions (see aead::Aesni::CachedKey). Pool workers wipe theirs when idle.
+NAN_METHOD(async::ClearKeyCache) {
+	aead::Aesni::ClearCachedKeys();
+	aead::SoftAead::ClearCachedKeys();
+}
+
+// Returns the names of the backends compiled in, for the backend key option.
+// Whether one supports a key on this machine is checked when it is set.
+NAN_METHOD(async::GetBackends) {
+	Local<Array> result = Nan::New<Array>((int)aead::Backend::Count());
+	for (size_t i = 0; i < aead::Backend::Count(); i++) {
+		Nan::Set(result, (uint32_t)i, Nan::New<String>(aead::Backend::At(i).name()).ToLocalChecked());
+	}
+	info.GetReturnValue().Set(result);
+}
+
+static void SetBoolean(Local<Object> obj, const char *name, bool value) {
+	Nan::Set(obj, Nan::New<String>(name).ToLocalChecked(), Nan::New<Boolean>(value));
+}
+
+// Reports the detected CPU features, the OpenSSL the addon runs on and the
+// implementation the one-shot functions use per mode and key size, for
+// short (up to 64 bytes) and longer messages
+NAN_METHOD(async::GetCapabilities) {
+	const aead::CpuFeatures &features = aead::CpuFeatures::Get();
+	Local<Object> cpu = Nan::New<Object>();
+	SetBoolean(cpu, "aesni", features.aesni);
+	SetBoolean(cpu, "pclmulqdq", features.pclmulqdq);
+	SetBoolean(cpu, "ssse3", features.ssse3);
+	SetBoolean(cpu, "sse41", features.sse41);
+	SetBoolean(cpu, "avx", features.avx);
+	SetBoolean(cpu, "avx2", features.avx2);
+	SetBoolean(cpu, "vaes", features.vaes);
+	SetBoolean(cpu, "vpclmulqdq", features.vpclmulqdq);
+	SetBoolean(cpu, "avx512f", features.avx512f);
+	SetBoolean(cpu, "aesMissing", features.aes_missing);
+
+	Local<Object> openssl = Nan::New<Object>();
+	Nan::Set(openssl, Nan::New<String>("version").ToLocalChecked(),
+		Nan::New<String>(aead::Capabilities::OpenSslVersion()).ToLocalChecked());
+	Nan::Set(openssl, Nan::New<String>("versionNumber").ToLocalChecked(),
+		Nan::New<Number>((double)aead::Capabilities::OpenSslVersionNumber()));
+	const char *provider = aead::Capabilities::OpenSslProvider();
+	if (provider != NULL) {
+		Nan::Set(openssl, Nan::New<String>("provider").ToLocalChecked(), Nan::New<String>(provider).ToLocalChecked());
+	} else {
+		Nan::Set(openssl, Nan::New<String>("provider").ToLocalChecked(), Nan::Null());
+	}
+	Nan::Set(openssl, Nan::New<String>("aes").ToLocalChecked(),
+		Nan::New<String>(aead::Capabilities::OpenSslAes()).ToLocalChecked());
+
+	// one entry per Tuning bucket, as the kernels are tuned per bucket
+	Local<Object> implementations = Nan::New<Object>();
+	const aead::Mode modes[] = { aead::MODE_GCM, aead::MODE_CCM };
+	const char *mode_names[] = { "gcm", "ccm" };
+	for (int i = 0; i < 2; i++) {
+		Local<Array> list = Nan::New<Array>(aead::Tuning::BUCKETS);
+		for (int b = 0; b < aead::Tuning::BUCKETS; b++) {
+			const size_t limit = aead::Tuning::BucketLimit(b);
+			Local<Object> bucket = Nan::New<Object>();
+			if (b < aead::Tuning::BUCKETS - 1) {
+				Nan::Set(bucket, Nan::New<String>("maxLength").ToLocalChecked(), Nan::New<Number>((double)limit));
+			} else {
+				Nan::Set(bucket, Nan::New<String>("maxLength").ToLocalChecked(), Nan::Null());
+			}
+			Nan::Set(bucket, Nan::New<String>("implementation").ToLocalChecked(),
+				Nan::New<String>(aead::Capabilities::Implementation(modes[i], limit)).ToLocalChecked());
+			const size_t parallel_from = aead::Capabilities::ParallelFrom(modes[i], b);
+			if (parallel_from != 0) {
+				Local<Object> parallel = Nan::New<Object>();
+				Nan::Set(parallel, Nan::New<String>("minLength").ToLocalChecked(), Nan::New<Number>((double)parallel_from));
+				Nan::Set(parallel, Nan::New<String>("implementation").ToLocalChecked(),
+					Nan::New<String>(aead::Capabilities::ParallelImplementation()).ToLocalChecked());
+				Nan::Set(bucket, Nan::New<String>("parallel").ToLocalChecked(), parallel);
+			} else {
+				Nan::Set(bucket, Nan::New<String>("parallel").ToLocalChecked(), Nan::Null());
+			}
+			Nan::Set(list, (uint32_t)b, bucket);
+		}
+		Nan::Set(implementations, Nan::New<String>(mode_names[i]).ToLocalChecked(), list);
+	}
+
+	Local<Object> result = Nan::New<Object>();
+	Nan::Set(result, Nan::New<String>("cpu").ToLocalChecked(), cpu);
+	Nan::Set(result, Nan::New<String>("openssl").ToLocalChecked(), openssl);
+	SetBoolean(result, "softwareAes", aead::SoftAead::Enabled());
+	Nan::Set(result, Nan::New<String>("implementations").ToLocalChecked(), implementations);
+	info.GetReturnValue().Set(result);
+}
+
+static const char *kernel_names[] = { "auto", "builtin", "openssl" };
+
+// Reads the per-bucket kernel names of one mode into kernels, if given.
+// Returns false after throwing if they are invalid.
+static bool ReadKernels(Local<Object> obj, const char *mode, aead::Kernel kernels[aead::Tuning::BUCKETS], bool *given) {
+	Local<Value> value = Nan::Get(obj, Nan::New<String>(mode).ToLocalChecked()).ToLocalChecked();
+	*given = !value->IsUndefined();
+	if (!*given) return true;
+	if (!value->IsArray() || value.As<Array>()->Length() != (uint32_t)aead::Tuning::BUCKETS) {
+		Nan::ThrowTypeError("The kernels of a mode must be an array with one entry per size bucket.");
+		return false;
+	}
+	for (int b = 0; b < aead::Tuning::BUCKETS; b++) {
+		Nan::Utf8String name(Nan::Get(value.As<Array>(), (uint32_t)b).ToLocalChecked());
+		int k = 0;
+		while (k < 3 && (*name == NULL || strcmp(*name, kernel_names[k]) != 0)) k++;
+		if (k == 3) {
+			Nan::ThrowError("Kernels must be \"auto\", \"builtin\" or \"openssl\".");
+			return false;
+		}
+		kernels[b] = (aead::Kernel)k;
+	}
+	return true;
+}
+
+// Reads a non-negative number of the given object, which is left as is if not given
+static bool ReadEstimate(Local<Object> obj, const char *name, double *estimate) {
+	Local<Value> value = Nan::Get(obj, Nan::New<String>(name).ToLocalChecked()).ToLocalChecked();
+	if (value->IsUndefined()) return true;
+	if (!value->IsNumber() || !(Nan::To<double>(value).FromJust() >= 0)) {
+		Nan::ThrowError("Dispatch estimates must be non-negative numbers.");
+		return false;
+	}
+	*estimate = Nan::To<double>(value).FromJust();
+	return true;
+}
+
+// Applies the settings of a tuning profile; nothing is changed if any is
+// invalid. Returns the current settings:
+// { buckets, kernels: { gcm, ccm }, parallelThreshold, parallelChunkSize },
+// where buckets holds the largest message of each size bucket (null for
+// the last) and kernels one of "auto", "builtin" or "openssl" per bucket.
+// Arguments: { kernels, parallelThreshold, parallelChunkSize,
+//   estimates: { dispatchNs, gcm: { fixedNs, perByteNs }, ccm } } (optional)
+NAN_METHOD(async::ConfigureTuning) {
+	const aead::Mode modes[] = { aead::MODE_GCM, aead::MODE_CCM };
+	const char *mode_names[] = { "gcm", "ccm" };
+
+	if (info.Length() > 0 && !info[0]->IsUndefined()) {
+		if (!info[0]->IsObject()) {
+			Nan::ThrowTypeError("The tuning options must be an object.");
+			return;
+		}
+		Local<Object> obj = info[0].As<Object>();
+
+		aead::Kernel kernels[2][aead::Tuning::BUCKETS];
+		bool kernels_given[2] = { false, false };
+		Local<Value> kernels_val = Nan::Get(obj, Nan::New<String>("kernels").ToLocalChecked()).ToLocalChecked();
+		if (!kernels_val->IsUndefined()) {
+			if (!kernels_val->IsObject()) {
+				Nan::ThrowTypeError("The kernels option must be an object.");
+				return;
+			}
+			for (int i = 0; i < 2; i++) {
+				if (!ReadKernels(kernels_val.As<Object>(), mode_names[i], kernels[i], &kernels_given[i])) return;
+			}
+		}
+
+		size_t threshold = aead::ChunkedWork::threshold();
+		Local<Value> threshold_val = Nan::Get(obj, Nan::New<String>("parallelThreshold").ToLocalChecked()).ToLocalChecked();
+		if (!threshold_val->IsUndefined()) {
+			if (!threshold_val->IsNumber() || !(Nan::To<double>(threshold_val).FromJust() >= 0)) {
+				Nan::ThrowError("The parallel threshold must be a non-negative number of bytes.");
+				return;
+			}
+			const double bytes = Nan::To<double>(threshold_val).FromJust();
+			threshold = bytes >= (double)SIZE_MAX ? SIZE_MAX : (size_t)bytes;
+		}
+
+		size_t chunk_size = aead::ChunkedWork::min_chunk_size();
+		Local<Value> chunk_val = Nan::Get(obj, Nan::New<String>("parallelChunkSize").ToLocalChecked()).ToLocalChecked();
+		if (!chunk_val->IsUndefined()) {
+			if (!chunk_val->IsUint32() || Nan::To<uint32_t>(chunk_val).FromJust() < aead::ChunkedWork::MIN_CHUNK_SIZE) {
+				Nan::ThrowError("The parallel chunk size must be an integer of at least 16384.");
+				return;
+			}
+			chunk_size = Nan::To<uint32_t>(chunk_val).FromJust();
+		}
+
+		aead::DispatchEstimator &estimator = aead::DispatchEstimator::Get();
+		double dispatch_ns = estimator.dispatch_ns();
+		double fixed_ns[2], per_byte_ns[2];
+		for (int i = 0; i < 2; i++) {
+			fixed_ns[i] = estimator.fixed_ns(modes[i]);
+			per_byte_ns[i] = estimator.per_byte_ns(modes[i]);
+		}
+		Local<Value> estimates_val = Nan::Get(obj, Nan::New<String>("estimates").ToLocalChecked()).ToLocalChecked();
+		if (!estimates_val->IsUndefined()) {
+			if (!estimates_val->IsObject()) {
+				Nan::ThrowTypeError("The estimates option must be an object.");
+				return;
+			}
+			Local<Object> estimates = estimates_val.As<Object>();
+			if (!ReadEstimate(estimates, "dispatchNs", &dispatch_ns)) return;
+			for (int i = 0; i < 2; i++) {
+				Local<Value> mode = Nan::Get(estimates, Nan::New<String>(mode_names[i]).ToLocalChecked()).ToLocalChecked();
+				if (mode->IsUndefined()) continue;
+				if (!mode->IsObject()) {
+					Nan::ThrowTypeError("The estimates of a mode must be an object.");
+					return;
+				}
+				if (!ReadEstimate(mode.As<Object>(), "fixedNs", &fixed_ns[i]) ||
+					!ReadEstimate(mode.As<Object>(), "perByteNs", &per_byte_ns[i])
+				) {
+					return;
+				}
+			}
+		}
+
+		for (int i = 0; i < 2; i++) {
+			if (!kernels_given[i]) continue;
+			for (int b = 0; b < aead::Tuning::BUCKETS; b++) aead::Tuning::Set(modes[i], b, kernels[i][b]);
+		}
+		aead::ChunkedWork::Configure(threshold);
+		aead::ChunkedWork::ConfigureChunkSize(chunk_size);
+		estimator.SeedDispatch(dispatch_ns);
+		for (int i = 0; i < 2; i++) estimator.Seed(modes[i], fixed_ns[i], per_byte_ns[i]);
+	}
+
+	Local<Array> buckets = Nan::New<Array>(aead::Tuning::BUCKETS);
+	for (int b = 0; b < aead::Tuning::BUCKETS; b++) {
+		if (b < aead::Tuning::BUCKETS - 1) {
+			Nan::Set(buckets, (uint32_t)b, Nan::New<Number>((double)aead::Tuning::BucketLimit(b)));
+		} else {
+			Nan::Set(buckets, (uint32_t)b, Nan::Null());
+		}
+	}
+	Local<Object> kernels = Nan::New<Object>();
+	for (int i = 0; i < 2; i++) {
+		Local<Array> list = Nan::New<Array>(aead::Tuning::BUCKETS);
+		for (int b = 0; b < aead::Tuning::BUCKETS; b++) {
+			Nan::Set(list, (uint32_t)b,
+				Nan::New<String>(kernel_names[aead::Tuning::GetBucket(modes[i], b)]).ToLocalChecked());
+		}
+		Nan::Set(kernels, Nan::New<String>(mode_names[i]).ToLocalChecked(), list);
+	}
+	Local<Object> result = Nan::New<Object>();
+	Nan::Set(result, Nan::New<String>("buckets").ToLocalChecked(), buckets);
+	Nan::Set(result, Nan::New<String>("kernels").ToLocalChecked(), kernels);
+	Nan::Set(result, Nan::New<String>("parallelThreshold").ToLocalChecked(),
+		Nan::New<Number>((double)aead::ChunkedWork::threshold()));
+	Nan::Set(result, Nan::New<String>("parallelChunkSize").ToLocalChecked(),
+		Nan::New<Number>((double)aead::ChunkedWork::min_chunk_size()));
+	info.GetReturnValue().Set(result);
+}
@@ -0,0 +1,205 @@
+#ifndef NODE_AEAD_ASYNC_H_
+#define NODE_AEAD_ASYNC_H_
+
+#include <nan.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "aead-dispatch.h"
+#include "aead-key.h"
+#include "aead-pool.h"
+#include "aead-scheduler.h"
+
+namespace async {
+
+    class CompletionPort;
+
+    // Base for jobs started from JS and run on the crypto thread pool.
+    // The callback is called on the submitting thread as callback(error, result).
+    class AsyncJob : public aead::Job {
+    public:
+        explicit AsyncJob(v8::Local<v8::Function> callback);
+        virtual ~AsyncJob();
+
+        // Keeps a JS value (usually an input buffer) alive until the job completes
+        void Retain(v8::Local<v8::Value> value);
+        // Returns the contents of an input buffer (NULL and 0 for anything
+        // else), valid until the job is destroyed. Retaining the buffer is
+        // not enough: its ArrayBuffer may be transferred or detached while
+        // the job is queued. On V8 8+ the backing store is pinned; older
+        // versions can't, so there the contents are copied.
+        const unsigned char *Pin(v8::Local<v8::Value> buf, size_t *len);
+
+        void Done();
+        void Expire();
+        // Calls the callback; runs on the submitting thread
+        void Complete();
+
+    protected:
+        // Builds the result passed to the callback; runs on the submitting thread
+        virtual v8::Local<v8::Value> Result() = 0;
+        // Fails the job; call from Run()
+        void SetError(const char *message) { error_ = message; }
+        // Reports how long the job took to process, so the time it spent
+        // in the pool can be fed to the DispatchEstimator
+        void SetRunTime(uint64_t ns) { run_ns_ = ns; timed_ = true; }
+
+    private:
+        friend bool Submit(AsyncJob *job, const aead::ScheduleOptions &options);
+
+        Nan::Callback callback_;
+        Nan::AsyncResource async_resource_;
+        Nan::Persistent<v8::Array> retained_;
+        uint32_t retained_count_;
+#if V8_MAJOR_VERSION >= 8
+        std::vector<std::shared_ptr<v8::BackingStore> > pinned_;
+#else
+        // copies of the inputs, with their lengths
+        std::vector<std::pair<unsigned char *, size_t> > copies_;
+#endif
+        const char *error_;
+        CompletionPort *port_;
+        uint64_t created_;
+        uint64_t run_ns_;
+        bool timed_;
+    };
+
+    // Reads the { tenant, timeout } scheduling options passed before the
+    // callback. Returns false after throwing if they are invalid.
+    bool GetScheduleOptions(v8::Local<v8::Value> value, aead::ScheduleOptions *options);
+
+    // Queues a job on the crypto thread pool. Returns false after throwing
+    // (and deleting the job) if the pool is overloaded.
+    bool Submit(AsyncJob *job, const aead::ScheduleOptions &options);
+
+    // Encrypts with a key context; the result is { ciphertext, auth_tag }.
+    // The input buffers are retained and pinned (see AsyncJob::Pin).
+    class EncryptJob : public AsyncJob {
+    public:
+        EncryptJob(v8::Local<v8::Function> callback,
+            const std::shared_ptr<aead::KeyContext> &key,
+            v8::Local<v8::Value> iv, v8::Local<v8::Value> plaintext, v8::Local<v8::Value> aad,
+            size_t auth_tag_len);
+        ~EncryptJob();
+
+        void Run(aead::WorkerContext &worker);
+        size_t Cost() const { return plaintext_len_ - offset_; }
+        bool RunSlice(aead::WorkerContext &worker, size_t budget);
+
+    protected:
+        v8::Local<v8::Value> Result();
+
+    private:
+        std::shared_ptr<aead::KeyContext> key_;
+        const unsigned char *iv_, *plaintext_, *aad_;
+        size_t iv_len_, plaintext_len_, aad_len_;
+        char *ciphertext_, *auth_tag_;
+        size_t auth_tag_len_;
+        // GCM messages longer than a slice are processed incrementally in
+        // their own context, as slices may run on different workers
+        EVP_CIPHER_CTX *stream_;
+        size_t offset_;
+    };
+
+    // Decrypts with a key context; the result is { plaintext, auth_ok }.
+    class DecryptJob : public AsyncJob {
+    public:
+        DecryptJob(v8::Local<v8::Function> callback,
+            const std::shared_ptr<aead::KeyContext> &key,
+            v8::Local<v8::Value> iv, v8::Local<v8::Value> ciphertext, v8::Local<v8::Value> aad,
+            v8::Local<v8::Value> auth_tag);
+        ~DecryptJob();
+
+        void Run(aead::WorkerContext &worker);
+        size_t Cost() const { return ciphertext_len_ - offset_; }
+        bool RunSlice(aead::WorkerContext &worker, size_t budget);
+
+    protected:
+        v8::Local<v8::Value> Result();
+
+    private:
+        std::shared_ptr<aead::KeyContext> key_;
+        const unsigned char *iv_, *ciphertext_, *aad_, *auth_tag_;
+        size_t iv_len_, ciphertext_len_, aad_len_, auth_tag_len_;
+        char *plaintext_;
+        bool auth_ok_;
+        EVP_CIPHER_CTX *stream_;
+        size_t offset_;
+    };
+
+    // One operation of a batch, read from an array
+    // [encrypt (boolean), iv, data, auth_data, auth tag | auth tag length]
+    struct BatchOp {
+        bool encrypt;
+        v8::Local<v8::Value> iv, data, aad;
+        // the tag to check when decrypting, the optional tag length when encrypting
+        v8::Local<v8::Value> auth_tag;
+    };
+
+    // Returns false if the value is not a well-formed operation
+    bool ReadBatchOp(v8::Local<v8::Value> value, BatchOp *op);
+
+    // Runs a batch of operations with one key as a single job, so the
+    // submission and completion costs are paid once per batch. The result
+    // is an array with one entry per operation: { ciphertext, auth_tag },
+    // { plaintext, auth_ok } or an Error. The whole operations array is
+    // retained instead of the individual buffers, which are only pinned.
+    class BatchJob : public AsyncJob {
+    public:
+        BatchJob(v8::Local<v8::Function> callback,
+            const std::shared_ptr<aead::KeyContext> &key, v8::Local<v8::Array> ops);
+        ~BatchJob();
+
+        // Operations are added in the order of the results
+        void AddEncrypt(v8::Local<v8::Value> iv, v8::Local<v8::Value> plaintext, v8::Local<v8::Value> aad,
+            size_t auth_tag_len);
+        void AddDecrypt(v8::Local<v8::Value> iv, v8::Local<v8::Value> ciphertext, v8::Local<v8::Value> aad,
+            v8::Local<v8::Value> auth_tag);
+        // An operation that failed validation and is answered with an Error
+        void AddError(const char *message);
+
+        void Run(aead::WorkerContext &worker);
+        size_t Cost() const { return remaining_; }
+        // Slices end between operations
+        bool RunSlice(aead::WorkerContext &worker, size_t budget);
+
+    protected:
+        v8::Local<v8::Value> Result();
+
+    private:
+        struct Op {
+            bool encrypt;
+            const unsigned char *iv, *input, *aad, *auth_tag_in;
+            size_t iv_len, input_len, aad_len, auth_tag_len;
+            char *output, *auth_tag_out;
+            bool auth_ok;
+            const char *error;
+        };
+        // Runs ops_[begin, end) as one KeyContext::RunBatch, so short
+        // messages can go through the multi-buffer kernels together
+        void RunOps(size_t begin, size_t end, EVP_CIPHER_CTX *scratch);
+
+        std::shared_ptr<aead::KeyContext> key_;
+        std::vector<Op> ops_;
+        size_t next_;
+        size_t remaining_;
+    };
+
+    // Decides whether an operation is processed inline or on the pool, and
+    // records how long inline operations took
+    bool ShouldInline(aead::Mode mode, size_t bytes);
+    void RecordInline(aead::Mode mode, size_t bytes, uint64_t ns);
+
+    NAN_METHOD(ConfigurePool);
+    NAN_METHOD(GetSchedulerStats);
+    NAN_METHOD(GetDispatchEstimates);
+    NAN_METHOD(ConfigureSoftwareAes);
+    NAN_METHOD(ClearKeyCache);
+    NAN_METHOD(GetBackends);
+    NAN_METHOD(GetCapabilities);
+    NAN_METHOD(ConfigureTuning);
+
+}
+
+#endif
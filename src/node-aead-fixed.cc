@@ -0,0 +1,157 @@
+#include <node.h>
+#include <nan.h>
+#include <string>
+
+#include "node-aead-fixed.h"
+#include "node-aes-gcm.h"
+#include "aead-fixed.h"
+
+using namespace v8;
+using namespace node;
+
+// The entry points take the same arguments as gcm.encrypt and
+// gcm.decrypt, minus what the configuration fixes: encrypt(key, iv,
+// plaintext, auth_data) and decrypt(key, iv, ciphertext, auth_data,
+// auth_tag). The key, IV and tag lengths must match it exactly.
+
+// Checks the key and IV, and the tag if one is given. Returns false after
+// throwing.
+template <class Cipher>
+static bool CheckLengths(Local<Value> key, Local<Value> iv, Local<Value> auth_tag) {
+	if (Buffer::Length(key) != Cipher::KEY_LEN) {
+		Nan::ThrowError("Invalid key length specified for this configuration.");
+		return false;
+	}
+	if (Buffer::Length(iv) != Cipher::IV_LEN) {
+		Nan::ThrowError("Invalid IV length specified for this configuration.");
+		return false;
+	}
+	if (!auth_tag.IsEmpty() && Buffer::Length(auth_tag) != Cipher::TAG_LEN) {
+		Nan::ThrowError("Invalid auth tag length specified for this configuration.");
+		return false;
+	}
+	return true;
+}
+
+// The GCM entry points share the nonce reuse detection of gcm.encrypt;
+// there is none for CCM. Return false after throwing.
+template <size_t KeyLen>
+static bool CheckNonce(const aead::FixedGcm<KeyLen> *, const unsigned char *key, const unsigned char *iv) {
+	return gcm::CheckNonceReuse(key, KeyLen, iv, aead::FixedGcm<KeyLen>::IV_LEN);
+}
+
+template <size_t KeyLen, size_t IvLen, size_t TagLen>
+static bool CheckNonce(const aead::FixedCcm<KeyLen, IvLen, TagLen> *, const unsigned char *, const unsigned char *) {
+	return true;
+}
+
+template <class Cipher>
+static void Encrypt(const Nan::FunctionCallbackInfo<Value> &info) {
+	Nan::HandleScope scope;
+
+	// check arguments
+	if (info.Length() < 4 ||
+		!Buffer::HasInstance(info[0]) || // key
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // plaintext
+		!(info[3]->IsUndefined() || info[3]->IsNull() || Buffer::HasInstance(info[3])) // auth_data, optional
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key (Buffer), iv (Buffer), plaintext (Buffer), auth_data (Buffer | NULL)."
+		);
+		return;
+	}
+	if (!CheckLengths<Cipher>(info[0], info[1], Local<Value>())) return;
+	if (!CheckNonce((const Cipher *)NULL,
+		(const unsigned char *)Buffer::Data(info[0]), (const unsigned char *)Buffer::Data(info[1])
+	)) return;
+
+	const unsigned char *plaintext = (const unsigned char *)Buffer::Data(info[2]);
+	const size_t plaintext_len = Buffer::Length(info[2]);
+	const bool hasAuthData = Buffer::HasInstance(info[3]);
+	const unsigned char *aad = hasAuthData ? (const unsigned char *)Buffer::Data(info[3]) : NULL;
+	const size_t aad_len = hasAuthData ? Buffer::Length(info[3]) : 0;
+
+	// the results are written straight into the returned buffers
+	Local<Object> ciphertext_buf = Nan::NewBuffer((uint32_t)plaintext_len).ToLocalChecked();
+	Local<Object> auth_tag_buf = Nan::NewBuffer((uint32_t)Cipher::TAG_LEN).ToLocalChecked();
+	if (!Cipher::Encrypt(
+		(const unsigned char *)Buffer::Data(info[0]), (const unsigned char *)Buffer::Data(info[1]),
+		aad, aad_len, plaintext, plaintext_len,
+		(unsigned char *)Buffer::Data(ciphertext_buf), (unsigned char *)Buffer::Data(auth_tag_buf)
+	)) {
+		Nan::ThrowError(plaintext_len > Cipher::MAX_LENGTH
+			? "The plaintext is too long for the nonce length." : "Encryption failed.");
+		return;
+	}
+
+	Local<Object> return_obj = Nan::New<Object>();
+	Nan::Set(return_obj, Nan::New<String>("ciphertext").ToLocalChecked(), ciphertext_buf);
+	Nan::Set(return_obj, Nan::New<String>("auth_tag").ToLocalChecked(), auth_tag_buf);
+	info.GetReturnValue().Set(return_obj);
+}
+
+template <class Cipher>
+static void Decrypt(const Nan::FunctionCallbackInfo<Value> &info) {
+	Nan::HandleScope scope;
+
+	// check arguments
+	if (info.Length() < 5 ||
+		!Buffer::HasInstance(info[0]) || // key
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // ciphertext
+		!(info[3]->IsUndefined() || info[3]->IsNull() || Buffer::HasInstance(info[3])) || // auth_data, optional
+		!Buffer::HasInstance(info[4]) // auth tag
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key (Buffer), iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer)."
+		);
+		return;
+	}
+	if (!CheckLengths<Cipher>(info[0], info[1], info[4])) return;
+
+	const unsigned char *ciphertext = (const unsigned char *)Buffer::Data(info[2]);
+	const size_t ciphertext_len = Buffer::Length(info[2]);
+	const bool hasAuthData = Buffer::HasInstance(info[3]);
+	const unsigned char *aad = hasAuthData ? (const unsigned char *)Buffer::Data(info[3]) : NULL;
+	const size_t aad_len = hasAuthData ? Buffer::Length(info[3]) : 0;
+
+	Local<Object> plaintext_buf = Nan::NewBuffer((uint32_t)ciphertext_len).ToLocalChecked();
+	bool auth_ok = false;
+	if (!Cipher::Decrypt(
+		(const unsigned char *)Buffer::Data(info[0]), (const unsigned char *)Buffer::Data(info[1]),
+		aad, aad_len, ciphertext, ciphertext_len,
+		(unsigned char *)Buffer::Data(plaintext_buf), (const unsigned char *)Buffer::Data(info[4]), &auth_ok
+	)) {
+		Nan::ThrowError(ciphertext_len > Cipher::MAX_LENGTH
+			? "The ciphertext is too long for the nonce length." : "Decryption failed.");
+		return;
+	}
+
+	Local<Object> return_obj = Nan::New<Object>();
+	Nan::Set(return_obj, Nan::New<String>("plaintext").ToLocalChecked(), plaintext_buf);
+	Nan::Set(return_obj, Nan::New<String>("auth_ok").ToLocalChecked(), Nan::New<Boolean>(auth_ok));
+	info.GetReturnValue().Set(return_obj);
+}
+
+template <class Cipher>
+static void Register(Local<Object> target, const char *mode, const char *name) {
+	Nan::Set(target,
+		Nan::New<String>(std::string(mode) + "Encrypt" + name).ToLocalChecked(),
+		Nan::GetFunction(Nan::New<FunctionTemplate>(Encrypt<Cipher>)).ToLocalChecked()
+	);
+	Nan::Set(target,
+		Nan::New<String>(std::string(mode) + "Decrypt" + name).ToLocalChecked(),
+		Nan::GetFunction(Nan::New<FunctionTemplate>(Decrypt<Cipher>)).ToLocalChecked()
+	);
+}
+
+NAN_MODULE_INIT(fixed::Init) {
+	Register<aead::FixedGcm<16> >(target, "Gcm", "Aes128_12_16");
+	Register<aead::FixedGcm<32> >(target, "Gcm", "Aes256_12_16");
+	Register<aead::FixedCcm<16, 13, 8> >(target, "Ccm", "Aes128_13_8");
+	Register<aead::FixedCcm<16, 12, 16> >(target, "Ccm", "Aes128_12_16");
+	Register<aead::FixedCcm<16, 12, 8> >(target, "Ccm", "Aes128_12_8");
+}
@@ -0,0 +1,14 @@
+#ifndef NODE_AEAD_FIXED_H_
+#define NODE_AEAD_FIXED_H_
+
+#include <nan.h>
+
+namespace fixed {
+
+    // Registers the dedicated entry points of the aead::FixedGcm and
+    // aead::FixedCcm configurations, as GcmEncryptAes128_12_16 etc.
+    NAN_MODULE_INIT(Init);
+
+}
+
+#endif
@@ -0,0 +1,1225 @@
+#include <node.h>
+#include <nan.h>
+#include <math.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <openssl/evp.h>
+
+#include "node-aead-keyring.h"
+#include "node-aead-async.h"
+#include "aead-ccm-format.h"
+
+using namespace v8;
+using namespace node;
+using namespace keyring;
+
+// Checks whether the argument is a Buffer or null/undefined
+static bool IsOptionalBuffer(Local<Value> arg) {
+	return arg->IsUndefined() || arg->IsNull() || Buffer::HasInstance(arg);
+}
+
+// Decrypts a single frame with the given key and stores a { plaintext, auth_ok }
+// object in result, and auth_ok in authenticated if given.
+// Returns false if the IV or tag length is invalid for the key.
+static bool DecryptFrame(EVP_CIPHER_CTX *scratch, const aead::KeyContext &key,
+	const unsigned char *iv, size_t iv_len,
+	const unsigned char *ciphertext, size_t ciphertext_len,
+	Local<Value> aad,
+	const unsigned char *auth_tag, size_t auth_tag_len,
+	Local<Object> *result,
+	bool *authenticated = NULL
+) {
+	Local<Object> plaintext_buf = Nan::NewBuffer((uint32_t)ciphertext_len).ToLocalChecked();
+	const bool hasAuthData = Buffer::HasInstance(aad);
+
+	bool auth_ok = false;
+	if (!key.Decrypt(scratch,
+		iv, iv_len,
+		hasAuthData ? (unsigned char *)Buffer::Data(aad) : NULL, hasAuthData ? Buffer::Length(aad) : 0,
+		ciphertext, ciphertext_len,
+		(unsigned char *)Buffer::Data(plaintext_buf),
+		auth_tag, auth_tag_len,
+		&auth_ok
+	)) {
+		return false;
+	}
+
+	*result = Nan::New<Object>();
+	Nan::Set(*result, Nan::New<String>("plaintext").ToLocalChecked(), plaintext_buf);
+	Nan::Set(*result, Nan::New<String>("auth_ok").ToLocalChecked(), Nan::New<Boolean>(auth_ok));
+	if (authenticated != NULL) *authenticated = auth_ok;
+	return true;
+}
+
+// The result for frames whose key is unknown or whose parameters don't fit the key
+static Local<Object> FailedFrame() {
+	Local<Object> result = Nan::New<Object>();
+	Nan::Set(result, Nan::New<String>("plaintext").ToLocalChecked(), Nan::Null());
+	Nan::Set(result, Nan::New<String>("auth_ok").ToLocalChecked(), Nan::False());
+	return result;
+}
+
+// The result for frames rejected by the replay window
+static Local<Object> ReplayedFrame() {
+	Local<Object> result = FailedFrame();
+	Nan::Set(result, Nan::New<String>("replayed").ToLocalChecked(), Nan::True());
+	return result;
+}
+
+// 64 bit counters are exchanged with JS as BigInts where available (V8 6.7+)
+// and as Numbers otherwise
+#if V8_MAJOR_VERSION > 6 || (V8_MAJOR_VERSION == 6 && V8_MINOR_VERSION >= 7)
+#define KEYRING_HAVE_BIGINT
+#endif
+
+static bool ToUint64(Local<Value> value, uint64_t *out) {
+#ifdef KEYRING_HAVE_BIGINT
+	if (value->IsBigInt()) {
+		bool lossless;
+		*out = value.As<BigInt>()->Uint64Value(&lossless);
+		return lossless;
+	}
+#endif
+	if (!value->IsNumber()) return false;
+	const double number = Nan::To<double>(value).FromJust();
+	// only integers which can be represented exactly
+	if (number < 0 || number > 9007199254740991.0 || floor(number) != number) return false;
+	*out = (uint64_t)number;
+	return true;
+}
+
+static Local<Value> FromUint64(uint64_t value) {
+#ifdef KEYRING_HAVE_BIGINT
+	return BigInt::NewFromUnsigned(Isolate::GetCurrent(), value);
+#else
+	return Nan::New<Number>((double)value);
+#endif
+}
+
+// Configures nonce generation for seal()
+static bool ApplyNonceOptions(aead::KeyContext *key, Local<Object> options) {
+	Local<Value> nonce = Nan::Get(options, Nan::New<String>("nonce").ToLocalChecked()).ToLocalChecked();
+	Local<Value> fixed = Nan::Get(options, Nan::New<String>("fixedField").ToLocalChecked()).ToLocalChecked();
+	Local<Value> counter = Nan::Get(options, Nan::New<String>("counter").ToLocalChecked()).ToLocalChecked();
+	Local<Value> nonce_len = Nan::Get(options, Nan::New<String>("nonceLength").ToLocalChecked()).ToLocalChecked();
+
+	bool random = false;
+	if (!nonce->IsUndefined()) {
+		Nan::Utf8String nonce_str(nonce);
+		if (*nonce_str != NULL && strcmp(*nonce_str, "random") == 0) {
+			random = true;
+		} else if (*nonce_str == NULL || strcmp(*nonce_str, "sequence") != 0) {
+			Nan::ThrowError("The nonce option must be \"sequence\" or \"random\".");
+			return false;
+		}
+	}
+
+	if (random) {
+		if (!fixed->IsUndefined() || !counter->IsUndefined()) {
+			Nan::ThrowError("Random nonces can't be combined with a fixed field or counter.");
+			return false;
+		}
+		// GCM: 96 bit IVs, CCM: 13 byte nonces (the largest, leaving 2^16 byte messages)
+		uint32_t len = key->mode() == aead::MODE_GCM ? 12 : 13;
+		if (!nonce_len->IsUndefined()) {
+			if (!nonce_len->IsUint32()) {
+				Nan::ThrowError("The nonce length must be an unsigned integer.");
+				return false;
+			}
+			len = Nan::To<uint32_t>(nonce_len).FromJust();
+		}
+		if (key->mode() == aead::MODE_GCM ? (len < 12 || len > 16) : (len < 7 || len > 13)) {
+			Nan::ThrowError(key->mode() == aead::MODE_GCM
+				? "Random GCM nonces must be 12 to 16 bytes long."
+				: "CCM nonces must be 7 to 13 bytes long."
+			);
+			return false;
+		}
+		key->set_nonce_generator(aead::NonceGenerator::Random(len));
+		return true;
+	}
+
+	if (!nonce_len->IsUndefined()) {
+		Nan::ThrowError("The nonce length can only be chosen for random nonces.");
+		return false;
+	}
+	if (!fixed->IsUndefined()) {
+		// GCM: 8 to 16 byte IVs, CCM: 8 to 13 byte nonces
+		const size_t max_fixed_len = key->mode() == aead::MODE_GCM ? 8 : 5;
+		if (!Buffer::HasInstance(fixed) || Buffer::Length(fixed) > max_fixed_len) {
+			Nan::ThrowError(key->mode() == aead::MODE_GCM
+				? "The fixed nonce field must be a Buffer of at most 8 bytes for GCM keys."
+				: "The fixed nonce field must be a Buffer of at most 5 bytes for CCM keys."
+			);
+			return false;
+		}
+		uint64_t start = 0;
+		if (!counter->IsUndefined() && (!ToUint64(counter, &start) || start == aead::NonceGenerator::EXHAUSTED)) {
+			Nan::ThrowError("The nonce counter must be an unsigned 64 bit integer below 2^64 - 1.");
+			return false;
+		}
+		key->set_nonce_generator(aead::NonceGenerator::Sequence(
+			(unsigned char *)Buffer::Data(fixed), Buffer::Length(fixed), start
+		));
+	} else if (!counter->IsUndefined()) {
+		Nan::ThrowError("A nonce counter requires a fixed nonce field.");
+		return false;
+	} else if (!nonce->IsUndefined()) {
+		Nan::ThrowError("A nonce sequence requires a fixed nonce field.");
+		return false;
+	}
+	return true;
+}
+
+// Number of recent nonces remembered by default, using 512 KiB per key
+static const uint32_t DEFAULT_REUSE_CAPACITY = 1 << 16;
+
+// Configures nonce reuse detection
+static bool ApplyReuseOptions(aead::KeyContext *key, Local<Object> options) {
+	Local<Value> reuse = Nan::Get(options, Nan::New<String>("reuseDetection").ToLocalChecked()).ToLocalChecked();
+	if (!reuse->IsUndefined() && !reuse->IsFalse()) {
+		// true or { capacity, reject }
+		uint32_t capacity = DEFAULT_REUSE_CAPACITY;
+		bool reject = false;
+		if (reuse->IsObject()) {
+			Local<Value> capacity_val = Nan::Get(reuse.As<Object>(), Nan::New<String>("capacity").ToLocalChecked()).ToLocalChecked();
+			Local<Value> reject_val = Nan::Get(reuse.As<Object>(), Nan::New<String>("reject").ToLocalChecked()).ToLocalChecked();
+			if (!capacity_val->IsUndefined()) {
+				if (!capacity_val->IsUint32() || Nan::To<uint32_t>(capacity_val).FromJust() == 0) {
+					Nan::ThrowError("The reuse detection capacity must be a positive integer.");
+					return false;
+				}
+				capacity = Nan::To<uint32_t>(capacity_val).FromJust();
+			}
+			reject = Nan::To<bool>(reject_val).FromJust();
+		} else if (!reuse->IsTrue()) {
+			Nan::ThrowTypeError("The reuseDetection option must be a boolean or an object.");
+			return false;
+		}
+		key->set_reuse_detector(new aead::NonceReuseDetector(capacity, reject));
+	}
+	return true;
+}
+
+// Reads one limit of the limits option, which is left as is if not given
+static bool GetLimit(Local<Object> limits, const char *name, uint64_t *limit) {
+	Local<Value> value = Nan::Get(limits, Nan::New<String>(name).ToLocalChecked()).ToLocalChecked();
+	if (value->IsUndefined()) return true;
+	if (!ToUint64(value, limit) || *limit == 0) {
+		Nan::ThrowError("Key usage limits must be positive 64 bit integers.");
+		return false;
+	}
+	return true;
+}
+
+// Configures the usage limits. Must be called after ApplyNonceOptions.
+static bool ApplyLimitOptions(aead::KeyContext *key, Local<Object> options) {
+	aead::KeyLimits limits;
+	// Random 96 bit GCM IVs may only be used for 2^32 messages per key
+	// (NIST SP 800-38D, section 8.3)
+	if (key->mode() == aead::MODE_GCM &&
+		key->nonce_generator() != NULL && key->nonce_generator()->is_random()
+	) {
+		limits.hard_messages = (uint64_t)1 << 32;
+	}
+
+	Local<Value> limits_val = Nan::Get(options, Nan::New<String>("limits").ToLocalChecked()).ToLocalChecked();
+	if (!limits_val->IsUndefined()) {
+		if (!limits_val->IsObject()) {
+			Nan::ThrowTypeError("The limits option must be an object.");
+			return false;
+		}
+		Local<Object> obj = limits_val.As<Object>();
+		if (!GetLimit(obj, "softMessages", &limits.soft_messages) ||
+			!GetLimit(obj, "hardMessages", &limits.hard_messages) ||
+			!GetLimit(obj, "softBytes", &limits.soft_bytes) ||
+			!GetLimit(obj, "hardBytes", &limits.hard_bytes)
+		) {
+			return false;
+		}
+	}
+	key->set_limits(limits);
+	return true;
+}
+
+// Selects the backend: "auto" (the default) or the name of one of those
+// returned by getBackends()
+static bool ApplyBackendOption(aead::KeyContext *key, Local<Object> options) {
+	Local<Value> backend_val = Nan::Get(options, Nan::New<String>("backend").ToLocalChecked()).ToLocalChecked();
+	if (backend_val->IsUndefined()) return true;
+	if (!backend_val->IsString()) {
+		Nan::ThrowTypeError("The backend option must be a string.");
+		return false;
+	}
+	Nan::Utf8String name(backend_val);
+	if (strcmp(*name, "auto") == 0) return true;
+	const aead::Backend *backend = aead::Backend::Find(*name);
+	if (backend == NULL) {
+		Nan::ThrowError("Unknown backend.");
+		return false;
+	}
+	if (!key->set_backend(backend)) {
+		Nan::ThrowError("The backend doesn't support this key on this machine.");
+		return false;
+	}
+	return true;
+}
+
+// Parses the options of Keyring.prototype.set() and configures the key.
+// Returns false after throwing if they are invalid.
+static bool ApplyKeyOptions(aead::KeyContext *key, Local<Value> options_val) {
+	if (options_val->IsUndefined() || options_val->IsNull()) return true;
+	if (!options_val->IsObject()) {
+		Nan::ThrowTypeError("The key options must be an object.");
+		return false;
+	}
+	Local<Object> options = options_val.As<Object>();
+	return ApplyNonceOptions(key, options) &&
+		ApplyReuseOptions(key, options) &&
+		ApplyLimitOptions(key, options) &&
+		ApplyBackendOption(key, options);
+}
+
+// Reads the optional auth tag length argument, which is required for CCM keys.
+// Returns false after throwing if it is missing or invalid.
+static bool GetAuthTagLength(const aead::KeyContext &key, Local<Value> arg, size_t *auth_tag_len) {
+	if (arg->IsUndefined()) {
+		if (key.mode() == aead::MODE_CCM) {
+			Nan::ThrowError("The auth tag length must be specified for CCM keys.");
+			return false;
+		}
+		*auth_tag_len = 16;
+		return true;
+	}
+	if (!arg->IsUint32()) {
+		Nan::ThrowTypeError("The auth tag length must be a positive integer.");
+		return false;
+	}
+	*auth_tag_len = Nan::To<uint32_t>(arg).FromJust();
+	return true;
+}
+
+// Whether the key can encrypt a message of len bytes with the given IV
+// and auth tag lengths. For CCM, the IV length caps the message length.
+static bool ValidEncryption(const aead::KeyContext &key, size_t iv_len, size_t auth_tag_len, size_t len) {
+	return aead::KeyContext::ValidParams(key.mode(), iv_len, auth_tag_len) &&
+		(key.mode() != aead::MODE_CCM || aead::CcmFormat::LengthFits(iv_len, len));
+}
+
+// Records the nonce with the key's reuse detector, if it has one.
+// Returns true if the nonce was seen before and the detector rejects
+// reused nonces.
+static bool NonceReused(const aead::KeyContext &key, const unsigned char *nonce, size_t nonce_len) {
+	aead::NonceReuseDetector *detector = key.reuse_detector();
+	return detector != NULL && detector->Record(nonce, nonce_len) && detector->reject();
+}
+
+// Like NonceReused, but returns false after throwing
+static bool CheckNonceReuse(const aead::KeyContext &key, const unsigned char *nonce, size_t nonce_len) {
+	if (NonceReused(key, nonce, nonce_len)) {
+		Nan::ThrowError("The nonce has been used with this key before.");
+		return false;
+	}
+	return true;
+}
+
+// Returns a { messages, bytes } object with the usage counters of a key
+static Local<Object> KeyUsage(const aead::KeyContext &key) {
+	Local<Object> usage = Nan::New<Object>();
+	Nan::Set(usage, Nan::New<String>("messages").ToLocalChecked(), FromUint64(key.messages()));
+	Nan::Set(usage, Nan::New<String>("bytes").ToLocalChecked(), FromUint64(key.bytes()));
+	return usage;
+}
+
+// Counts an encryption against the usage limits of the key.
+// Returns false after throwing if a hard limit has been reached.
+static bool UseKey(aead::KeyContext &key, size_t bytes, bool *rotate) {
+	const aead::UsageResult result = key.Use(bytes);
+	if (result == aead::USAGE_HARD_LIMIT) {
+		Nan::ThrowError("The usage limit of this key has been reached.");
+		return false;
+	}
+	*rotate = result == aead::USAGE_SOFT_LIMIT;
+	return true;
+}
+
+// Emits a "rotate" event with the key ID and its usage on the keyring,
+// which index.js turns into an EventEmitter. Outside of a call from JS,
+// the event is emitted in the scope of resource.
+static void EmitRotateEvent(Local<Object> keyring, uint32_t key_id, const aead::KeyContext &key,
+	Nan::AsyncResource *resource = NULL
+) {
+	Local<Value> emit = Nan::Get(keyring, Nan::New<String>("emit").ToLocalChecked()).ToLocalChecked();
+	if (!emit->IsFunction()) return;
+	Local<Value> argv[] = {
+		Nan::New<String>("rotate").ToLocalChecked(),
+		Nan::New<Number>(key_id),
+		KeyUsage(key)
+	};
+	if (resource != NULL) {
+		resource->runInAsyncScope(keyring, emit.As<Function>(), 3, argv);
+	} else {
+		Nan::Call(emit.As<Function>(), keyring, 3, argv);
+	}
+}
+
+void KeyringWrap::EmitRotate(Local<Object> keyring, uint32_t key_id, Nan::AsyncResource *resource) {
+	KeyringWrap *self = FromValue(keyring);
+	if (self == NULL) return;
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(key_id);
+	if (key) EmitRotateEvent(keyring, key_id, *key, resource);
+}
+
+// ==================
+
+// Keyrings are shared between threads through SharedArrayBuffers. The buffer
+// contents are only used to identify the keyring; the deleter of its backing
+// store holds a reference to the keyring, so the keyring lives until the last
+// thread has dropped both the buffer and its Keyring objects.
+// Backing stores with custom deleters are only available on V8 8+ (Node.js 14+).
+#if V8_MAJOR_VERSION >= 8
+#define KEYRING_CAN_SHARE
+#endif
+
+#ifdef KEYRING_CAN_SHARE
+struct SharedKeyring {
+	std::shared_ptr<aead::Keyring> keyring;
+};
+
+static std::mutex shared_mutex;
+static std::map<void *, SharedKeyring *> shared_keyrings;
+
+static void FreeSharedKeyring(void *data, size_t length, void *deleter_data) {
+	{
+		std::lock_guard<std::mutex> lock(shared_mutex);
+		shared_keyrings.erase(data);
+	}
+	delete (SharedKeyring *)deleter_data;
+	delete[] (unsigned char *)data;
+}
+#endif
+
+// Keyring objects are recognized like ReplayWindow objects below
+static const int KEYRING_TAG_FIELD = 1;
+static char keyring_tag;
+
+KeyringWrap::KeyringWrap(const std::shared_ptr<aead::Keyring> &keyring) : keyring_(keyring) {
+	scratch_ = EVP_CIPHER_CTX_new();
+}
+
+KeyringWrap::~KeyringWrap() {
+	EVP_CIPHER_CTX_free(scratch_);
+}
+
+NAN_MODULE_INIT(KeyringWrap::Init) {
+	Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+	tpl->SetClassName(Nan::New<String>("Keyring").ToLocalChecked());
+	tpl->InstanceTemplate()->SetInternalFieldCount(2);
+
+	Nan::SetPrototypeMethod(tpl, "share", Share);
+	Nan::SetPrototypeMethod(tpl, "set", Set);
+	Nan::SetPrototypeMethod(tpl, "delete", Delete);
+	Nan::SetPrototypeMethod(tpl, "has", Has);
+	Nan::SetPrototypeMethod(tpl, "encrypt", Encrypt);
+	Nan::SetPrototypeMethod(tpl, "decrypt", Decrypt);
+	Nan::SetPrototypeMethod(tpl, "decryptBatch", DecryptBatch);
+	Nan::SetPrototypeMethod(tpl, "encryptAsync", EncryptAsync);
+	Nan::SetPrototypeMethod(tpl, "decryptAsync", DecryptAsync);
+	Nan::SetPrototypeMethod(tpl, "batchAsync", BatchAsync);
+	Nan::SetPrototypeMethod(tpl, "seal", Seal);
+	Nan::SetPrototypeMethod(tpl, "open", Open);
+	Nan::SetPrototypeMethod(tpl, "getNonceCounter", GetNonceCounter);
+	Nan::SetPrototypeMethod(tpl, "getNonceReuseCount", GetNonceReuseCount);
+	Nan::SetPrototypeMethod(tpl, "usage", Usage);
+	Nan::SetAccessor(tpl->InstanceTemplate(), Nan::New<String>("size").ToLocalChecked(), GetSize);
+
+	Nan::Set(target,
+		Nan::New<String>("Keyring").ToLocalChecked(),
+		Nan::GetFunction(tpl).ToLocalChecked()
+	);
+}
+
+KeyringWrap *KeyringWrap::FromValue(Local<Value> value) {
+	if (!value->IsObject()) return NULL;
+	Local<Object> obj = value.As<Object>();
+	if (obj->InternalFieldCount() != 2 ||
+		obj->GetAlignedPointerFromInternalField(KEYRING_TAG_FIELD) != &keyring_tag
+	) {
+		return NULL;
+	}
+	return Nan::ObjectWrap::Unwrap<KeyringWrap>(obj);
+}
+
+// Creates a new keyring, or attaches to the keyring another thread has shared
+// if a SharedArrayBuffer returned by share() is passed.
+NAN_METHOD(KeyringWrap::New) {
+	if (!info.IsConstructCall()) {
+		Nan::ThrowTypeError("Keyring must be called with new.");
+		return;
+	}
+
+	std::shared_ptr<aead::Keyring> keyring;
+	if (info.Length() > 0 && info[0]->IsSharedArrayBuffer()) {
+#ifdef KEYRING_CAN_SHARE
+		void *data = info[0].As<SharedArrayBuffer>()->GetBackingStore()->Data();
+		std::lock_guard<std::mutex> lock(shared_mutex);
+		std::map<void *, SharedKeyring *>::iterator it = shared_keyrings.find(data);
+		if (it == shared_keyrings.end()) {
+			Nan::ThrowError("The SharedArrayBuffer was not created by Keyring.prototype.share().");
+			return;
+		}
+		keyring = it->second->keyring;
+#else
+		Nan::ThrowError("Sharing keyrings requires Node.js 14 or newer.");
+		return;
+#endif
+	} else if (info.Length() > 0 && !info[0]->IsUndefined()) {
+		Nan::ThrowTypeError("The argument must be a SharedArrayBuffer returned by Keyring.prototype.share().");
+		return;
+	} else {
+		keyring.reset(new aead::Keyring());
+	}
+
+	KeyringWrap *obj = new KeyringWrap(keyring);
+	obj->Wrap(info.This());
+	info.This()->SetAlignedPointerInInternalField(KEYRING_TAG_FIELD, &keyring_tag);
+	info.GetReturnValue().Set(info.This());
+}
+
+// Returns a SharedArrayBuffer that can be posted to worker threads, which
+// pass it to the Keyring constructor to use the same keys.
+NAN_METHOD(KeyringWrap::Share) {
+#ifdef KEYRING_CAN_SHARE
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+
+	const size_t handle_len = 8;
+	unsigned char *data = new unsigned char[handle_len]();
+	SharedKeyring *shared = new SharedKeyring();
+	shared->keyring = self->keyring_;
+	{
+		std::lock_guard<std::mutex> lock(shared_mutex);
+		shared_keyrings[data] = shared;
+	}
+
+	std::unique_ptr<BackingStore> store = SharedArrayBuffer::NewBackingStore(
+		data, handle_len, FreeSharedKeyring, shared
+	);
+	info.GetReturnValue().Set(SharedArrayBuffer::New(info.GetIsolate(), std::move(store)));
+#else
+	Nan::ThrowError("Sharing keyrings requires Node.js 14 or newer.");
+#endif
+}
+
+// Adds a key or replaces the key with the same ID.
+// Arguments: key ID (uint32), mode ("gcm" | "ccm"), key (Buffer), options (Object, optional)
+NAN_METHOD(KeyringWrap::Set) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+
+	// check arguments
+	if (info.Length() < 3 ||
+		!info[0]->IsUint32() || // key ID
+		!info[1]->IsString() || // mode
+		!Buffer::HasInstance(info[2]) // key
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key ID (uint32), mode (\"gcm\" | \"ccm\"), key (Buffer)."
+		);
+		return;
+	}
+
+	aead::Mode mode;
+	Nan::Utf8String mode_str(info[1]);
+	if (strcmp(*mode_str, "gcm") == 0) {
+		mode = aead::MODE_GCM;
+	} else if (strcmp(*mode_str, "ccm") == 0) {
+		mode = aead::MODE_CCM;
+	} else {
+		Nan::ThrowError("Invalid mode specified. Allowed are \"gcm\" and \"ccm\".");
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = aead::KeyContext::Create(mode,
+		(unsigned char *)Buffer::Data(info[2]), Buffer::Length(info[2]));
+	if (!key) {
+		Nan::ThrowError("Invalid key length specified. Allowed are 128, 192 and 256 bits.");
+		return;
+	}
+	if (!ApplyKeyOptions(key.get(), info[3])) return;
+
+	self->keyring_->Set(Nan::To<uint32_t>(info[0]).FromJust(), key);
+}
+
+NAN_METHOD(KeyringWrap::Delete) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+	if (info.Length() < 1 || !info[0]->IsUint32()) {
+		Nan::ThrowError("Not enough (or wrong) arguments specified. Required: key ID (uint32).");
+		return;
+	}
+	info.GetReturnValue().Set(self->keyring_->Delete(Nan::To<uint32_t>(info[0]).FromJust()));
+}
+
+NAN_METHOD(KeyringWrap::Has) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+	if (info.Length() < 1 || !info[0]->IsUint32()) {
+		Nan::ThrowError("Not enough (or wrong) arguments specified. Required: key ID (uint32).");
+		return;
+	}
+	info.GetReturnValue().Set((bool)self->keyring_->Get(Nan::To<uint32_t>(info[0]).FromJust()));
+}
+
+NAN_GETTER(KeyringWrap::GetSize) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+	info.GetReturnValue().Set((double)self->keyring_->Size());
+}
+
+// Encrypts using the key with the given ID and returns an object containing
+// "ciphertext" and "auth_tag" buffers. The auth tag length defaults to
+// 16 bytes and must be given for CCM keys.
+NAN_METHOD(KeyringWrap::Encrypt) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+
+	// check arguments
+	if (info.Length() < 4 ||
+		!info[0]->IsUint32() || // key ID
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // plaintext
+		!IsOptionalBuffer(info[3]) || // auth_data, optional
+		!(info[4]->IsUndefined() || info[4]->IsUint32()) // auth tag length, optional
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key ID (uint32), iv (Buffer), plaintext (Buffer), auth_data (Buffer | NULL), auth tag length (int, optional)."
+		);
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(Nan::To<uint32_t>(info[0]).FromJust());
+	if (!key) {
+		Nan::ThrowError("There is no key with the given ID.");
+		return;
+	}
+	size_t auth_tag_len;
+	if (!GetAuthTagLength(*key, info[4], &auth_tag_len)) return;
+	const size_t plaintext_len = Buffer::Length(info[2]);
+	// only encryptions that can succeed record their nonce
+	if (!ValidEncryption(*key, Buffer::Length(info[1]), auth_tag_len, plaintext_len)) {
+		Nan::ThrowError("Invalid IV or auth tag length for this key.");
+		return;
+	}
+	if (!CheckNonceReuse(*key, (unsigned char *)Buffer::Data(info[1]), Buffer::Length(info[1]))) return;
+
+	const bool hasAuthData = Buffer::HasInstance(info[3]);
+	bool rotate;
+	if (!UseKey(*key, plaintext_len + (hasAuthData ? Buffer::Length(info[3]) : 0), &rotate)) return;
+	Local<Object> ciphertext_buf = Nan::NewBuffer((uint32_t)plaintext_len).ToLocalChecked();
+	Local<Object> auth_tag_buf = Nan::NewBuffer((uint32_t)auth_tag_len).ToLocalChecked();
+
+	if (!key->Encrypt(self->scratch_,
+		(unsigned char *)Buffer::Data(info[1]), Buffer::Length(info[1]),
+		hasAuthData ? (unsigned char *)Buffer::Data(info[3]) : NULL, hasAuthData ? Buffer::Length(info[3]) : 0,
+		(unsigned char *)Buffer::Data(info[2]), plaintext_len,
+		(unsigned char *)Buffer::Data(ciphertext_buf),
+		(unsigned char *)Buffer::Data(auth_tag_buf), auth_tag_len
+	)) {
+		Nan::ThrowError("Invalid IV or auth tag length for this key.");
+		return;
+	}
+
+	Local<Object> return_obj = Nan::New<Object>();
+	Nan::Set(return_obj, Nan::New<String>("ciphertext").ToLocalChecked(), ciphertext_buf);
+	Nan::Set(return_obj, Nan::New<String>("auth_tag").ToLocalChecked(), auth_tag_buf);
+	if (rotate) EmitRotateEvent(info.Holder(), Nan::To<uint32_t>(info[0]).FromJust(), *key);
+	info.GetReturnValue().Set(return_obj);
+}
+
+// Decrypts using the key with the given ID and returns an object containing
+// a "plaintext" buffer and an "auth_ok" boolean.
+NAN_METHOD(KeyringWrap::Decrypt) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+
+	// check arguments
+	if (info.Length() < 5 ||
+		!info[0]->IsUint32() || // key ID
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // ciphertext
+		!IsOptionalBuffer(info[3]) || // auth_data, optional
+		!Buffer::HasInstance(info[4]) // auth tag
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key ID (uint32), iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer)."
+		);
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(Nan::To<uint32_t>(info[0]).FromJust());
+	if (!key) {
+		Nan::ThrowError("There is no key with the given ID.");
+		return;
+	}
+
+	Local<Object> result;
+	if (!DecryptFrame(self->scratch_, *key,
+		(unsigned char *)Buffer::Data(info[1]), Buffer::Length(info[1]),
+		(unsigned char *)Buffer::Data(info[2]), Buffer::Length(info[2]),
+		info[3],
+		(unsigned char *)Buffer::Data(info[4]), Buffer::Length(info[4]),
+		&result
+	)) {
+		Nan::ThrowError("Invalid IV or auth tag length for this key.");
+		return;
+	}
+	info.GetReturnValue().Set(result);
+}
+
+// Like encrypt, but runs on the crypto thread pool and calls back with
+// (error, result). The callback is always the last argument; the scheduling
+// options { tenant, timeout } may precede it.
+// Arguments: key ID (uint32), iv (Buffer), plaintext (Buffer), auth_data (Buffer | NULL), auth tag length (int, optional), options (Object, optional), callback (Function)
+NAN_METHOD(KeyringWrap::EncryptAsync) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+
+	// both the auth tag length and the options are optional
+	const int callback_index = info.Length() - 1;
+	Local<Value> tag_length = Nan::Undefined(), options = Nan::Undefined();
+	if (callback_index == 6) {
+		tag_length = info[4];
+		options = info[5];
+	} else if (callback_index == 5) {
+		if (info[4]->IsObject()) options = info[4];
+		else tag_length = info[4];
+	}
+
+	// check arguments
+	if (info.Length() < 5 || info.Length() > 7 ||
+		!info[0]->IsUint32() || // key ID
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // plaintext
+		!IsOptionalBuffer(info[3]) || // auth_data, optional
+		!(tag_length->IsUndefined() || tag_length->IsUint32()) || // auth tag length, optional
+		!info[callback_index]->IsFunction() // callback
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key ID (uint32), iv (Buffer), plaintext (Buffer), auth_data (Buffer | NULL), auth tag length (int, optional), "
+			"options (Object, optional), callback (Function)."
+		);
+		return;
+	}
+
+	const uint32_t key_id = Nan::To<uint32_t>(info[0]).FromJust();
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(key_id);
+	if (!key) {
+		Nan::ThrowError("There is no key with the given ID.");
+		return;
+	}
+	size_t auth_tag_len;
+	if (!GetAuthTagLength(*key, tag_length, &auth_tag_len)) return;
+	if (!ValidEncryption(*key, Buffer::Length(info[1]), auth_tag_len, Buffer::Length(info[2]))) {
+		Nan::ThrowError("Invalid IV or auth tag length for this key.");
+		return;
+	}
+	aead::ScheduleOptions schedule;
+	if (!async::GetScheduleOptions(options, &schedule)) return;
+	if (!CheckNonceReuse(*key, (unsigned char *)Buffer::Data(info[1]), Buffer::Length(info[1]))) return;
+	const size_t bytes = Buffer::Length(info[2]) + (Buffer::HasInstance(info[3]) ? Buffer::Length(info[3]) : 0);
+	bool rotate;
+	if (!UseKey(*key, bytes, &rotate)) return;
+
+	if (!async::Submit(new async::EncryptJob(
+		info[callback_index].As<Function>(), key, info[1], info[2], info[3], auth_tag_len
+	), schedule)) {
+		// refused jobs don't count, and a crossing is reported again by the next call
+		key->Refund(1, bytes);
+		return;
+	}
+	if (rotate) EmitRotateEvent(info.Holder(), key_id, *key);
+}
+
+// Like decrypt, but runs on the crypto thread pool and calls back with (error, result).
+// Arguments: key ID (uint32), iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer), options (Object, optional), callback (Function)
+NAN_METHOD(KeyringWrap::DecryptAsync) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+
+	// check arguments
+	const int callback_index = info.Length() - 1;
+	if (info.Length() < 6 || info.Length() > 7 ||
+		!info[0]->IsUint32() || // key ID
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // ciphertext
+		!IsOptionalBuffer(info[3]) || // auth_data, optional
+		!Buffer::HasInstance(info[4]) || // auth tag
+		!info[callback_index]->IsFunction() // callback
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key ID (uint32), iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer), options (Object, optional), callback (Function)."
+		);
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(Nan::To<uint32_t>(info[0]).FromJust());
+	if (!key) {
+		Nan::ThrowError("There is no key with the given ID.");
+		return;
+	}
+	if (!aead::KeyContext::ValidParams(key->mode(), Buffer::Length(info[1]), Buffer::Length(info[4]))) {
+		Nan::ThrowError("Invalid IV or auth tag length for this key.");
+		return;
+	}
+
+	aead::ScheduleOptions schedule;
+	if (!async::GetScheduleOptions(callback_index == 6 ? info[5] : Nan::Undefined().As<Value>(), &schedule)) return;
+
+	async::Submit(new async::DecryptJob(info[callback_index].As<Function>(), key, info[1], info[2], info[3], info[4]), schedule);
+}
+
+// Runs a batch of operations with one key as a single job on the crypto
+// thread pool and calls back with an array of results, one per operation.
+// Invalid operations, reused nonces and encryptions over the key's hard
+// usage limit fail individually with an Error in their place.
+// Arguments: key ID (uint32), operations (Array of [encrypt, iv, data, auth_data, auth tag | auth tag length]), options (Object, optional), callback (Function)
+NAN_METHOD(KeyringWrap::BatchAsync) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+
+	// check arguments
+	const int callback_index = info.Length() - 1;
+	if (info.Length() < 3 || info.Length() > 4 ||
+		!info[0]->IsUint32() || // key ID
+		!info[1]->IsArray() || // operations
+		!info[callback_index]->IsFunction() // callback
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key ID (uint32), operations (Array), options (Object, optional), callback (Function)."
+		);
+		return;
+	}
+
+	const uint32_t key_id = Nan::To<uint32_t>(info[0]).FromJust();
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(key_id);
+	if (!key) {
+		Nan::ThrowError("There is no key with the given ID.");
+		return;
+	}
+	aead::ScheduleOptions schedule;
+	if (!async::GetScheduleOptions(callback_index == 3 ? info[2] : Nan::Undefined().As<Value>(), &schedule)) return;
+
+	Local<Array> ops = info[1].As<Array>();
+	async::BatchJob *job = new async::BatchJob(info[callback_index].As<Function>(), key, ops);
+	bool rotate = false;
+	// what was counted, to take back if the pool refuses the job
+	uint64_t used_messages = 0;
+	size_t used_bytes = 0;
+	for (uint32_t i = 0; i < ops->Length(); i++) {
+		async::BatchOp op;
+		if (!async::ReadBatchOp(Nan::Get(ops, i).ToLocalChecked(), &op)) {
+			job->AddError("Each operation must be an array [encrypt, iv, data, auth_data, auth_tag | auth_tag_length].");
+			continue;
+		}
+		if (!op.encrypt) {
+			if (!aead::KeyContext::ValidParams(key->mode(), Buffer::Length(op.iv), Buffer::Length(op.auth_tag))) {
+				job->AddError("Invalid IV or auth tag length for this key.");
+			} else {
+				job->AddDecrypt(op.iv, op.data, op.aad, op.auth_tag);
+			}
+			continue;
+		}
+
+		if (op.auth_tag->IsUndefined() && key->mode() == aead::MODE_CCM) {
+			job->AddError("The auth tag length must be specified for CCM keys.");
+			continue;
+		}
+		const size_t auth_tag_len = op.auth_tag->IsUndefined() ? 16 : Nan::To<uint32_t>(op.auth_tag).FromJust();
+		if (!ValidEncryption(*key, Buffer::Length(op.iv), auth_tag_len, Buffer::Length(op.data))) {
+			job->AddError("Invalid IV or auth tag length for this key.");
+			continue;
+		}
+		if (NonceReused(*key, (unsigned char *)Buffer::Data(op.iv), Buffer::Length(op.iv))) {
+			job->AddError("The nonce has been used with this key before.");
+			continue;
+		}
+		const size_t bytes = Buffer::Length(op.data) + (Buffer::HasInstance(op.aad) ? Buffer::Length(op.aad) : 0);
+		const aead::UsageResult usage = key->Use(bytes);
+		if (usage == aead::USAGE_HARD_LIMIT) {
+			job->AddError("The usage limit of this key has been reached.");
+			continue;
+		}
+		if (usage == aead::USAGE_SOFT_LIMIT) rotate = true;
+		used_messages++;
+		used_bytes += bytes;
+		job->AddEncrypt(op.iv, op.data, op.aad, auth_tag_len);
+	}
+
+	if (!async::Submit(job, schedule)) {
+		key->Refund(used_messages, used_bytes);
+		return;
+	}
+	if (rotate) EmitRotateEvent(info.Holder(), key_id, *key);
+}
+
+// Decrypts an array of [keyId, iv, ciphertext, auth_data, auth_tag] tuples
+// and returns an array of { plaintext, auth_ok } objects in the same order.
+// Frames with an unknown key ID or invalid parameters yield a NULL plaintext.
+// If a ReplayWindow is passed, each tuple carries a sequence number as sixth
+// element. Frames the window has already seen (or which are too old) are
+// skipped without decryption and marked as "replayed"; the window is only
+// advanced by frames which pass authentication.
+NAN_METHOD(KeyringWrap::DecryptBatch) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+
+	ReplayWindowWrap *window = NULL;
+	if (info.Length() < 1 || !info[0]->IsArray() ||
+		(info.Length() > 1 && !info[1]->IsUndefined() && (window = ReplayWindowWrap::FromValue(info[1])) == NULL)
+	) {
+		Nan::ThrowError("Not enough (or wrong) arguments specified. Required: frames (Array), replay window (ReplayWindow, optional).");
+		return;
+	}
+	Local<Array> frames = info[0].As<Array>();
+	const uint32_t count = frames->Length();
+	Local<Array> results = Nan::New<Array>(count);
+
+	// consecutive frames often share a key, so remember the last one
+	uint32_t last_id = 0;
+	std::shared_ptr<aead::KeyContext> key;
+
+	for (uint32_t i = 0; i < count; i++) {
+		Local<Value> frame_val = Nan::Get(frames, i).ToLocalChecked();
+		if (!frame_val->IsArray()) {
+			Nan::ThrowTypeError("Each frame must be an array [keyId, iv, ciphertext, auth_data, auth_tag].");
+			return;
+		}
+		Local<Array> frame = frame_val.As<Array>();
+		Local<Value> id = Nan::Get(frame, 0).ToLocalChecked();
+		Local<Value> iv = Nan::Get(frame, 1).ToLocalChecked();
+		Local<Value> ciphertext = Nan::Get(frame, 2).ToLocalChecked();
+		Local<Value> aad = Nan::Get(frame, 3).ToLocalChecked();
+		Local<Value> auth_tag = Nan::Get(frame, 4).ToLocalChecked();
+		if (!id->IsUint32() ||
+			!Buffer::HasInstance(iv) ||
+			!Buffer::HasInstance(ciphertext) ||
+			!IsOptionalBuffer(aad) ||
+			!Buffer::HasInstance(auth_tag)
+		) {
+			Nan::ThrowTypeError("Each frame must be an array [keyId, iv, ciphertext, auth_data, auth_tag].");
+			return;
+		}
+
+		uint64_t seq = 0;
+		if (window != NULL) {
+			if (!ToUint64(Nan::Get(frame, 5).ToLocalChecked(), &seq)) {
+				Nan::ThrowTypeError("With a replay window, each frame must be an array [keyId, iv, ciphertext, auth_data, auth_tag, sequence number].");
+				return;
+			}
+			// drop duplicates before spending any work on them
+			if (!window->window().Check(seq)) {
+				Nan::Set(results, i, ReplayedFrame());
+				continue;
+			}
+		}
+
+		const uint32_t key_id = Nan::To<uint32_t>(id).FromJust();
+		if (!key || key_id != last_id) {
+			key = self->keyring_->Get(key_id);
+			last_id = key_id;
+		}
+
+		Local<Object> result;
+		bool auth_ok = false;
+		if (!key || !DecryptFrame(self->scratch_, *key,
+			(unsigned char *)Buffer::Data(iv), Buffer::Length(iv),
+			(unsigned char *)Buffer::Data(ciphertext), Buffer::Length(ciphertext),
+			aad,
+			(unsigned char *)Buffer::Data(auth_tag), Buffer::Length(auth_tag),
+			&result, &auth_ok
+		)) {
+			result = FailedFrame();
+		} else if (window != NULL && auth_ok) {
+			window->window().Update(seq);
+		}
+		Nan::Set(results, i, result);
+	}
+
+	info.GetReturnValue().Set(results);
+}
+
+// Encrypts using the key's next nonce and returns a single frame
+// nonce || ciphertext || auth_tag. The nonce is written straight into the frame.
+// Arguments: key ID (uint32), plaintext (Buffer), auth_data (Buffer | NULL), auth tag length (int, optional)
+NAN_METHOD(KeyringWrap::Seal) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+
+	// check arguments
+	if (info.Length() < 2 ||
+		!info[0]->IsUint32() || // key ID
+		!Buffer::HasInstance(info[1]) || // plaintext
+		!IsOptionalBuffer(info[2]) // auth_data, optional
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key ID (uint32), plaintext (Buffer), auth_data (Buffer | NULL), auth tag length (int, optional)."
+		);
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(Nan::To<uint32_t>(info[0]).FromJust());
+	if (!key) {
+		Nan::ThrowError("There is no key with the given ID.");
+		return;
+	}
+	aead::NonceGenerator *generator = key->nonce_generator();
+	if (generator == NULL) {
+		Nan::ThrowError("The key has no nonce configuration.");
+		return;
+	}
+	size_t auth_tag_len;
+	if (!GetAuthTagLength(*key, info[3], &auth_tag_len)) return;
+	if (!aead::KeyContext::ValidParams(key->mode(), generator->nonce_len(), auth_tag_len)) {
+		Nan::ThrowError("Invalid auth tag length for this key.");
+		return;
+	}
+
+	const size_t nonce_len = generator->nonce_len();
+	const size_t plaintext_len = Buffer::Length(info[1]);
+	if (!ValidEncryption(*key, nonce_len, auth_tag_len, plaintext_len)) {
+		Nan::ThrowError("The plaintext is too long for the nonce length of this key.");
+		return;
+	}
+	const bool hasAuthData = Buffer::HasInstance(info[2]);
+	Local<Object> frame_buf = Nan::NewBuffer((uint32_t)(nonce_len + plaintext_len + auth_tag_len)).ToLocalChecked();
+	unsigned char *frame = (unsigned char *)Buffer::Data(frame_buf);
+
+	if (!generator->Next(frame)) {
+		Nan::ThrowError(generator->is_random()
+			? "Failed to generate a random nonce."
+			: "The nonce counter of this key is exhausted."
+		);
+		return;
+	}
+	if (!CheckNonceReuse(*key, frame, nonce_len)) return;
+	bool rotate;
+	if (!UseKey(*key, plaintext_len + (hasAuthData ? Buffer::Length(info[2]) : 0), &rotate)) return;
+	if (!key->Encrypt(self->scratch_,
+		frame, nonce_len,
+		hasAuthData ? (unsigned char *)Buffer::Data(info[2]) : NULL, hasAuthData ? Buffer::Length(info[2]) : 0,
+		(unsigned char *)Buffer::Data(info[1]), plaintext_len,
+		frame + nonce_len,
+		frame + nonce_len + plaintext_len, auth_tag_len
+	)) {
+		Nan::ThrowError("Encryption failed.");
+		return;
+	}
+
+	if (rotate) EmitRotateEvent(info.Holder(), Nan::To<uint32_t>(info[0]).FromJust(), *key);
+	info.GetReturnValue().Set(frame_buf);
+}
+
+// Decrypts a frame created by seal() and returns an object containing
+// a "plaintext" buffer and an "auth_ok" boolean.
+// Arguments: key ID (uint32), frame (Buffer), auth_data (Buffer | NULL), auth tag length (int, optional)
+NAN_METHOD(KeyringWrap::Open) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+
+	// check arguments
+	if (info.Length() < 2 ||
+		!info[0]->IsUint32() || // key ID
+		!Buffer::HasInstance(info[1]) || // frame
+		!IsOptionalBuffer(info[2]) // auth_data, optional
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key ID (uint32), frame (Buffer), auth_data (Buffer | NULL), auth tag length (int, optional)."
+		);
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(Nan::To<uint32_t>(info[0]).FromJust());
+	if (!key) {
+		Nan::ThrowError("There is no key with the given ID.");
+		return;
+	}
+	if (key->nonce_generator() == NULL) {
+		Nan::ThrowError("The key has no nonce configuration.");
+		return;
+	}
+	size_t auth_tag_len;
+	if (!GetAuthTagLength(*key, info[3], &auth_tag_len)) return;
+
+	const size_t nonce_len = key->nonce_generator()->nonce_len();
+	const unsigned char *frame = (unsigned char *)Buffer::Data(info[1]);
+	const size_t frame_len = Buffer::Length(info[1]);
+	if (frame_len < nonce_len + auth_tag_len) {
+		Nan::ThrowError("The frame is too short.");
+		return;
+	}
+	const size_t ciphertext_len = frame_len - nonce_len - auth_tag_len;
+
+	Local<Object> result;
+	if (!DecryptFrame(self->scratch_, *key,
+		frame, nonce_len,
+		frame + nonce_len, ciphertext_len,
+		info[2],
+		frame + nonce_len + ciphertext_len, auth_tag_len,
+		&result
+	)) {
+		Nan::ThrowError("Invalid auth tag length for this key.");
+		return;
+	}
+	info.GetReturnValue().Set(result);
+}
+
+// Returns the counter value the next nonce of the key will use, so the
+// position can be persisted and passed back as the "counter" option later.
+NAN_METHOD(KeyringWrap::GetNonceCounter) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+	if (info.Length() < 1 || !info[0]->IsUint32()) {
+		Nan::ThrowError("Not enough (or wrong) arguments specified. Required: key ID (uint32).");
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(Nan::To<uint32_t>(info[0]).FromJust());
+	if (!key) {
+		Nan::ThrowError("There is no key with the given ID.");
+		return;
+	}
+	if (key->nonce_generator() == NULL || key->nonce_generator()->is_random()) {
+		Nan::ThrowError("The key has no nonce sequence.");
+		return;
+	}
+	info.GetReturnValue().Set(FromUint64(key->nonce_generator()->Position()));
+}
+
+// Returns how often the reuse detector of the key reported a reused nonce.
+NAN_METHOD(KeyringWrap::GetNonceReuseCount) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+	if (info.Length() < 1 || !info[0]->IsUint32()) {
+		Nan::ThrowError("Not enough (or wrong) arguments specified. Required: key ID (uint32).");
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(Nan::To<uint32_t>(info[0]).FromJust());
+	if (!key) {
+		Nan::ThrowError("There is no key with the given ID.");
+		return;
+	}
+	if (key->reuse_detector() == NULL) {
+		Nan::ThrowError("Nonce reuse detection is not enabled for this key.");
+		return;
+	}
+	info.GetReturnValue().Set(Nan::New<Number>((double)key->reuse_detector()->hits()));
+}
+
+// Returns the usage counters of a key as { messages, bytes }. The counters
+// are read without synchronization, so this is cheap enough for metrics.
+NAN_METHOD(KeyringWrap::Usage) {
+	KeyringWrap *self = Nan::ObjectWrap::Unwrap<KeyringWrap>(info.Holder());
+	if (info.Length() < 1 || !info[0]->IsUint32()) {
+		Nan::ThrowError("Not enough (or wrong) arguments specified. Required: key ID (uint32).");
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = self->keyring_->Get(Nan::To<uint32_t>(info[0]).FromJust());
+	if (!key) {
+		Nan::ThrowError("There is no key with the given ID.");
+		return;
+	}
+	info.GetReturnValue().Set(KeyUsage(*key));
+}
+
+// ==================
+
+// ReplayWindow objects are recognized by a tag in a second internal field,
+// which works across all module instances (main thread and workers)
+static const int REPLAY_WINDOW_TAG_FIELD = 1;
+static char replay_window_tag;
+
+ReplayWindowWrap::ReplayWindowWrap(size_t size) : window_(size) {}
+
+NAN_MODULE_INIT(ReplayWindowWrap::Init) {
+	Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+	tpl->SetClassName(Nan::New<String>("ReplayWindow").ToLocalChecked());
+	tpl->InstanceTemplate()->SetInternalFieldCount(2);
+
+	Nan::SetPrototypeMethod(tpl, "check", Check);
+	Nan::SetPrototypeMethod(tpl, "update", Update);
+	Nan::SetAccessor(tpl->InstanceTemplate(), Nan::New<String>("size").ToLocalChecked(), GetSize);
+	Nan::SetAccessor(tpl->InstanceTemplate(), Nan::New<String>("highest").ToLocalChecked(), GetHighest);
+
+	Nan::Set(target,
+		Nan::New<String>("ReplayWindow").ToLocalChecked(),
+		Nan::GetFunction(tpl).ToLocalChecked()
+	);
+}
+
+ReplayWindowWrap *ReplayWindowWrap::FromValue(Local<Value> value) {
+	if (!value->IsObject()) return NULL;
+	Local<Object> obj = value.As<Object>();
+	if (obj->InternalFieldCount() != 2 ||
+		obj->GetAlignedPointerFromInternalField(REPLAY_WINDOW_TAG_FIELD) != &replay_window_tag
+	) {
+		return NULL;
+	}
+	return Nan::ObjectWrap::Unwrap<ReplayWindowWrap>(obj);
+}
+
+// Creates a window covering the given number of sequence numbers.
+// Arguments: size (int, 64 to 4096, optional; default 64)
+NAN_METHOD(ReplayWindowWrap::New) {
+	if (!info.IsConstructCall()) {
+		Nan::ThrowTypeError("ReplayWindow must be called with new.");
+		return;
+	}
+
+	uint32_t size = aead::ReplayWindow::MIN_SIZE;
+	if (info.Length() > 0 && !info[0]->IsUndefined()) {
+		if (!info[0]->IsUint32() ||
+			Nan::To<uint32_t>(info[0]).FromJust() < aead::ReplayWindow::MIN_SIZE ||
+			Nan::To<uint32_t>(info[0]).FromJust() > aead::ReplayWindow::MAX_SIZE
+		) {
+			Nan::ThrowError("The replay window size must be between 64 and 4096.");
+			return;
+		}
+		size = Nan::To<uint32_t>(info[0]).FromJust();
+	}
+
+	ReplayWindowWrap *obj = new ReplayWindowWrap(size);
+	obj->Wrap(info.This());
+	info.This()->SetAlignedPointerInInternalField(REPLAY_WINDOW_TAG_FIELD, &replay_window_tag);
+	info.GetReturnValue().Set(info.This());
+}
+
+// Returns whether a sequence number is new and within the window.
+// Arguments: sequence number (Number | BigInt)
+NAN_METHOD(ReplayWindowWrap::Check) {
+	ReplayWindowWrap *self = Nan::ObjectWrap::Unwrap<ReplayWindowWrap>(info.Holder());
+	uint64_t seq;
+	if (info.Length() < 1 || !ToUint64(info[0], &seq)) {
+		Nan::ThrowError("Not enough (or wrong) arguments specified. Required: sequence number (unsigned 64 bit integer).");
+		return;
+	}
+	info.GetReturnValue().Set(Nan::New<Boolean>(self->window_.Check(seq)));
+}
+
+// Marks a sequence number as seen. Only call this for authenticated frames.
+// Arguments: sequence number (Number | BigInt)
+NAN_METHOD(ReplayWindowWrap::Update) {
+	ReplayWindowWrap *self = Nan::ObjectWrap::Unwrap<ReplayWindowWrap>(info.Holder());
+	uint64_t seq;
+	if (info.Length() < 1 || !ToUint64(info[0], &seq)) {
+		Nan::ThrowError("Not enough (or wrong) arguments specified. Required: sequence number (unsigned 64 bit integer).");
+		return;
+	}
+	self->window_.Update(seq);
+}
+
+NAN_GETTER(ReplayWindowWrap::GetSize) {
+	ReplayWindowWrap *self = Nan::ObjectWrap::Unwrap<ReplayWindowWrap>(info.Holder());
+	info.GetReturnValue().Set(Nan::New<Number>((double)self->window_.size()));
+}
+
+NAN_GETTER(ReplayWindowWrap::GetHighest) {
+	ReplayWindowWrap *self = Nan::ObjectWrap::Unwrap<ReplayWindowWrap>(info.Holder());
+	info.GetReturnValue().Set(FromUint64(self->window_.Highest()));
+}
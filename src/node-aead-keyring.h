@@ -0,0 +1,80 @@
+#ifndef NODE_AEAD_KEYRING_H_
+#define NODE_AEAD_KEYRING_H_
+
+#include <nan.h>
+#include <memory>
+#include <openssl/evp.h>
+
+#include "aead-keyring.h"
+#include "aead-replay.h"
+
+namespace keyring {
+
+    // JS-facing Keyring class. The key table itself lives in an aead::Keyring
+    // which may be shared with Keyring objects in other worker threads; the
+    // wrapper only owns the scratch cipher context of the JS thread it was
+    // created on.
+    class KeyringWrap : public Nan::ObjectWrap {
+    public:
+        static NAN_MODULE_INIT(Init);
+        // Returns NULL if value is not a Keyring
+        static KeyringWrap *FromValue(v8::Local<v8::Value> value);
+
+        const std::shared_ptr<aead::Keyring> &keyring() const { return keyring_; }
+
+        // Emits "rotate" for a key whose soft limit was crossed outside of
+        // the keyring's own calls, e.g. by a CryptoRing. Nothing happens if
+        // the key is gone by now.
+        static void EmitRotate(v8::Local<v8::Object> keyring, uint32_t key_id, Nan::AsyncResource *resource);
+
+    private:
+        explicit KeyringWrap(const std::shared_ptr<aead::Keyring> &keyring);
+        ~KeyringWrap();
+
+        static NAN_METHOD(New);
+        static NAN_METHOD(Share);
+        static NAN_METHOD(Set);
+        static NAN_METHOD(Delete);
+        static NAN_METHOD(Has);
+        static NAN_GETTER(GetSize);
+        static NAN_METHOD(Encrypt);
+        static NAN_METHOD(Decrypt);
+        static NAN_METHOD(DecryptBatch);
+        static NAN_METHOD(EncryptAsync);
+        static NAN_METHOD(DecryptAsync);
+        static NAN_METHOD(BatchAsync);
+        static NAN_METHOD(Seal);
+        static NAN_METHOD(Open);
+        static NAN_METHOD(GetNonceCounter);
+        static NAN_METHOD(GetNonceReuseCount);
+        static NAN_METHOD(Usage);
+
+        std::shared_ptr<aead::Keyring> keyring_;
+        EVP_CIPHER_CTX *scratch_;
+    };
+
+    // JS-facing ReplayWindow class, which decryptBatch() consults to drop
+    // replayed frames before decrypting them.
+    class ReplayWindowWrap : public Nan::ObjectWrap {
+    public:
+        static NAN_MODULE_INIT(Init);
+        // Returns NULL if value is not a ReplayWindow
+        static ReplayWindowWrap *FromValue(v8::Local<v8::Value> value);
+
+        aead::ReplayWindow &window() { return window_; }
+
+    private:
+        explicit ReplayWindowWrap(size_t size);
+
+        static NAN_METHOD(New);
+        static NAN_METHOD(Check);
+        static NAN_METHOD(Update);
+        static NAN_GETTER(GetSize);
+        static NAN_GETTER(GetHighest);
+
+        aead::ReplayWindow window_;
+    };
+
+}
+
+#endif
@@ -0,0 +1,229 @@
+#include <node.h>
+#include <nan.h>
+#include <mutex>
+#include <vector>
+
+#include "node-aead-keyring.h"
+#include "node-aead-ring.h"
+
+using namespace v8;
+using namespace node;
+using namespace ring;
+
+// The ring memory becomes the backing store of a SharedArrayBuffer, whose
+// deleter holds a reference to the ring. The ring (and its poller) lives
+// until both the buffer and the CryptoRing object are gone.
+// Like sharing keyrings, this needs V8 8+ (Node.js 14+).
+#if V8_MAJOR_VERSION >= 8
+#define RING_CAN_SHARE
+#endif
+
+#ifdef RING_CAN_SHARE
+struct SharedRing {
+	std::shared_ptr<aead::CryptoRing> ring;
+};
+
+static void FreeSharedRing(void *data, size_t length, void *deleter_data) {
+	delete (SharedRing *)deleter_data;
+}
+
+static const uint32_t DEFAULT_ENTRIES = 256;
+static const uint32_t DEFAULT_DATA_SIZE = 1 << 20;
+
+// Reads an optional unsigned integer option. Returns false after throwing
+// if it is not an integer within [min, max].
+static bool GetUintOption(Local<Object> options, const char *name, uint32_t min, uint32_t max,
+	const char *message, uint32_t *result
+) {
+	Local<Value> value = Nan::Get(options, Nan::New<String>(name).ToLocalChecked()).ToLocalChecked();
+	if (value->IsUndefined()) return true;
+	if (!value->IsUint32() ||
+		Nan::To<uint32_t>(value).FromJust() < min ||
+		Nan::To<uint32_t>(value).FromJust() > max
+	) {
+		Nan::ThrowError(message);
+		return false;
+	}
+	*result = Nan::To<uint32_t>(value).FromJust();
+	return true;
+}
+#endif
+
+// Hands soft limit crossings from the poller to the JS thread through a
+// uv_async_t, which doesn't keep the loop alive, like the completion ports
+// of the async functions
+class RingWrap::RotateNotifier : public aead::CryptoRing::Listener {
+public:
+	RotateNotifier(const std::shared_ptr<aead::CryptoRing> &ring, Local<Object> keyring)
+		: ring_(ring), resource_("aead:rotate")
+	{
+		keyring_.Reset(keyring);
+		uv_async_init(Nan::GetCurrentEventLoop(), &async_, OnAsync);
+		async_.data = this;
+		uv_unref((uv_handle_t *)&async_);
+		ring_->SetListener(this);
+	}
+
+	// Poller thread
+	void SoftLimitReached(uint32_t key_id) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		key_ids_.push_back(key_id);
+		uv_async_send(&async_);
+	}
+
+	// JS thread: stops listening and frees the notifier once the handle is closed
+	void Close() {
+		// afterwards, the poller won't signal the handle anymore
+		ring_->SetListener(NULL);
+		keyring_.Reset();
+		uv_close((uv_handle_t *)&async_, OnClose);
+	}
+
+private:
+	static void OnAsync(uv_async_t *handle) {
+		((RotateNotifier *)handle->data)->Drain();
+	}
+
+	static void OnClose(uv_handle_t *handle) {
+		delete (RotateNotifier *)handle->data;
+	}
+
+	void Drain() {
+		std::vector<uint32_t> key_ids;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			key_ids.swap(key_ids_);
+		}
+		if (keyring_.IsEmpty()) return;
+		Nan::HandleScope scope;
+		Local<Object> keyring = Nan::New(keyring_);
+		for (size_t i = 0; i < key_ids.size(); i++) {
+			keyring::KeyringWrap::EmitRotate(keyring, key_ids[i], &resource_);
+		}
+	}
+
+	std::shared_ptr<aead::CryptoRing> ring_;
+	Nan::Persistent<Object> keyring_;
+	Nan::AsyncResource resource_;
+	uv_async_t async_;
+	std::mutex mutex_;
+	std::vector<uint32_t> key_ids_;
+};
+
+RingWrap::RingWrap(const std::shared_ptr<aead::CryptoRing> &ring) : ring_(ring), notifier_(NULL) {}
+
+RingWrap::~RingWrap() {
+	if (notifier_ == NULL) return;
+#if NODE_MODULE_VERSION >= 64
+	RemoveEnvironmentCleanupHook(Isolate::GetCurrent(), Cleanup, this);
+#endif
+	CloseNotifier();
+}
+
+// The thread's environment is going away before the wrapper
+void RingWrap::Cleanup(void *arg) {
+	((RingWrap *)arg)->CloseNotifier();
+}
+
+void RingWrap::CloseNotifier() {
+	notifier_->Close();
+	notifier_ = NULL;
+}
+
+NAN_MODULE_INIT(RingWrap::Init) {
+	Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+	tpl->SetClassName(Nan::New<String>("CryptoRing").ToLocalChecked());
+	tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+	Nan::SetPrototypeMethod(tpl, "wakeup", Wakeup);
+	Nan::SetPrototypeMethod(tpl, "close", Close);
+
+	Nan::Set(target,
+		Nan::New<String>("CryptoRing").ToLocalChecked(),
+		Nan::GetFunction(tpl).ToLocalChecked()
+	);
+}
+
+// Creates the rings and starts their poller thread. The object gets a
+// "buffer" property with the ring memory and the layout properties
+// "entries", "sqOffset", "cqOffset", "dataOffset" and "dataSize".
+// Arguments: keyring (Keyring), options ({ entries, dataSize, cpu, idle }, optional)
+NAN_METHOD(RingWrap::New) {
+	if (!info.IsConstructCall()) {
+		Nan::ThrowTypeError("CryptoRing must be called with new.");
+		return;
+	}
+	keyring::KeyringWrap *keyring;
+	if (info.Length() < 1 || (keyring = keyring::KeyringWrap::FromValue(info[0])) == NULL) {
+		Nan::ThrowError("Not enough (or wrong) arguments specified. Required: keyring (Keyring), options (Object, optional).");
+		return;
+	}
+
+#ifdef RING_CAN_SHARE
+	uint32_t entries = DEFAULT_ENTRIES;
+	uint32_t data_size = DEFAULT_DATA_SIZE;
+	uint32_t cpu = UINT32_MAX;
+	uint32_t idle_us = aead::CryptoRing::DEFAULT_IDLE_NS / 1000;
+	if (info.Length() > 1 && !info[1]->IsUndefined()) {
+		if (!info[1]->IsObject()) {
+			Nan::ThrowTypeError("The ring options must be an object.");
+			return;
+		}
+		Local<Object> options = info[1].As<Object>();
+		if (!GetUintOption(options, "entries", aead::CryptoRing::MIN_ENTRIES, aead::CryptoRing::MAX_ENTRIES,
+				"The number of ring entries must be a power of two between 2 and 65536.", &entries) ||
+			!GetUintOption(options, "dataSize", 0, aead::CryptoRing::MAX_DATA_SIZE,
+				"The data size must be between 0 and 1073741824 bytes.", &data_size) ||
+			!GetUintOption(options, "cpu", 0, UINT32_MAX - 1,
+				"The CPU must be a CPU number.", &cpu) ||
+			!GetUintOption(options, "idle", 0, 1000000,
+				"The idle time must be between 0 and 1000000 microseconds.", &idle_us)
+		) {
+			return;
+		}
+		if ((entries & (entries - 1)) != 0) {
+			Nan::ThrowError("The number of ring entries must be a power of two between 2 and 65536.");
+			return;
+		}
+	}
+
+	std::shared_ptr<aead::CryptoRing> ring(new aead::CryptoRing(keyring->keyring(), entries, data_size));
+	ring->Start(cpu == UINT32_MAX ? -1 : (int)cpu, (uint64_t)idle_us * 1000);
+
+	SharedRing *shared = new SharedRing();
+	shared->ring = ring;
+	std::unique_ptr<BackingStore> store = SharedArrayBuffer::NewBackingStore(
+		ring->memory(), ring->size(), FreeSharedRing, shared
+	);
+	Local<SharedArrayBuffer> buffer = SharedArrayBuffer::New(info.GetIsolate(), std::move(store));
+
+	RingWrap *obj = new RingWrap(ring);
+	obj->Wrap(info.This());
+	obj->notifier_ = new RotateNotifier(ring, info[0].As<Object>());
+#if NODE_MODULE_VERSION >= 64
+	AddEnvironmentCleanupHook(info.GetIsolate(), Cleanup, obj);
+#endif
+	Local<Object> self = info.This();
+	Nan::Set(self, Nan::New<String>("buffer").ToLocalChecked(), buffer);
+	Nan::Set(self, Nan::New<String>("entries").ToLocalChecked(), Nan::New<Number>(ring->entries()));
+	Nan::Set(self, Nan::New<String>("sqOffset").ToLocalChecked(), Nan::New<Number>((double)ring->sq_offset()));
+	Nan::Set(self, Nan::New<String>("cqOffset").ToLocalChecked(), Nan::New<Number>((double)ring->cq_offset()));
+	Nan::Set(self, Nan::New<String>("dataOffset").ToLocalChecked(), Nan::New<Number>((double)ring->data_offset()));
+	Nan::Set(self, Nan::New<String>("dataSize").ToLocalChecked(), Nan::New<Number>((double)ring->data_size()));
+	info.GetReturnValue().Set(self);
+#else
+	Nan::ThrowError("CryptoRing requires Node.js 14 or newer.");
+#endif
+}
+
+// Wakes the poller up after it has set the NEED_WAKEUP flag
+NAN_METHOD(RingWrap::Wakeup) {
+	RingWrap *self = Nan::ObjectWrap::Unwrap<RingWrap>(info.Holder());
+	self->ring_->Wakeup();
+}
+
+// Stops the poller. Submissions it has not taken yet are not processed.
+NAN_METHOD(RingWrap::Close) {
+	RingWrap *self = Nan::ObjectWrap::Unwrap<RingWrap>(info.Holder());
+	self->ring_->Stop();
+}
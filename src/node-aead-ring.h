@@ -0,0 +1,38 @@
+#ifndef NODE_AEAD_RING_H_
+#define NODE_AEAD_RING_H_
+
+#include <nan.h>
+#include <memory>
+
+#include "aead-ring.h"
+
+namespace ring {
+
+    // JS-facing side of an aead::CryptoRing. The ring memory is exposed as a
+    // SharedArrayBuffer; lib/ring.js reads and writes the rings through it
+    // and only calls into the addon to wake up a sleeping poller. Keys that
+    // reach a soft usage limit on the ring make the keyring emit "rotate" on
+    // the JS thread the ring was created on.
+    class RingWrap : public Nan::ObjectWrap {
+    public:
+        static NAN_MODULE_INIT(Init);
+
+    private:
+        class RotateNotifier;
+
+        explicit RingWrap(const std::shared_ptr<aead::CryptoRing> &ring);
+        ~RingWrap();
+        static void Cleanup(void *arg);
+        void CloseNotifier();
+
+        static NAN_METHOD(New);
+        static NAN_METHOD(Wakeup);
+        static NAN_METHOD(Close);
+
+        std::shared_ptr<aead::CryptoRing> ring_;
+        RotateNotifier *notifier_;
+    };
+
+}
+
+#endif
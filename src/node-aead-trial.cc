@@ -0,0 +1,142 @@
+#include <node.h>
+#include <nan.h>
+#include <string.h>
+#include <memory>
+#include <vector>
+
+#include "node-aead-trial.h"
+#include "aead-key.h"
+#include "aead-trial.h"
+#include "node-aead-keyring.h"
+
+using namespace v8;
+using namespace node;
+
+// Collects raw keys of one mode, or returns false after throwing
+static bool RawCandidates(Local<Value> keys, Local<Value> mode_arg, std::vector<aead::TrialKey> *out) {
+	aead::Mode mode = aead::MODE_GCM;
+	if (!mode_arg->IsUndefined()) {
+		Nan::Utf8String mode_str(mode_arg);
+		if (mode_arg->IsString() && strcmp(*mode_str, "ccm") == 0) {
+			mode = aead::MODE_CCM;
+		} else if (!mode_arg->IsString() || strcmp(*mode_str, "gcm") != 0) {
+			Nan::ThrowError("Invalid mode specified. Allowed are \"gcm\" and \"ccm\".");
+			return false;
+		}
+	}
+	Local<Array> list = keys.As<Array>();
+	for (uint32_t i = 0; i < list->Length(); i++) {
+		Local<Value> key = Nan::Get(list, i).ToLocalChecked();
+		if (!Buffer::HasInstance(key)) {
+			Nan::ThrowError("The candidate keys must be Buffers.");
+			return false;
+		}
+		const size_t key_len = Buffer::Length(key);
+		if (key_len != 16 && key_len != 24 && key_len != 32) {
+			Nan::ThrowError("Invalid key length specified. Allowed are 128, 192 and 256 bits.");
+			return false;
+		}
+		aead::TrialKey candidate = { mode, (const unsigned char *)Buffer::Data(key), key_len, NULL };
+		out->push_back(candidate);
+	}
+	return true;
+}
+
+// Collects keyring keys by ID, each in its own mode, or returns false
+// after throwing. Unknown IDs stay in the list, so the indices match, but
+// never match.
+static bool KeyringCandidates(const aead::Keyring &keyring, Local<Value> ids,
+	std::vector<std::shared_ptr<aead::KeyContext> > *contexts, std::vector<aead::TrialKey> *out
+) {
+	if (!ids->IsArray()) {
+		Nan::ThrowError("The candidate key IDs must be an array.");
+		return false;
+	}
+	Local<Array> list = ids.As<Array>();
+	for (uint32_t i = 0; i < list->Length(); i++) {
+		Local<Value> id = Nan::Get(list, i).ToLocalChecked();
+		if (!id->IsUint32()) {
+			Nan::ThrowError("The candidate key IDs must be uint32.");
+			return false;
+		}
+		std::shared_ptr<aead::KeyContext> key = keyring.Get(Nan::To<uint32_t>(id).FromJust());
+		aead::TrialKey candidate = { aead::MODE_GCM, NULL, 0, NULL };
+		if (key) {
+			candidate.mode = key->mode();
+			candidate.key = key->key();
+			candidate.key_len = key->key_len();
+			candidate.schedule = key->aesni_key();
+		}
+		contexts->push_back(key);
+		out->push_back(candidate);
+	}
+	return true;
+}
+
+// Returns an object containing the "index" of the matching candidate (-1 if
+// none matched), its "plaintext" buffer (null if none matched) and an
+// "auth_ok" boolean. Candidates whose mode doesn't allow the IV and tag
+// lengths are skipped.
+// Arguments: iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer),
+// then either keys (Buffer[]), mode ("gcm" | "ccm", optional) or keyring (Keyring), key IDs (uint32[])
+NAN_METHOD(trial::Decrypt) {
+	Nan::HandleScope scope;
+
+	// check arguments
+	keyring::KeyringWrap *keyring = NULL;
+	if (info.Length() < 5 ||
+		!Buffer::HasInstance(info[0]) || // iv
+		!Buffer::HasInstance(info[1]) || // ciphertext
+		!(info[2]->IsUndefined() || info[2]->IsNull() || Buffer::HasInstance(info[2])) || // auth_data, optional
+		!Buffer::HasInstance(info[3]) || // auth tag
+		!(info[4]->IsArray() || (keyring = keyring::KeyringWrap::FromValue(info[4])) != NULL) // candidates
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer), "
+			"keys (Buffer[]) or keyring (Keyring)."
+		);
+		return;
+	}
+
+	std::vector<std::shared_ptr<aead::KeyContext> > contexts;
+	std::vector<aead::TrialKey> candidates;
+	if (keyring != NULL
+		? !KeyringCandidates(*keyring->keyring(), info[5], &contexts, &candidates)
+		: !RawCandidates(info[4], info[5], &candidates)
+	) {
+		return;
+	}
+
+	const unsigned char *iv = (const unsigned char *)Buffer::Data(info[0]);
+	const size_t iv_len = Buffer::Length(info[0]);
+	const unsigned char *ciphertext = (const unsigned char *)Buffer::Data(info[1]);
+	const size_t ciphertext_len = Buffer::Length(info[1]);
+	const bool hasAuthData = Buffer::HasInstance(info[2]);
+	const unsigned char *aad = hasAuthData ? (const unsigned char *)Buffer::Data(info[2]) : NULL;
+	const size_t aad_len = hasAuthData ? Buffer::Length(info[2]) : 0;
+	const unsigned char *auth_tag = (const unsigned char *)Buffer::Data(info[3]);
+	const size_t auth_tag_len = Buffer::Length(info[3]);
+
+	// ==================
+
+	// Authenticate against all candidates, then decrypt with the match only
+
+	const size_t index = aead::TrialDecryption::Find(candidates.data(), candidates.size(),
+		iv, iv_len, aad, aad_len, ciphertext, ciphertext_len, auth_tag, auth_tag_len);
+	bool auth_ok = false;
+	Local<Value> plaintext = Nan::Null();
+	if (index < candidates.size()) {
+		Local<Object> plaintext_buf = Nan::NewBuffer((uint32_t)ciphertext_len).ToLocalChecked();
+		auth_ok = aead::TrialDecryption::Decrypt(candidates[index], iv, iv_len, aad, aad_len,
+			ciphertext, ciphertext_len, (unsigned char *)Buffer::Data(plaintext_buf), auth_tag, auth_tag_len);
+		if (auth_ok) plaintext = plaintext_buf;
+	}
+
+	Local<Object> return_obj = Nan::New<Object>();
+	Nan::Set(return_obj, Nan::New<String>("index").ToLocalChecked(),
+		Nan::New<Number>(auth_ok ? (double)index : -1));
+	Nan::Set(return_obj, Nan::New<String>("plaintext").ToLocalChecked(), plaintext);
+	Nan::Set(return_obj, Nan::New<String>("auth_ok").ToLocalChecked(), Nan::New<Boolean>(auth_ok));
+	info.GetReturnValue().Set(return_obj);
+}
@@ -0,0 +1,14 @@
+#ifndef NODE_AEAD_TRIAL_H_
+#define NODE_AEAD_TRIAL_H_
+
+#include <nan.h>
+
+namespace trial {
+
+    // Decrypts a frame that doesn't name its key with the first of several
+    // candidate keys that authenticates it (see aead::TrialDecryption)
+    NAN_METHOD(Decrypt);
+
+}
+
+#endif
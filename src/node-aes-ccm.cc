@@ -4,6 +4,15 @@
 #include <openssl/evp.h>
 
 #include "node-aes-ccm.h"
+#include "aead-ccm-format.h"
+#include "aead-ccm-parallel.h"
+#include "aead-ccm-small.h"
+#include "aead-fixed.h"
+#include "aead-parallel.h"
+#include "aead-random.h"
+#include "aead-soft.h"
+#include "aead-tuning.h"
+#include "node-aead-async.h"
 
 // see https://wiki.openssl.org/index.php/EVP_Authenticated_Encryption_and_Decryption
 // for details on the implementation
@@ -14,6 +23,8 @@ using namespace node;
 // Perform CCM mode AES encryption using the provided key, IV, plaintext
 // and auth_data buffers, and return an object containing "ciphertext"
 // and "auth_tag" buffers.
+// If a nonce length is passed instead of the IV, a random nonce is generated
+// and returned as "iv".
 // The key length determines the encryption bit level used.
 NAN_METHOD(ccm::Encrypt) {
 	Nan::HandleScope scope;
@@ -21,14 +32,14 @@ NAN_METHOD(ccm::Encrypt) {
 	// check arguments
 	if (info.Length() < 5 || 
 		!Buffer::HasInstance(info[0]) || // key
-		!Buffer::HasInstance(info[1]) || // iv
+		!(Buffer::HasInstance(info[1]) || info[1]->IsUint32()) || // iv or random IV length
 		!Buffer::HasInstance(info[2]) || // plaintext
 		!(info[3]->IsUndefined() || info[3]->IsNull() || Buffer::HasInstance(info[3])) || // auth_data, optional
 		!info[4]->IsNumber() // auth tag length
 	) {
 		Nan::ThrowError(
 			"Not enough (or wrong) arguments specified. Required: "
-			"key (Buffer), iv (Buffer), plaintext (Buffer), auth_data (Buffer | NULL), auth tag length (int)."
+			"key (Buffer), iv (Buffer | random IV length), plaintext (Buffer), auth_data (Buffer | NULL), auth tag length (int)."
 		);
 		return;
 	}
@@ -52,9 +63,25 @@ NAN_METHOD(ccm::Encrypt) {
 			return;
 	}
 
-	// parse iv and plaintext
-	unsigned char *iv = (unsigned char *)Buffer::Data(info[1]);
-	const size_t iv_len = Buffer::Length(info[1]);
+	// parse iv (a number requests a random IV of that length) and plaintext
+	const bool randomIv = !Buffer::HasInstance(info[1]);
+	Local<Object> iv_buf;
+	if (randomIv) {
+		const uint32_t random_iv_len = Nan::To<uint32_t>(info[1]).FromJust();
+		if (random_iv_len < 7 || random_iv_len > 13) {
+			Nan::ThrowError("Random CCM nonces must be 7 to 13 bytes long.");
+			return;
+		}
+		iv_buf = Nan::NewBuffer(random_iv_len).ToLocalChecked();
+		if (!aead::RandomBytes((unsigned char *)Buffer::Data(iv_buf), random_iv_len)) {
+			Nan::ThrowError("Failed to generate a random IV.");
+			return;
+		}
+	} else {
+		iv_buf = info[1].As<Object>();
+	}
+	unsigned char *iv = (unsigned char *)Buffer::Data(iv_buf);
+	const size_t iv_len = Buffer::Length(iv_buf);
 	unsigned char *plaintext = (unsigned char *)Buffer::Data(info[2]);
 	const size_t plaintext_len = Buffer::Length(info[2]);
 	// Make a buffer for the ciphertext that is the same size as the
@@ -70,7 +97,7 @@ NAN_METHOD(ccm::Encrypt) {
 		aad_len = Buffer::Length(info[3]);
 	}
 	// Make a authentication tag buffer
-	const int auth_tag_len = info[4]->Int32Value();
+	const int auth_tag_len = Nan::To<int32_t>(info[4]).FromJust();
 	unsigned char *auth_tag = new unsigned char[auth_tag_len];
 	
 		
@@ -78,41 +105,76 @@ NAN_METHOD(ccm::Encrypt) {
 
 	// Now do the encryption
 
-	// create the context
-	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-	// initialize the encryption operation with the chosen cipher
-	EVP_EncryptInit_ex(ctx, cipher_type, NULL, NULL, NULL);
-
-	// set iv and auth tag length
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, iv_len, NULL);
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, auth_tag_len, NULL);
-
-	// provide the key and iv
-	EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv);
-
-	int outl; // output length
-	
-	// if we have additional authenticated data,
-	// provide it and the the plaintext length
-	if (hasAuthData) {
-		EVP_EncryptUpdate(ctx, NULL, &outl, NULL, plaintext_len);
-		EVP_EncryptUpdate(ctx, NULL, &outl, aad, aad_len);
+	const aead::SoftKey *soft_key = aead::SoftAead::Enabled() &&
+		aead::KeyContext::ValidParams(aead::MODE_CCM, iv_len, auth_tag_len)
+		? aead::SoftAead::CachedKey(key, key_len) : NULL;
+	const aead::Kernel kernel = aead::Tuning::Get(aead::MODE_CCM, plaintext_len);
+	const aead::AesniKey *small_key = soft_key == NULL && kernel != aead::KERNEL_OPENSSL &&
+		aead::SmallCcm::Accepts(iv_len, plaintext_len, auth_tag_len)
+		? aead::Aesni::CachedKey(key, key_len) : NULL;
+	// only where the autotuner found AES-NI faster than OpenSSL
+	const aead::AesniKey *builtin_key = soft_key == NULL && small_key == NULL && kernel == aead::KERNEL_BUILTIN &&
+		aead::KeyContext::ValidParams(aead::MODE_CCM, iv_len, auth_tag_len) &&
+		aead::CcmFormat::LengthFits(iv_len, plaintext_len)
+		? aead::Aesni::CachedKey(key, key_len) : NULL;
+	if (soft_key != NULL) {
+		// constant-time software AES where OpenSSL would use lookup tables
+		aead::SoftAead::CcmEncrypt(*soft_key, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+			plaintext, plaintext_len, ciphertext, auth_tag, auth_tag_len);
+		ciphertext_len = plaintext_len;
+	} else if (small_key != NULL) {
+		// short messages skip the EVP setup
+		aead::SmallCcm::Encrypt(*small_key, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+			plaintext, plaintext_len, ciphertext, auth_tag, auth_tag_len);
+		ciphertext_len = plaintext_len;
+	} else if (aead::ChunkedWork::ShouldSplit(plaintext_len) && aead::ParallelCcm::Encrypt(
+		key, key_len, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+		plaintext, plaintext_len, ciphertext, auth_tag, auth_tag_len
+	)) {
+		// large messages are encrypted on the crypto thread pool while
+		// this thread computes the CBC-MAC
+		ciphertext_len = plaintext_len;
+	} else if (builtin_key != NULL) {
+		aead::AesniAead::CcmEncrypt(*builtin_key, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+			plaintext, plaintext_len, ciphertext, auth_tag, auth_tag_len);
+		ciphertext_len = plaintext_len;
+	} else {
+		// create the context
+		EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+		// initialize the encryption operation with the chosen cipher
+		EVP_EncryptInit_ex(ctx, cipher_type, NULL, NULL, NULL);
+
+		// set iv and auth tag length
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, iv_len, NULL);
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, auth_tag_len, NULL);
+
+		// provide the key and iv
+		EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv);
+
+		int outl; // output length
+
+		// if we have additional authenticated data,
+		// provide it and the the plaintext length
+		if (hasAuthData) {
+			EVP_EncryptUpdate(ctx, NULL, &outl, NULL, plaintext_len);
+			EVP_EncryptUpdate(ctx, NULL, &outl, aad, aad_len);
+		}
+
+		// Encrypt plaintext
+		EVP_EncryptUpdate(ctx, ciphertext, &outl, plaintext, plaintext_len);
+		ciphertext_len = outl;
+
+		// Finalize the encryption
+		EVP_EncryptFinal_ex(ctx, ciphertext + outl, &outl);
+		ciphertext_len += outl;
+
+		// Get the authentication tag
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_GET_TAG, auth_tag_len, auth_tag);
+
+		// Clean up
+		EVP_CIPHER_CTX_free(ctx);
 	}
 
-	// Encrypt plaintext
-	EVP_EncryptUpdate(ctx, ciphertext, &outl, plaintext, plaintext_len);
-	ciphertext_len = outl;
-
-	// Finalize the encryption
-	EVP_EncryptFinal_ex(ctx, ciphertext + outl, &outl);
-	ciphertext_len += outl;
-
-	// Get the authentication tag
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_GET_TAG, auth_tag_len, auth_tag);
-
-	// Clean up
-	EVP_CIPHER_CTX_free(ctx);
-
 	// ===================================
 
 	// Create the return buffers and object
@@ -122,6 +184,9 @@ NAN_METHOD(ccm::Encrypt) {
 	Local<Object> return_obj = Nan::New<Object>();
 	Nan::Set(return_obj, Nan::New<String>("ciphertext").ToLocalChecked(), ciphertext_buf.ToLocalChecked());
 	Nan::Set(return_obj, Nan::New<String>("auth_tag").ToLocalChecked(), auth_tag_buf.ToLocalChecked());
+	if (randomIv) {
+		Nan::Set(return_obj, Nan::New<String>("iv").ToLocalChecked(), iv_buf);
+	}
 
 	// Return it
 	info.GetReturnValue().Set(return_obj);
@@ -195,35 +260,74 @@ NAN_METHOD(ccm::Decrypt) {
 
 	// Now do the decryption
 
-	// create the context
-	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-	// initialize the decryption operation with the chosen cipher
-	EVP_DecryptInit_ex(ctx, cipher_type, NULL, NULL, NULL);
-
-	// Set the IV length
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, iv_len, NULL);
-
-	// Set the expected authentication tag
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, auth_tag_len, auth_tag);
-
-	// Provide key and iv to OpenSSL
-	EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv);
-
-	int outl; // output length
-	
-	// if we have additional authenticated data,
-	// provide it and the the ciphertext length
-	if (hasAuthData) {
-		EVP_DecryptUpdate(ctx, NULL, &outl, NULL, ciphertext_len);
-		EVP_DecryptUpdate(ctx, NULL, &outl, aad, aad_len);
+	bool auth_ok;
+	const aead::SoftKey *soft_key = aead::SoftAead::Enabled() &&
+		aead::KeyContext::ValidParams(aead::MODE_CCM, iv_len, auth_tag_len)
+		? aead::SoftAead::CachedKey(key, key_len) : NULL;
+	const aead::Kernel kernel = aead::Tuning::Get(aead::MODE_CCM, ciphertext_len);
+	const aead::AesniKey *small_key = soft_key == NULL && kernel != aead::KERNEL_OPENSSL &&
+		aead::SmallCcm::Accepts(iv_len, ciphertext_len, auth_tag_len)
+		? aead::Aesni::CachedKey(key, key_len) : NULL;
+	// only where the autotuner found AES-NI faster than OpenSSL
+	const aead::AesniKey *builtin_key = soft_key == NULL && small_key == NULL && kernel == aead::KERNEL_BUILTIN &&
+		aead::KeyContext::ValidParams(aead::MODE_CCM, iv_len, auth_tag_len) &&
+		aead::CcmFormat::LengthFits(iv_len, ciphertext_len)
+		? aead::Aesni::CachedKey(key, key_len) : NULL;
+	if (soft_key != NULL) {
+		// constant-time software AES where OpenSSL would use lookup tables;
+		// like OpenSSL, return no plaintext if authentication fails
+		auth_ok = aead::SoftAead::CcmDecrypt(*soft_key, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+			ciphertext, ciphertext_len, plaintext, auth_tag, auth_tag_len);
+		plaintext_len = auth_ok ? ciphertext_len : 0;
+	} else if (small_key != NULL) {
+		// short messages skip the EVP setup; like OpenSSL, return no
+		// plaintext if authentication fails
+		auth_ok = aead::SmallCcm::Decrypt(*small_key, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+			ciphertext, ciphertext_len, plaintext, auth_tag, auth_tag_len);
+		plaintext_len = auth_ok ? ciphertext_len : 0;
+	} else if (aead::ChunkedWork::ShouldSplit(ciphertext_len) && aead::ParallelCcm::Decrypt(
+		key, key_len, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+		ciphertext, ciphertext_len, plaintext, auth_tag, auth_tag_len, &auth_ok
+	)) {
+		// large messages are decrypted on the crypto thread pool while
+		// this thread follows with the CBC-MAC. Like OpenSSL, return no
+		// plaintext if authentication fails.
+		plaintext_len = auth_ok ? ciphertext_len : 0;
+	} else if (builtin_key != NULL) {
+		aead::AesniAead::CcmDecrypt(*builtin_key, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+			ciphertext, ciphertext_len, plaintext, auth_tag, auth_tag_len, &auth_ok);
+		plaintext_len = auth_ok ? ciphertext_len : 0;
+	} else {
+		// create the context
+		EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+		// initialize the decryption operation with the chosen cipher
+		EVP_DecryptInit_ex(ctx, cipher_type, NULL, NULL, NULL);
+
+		// Set the IV length
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, iv_len, NULL);
+
+		// Set the expected authentication tag
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, auth_tag_len, auth_tag);
+
+		// Provide key and iv to OpenSSL
+		EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv);
+
+		int outl; // output length
+
+		// if we have additional authenticated data,
+		// provide it and the the ciphertext length
+		if (hasAuthData) {
+			EVP_DecryptUpdate(ctx, NULL, &outl, NULL, ciphertext_len);
+			EVP_DecryptUpdate(ctx, NULL, &outl, aad, aad_len);
+		}
+
+		// Decrypt ciphertext
+		auth_ok = EVP_DecryptUpdate(ctx, plaintext, &outl, ciphertext, ciphertext_len);
+		plaintext_len = outl;
+
+		// Clean up
+		EVP_CIPHER_CTX_free(ctx);
 	}
-	
-	// Decrypt ciphertext
-	bool auth_ok = EVP_DecryptUpdate(ctx, plaintext, &outl, ciphertext, ciphertext_len);
-	plaintext_len = outl;
-
-	// Clean up
-	EVP_CIPHER_CTX_free(ctx);
 
 	// ==================
 
@@ -236,4 +340,171 @@ NAN_METHOD(ccm::Decrypt) {
 
 	// Return it
 	info.GetReturnValue().Set(return_obj);
-}
\ No newline at end of file
+}
+
+// Asynchronous variants of encrypt and decrypt, which run on the crypto
+// thread pool and call back with (error, result). The buffers must not be
+// modified until the callback is called. The optional scheduling options
+// { tenant, timeout } select the tenant queue and the deadline of the job.
+
+// Arguments: key (Buffer), iv (Buffer), plaintext (Buffer), auth_data (Buffer | NULL), auth tag length (int), options (Object, optional), callback (Function)
+NAN_METHOD(ccm::EncryptAsync) {
+	// check arguments
+	const int callback_index = info.Length() - 1;
+	if (info.Length() < 6 || info.Length() > 7 ||
+		!Buffer::HasInstance(info[0]) || // key
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // plaintext
+		!(info[3]->IsUndefined() || info[3]->IsNull() || Buffer::HasInstance(info[3])) || // auth_data, optional
+		!info[4]->IsUint32() || // auth tag length
+		!info[callback_index]->IsFunction() // callback
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key (Buffer), iv (Buffer), plaintext (Buffer), auth_data (Buffer | NULL), auth tag length (int), options (Object, optional), callback (Function)."
+		);
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = aead::KeyContext::Create(
+		aead::MODE_CCM, (unsigned char *)Buffer::Data(info[0]), Buffer::Length(info[0])
+	);
+	if (!key) {
+		Nan::ThrowError("Invalid key length specified. Allowed are 128, 192 and 256 bits.");
+		return;
+	}
+	const size_t auth_tag_len = Nan::To<uint32_t>(info[4]).FromJust();
+	if (!aead::KeyContext::ValidParams(aead::MODE_CCM, Buffer::Length(info[1]), auth_tag_len)) {
+		Nan::ThrowError("Invalid IV or auth tag length specified.");
+		return;
+	}
+	aead::ScheduleOptions schedule;
+	if (!async::GetScheduleOptions(callback_index == 6 ? info[5] : Nan::Undefined().As<Value>(), &schedule)) return;
+
+	async::Submit(new async::EncryptJob(info[callback_index].As<Function>(), key, info[1], info[2], info[3], auth_tag_len), schedule);
+}
+
+// Arguments: key (Buffer), iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer), options (Object, optional), callback (Function)
+NAN_METHOD(ccm::DecryptAsync) {
+	// check arguments
+	const int callback_index = info.Length() - 1;
+	if (info.Length() < 6 || info.Length() > 7 ||
+		!Buffer::HasInstance(info[0]) || // key
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // ciphertext
+		!(info[3]->IsUndefined() || info[3]->IsNull() || Buffer::HasInstance(info[3])) || // auth_data, optional
+		!Buffer::HasInstance(info[4]) || // auth tag
+		!info[callback_index]->IsFunction() // callback
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key (Buffer), iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer), options (Object, optional), callback (Function)."
+		);
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = aead::KeyContext::Create(
+		aead::MODE_CCM, (unsigned char *)Buffer::Data(info[0]), Buffer::Length(info[0])
+	);
+	if (!key) {
+		Nan::ThrowError("Invalid key length specified. Allowed are 128, 192 and 256 bits.");
+		return;
+	}
+	if (!aead::KeyContext::ValidParams(aead::MODE_CCM, Buffer::Length(info[1]), Buffer::Length(info[4]))) {
+		Nan::ThrowError("Invalid IV or auth tag length specified.");
+		return;
+	}
+	aead::ScheduleOptions schedule;
+	if (!async::GetScheduleOptions(callback_index == 6 ? info[5] : Nan::Undefined().As<Value>(), &schedule)) return;
+
+	async::Submit(new async::DecryptJob(info[callback_index].As<Function>(), key, info[1], info[2], info[3], info[4]), schedule);
+}
+
+// Runs a batch of operations with one key as a single job on the crypto
+// thread pool and calls back with an array of results, one per operation.
+// Invalid operations fail individually with an Error in their place.
+// Arguments: key (Buffer), operations (Array of [encrypt, iv, data, auth_data, auth tag | auth tag length]), options (Object, optional), callback (Function)
+NAN_METHOD(ccm::BatchAsync) {
+	// check arguments
+	const int callback_index = info.Length() - 1;
+	if (info.Length() < 3 || info.Length() > 4 ||
+		!Buffer::HasInstance(info[0]) || // key
+		!info[1]->IsArray() || // operations
+		!info[callback_index]->IsFunction() // callback
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key (Buffer), operations (Array), options (Object, optional), callback (Function)."
+		);
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = aead::KeyContext::Create(
+		aead::MODE_CCM, (unsigned char *)Buffer::Data(info[0]), Buffer::Length(info[0])
+	);
+	if (!key) {
+		Nan::ThrowError("Invalid key length specified. Allowed are 128, 192 and 256 bits.");
+		return;
+	}
+	aead::ScheduleOptions schedule;
+	if (!async::GetScheduleOptions(callback_index == 3 ? info[2] : Nan::Undefined().As<Value>(), &schedule)) return;
+
+	Local<Array> ops = info[1].As<Array>();
+	async::BatchJob *job = new async::BatchJob(info[callback_index].As<Function>(), key, ops);
+	for (uint32_t i = 0; i < ops->Length(); i++) {
+		async::BatchOp op;
+		if (!async::ReadBatchOp(Nan::Get(ops, i).ToLocalChecked(), &op) ||
+			(op.encrypt && op.auth_tag->IsUndefined()) // the tag length is required
+		) {
+			job->AddError("Each operation must be an array [encrypt, iv, data, auth_data, auth_tag | auth_tag_length].");
+			continue;
+		}
+		const size_t auth_tag_len = op.encrypt
+			? Nan::To<uint32_t>(op.auth_tag).FromJust()
+			: Buffer::Length(op.auth_tag);
+		if (!aead::KeyContext::ValidParams(aead::MODE_CCM, Buffer::Length(op.iv), auth_tag_len)) {
+			job->AddError("Invalid IV or auth tag length specified.");
+		} else if (op.encrypt) {
+			job->AddEncrypt(op.iv, op.data, op.aad, auth_tag_len);
+		} else {
+			job->AddDecrypt(op.iv, op.data, op.aad, op.auth_tag);
+		}
+	}
+	async::Submit(job, schedule);
+}
+
+// Processes messages below the DispatchEstimator's cutoff inline and returns
+// the result like encrypt; hands larger ones to the crypto thread pool like
+// encryptAsync and returns undefined. index.js delivers inline results
+// asynchronously, so callers can't tell the difference.
+// Arguments: like encryptAsync
+NAN_METHOD(ccm::EncryptAuto) {
+	if (info.Length() >= 4 && Buffer::HasInstance(info[1]) && Buffer::HasInstance(info[2])) {
+		const size_t bytes = Buffer::Length(info[2]) + (Buffer::HasInstance(info[3]) ? Buffer::Length(info[3]) : 0);
+		if (async::ShouldInline(aead::MODE_CCM, bytes)) {
+			const uint64_t start = aead::Scheduler::Now();
+			Encrypt(info);
+			async::RecordInline(aead::MODE_CCM, bytes, aead::Scheduler::Now() - start);
+			return;
+		}
+	}
+	EncryptAsync(info);
+}
+
+// Processes messages below the DispatchEstimator's cutoff inline and returns
+// the result like decrypt; hands larger ones to the crypto thread pool like
+// decryptAsync and returns undefined. index.js delivers inline results
+// asynchronously, so callers can't tell the difference.
+// Arguments: like decryptAsync
+NAN_METHOD(ccm::DecryptAuto) {
+	if (info.Length() >= 4 && Buffer::HasInstance(info[1]) && Buffer::HasInstance(info[2])) {
+		const size_t bytes = Buffer::Length(info[2]) + (Buffer::HasInstance(info[3]) ? Buffer::Length(info[3]) : 0);
+		if (async::ShouldInline(aead::MODE_CCM, bytes)) {
+			const uint64_t start = aead::Scheduler::Now();
+			Decrypt(info);
+			async::RecordInline(aead::MODE_CCM, bytes, aead::Scheduler::Now() - start);
+			return;
+		}
+	}
+	DecryptAsync(info);
+}
@@ -7,6 +7,11 @@ namespace ccm {
 
     NAN_METHOD(Encrypt);
     NAN_METHOD(Decrypt);
+    NAN_METHOD(EncryptAsync);
+    NAN_METHOD(DecryptAsync);
+    NAN_METHOD(BatchAsync);
+    NAN_METHOD(EncryptAuto);
+    NAN_METHOD(DecryptAuto);
 
 }
 
@@ -22,9 +22,24 @@
  
 #include <node.h>
 #include <nan.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <openssl/evp.h>
 
 #include "node-aes-gcm.h"
+#include "aead-epoch.h"
+#include "aead-fixed.h"
+#include "aead-gcm-verify.h"
+#include "aead-gcm-parallel.h"
+#include "aead-gcm-small.h"
+#include "aead-gcm-wide.h"
+#include "aead-parallel.h"
+#include "aead-random.h"
+#include "aead-reuse.h"
+#include "aead-soft.h"
+#include "aead-tuning.h"
+#include "node-aead-async.h"
 
 // see https://wiki.openssl.org/index.php/EVP_Authenticated_Encryption_and_Decryption
 // for details on the implementation
@@ -43,10 +58,44 @@ using namespace node;
 #define EVP_CTRL_GCM_SET_IVLEN    EVP_CTRL_AEAD_SET_IVLEN
 #endif
 
+// Optional detection of reused (key, IV) pairs, shared by all threads.
+// Threads recording into the detector count as readers of ReuseEpoch(), so
+// a replaced detector is freed once none of them can still use it.
+
+static std::atomic<aead::NonceReuseDetector *> reuse_detector(NULL);
+static std::mutex reuse_detector_mutex;
+
+// Never destroyed, since other threads may still record at exit
+static aead::ReaderEpoch &ReuseEpoch() {
+	static aead::ReaderEpoch *epoch = new aead::ReaderEpoch();
+	return *epoch;
+}
+
+// Checks the IV against recently used ones, if enabled.
+// Returns true if it was used before and reuse is rejected.
+static bool NonceReused(const unsigned char *key, size_t key_len, const unsigned char *iv, size_t iv_len) {
+	// skip the reader count while detection is off
+	if (reuse_detector.load(std::memory_order_relaxed) == NULL) return false;
+	aead::ReaderEpoch::Reader reader(ReuseEpoch());
+	aead::NonceReuseDetector *detector = reuse_detector.load();
+	return detector != NULL && detector->Record(iv, iv_len, key, key_len) && detector->reject();
+}
+
+// Like NonceReused, but returns false after throwing
+bool gcm::CheckNonceReuse(const unsigned char *key, size_t key_len, const unsigned char *iv, size_t iv_len) {
+	if (NonceReused(key, key_len, iv, iv_len)) {
+		Nan::ThrowError("The IV has been used with this key before.");
+		return false;
+	}
+	return true;
+}
+
 
 // Perform GCM mode AES encryption using the
 // provided key, IV, plaintext and auth_data buffers, and return an object
 // containing "ciphertext" and "auth_tag" buffers.
+// If an IV length is passed instead of the IV, a random IV is generated
+// and returned as "iv".
 // The key length determines the encryption bit level used.
 NAN_METHOD(gcm::Encrypt) {
 	Nan::HandleScope scope;
@@ -54,13 +103,13 @@ NAN_METHOD(gcm::Encrypt) {
 	// check arguments
 	if (info.Length() < 4 || 
 		!Buffer::HasInstance(info[0]) || // key
-		!Buffer::HasInstance(info[1]) || // iv
+		!(Buffer::HasInstance(info[1]) || info[1]->IsUint32()) || // iv or random IV length
 		!Buffer::HasInstance(info[2]) || // plaintext
 		!(info[3]->IsUndefined() || info[3]->IsNull() || Buffer::HasInstance(info[3])) // auth_data, optional
 	) {
 		Nan::ThrowError(
 			"Not enough (or wrong) arguments specified. Required: "
-			"key (Buffer), iv (Buffer), plaintext (Buffer), auth_data (Buffer | NULL)."
+			"key (Buffer), iv (Buffer | random IV length), plaintext (Buffer), auth_data (Buffer | NULL)."
 		);
 		return;
 	}
@@ -84,9 +133,26 @@ NAN_METHOD(gcm::Encrypt) {
 			return;
 	}
 
-	// parse iv and plaintext
-	unsigned char *iv = (unsigned char *)Buffer::Data(info[1]);
-	const size_t iv_len = Buffer::Length(info[1]);
+	// parse iv (a number requests a random IV of that length) and plaintext
+	const bool randomIv = !Buffer::HasInstance(info[1]);
+	Local<Object> iv_buf;
+	if (randomIv) {
+		const uint32_t random_iv_len = Nan::To<uint32_t>(info[1]).FromJust();
+		if (random_iv_len < 12 || random_iv_len > 16) {
+			Nan::ThrowError("Random GCM IVs must be 12 to 16 bytes long.");
+			return;
+		}
+		iv_buf = Nan::NewBuffer(random_iv_len).ToLocalChecked();
+		if (!aead::RandomBytes((unsigned char *)Buffer::Data(iv_buf), random_iv_len)) {
+			Nan::ThrowError("Failed to generate a random IV.");
+			return;
+		}
+	} else {
+		iv_buf = info[1].As<Object>();
+	}
+	unsigned char *iv = (unsigned char *)Buffer::Data(iv_buf);
+	const size_t iv_len = Buffer::Length(iv_buf);
+	if (!CheckNonceReuse(key, key_len, iv, iv_len)) return;
 	unsigned char *plaintext = (unsigned char *)Buffer::Data(info[2]);
 	const size_t plaintext_len = Buffer::Length(info[2]);
 	// Make a buffer for the ciphertext that is the same size as the
@@ -109,38 +175,76 @@ NAN_METHOD(gcm::Encrypt) {
 
 	// Now do the encryption
 
-	// create the context
-	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-	// initialize the encryption operation with the chosen cipher
-	EVP_EncryptInit_ex(ctx, cipher_type, NULL, NULL, NULL);
-
-	// set iv and auth tag length
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv_len, NULL);
-
-	// provide the key and iv
-	EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv);
-	
-	int outl; // output length
-	
-	// if we have additional authenticated data, provide it
-	if (hasAuthData) {
-		EVP_EncryptUpdate(ctx, NULL, &outl, aad, aad_len);
+	const aead::SoftKey *soft_key = aead::SoftAead::Enabled() && iv_len > 0
+		? aead::SoftAead::CachedKey(key, key_len) : NULL;
+	const aead::Kernel kernel = aead::Tuning::Get(aead::MODE_GCM, plaintext_len);
+	const aead::AesniKey *small_key = soft_key == NULL && kernel != aead::KERNEL_OPENSSL &&
+		aead::SmallGcm::Accepts(iv_len, plaintext_len)
+		? aead::Aesni::CachedKey(key, key_len) : NULL;
+	// VAES by default, AES-NI too where the autotuner found it faster
+	const aead::AesniKey *builtin_key = soft_key == NULL && small_key == NULL && kernel != aead::KERNEL_OPENSSL &&
+		aead::WideGcm::Accepts(iv_len) && (aead::WideGcm::Supported() || kernel == aead::KERNEL_BUILTIN)
+		? aead::Aesni::CachedKey(key, key_len) : NULL;
+	if (soft_key != NULL) {
+		// constant-time software AES where OpenSSL would use lookup tables
+		aead::SoftAead::GcmEncrypt(*soft_key, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+			plaintext, plaintext_len, ciphertext, auth_tag);
+		ciphertext_len = plaintext_len;
+	} else if (small_key != NULL) {
+		// short messages skip the EVP setup
+		aead::SmallGcm::Encrypt(*small_key, iv, hasAuthData ? aad : NULL, aad_len,
+			plaintext, plaintext_len, ciphertext, auth_tag);
+		ciphertext_len = plaintext_len;
+	} else if (aead::ChunkedWork::ShouldSplit(plaintext_len) && aead::ParallelGcm::Encrypt(
+		key, key_len, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+		plaintext, plaintext_len, ciphertext, auth_tag, AUTH_TAG_LEN
+	)) {
+		// large messages are split across the crypto thread pool
+		ciphertext_len = plaintext_len;
+	} else if (builtin_key != NULL) {
+		// VAES and VPCLMULQDQ, independent of the OpenSSL build
+		if (aead::WideGcm::Supported()) {
+			aead::WideGcm::Encrypt(*builtin_key, iv, hasAuthData ? aad : NULL, aad_len,
+				plaintext, plaintext_len, ciphertext, auth_tag);
+		} else {
+			aead::AesniAead::GcmEncrypt(*builtin_key, iv, hasAuthData ? aad : NULL, aad_len,
+				plaintext, plaintext_len, ciphertext, auth_tag);
+		}
+		ciphertext_len = plaintext_len;
+	} else {
+		// create the context
+		EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+		// initialize the encryption operation with the chosen cipher
+		EVP_EncryptInit_ex(ctx, cipher_type, NULL, NULL, NULL);
+
+		// set iv and auth tag length
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv_len, NULL);
+
+		// provide the key and iv
+		EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv);
+
+		int outl; // output length
+
+		// if we have additional authenticated data, provide it
+		if (hasAuthData) {
+			EVP_EncryptUpdate(ctx, NULL, &outl, aad, aad_len);
+		}
+
+		// Encrypt plaintext
+		EVP_EncryptUpdate(ctx, ciphertext, &outl, plaintext, plaintext_len);
+		ciphertext_len = outl;
+
+		// Finalize the encryption
+		EVP_EncryptFinal_ex(ctx, ciphertext + outl, &outl);
+		ciphertext_len += outl;
+
+		// Get the authentication tag
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AUTH_TAG_LEN, auth_tag);
+
+		// Clean up
+		EVP_CIPHER_CTX_free(ctx);
 	}
 	
-	// Encrypt plaintext
-	EVP_EncryptUpdate(ctx, ciphertext, &outl, plaintext, plaintext_len);
-	ciphertext_len = outl;
-
-	// Finalize the encryption
-	EVP_EncryptFinal_ex(ctx, ciphertext + outl, &outl);
-	ciphertext_len += outl;
-
-	// Get the authentication tag
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AUTH_TAG_LEN, auth_tag);
-
-	// Clean up
-	EVP_CIPHER_CTX_free(ctx);
-	
 	// ===================================
 	
 	// Create the return buffers and object
@@ -150,6 +254,9 @@ NAN_METHOD(gcm::Encrypt) {
 	Local<Object> return_obj = Nan::New<Object>();
 	Nan::Set(return_obj, Nan::New<String>("ciphertext").ToLocalChecked(), ciphertext_buf.ToLocalChecked());
 	Nan::Set(return_obj, Nan::New<String>("auth_tag").ToLocalChecked(), auth_tag_buf.ToLocalChecked());
+	if (randomIv) {
+		Nan::Set(return_obj, Nan::New<String>("iv").ToLocalChecked(), iv_buf);
+	}
 
 	// Return it
 	info.GetReturnValue().Set(return_obj);
@@ -223,37 +330,74 @@ NAN_METHOD(gcm::Decrypt) {
 
 	// Now do the decryption
 
-	// create the context
-	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-	// initialize the decryption operation with the chosen cipher
-	EVP_DecryptInit_ex(ctx, cipher_type, NULL, NULL, NULL);
-
-	// Set the IV length
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv_len, NULL);
-	
-	// Provide key and iv to OpenSSL
-	EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv);
-	
-	int outl; // output length
-	
-	// if we have additional authenticated data, provide it
-	if (hasAuthData) {
-		EVP_DecryptUpdate(ctx, NULL, &outl, aad, aad_len);
+	bool auth_ok;
+	const aead::SoftKey *soft_key = aead::SoftAead::Enabled() && iv_len > 0
+		? aead::SoftAead::CachedKey(key, key_len) : NULL;
+	const aead::Kernel kernel = aead::Tuning::Get(aead::MODE_GCM, ciphertext_len);
+	const aead::AesniKey *small_key = soft_key == NULL && kernel != aead::KERNEL_OPENSSL &&
+		aead::SmallGcm::Accepts(iv_len, ciphertext_len)
+		? aead::Aesni::CachedKey(key, key_len) : NULL;
+	// VAES by default, AES-NI too where the autotuner found it faster
+	const aead::AesniKey *builtin_key = soft_key == NULL && small_key == NULL && kernel != aead::KERNEL_OPENSSL &&
+		aead::WideGcm::Accepts(iv_len) && (aead::WideGcm::Supported() || kernel == aead::KERNEL_BUILTIN)
+		? aead::Aesni::CachedKey(key, key_len) : NULL;
+	if (soft_key != NULL) {
+		// constant-time software AES where OpenSSL would use lookup tables
+		auth_ok = aead::SoftAead::GcmDecrypt(*soft_key, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+			ciphertext, ciphertext_len, plaintext, auth_tag);
+		plaintext_len = ciphertext_len;
+	} else if (small_key != NULL) {
+		// short messages skip the EVP setup
+		auth_ok = aead::SmallGcm::Decrypt(*small_key, iv, hasAuthData ? aad : NULL, aad_len,
+			ciphertext, ciphertext_len, plaintext, auth_tag);
+		plaintext_len = ciphertext_len;
+	} else if (aead::ChunkedWork::ShouldSplit(ciphertext_len) && aead::ParallelGcm::Decrypt(
+		key, key_len, iv, iv_len, hasAuthData ? aad : NULL, aad_len,
+		ciphertext, ciphertext_len, plaintext, auth_tag, AUTH_TAG_LEN, &auth_ok
+	)) {
+		// large messages are split across the crypto thread pool
+		plaintext_len = ciphertext_len;
+	} else if (builtin_key != NULL) {
+		// VAES and VPCLMULQDQ, independent of the OpenSSL build
+		auth_ok = aead::WideGcm::Supported()
+			? aead::WideGcm::Decrypt(*builtin_key, iv, hasAuthData ? aad : NULL, aad_len,
+				ciphertext, ciphertext_len, plaintext, auth_tag)
+			: aead::AesniAead::GcmDecrypt(*builtin_key, iv, hasAuthData ? aad : NULL, aad_len,
+				ciphertext, ciphertext_len, plaintext, auth_tag);
+		plaintext_len = ciphertext_len;
+	} else {
+		// create the context
+		EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+		// initialize the decryption operation with the chosen cipher
+		EVP_DecryptInit_ex(ctx, cipher_type, NULL, NULL, NULL);
+
+		// Set the IV length
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv_len, NULL);
+
+		// Provide key and iv to OpenSSL
+		EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv);
+
+		int outl; // output length
+
+		// if we have additional authenticated data, provide it
+		if (hasAuthData) {
+			EVP_DecryptUpdate(ctx, NULL, &outl, aad, aad_len);
+		}
+
+		// Decrypt ciphertext
+		EVP_DecryptUpdate(ctx, plaintext, &outl, ciphertext, ciphertext_len);
+		plaintext_len = outl;
+
+		// Set the input reference authentication tag
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, AUTH_TAG_LEN, auth_tag);
+
+		// Finalize
+		auth_ok = EVP_DecryptFinal_ex(ctx, plaintext + outl, &outl);
+		plaintext_len += outl;
+
+		// Clean up
+		EVP_CIPHER_CTX_free(ctx);
 	}
-
-	// Decrypt ciphertext
-	EVP_DecryptUpdate(ctx, plaintext, &outl, ciphertext, ciphertext_len);
-	plaintext_len = outl;
-
-	// Set the input reference authentication tag
-	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, AUTH_TAG_LEN, auth_tag);
-
-	// Finalize
-	bool auth_ok = EVP_DecryptFinal_ex(ctx, plaintext + outl, &outl);
-	plaintext_len += outl;
-
-	// Clean up
-	EVP_CIPHER_CTX_free(ctx);
 	
 	// ==================
 
@@ -266,4 +410,267 @@ NAN_METHOD(gcm::Decrypt) {
 
 	// Return it
 	info.GetReturnValue().Set(return_obj);
-}
\ No newline at end of file
+}
+
+// Like gcm.decrypt, but the tag is checked before anything is decrypted.
+// Returns an object containing a "plaintext" buffer, which is null if the
+// tag doesn't match, and an "auth_ok" boolean. A forged message costs only
+// the hash over its AAD and ciphertext, and no plaintext buffer is made
+// for it.
+
+NAN_METHOD(gcm::DecryptVerified) {
+	Nan::HandleScope scope;
+
+	// check arguments
+	if (info.Length() < 5 ||
+		!Buffer::HasInstance(info[0]) || // key
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // ciphertext
+		!(info[3]->IsUndefined() || info[3]->IsNull() || Buffer::HasInstance(info[3])) || // auth_data, optional
+		!Buffer::HasInstance(info[4]) || // auth tag
+		Buffer::Length(info[4]) != AUTH_TAG_LEN
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key (Buffer), iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer, 16 bytes)."
+		);
+		return;
+	}
+
+	const unsigned char *key = (const unsigned char *)Buffer::Data(info[0]);
+	const size_t key_len = Buffer::Length(info[0]);
+	if (key_len != 16 && key_len != 24 && key_len != 32) {
+		Nan::ThrowError("Invalid key length specified. Allowed are 128, 192 and 256 bits.");
+		return;
+	}
+	const unsigned char *iv = (const unsigned char *)Buffer::Data(info[1]);
+	const size_t iv_len = Buffer::Length(info[1]);
+	if (iv_len == 0) {
+		Nan::ThrowError("Invalid IV length specified. The IV must not be empty.");
+		return;
+	}
+	const unsigned char *ciphertext = (const unsigned char *)Buffer::Data(info[2]);
+	const size_t ciphertext_len = Buffer::Length(info[2]);
+	const bool hasAuthData = Buffer::HasInstance(info[3]);
+	const unsigned char *aad = hasAuthData ? (const unsigned char *)Buffer::Data(info[3]) : NULL;
+	const size_t aad_len = hasAuthData ? Buffer::Length(info[3]) : 0;
+	const unsigned char *auth_tag = (const unsigned char *)Buffer::Data(info[4]);
+
+	// ==================
+
+	// Authenticate, then decrypt straight into the returned buffer
+
+	aead::VerifiedGcm gcm(key, key_len, iv, iv_len);
+	const bool auth_ok = gcm.Verify(aad, aad_len, ciphertext, ciphertext_len, auth_tag, AUTH_TAG_LEN);
+	Local<Object> return_obj = Nan::New<Object>();
+	if (auth_ok) {
+		Local<Object> plaintext_buf = Nan::NewBuffer((uint32_t)ciphertext_len).ToLocalChecked();
+		gcm.Decrypt(ciphertext, ciphertext_len, (unsigned char *)Buffer::Data(plaintext_buf));
+		Nan::Set(return_obj, Nan::New<String>("plaintext").ToLocalChecked(), plaintext_buf);
+	} else {
+		Nan::Set(return_obj, Nan::New<String>("plaintext").ToLocalChecked(), Nan::Null());
+	}
+	Nan::Set(return_obj, Nan::New<String>("auth_ok").ToLocalChecked(), Nan::New<Boolean>(auth_ok));
+
+	info.GetReturnValue().Set(return_obj);
+}
+
+// Enables detection of reused IVs in gcm.encrypt, which remembers (roughly)
+// the given number of recent (key, IV) pairs. Reused IVs are counted and,
+// if reject is set, refused. A capacity of 0 disables detection.
+NAN_METHOD(gcm::SetNonceReuseDetection) {
+	if (info.Length() < 1 || !info[0]->IsUint32()) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"capacity (uint32), reject (boolean, optional)."
+		);
+		return;
+	}
+	const uint32_t capacity = Nan::To<uint32_t>(info[0]).FromJust();
+
+	aead::NonceReuseDetector *detector = capacity > 0
+		? new aead::NonceReuseDetector(capacity, Nan::To<bool>(info[1]).FromJust()) : NULL;
+	std::lock_guard<std::mutex> lock(reuse_detector_mutex);
+	aead::NonceReuseDetector *old = reuse_detector.exchange(detector);
+	if (old == NULL) return;
+	ReuseEpoch().Synchronize();
+	delete old;
+}
+
+// Returns how often gcm.encrypt detected a reused IV since detection was enabled.
+NAN_METHOD(gcm::GetNonceReuseCount) {
+	uint64_t hits = 0;
+	{
+		aead::ReaderEpoch::Reader reader(ReuseEpoch());
+		aead::NonceReuseDetector *detector = reuse_detector.load();
+		if (detector != NULL) hits = detector->hits();
+	}
+	info.GetReturnValue().Set(Nan::New<Number>((double)hits));
+}
+
+// Asynchronous variants of encrypt and decrypt, which run on the crypto
+// thread pool and call back with (error, result). The buffers must not be
+// modified until the callback is called. The optional scheduling options
+// { tenant, timeout } select the tenant queue and the deadline of the job.
+
+// Arguments: key (Buffer), iv (Buffer), plaintext (Buffer), auth_data (Buffer | NULL), options (Object, optional), callback (Function)
+NAN_METHOD(gcm::EncryptAsync) {
+	// check arguments
+	const int callback_index = info.Length() - 1;
+	if (info.Length() < 5 || info.Length() > 6 ||
+		!Buffer::HasInstance(info[0]) || // key
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // plaintext
+		!(info[3]->IsUndefined() || info[3]->IsNull() || Buffer::HasInstance(info[3])) || // auth_data, optional
+		!info[callback_index]->IsFunction() // callback
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key (Buffer), iv (Buffer), plaintext (Buffer), auth_data (Buffer | NULL), options (Object, optional), callback (Function)."
+		);
+		return;
+	}
+
+	const unsigned char *key_data = (unsigned char *)Buffer::Data(info[0]);
+	const size_t key_len = Buffer::Length(info[0]);
+	std::shared_ptr<aead::KeyContext> key = aead::KeyContext::Create(aead::MODE_GCM, key_data, key_len);
+	if (!key) {
+		Nan::ThrowError("Invalid key length specified. Allowed are 128, 192 and 256 bits.");
+		return;
+	}
+	if (!aead::KeyContext::ValidParams(aead::MODE_GCM, Buffer::Length(info[1]), AUTH_TAG_LEN)) {
+		Nan::ThrowError("Invalid IV length specified.");
+		return;
+	}
+	aead::ScheduleOptions schedule;
+	if (!async::GetScheduleOptions(callback_index == 5 ? info[4] : Nan::Undefined().As<Value>(), &schedule)) return;
+	if (!CheckNonceReuse(key_data, key_len, (unsigned char *)Buffer::Data(info[1]), Buffer::Length(info[1]))) return;
+
+	async::Submit(
+		new async::EncryptJob(info[callback_index].As<Function>(), key, info[1], info[2], info[3], AUTH_TAG_LEN),
+		schedule
+	);
+}
+
+// Arguments: key (Buffer), iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer, 16 bytes), options (Object, optional), callback (Function)
+NAN_METHOD(gcm::DecryptAsync) {
+	// check arguments
+	const int callback_index = info.Length() - 1;
+	if (info.Length() < 6 || info.Length() > 7 ||
+		!Buffer::HasInstance(info[0]) || // key
+		!Buffer::HasInstance(info[1]) || // iv
+		!Buffer::HasInstance(info[2]) || // ciphertext
+		!(info[3]->IsUndefined() || info[3]->IsNull() || Buffer::HasInstance(info[3])) || // auth_data, optional
+		!Buffer::HasInstance(info[4]) || // auth tag
+		Buffer::Length(info[4]) != AUTH_TAG_LEN ||
+		!info[callback_index]->IsFunction() // callback
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key (Buffer), iv (Buffer), ciphertext (Buffer), auth_data (Buffer | NULL), auth tag (Buffer, 16 bytes), options (Object, optional), callback (Function)."
+		);
+		return;
+	}
+
+	std::shared_ptr<aead::KeyContext> key = aead::KeyContext::Create(
+		aead::MODE_GCM, (unsigned char *)Buffer::Data(info[0]), Buffer::Length(info[0])
+	);
+	if (!key) {
+		Nan::ThrowError("Invalid key length specified. Allowed are 128, 192 and 256 bits.");
+		return;
+	}
+	if (!aead::KeyContext::ValidParams(aead::MODE_GCM, Buffer::Length(info[1]), AUTH_TAG_LEN)) {
+		Nan::ThrowError("Invalid IV length specified.");
+		return;
+	}
+	aead::ScheduleOptions schedule;
+	if (!async::GetScheduleOptions(callback_index == 6 ? info[5] : Nan::Undefined().As<Value>(), &schedule)) return;
+
+	async::Submit(new async::DecryptJob(info[callback_index].As<Function>(), key, info[1], info[2], info[3], info[4]), schedule);
+}
+
+// Runs a batch of operations with one key as a single job on the crypto
+// thread pool and calls back with an array of results, one per operation.
+// Invalid operations fail individually with an Error in their place.
+// Arguments: key (Buffer), operations (Array of [encrypt, iv, data, auth_data, auth tag]), options (Object, optional), callback (Function)
+NAN_METHOD(gcm::BatchAsync) {
+	// check arguments
+	const int callback_index = info.Length() - 1;
+	if (info.Length() < 3 || info.Length() > 4 ||
+		!Buffer::HasInstance(info[0]) || // key
+		!info[1]->IsArray() || // operations
+		!info[callback_index]->IsFunction() // callback
+	) {
+		Nan::ThrowError(
+			"Not enough (or wrong) arguments specified. Required: "
+			"key (Buffer), operations (Array), options (Object, optional), callback (Function)."
+		);
+		return;
+	}
+
+	const unsigned char *key_data = (unsigned char *)Buffer::Data(info[0]);
+	const size_t key_len = Buffer::Length(info[0]);
+	std::shared_ptr<aead::KeyContext> key = aead::KeyContext::Create(aead::MODE_GCM, key_data, key_len);
+	if (!key) {
+		Nan::ThrowError("Invalid key length specified. Allowed are 128, 192 and 256 bits.");
+		return;
+	}
+	aead::ScheduleOptions schedule;
+	if (!async::GetScheduleOptions(callback_index == 3 ? info[2] : Nan::Undefined().As<Value>(), &schedule)) return;
+
+	Local<Array> ops = info[1].As<Array>();
+	async::BatchJob *job = new async::BatchJob(info[callback_index].As<Function>(), key, ops);
+	for (uint32_t i = 0; i < ops->Length(); i++) {
+		async::BatchOp op;
+		if (!async::ReadBatchOp(Nan::Get(ops, i).ToLocalChecked(), &op)) {
+			job->AddError("Each operation must be an array [encrypt, iv, data, auth_data, auth_tag].");
+		} else if (!aead::KeyContext::ValidParams(aead::MODE_GCM, Buffer::Length(op.iv), AUTH_TAG_LEN) ||
+			(!op.encrypt && Buffer::Length(op.auth_tag) != AUTH_TAG_LEN)
+		) {
+			job->AddError("Invalid IV or auth tag length specified.");
+		} else if (!op.encrypt) {
+			job->AddDecrypt(op.iv, op.data, op.aad, op.auth_tag);
+		} else if (NonceReused(key_data, key_len, (unsigned char *)Buffer::Data(op.iv), Buffer::Length(op.iv))) {
+			job->AddError("The IV has been used with this key before.");
+		} else {
+			job->AddEncrypt(op.iv, op.data, op.aad, AUTH_TAG_LEN);
+		}
+	}
+	async::Submit(job, schedule);
+}
+
+// Processes messages below the DispatchEstimator's cutoff inline and returns
+// the result like encrypt; hands larger ones to the crypto thread pool like
+// encryptAsync and returns undefined. index.js delivers inline results
+// asynchronously, so callers can't tell the difference.
+// Arguments: like encryptAsync
+NAN_METHOD(gcm::EncryptAuto) {
+	if (info.Length() >= 4 && Buffer::HasInstance(info[1]) && Buffer::HasInstance(info[2])) {
+		const size_t bytes = Buffer::Length(info[2]) + (Buffer::HasInstance(info[3]) ? Buffer::Length(info[3]) : 0);
+		if (async::ShouldInline(aead::MODE_GCM, bytes)) {
+			const uint64_t start = aead::Scheduler::Now();
+			Encrypt(info);
+			async::RecordInline(aead::MODE_GCM, bytes, aead::Scheduler::Now() - start);
+			return;
+		}
+	}
+	EncryptAsync(info);
+}
+
+// Processes messages below the DispatchEstimator's cutoff inline and returns
+// the result like decrypt; hands larger ones to the crypto thread pool like
+// decryptAsync and returns undefined. index.js delivers inline results
+// asynchronously, so callers can't tell the difference.
+// Arguments: like decryptAsync
+NAN_METHOD(gcm::DecryptAuto) {
+	if (info.Length() >= 4 && Buffer::HasInstance(info[1]) && Buffer::HasInstance(info[2])) {
+		const size_t bytes = Buffer::Length(info[2]) + (Buffer::HasInstance(info[3]) ? Buffer::Length(info[3]) : 0);
+		if (async::ShouldInline(aead::MODE_GCM, bytes)) {
+			const uint64_t start = aead::Scheduler::Now();
+			Decrypt(info);
+			async::RecordInline(aead::MODE_GCM, bytes, aead::Scheduler::Now() - start);
+			return;
+		}
+	}
+	DecryptAsync(info);
+}
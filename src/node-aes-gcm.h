@@ -7,6 +7,19 @@ namespace gcm {
 
     NAN_METHOD(Encrypt);
     NAN_METHOD(Decrypt);
+    NAN_METHOD(DecryptVerified);
+    NAN_METHOD(EncryptAsync);
+    NAN_METHOD(DecryptAsync);
+    NAN_METHOD(BatchAsync);
+    NAN_METHOD(EncryptAuto);
+    NAN_METHOD(DecryptAuto);
+    NAN_METHOD(SetNonceReuseDetection);
+    NAN_METHOD(GetNonceReuseCount);
+
+    // Records the IV in the detector of SetNonceReuseDetection, if enabled.
+    // Returns false after throwing if it was used before and reuse is
+    // rejected.
+    bool CheckNonceReuse(const unsigned char *key, size_t key_len, const unsigned char *iv, size_t iv_len);
 
 }
 
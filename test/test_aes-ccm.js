@@ -1,4 +1,5 @@
 var assert = require('assert');
+var crypto = require('crypto');
 var ccm = require('../').ccm;
 
 var TEST_CASES = [
@@ -92,4 +93,60 @@ for (var i in TEST_CASES) {
 		assert.equal(dres.auth_ok, false);
 	}
 }
+// Short messages of every length, with all nonce and tag lengths,
+// against node's own CCM (which can't encrypt empty messages)
+[16, 24, 32].forEach(function (keyLength) {
+	var key = crypto.randomBytes(keyLength),
+		aad = crypto.randomBytes(keyLength + 3);
+	for (var length = 1; length <= 80; length++) {
+		var iv = crypto.randomBytes(7 + length % 7),
+			tagLength = 4 + 2 * (length % 7),
+			plaintext = crypto.randomBytes(length),
+			withAad = length % 2 === 0,
+			cipher = crypto.createCipheriv('aes-' + keyLength * 8 + '-ccm', key, iv, { authTagLength: tagLength });
+		if (withAad) cipher.setAAD(aad, { plaintextLength: length });
+		var ct = Buffer.concat([cipher.update(plaintext), cipher.final()]),
+			res = ccm.encrypt(key, iv, plaintext, withAad ? aad : null, tagLength);
+		assert.ok(res.ciphertext.equals(ct));
+		assert.ok(res.auth_tag.equals(cipher.getAuthTag()));
+
+		var dres = ccm.decrypt(key, iv, ct, withAad ? aad : null, res.auth_tag);
+		assert.ok(dres.auth_ok);
+		assert.ok(dres.plaintext.equals(plaintext));
+		res.auth_tag[0] ^= 1;
+		assert.equal(ccm.decrypt(key, iv, ct, withAad ? aad : null, res.auth_tag).auth_ok, false);
+	}
+});
+
+// The dedicated entry points, against node's own CCM
+[['aes128_13_8', 13, 8], ['aes128_12_16', 12, 16], ['aes128_12_8', 12, 8]].forEach(function (preset) {
+	var fixed = ccm[preset[0]],
+		key = crypto.randomBytes(16),
+		aad = crypto.randomBytes(20);
+	[1, 15, 16, 17, 64, 100, 1000, 5000].forEach(function (length) {
+		var iv = crypto.randomBytes(preset[1]),
+			plaintext = crypto.randomBytes(length),
+			cipher = crypto.createCipheriv('aes-128-ccm', key, iv, { authTagLength: preset[2] });
+		cipher.setAAD(aad, { plaintextLength: length });
+		var ct = Buffer.concat([cipher.update(plaintext), cipher.final()]),
+			res = fixed.encrypt(key, iv, plaintext, aad);
+		assert.ok(res.ciphertext.equals(ct));
+		assert.ok(res.auth_tag.equals(cipher.getAuthTag()));
+
+		var dres = fixed.decrypt(key, iv, ct, aad, res.auth_tag);
+		assert.ok(dres.auth_ok);
+		assert.ok(dres.plaintext.equals(plaintext));
+		res.auth_tag[0] ^= 1;
+		dres = fixed.decrypt(key, iv, ct, aad, res.auth_tag);
+		assert.equal(dres.auth_ok, false);
+		assert.ok(dres.plaintext.equals(Buffer.alloc(length)));
+	});
+	// the lengths are fixed
+	assert.throws(function () { fixed.encrypt(crypto.randomBytes(32), crypto.randomBytes(preset[1]), Buffer.alloc(1), null); });
+	assert.throws(function () { fixed.encrypt(key, crypto.randomBytes(preset[1] - 1), Buffer.alloc(1), null); });
+	assert.throws(function () { fixed.decrypt(key, crypto.randomBytes(preset[1]), Buffer.alloc(1), null, Buffer.alloc(preset[2] + 2)); });
+});
+// a 13 byte nonce leaves two bytes for the length
+assert.throws(function () { ccm.aes128_13_8.encrypt(crypto.randomBytes(16), crypto.randomBytes(13), Buffer.alloc(65536), null); });
+
 console.log("aes-ccm test completed");
\ No newline at end of file
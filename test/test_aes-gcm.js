@@ -6,6 +6,7 @@
 require('buffertools');
 var fs = require('fs');
 var should = require('should');
+var crypto = require('crypto');
 var gcm = require('../').gcm;
 
 
@@ -439,4 +440,214 @@ describe('node-aes-gcm', function () {
 
     runEncryptDecryptTestCases(false);
   });
+
+  describe('Random IVs', function () {
+    it('should generate and return a fresh IV of the requested length', function () {
+      var key = new Buffer('8888888888888888'),
+          plaintext = new Buffer('random iv'),
+          first = gcm.encrypt(key, 12, plaintext, null),
+          second = gcm.encrypt(key, 12, plaintext, null);
+      first.iv.length.should.equal(12);
+      first.iv.equals(second.iv).should.not.be.ok();
+      gcm.decrypt(key, first.iv, first.ciphertext, null, first.auth_tag)
+        .plaintext.equals(plaintext).should.be.ok();
+    });
+
+    it('should reject short random IVs', function () {
+      (function () {
+        gcm.encrypt(new Buffer('8888888888888888'), 8, new Buffer('x'), null);
+      }).should.throw();
+    });
+  });
+
+  describe('Short messages', function () {
+    it('should match node crypto for every length up to 80 bytes', function () {
+      [16, 24, 32].forEach(function (keyLength) {
+        var key = crypto.randomBytes(keyLength),
+            iv = crypto.randomBytes(12),
+            aad = crypto.randomBytes(keyLength + 3);
+        for (var length = 0; length <= 80; length++) {
+          var plaintext = crypto.randomBytes(length),
+              cipher = crypto.createCipheriv('aes-' + keyLength * 8 + '-gcm', key, iv);
+          if (length % 2 === 0) cipher.setAAD(aad);
+          var ciphertext = Buffer.concat([cipher.update(plaintext), cipher.final()]),
+              result = gcm.encrypt(key, iv, plaintext, length % 2 === 0 ? aad : null);
+          result.ciphertext.equals(ciphertext).should.be.ok();
+          result.auth_tag.equals(cipher.getAuthTag()).should.be.ok();
+          var decrypted = gcm.decrypt(key, iv, ciphertext, length % 2 === 0 ? aad : null, result.auth_tag);
+          decrypted.auth_ok.should.be.ok();
+          decrypted.plaintext.equals(plaintext).should.be.ok();
+          result.auth_tag[length % 16] ^= 1;
+          gcm.decrypt(key, iv, ciphertext, length % 2 === 0 ? aad : null, result.auth_tag)
+            .auth_ok.should.not.be.ok();
+        }
+      });
+    });
+
+    it('should work the same after the key cache was cleared', function () {
+      var key = crypto.randomBytes(16), iv = crypto.randomBytes(12), plaintext = crypto.randomBytes(32);
+      var expected = gcm.encrypt(key, iv, plaintext, null);
+      require('../').clearKeyCache();
+      gcm.encrypt(key, iv, plaintext, null).auth_tag.equals(expected.auth_tag).should.be.ok();
+    });
+  });
+
+  describe('Long messages', function () {
+    it('should match node crypto for random lengths and additional data', function () {
+      for (var i = 0; i < 60; i++) {
+        var keyLength = [16, 24, 32][i % 3],
+            key = crypto.randomBytes(keyLength),
+            iv = crypto.randomBytes(12),
+            // around the 256 byte chunks of the wide kernel, then random
+            length = i < 30 ? 224 + i * 8 : 1 + Math.floor(Math.random() * 100000),
+            plaintext = crypto.randomBytes(length),
+            aad = crypto.randomBytes(Math.floor(Math.random() * 600)),
+            cipher = crypto.createCipheriv('aes-' + keyLength * 8 + '-gcm', key, iv);
+        cipher.setAAD(aad);
+        var ciphertext = Buffer.concat([cipher.update(plaintext), cipher.final()]),
+            result = gcm.encrypt(key, iv, plaintext, aad);
+        result.ciphertext.equals(ciphertext).should.be.ok();
+        result.auth_tag.equals(cipher.getAuthTag()).should.be.ok();
+        var decrypted = gcm.decrypt(key, iv, ciphertext, aad, result.auth_tag);
+        decrypted.auth_ok.should.be.ok();
+        decrypted.plaintext.equals(plaintext).should.be.ok();
+        ciphertext[length >> 1] ^= 1;
+        gcm.decrypt(key, iv, ciphertext, aad, result.auth_tag).auth_ok.should.not.be.ok();
+      }
+    });
+  });
+
+  describe('Verify before decrypt', function () {
+    var aead = require('../');
+
+    function check(keyLength, ivLength, length) {
+      var key = crypto.randomBytes(keyLength),
+          iv = crypto.randomBytes(ivLength),
+          plaintext = crypto.randomBytes(length),
+          aad = crypto.randomBytes(length % 40),
+          result = gcm.encrypt(key, iv, plaintext, aad);
+      var decrypted = gcm.decryptVerified(key, iv, result.ciphertext, aad, result.auth_tag);
+      decrypted.auth_ok.should.be.ok();
+      decrypted.plaintext.equals(plaintext).should.be.ok();
+      // no plaintext for forged messages, whatever was changed
+      result.auth_tag[0] ^= 1;
+      decrypted = gcm.decryptVerified(key, iv, result.ciphertext, aad, result.auth_tag);
+      decrypted.auth_ok.should.not.be.ok();
+      should(decrypted.plaintext).be.null();
+      result.auth_tag[0] ^= 1;
+      gcm.decryptVerified(key, iv, result.ciphertext, badAad, result.auth_tag).auth_ok.should.not.be.ok();
+      if (length > 0) {
+        result.ciphertext[length >> 1] ^= 1;
+        gcm.decryptVerified(key, iv, result.ciphertext, aad, result.auth_tag).auth_ok.should.not.be.ok();
+      }
+    }
+
+    it('should only return authentic plaintexts', function () {
+      [16, 24, 32].forEach(function (keyLength) {
+        [1, 8, 12, 16, 60].forEach(function (ivLength) {
+          [0, 1, 15, 16, 17, 128, 129, 1000, 70000].forEach(function (length) {
+            check(keyLength, ivLength, length);
+          });
+        });
+      });
+    });
+
+    it('should work with software AES', function () {
+      aead.configureSoftwareAes(true);
+      try {
+        [0, 1, 17, 1000].forEach(function (length) {
+          check(16, 12, length);
+          check(32, 16, length);
+        });
+      } finally {
+        aead.configureSoftwareAes();
+      }
+    });
+
+    it('should reject invalid arguments', function () {
+      var key = crypto.randomBytes(16), iv = crypto.randomBytes(12);
+      (function () { gcm.decryptVerified(crypto.randomBytes(20), iv, Buffer.alloc(1), null, Buffer.alloc(16)); }).should.throw();
+      (function () { gcm.decryptVerified(key, Buffer.alloc(0), Buffer.alloc(1), null, Buffer.alloc(16)); }).should.throw();
+      (function () { gcm.decryptVerified(key, iv, Buffer.alloc(1), null, Buffer.alloc(12)); }).should.throw();
+    });
+  });
+
+  describe('Dedicated entry points', function () {
+    [['aes128_12_16', 16], ['aes256_12_16', 32]].forEach(function (preset) {
+      var fixed = gcm[preset[0]];
+
+      it(preset[0] + ' should match node crypto', function () {
+        [0, 1, 16, 64, 65, 127, 128, 129, 1000, 70000].forEach(function (length) {
+          var key = crypto.randomBytes(preset[1]),
+              iv = crypto.randomBytes(12),
+              plaintext = crypto.randomBytes(length),
+              aad = crypto.randomBytes(length % 50),
+              cipher = crypto.createCipheriv('aes-' + preset[1] * 8 + '-gcm', key, iv);
+          cipher.setAAD(aad);
+          var ciphertext = Buffer.concat([cipher.update(plaintext), cipher.final()]),
+              result = fixed.encrypt(key, iv, plaintext, aad);
+          result.ciphertext.equals(ciphertext).should.be.ok();
+          result.auth_tag.equals(cipher.getAuthTag()).should.be.ok();
+          var decrypted = fixed.decrypt(key, iv, ciphertext, aad, result.auth_tag);
+          decrypted.auth_ok.should.be.ok();
+          decrypted.plaintext.equals(plaintext).should.be.ok();
+          result.auth_tag[0] ^= 1;
+          fixed.decrypt(key, iv, ciphertext, aad, result.auth_tag).auth_ok.should.not.be.ok();
+        });
+      });
+
+      it(preset[0] + ' should reject other lengths', function () {
+        var key = crypto.randomBytes(preset[1]), iv = crypto.randomBytes(12);
+        (function () { fixed.encrypt(crypto.randomBytes(24), iv, Buffer.alloc(1), null); }).should.throw();
+        (function () { fixed.encrypt(key, crypto.randomBytes(16), Buffer.alloc(1), null); }).should.throw();
+        (function () { fixed.decrypt(key, iv, Buffer.alloc(1), null, crypto.randomBytes(12)); }).should.throw();
+      });
+    });
+  });
+
+  describe('Nonce reuse detection', function () {
+    var key = new Buffer('8888888888888888'),
+        iv = new Buffer('666666666666'),
+        plaintext = new Buffer('reuse');
+
+    afterEach(function () {
+      gcm.setNonceReuseDetection(0);
+    });
+
+    it('should count reused IVs', function () {
+      gcm.setNonceReuseDetection(1024);
+      gcm.encrypt(key, iv, plaintext, null);
+      gcm.getNonceReuseCount().should.equal(0);
+      gcm.encrypt(key, iv, plaintext, null);
+      gcm.getNonceReuseCount().should.equal(1);
+      // the same IV under another key is fine
+      gcm.encrypt(new Buffer('9999999999999999'), iv, plaintext, null);
+      gcm.getNonceReuseCount().should.equal(1);
+    });
+
+    it('should cover the dedicated entry points', function () {
+      gcm.setNonceReuseDetection(1024, true);
+      gcm.encrypt(key, iv, plaintext, null);
+      (function () { gcm.aes128_12_16.encrypt(key, iv, plaintext, null); }).should.throw();
+      var key256 = Buffer.alloc(32, 7);
+      gcm.aes256_12_16.encrypt(key256, iv, plaintext, null);
+      (function () { gcm.encrypt(key256, iv, plaintext, null); }).should.throw();
+      gcm.getNonceReuseCount().should.equal(2);
+    });
+
+    it('should start afresh when reconfigured', function () {
+      for (var i = 0; i < 100; i++) {
+        gcm.setNonceReuseDetection(1024 + i);
+        gcm.encrypt(key, iv, plaintext, null);
+        gcm.encrypt(key, iv, plaintext, null);
+        gcm.getNonceReuseCount().should.equal(1);
+      }
+    });
+
+    it('should reject reused IVs if requested', function () {
+      gcm.setNonceReuseDetection(1024, true);
+      gcm.encrypt(key, iv, plaintext, null);
+      (function () { gcm.encrypt(key, iv, plaintext, null); }).should.throw();
+    });
+  });
 });
@@ -0,0 +1,709 @@
+// Test module for the asynchronous functions
+// Verifies that jobs on the crypto thread pool match the synchronous functions
+
+var should = require('should');
+var crypto = require('crypto');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+var aead = require('../');
+var gcm = aead.gcm, ccm = aead.ccm, Keyring = aead.Keyring;
+
+
+describe('Async crypto', function () {
+  var key = crypto.randomBytes(16),
+      gcmIv = crypto.randomBytes(12),
+      ccmIv = crypto.randomBytes(13),
+      plaintext = crypto.randomBytes(1000),
+      aad = Buffer.from('additional data'),
+      pool;
+
+  before(function () {
+    pool = aead.configurePool();
+  });
+
+  after(function () {
+    aead.configurePool({ threads: pool.threads, pin: pool.pinned });
+  });
+
+  it('should encrypt and decrypt like gcm.encrypt', function (done) {
+    var expected = gcm.encrypt(key, gcmIv, plaintext, aad);
+    gcm.encryptAsync(key, gcmIv, plaintext, aad, function (err, result) {
+      should(err).be.null();
+      result.ciphertext.equals(expected.ciphertext).should.be.ok();
+      result.auth_tag.equals(expected.auth_tag).should.be.ok();
+      gcm.decryptAsync(key, gcmIv, result.ciphertext, aad, result.auth_tag, function (err, result) {
+        should(err).be.null();
+        result.auth_ok.should.be.ok();
+        result.plaintext.equals(plaintext).should.be.ok();
+        done();
+      });
+    });
+  });
+
+  it('should encrypt and decrypt like ccm.encrypt', function (done) {
+    var expected = ccm.encrypt(key, ccmIv, plaintext, null, 12);
+    ccm.encryptAsync(key, ccmIv, plaintext, null, 12, function (err, result) {
+      should(err).be.null();
+      result.ciphertext.equals(expected.ciphertext).should.be.ok();
+      result.auth_tag.equals(expected.auth_tag).should.be.ok();
+      ccm.decryptAsync(key, ccmIv, result.ciphertext, aad, result.auth_tag, function (err, result) {
+        should(err).be.null();
+        result.auth_ok.should.not.be.ok();
+        done();
+      });
+    });
+  });
+
+  it('should run many jobs on keyring keys', function (done) {
+    var keyring = new Keyring();
+    keyring.set(1, 'gcm', key);
+    var expected = gcm.encrypt(key, gcmIv, plaintext, aad);
+    var remaining = 1000;
+    for (var i = 0; i < 1000; i++) {
+      keyring.encryptAsync(1, gcmIv, plaintext, aad, function (err, result) {
+        should(err).be.null();
+        result.auth_tag.equals(expected.auth_tag).should.be.ok();
+        if (--remaining === 0) done();
+      });
+    }
+  });
+
+  it('should keep inputs whose ArrayBuffer is transferred while queued', function (done) {
+    var MessageChannel;
+    try { MessageChannel = require('worker_threads').MessageChannel; } catch (e) { return this.skip(); }
+    var input = new Uint8Array(new ArrayBuffer(65536));
+    input.set(crypto.randomBytes(input.length));
+    var expected = gcm.encrypt(key, gcmIv, Buffer.from(input), aad);
+    var channel = new MessageChannel();
+    gcm.encryptAsync(key, gcmIv, Buffer.from(input.buffer), aad, function (err, result) {
+      channel.port1.close();
+      should(err).be.null();
+      result.auth_tag.equals(expected.auth_tag).should.be.ok();
+      done();
+    });
+    // detaches the ArrayBuffer
+    channel.port1.postMessage(input.buffer, [input.buffer]);
+    input.byteLength.should.equal(0);
+  });
+
+  it('should validate arguments synchronously', function () {
+    (function () { gcm.encryptAsync(key, gcmIv, plaintext, aad, {}, 'callback'); }).should.throw();
+    (function () { gcm.encryptAsync(Buffer.alloc(5), gcmIv, plaintext, aad, function () {}); }).should.throw();
+    (function () { ccm.encryptAsync(key, ccmIv, plaintext, aad, 5, function () {}); }).should.throw();
+  });
+
+  it('should reconfigure the pool', function (done) {
+    var info = aead.configurePool({ threads: 2, pin: true });
+    info.threads.should.equal(2);
+    gcm.encryptAsync(key, gcmIv, plaintext, aad, function (err) {
+      should(err).be.null();
+      done();
+    });
+  });
+
+  it('should keep the tuning not passed to configurePool', function () {
+    var previous = aead.configureTuning().parallelThreshold;
+    try {
+      aead.configureTuning({ parallelThreshold: 123456 });
+      aead.configurePool({ threads: 2 }).parallelThreshold.should.equal(123456);
+      aead.configureTuning().parallelThreshold.should.equal(123456);
+    } finally {
+      aead.configureTuning({ parallelThreshold: previous });
+    }
+  });
+
+  it('should keep the pool options not passed', function () {
+    var before = aead.configurePool({ threads: 3 });
+    before.threads.should.equal(3);
+    aead.configurePool({ chunkSize: before.chunkSize }).should.eql(before);
+  });
+});
+
+describe('Async scheduling', function () {
+  var key = crypto.randomBytes(32),
+      iv = crypto.randomBytes(12),
+      aad = Buffer.from('additional data'),
+      chunkSize;
+
+  before(function () {
+    chunkSize = aead.configurePool().chunkSize;
+  });
+
+  after(function () {
+    aead.configurePool({ chunkSize: chunkSize });
+  });
+
+  it('should encrypt large messages in slices like gcm.encrypt', function (done) {
+    aead.configurePool({ chunkSize: 4096 }).chunkSize.should.equal(4096);
+    var plaintext = crypto.randomBytes(100000 + 7);
+    var expected = gcm.encrypt(key, iv, plaintext, aad);
+    gcm.encryptAsync(key, iv, plaintext, aad, { tenant: 'backup' }, function (err, result) {
+      should(err).be.null();
+      result.ciphertext.equals(expected.ciphertext).should.be.ok();
+      result.auth_tag.equals(expected.auth_tag).should.be.ok();
+      gcm.decryptAsync(key, iv, result.ciphertext, aad, result.auth_tag, { tenant: 'backup' }, function (err, result) {
+        should(err).be.null();
+        result.auth_ok.should.be.ok();
+        result.plaintext.equals(plaintext).should.be.ok();
+        done();
+      });
+    });
+  });
+
+  it('should drop jobs whose timeout passed', function (done) {
+    gcm.encryptAsync(key, iv, Buffer.alloc(100), aad, { tenant: 'api', timeout: 1e-6 }, function (err) {
+      err.should.be.an.Error();
+      aead.getSchedulerStats().api.dropped.should.be.above(0);
+      done();
+    });
+  });
+
+  it('should report queue wait times per tenant', function (done) {
+    aead.getSchedulerStats(true);
+    var keyring = new Keyring();
+    keyring.set(1, 'ccm', key);
+    keyring.encryptAsync(1, crypto.randomBytes(13), Buffer.alloc(100), null, 8, { tenant: 7 }, function (err, result) {
+      should(err).be.null();
+      result.auth_tag.length.should.equal(8);
+      var stats = aead.getSchedulerStats();
+      stats['7'].jobs.should.equal(1);
+      stats['7'].queued.should.equal(0);
+      stats['7'].waitMax.should.be.aboveOrEqual(stats['7'].waitAvg);
+      done();
+    });
+  });
+
+  it('should forget idle tenants beyond the limit', function (done) {
+    var i = 0;
+    (function next() {
+      if (i === 1500) {
+        Object.keys(aead.getSchedulerStats()).length.should.be.belowOrEqual(1024);
+        return done();
+      }
+      gcm.encryptAsync(key, iv, Buffer.alloc(16), aad, { tenant: 'client-' + i++ }, function (err) {
+        should(err).be.null();
+        next();
+      });
+    })();
+  });
+
+  it('should validate the options', function () {
+    (function () { gcm.encryptAsync(key, iv, Buffer.alloc(1), aad, { timeout: -1 }, function () {}); }).should.throw();
+    (function () { gcm.encryptAsync(key, iv, Buffer.alloc(1), aad, 'tenant', function () {}); }).should.throw();
+    (function () { aead.configurePool({ chunkSize: 16 }); }).should.throw();
+  });
+});
+
+describe('Async batching', function () {
+  var key = crypto.randomBytes(16),
+      aad = Buffer.from('additional data');
+
+  afterEach(function () {
+    aead.configureCoalescing({ window: 0, maxBatch: 1024 });
+  });
+
+  it('should run batches with mixed operations', function (done) {
+    var iv = crypto.randomBytes(12), plaintext = crypto.randomBytes(50);
+    var expected = gcm.encrypt(key, iv, plaintext, aad);
+    gcm.batchAsync(key, [
+      [true, iv, plaintext, aad],
+      [false, iv, expected.ciphertext, aad, expected.auth_tag],
+      [false, iv, expected.ciphertext, null, expected.auth_tag],
+      [true, Buffer.alloc(0), plaintext, aad],
+      'not an operation',
+    ], function (err, results) {
+      should(err).be.null();
+      results.length.should.equal(5);
+      results[0].ciphertext.equals(expected.ciphertext).should.be.ok();
+      results[0].auth_tag.equals(expected.auth_tag).should.be.ok();
+      results[1].auth_ok.should.be.ok();
+      results[1].plaintext.equals(plaintext).should.be.ok();
+      results[2].auth_ok.should.not.be.ok();
+      results[3].should.be.an.Error();
+      results[4].should.be.an.Error();
+      done();
+    });
+  });
+
+  it('should match gcm.encrypt for large batches of short messages', function (done) {
+    var ops = [], expected = [];
+    for (var i = 0; i < 300; i++) {
+      var iv = crypto.randomBytes(i % 5 === 0 ? 16 : 12),
+          plaintext = crypto.randomBytes((i * 7) % 700),
+          opAad = i % 3 === 0 ? null : crypto.randomBytes(i % 40),
+          result = gcm.encrypt(key, iv, plaintext, opAad);
+      expected.push({ plaintext: plaintext, result: result });
+      if (i % 2 === 0) {
+        ops.push([true, iv, plaintext, opAad]);
+      } else {
+        var tag = Buffer.from(result.auth_tag);
+        if (i % 7 === 0) tag[3] ^= 1;
+        ops.push([false, iv, result.ciphertext, opAad, tag]);
+      }
+    }
+    gcm.batchAsync(key, ops, function (err, results) {
+      should(err).be.null();
+      results.forEach(function (result, i) {
+        if (i % 2 === 0) {
+          result.ciphertext.equals(expected[i].result.ciphertext).should.be.ok();
+          result.auth_tag.equals(expected[i].result.auth_tag).should.be.ok();
+        } else {
+          result.auth_ok.should.equal(i % 7 !== 0);
+          if (result.auth_ok) result.plaintext.equals(expected[i].plaintext).should.be.ok();
+        }
+      });
+      done();
+    });
+  });
+
+  it('should match ccm.encrypt for large batches of short messages', function (done) {
+    var ops = [], expected = [];
+    for (var i = 0; i < 300; i++) {
+      var iv = crypto.randomBytes(7 + i % 7),
+          tagLength = 4 + 2 * (i % 7),
+          plaintext = crypto.randomBytes((i * 5) % 400),
+          opAad = i % 3 === 0 ? null : crypto.randomBytes(i % 40),
+          result = ccm.encrypt(key, iv, plaintext, opAad, tagLength);
+      expected.push({ plaintext: plaintext, result: result });
+      if (i % 2 === 0) {
+        ops.push([true, iv, plaintext, opAad, tagLength]);
+      } else {
+        var tag = Buffer.from(result.auth_tag);
+        if (i % 9 === 0) tag[0] ^= 1;
+        ops.push([false, iv, result.ciphertext, opAad, tag]);
+      }
+    }
+    ccm.batchAsync(key, ops, function (err, results) {
+      should(err).be.null();
+      results.forEach(function (result, i) {
+        if (i % 2 === 0) {
+          result.ciphertext.equals(expected[i].result.ciphertext).should.be.ok();
+          result.auth_tag.equals(expected[i].result.auth_tag).should.be.ok();
+        } else {
+          result.auth_ok.should.equal(i % 9 !== 0);
+          if (result.auth_ok) result.plaintext.equals(expected[i].plaintext).should.be.ok();
+        }
+      });
+      done();
+    });
+  });
+
+  it('should return promises without a callback', function () {
+    var iv = crypto.randomBytes(13), plaintext = crypto.randomBytes(50);
+    var expected = ccm.encrypt(key, iv, plaintext, aad, 16);
+    return ccm.encryptAsync(key, iv, plaintext, aad, 16).then(function (result) {
+      result.ciphertext.equals(expected.ciphertext).should.be.ok();
+      return ccm.decryptAsync(key, iv, result.ciphertext, aad, result.auth_tag);
+    }).then(function (result) {
+      result.auth_ok.should.be.ok();
+      result.plaintext.equals(plaintext).should.be.ok();
+    });
+  });
+
+  it('should resolve each of many concurrent calls with its own result', function () {
+    aead.configureCoalescing({ window: 200, maxBatch: 64 });
+    var keyring = new Keyring();
+    keyring.set(3, 'gcm', key);
+    var inputs = [];
+    for (var i = 0; i < 500; i++) inputs.push({ iv: crypto.randomBytes(12), plaintext: crypto.randomBytes(i) });
+    return Promise.all(inputs.map(function (input) {
+      return keyring.encryptAsync(3, input.iv, input.plaintext, aad);
+    })).then(function (results) {
+      results.forEach(function (result, i) {
+        var expected = gcm.encrypt(key, inputs[i].iv, inputs[i].plaintext, aad);
+        result.ciphertext.equals(expected.ciphertext).should.be.ok();
+        result.auth_tag.equals(expected.auth_tag).should.be.ok();
+      });
+    });
+  });
+
+  it('should reject only the failing calls of a batch', function () {
+    var iv = crypto.randomBytes(12);
+    return Promise.all([
+      gcm.encryptAsync(key, iv, Buffer.alloc(10), aad),
+      gcm.encryptAsync(key, Buffer.alloc(0), Buffer.alloc(10), aad).then(function () {
+        throw new Error('should have failed');
+      }, function (err) {
+        err.should.be.an.Error();
+      }),
+    ]);
+  });
+});
+
+describe('Auto dispatch', function () {
+  var key = crypto.randomBytes(16),
+      iv = crypto.randomBytes(12),
+      aad = Buffer.from('additional data');
+
+  it('should deliver inline results asynchronously', function (done) {
+    var plaintext = crypto.randomBytes(16);
+    var expected = gcm.encrypt(key, iv, plaintext, aad);
+    var returned = false;
+    gcm.encryptAuto(key, iv, plaintext, aad, function (err, result) {
+      returned.should.be.ok();
+      should(err).be.null();
+      result.ciphertext.equals(expected.ciphertext).should.be.ok();
+      result.auth_tag.equals(expected.auth_tag).should.be.ok();
+      done();
+    });
+    returned = true;
+  });
+
+  it('should handle messages of any size', function () {
+    var sizes = [0, 100, 10000, 1000000];
+    return Promise.all(sizes.map(function (size) {
+      var plaintext = crypto.randomBytes(size);
+      var ccmIv = crypto.randomBytes(13);
+      var expected = ccm.encrypt(key, ccmIv, plaintext, aad, 16);
+      return ccm.encryptAuto(key, ccmIv, plaintext, aad, 16).then(function (result) {
+        result.ciphertext.equals(expected.ciphertext).should.be.ok();
+        return ccm.decryptAuto(key, ccmIv, result.ciphertext, aad, result.auth_tag);
+      }).then(function (result) {
+        result.auth_ok.should.be.ok();
+        result.plaintext.equals(plaintext).should.be.ok();
+      });
+    }));
+  });
+
+  it('should expose the cost model', function () {
+    var estimates = aead.getDispatchEstimates();
+    estimates.dispatchNs.should.be.above(0);
+    estimates.gcm.cutoff.should.be.a.Number();
+    estimates.ccm.perByteNs.should.be.above(0);
+  });
+
+  it('should reject invalid arguments in promise form', function () {
+    return gcm.encryptAuto(Buffer.alloc(3), iv, Buffer.alloc(10), aad).then(function () {
+      throw new Error('should have failed');
+    }, function (err) {
+      err.should.be.an.Error();
+    });
+  });
+});
+
+describe('Parallel GCM', function () {
+  var key = crypto.randomBytes(32),
+      aad = Buffer.from('additional data');
+
+  var pool;
+
+  before(function () {
+    pool = aead.configurePool();
+  });
+
+  after(function () {
+    aead.configurePool({ threads: pool.threads, parallelThreshold: pool.parallelThreshold });
+  });
+
+  // the reference results are computed with splitting disabled
+  function sequential(fn) {
+    aead.configurePool({ parallelThreshold: 0 });
+    try {
+      return fn();
+    } finally {
+      aead.configurePool({ threads: 4, parallelThreshold: 1 });
+    }
+  }
+
+  it('should produce the same ciphertext and tag as sequential GCM', function () {
+    aead.configurePool({ threads: 4, parallelThreshold: 1 }).parallelThreshold.should.equal(1);
+    [0, 15, 262144, 1000003, 3 << 20].forEach(function (size) {
+      [12, 16].forEach(function (ivLength) {
+        var plaintext = crypto.randomBytes(size);
+        var iv = crypto.randomBytes(ivLength);
+        var expected = sequential(function () { return gcm.encrypt(key, iv, plaintext, aad); });
+        var actual = gcm.encrypt(key, iv, plaintext, aad);
+        actual.ciphertext.equals(expected.ciphertext).should.be.ok();
+        actual.auth_tag.equals(expected.auth_tag).should.be.ok();
+      });
+    });
+  });
+
+  it('should decrypt and authenticate', function () {
+    aead.configurePool({ threads: 4, parallelThreshold: 1 });
+    var plaintext = crypto.randomBytes(2 << 20);
+    var iv = crypto.randomBytes(12);
+    var encrypted = gcm.encrypt(key, iv, plaintext, aad);
+    var result = gcm.decrypt(key, iv, encrypted.ciphertext, aad, encrypted.auth_tag);
+    result.auth_ok.should.be.ok();
+    result.plaintext.equals(plaintext).should.be.ok();
+
+    encrypted.ciphertext[12345] ^= 1;
+    gcm.decrypt(key, iv, encrypted.ciphertext, aad, encrypted.auth_tag).auth_ok.should.not.be.ok();
+  });
+
+  it('should validate the threshold', function () {
+    (function () { aead.configurePool({ parallelThreshold: -1 }); }).should.throw();
+    (function () { aead.configurePool({ parallelThreshold: 'big' }); }).should.throw();
+  });
+});
+
+describe('Parallel CCM', function () {
+  var key = crypto.randomBytes(16),
+      aad = Buffer.from('additional data');
+
+  var pool;
+
+  before(function () {
+    pool = aead.configurePool();
+  });
+
+  after(function () {
+    aead.configurePool({ threads: pool.threads, parallelThreshold: pool.parallelThreshold });
+  });
+
+  // the reference results are computed with splitting disabled
+  function sequential(fn) {
+    aead.configurePool({ parallelThreshold: 0 });
+    try {
+      return fn();
+    } finally {
+      aead.configurePool({ threads: 4, parallelThreshold: 1 });
+    }
+  }
+
+  it('should produce the same ciphertext and tag as sequential CCM', function () {
+    aead.configurePool({ threads: 4, parallelThreshold: 1 });
+    [0, 15, 262144, 1000003, 3 << 20].forEach(function (size) {
+      [[11, 16], [8, 4], [12, 10]].forEach(function (params) {
+        var plaintext = crypto.randomBytes(size);
+        var iv = crypto.randomBytes(params[0]);
+        var expected = sequential(function () { return ccm.encrypt(key, iv, plaintext, aad, params[1]); });
+        var actual = ccm.encrypt(key, iv, plaintext, aad, params[1]);
+        actual.ciphertext.equals(expected.ciphertext).should.be.ok();
+        actual.auth_tag.equals(expected.auth_tag).should.be.ok();
+      });
+    });
+  });
+
+  it('should decrypt and authenticate', function () {
+    aead.configurePool({ threads: 4, parallelThreshold: 1 });
+    var plaintext = crypto.randomBytes(2 << 20);
+    var iv = crypto.randomBytes(12);
+    var encrypted = ccm.encrypt(key, iv, plaintext, aad, 16);
+    var result = ccm.decrypt(key, iv, encrypted.ciphertext, aad, encrypted.auth_tag);
+    result.auth_ok.should.be.ok();
+    result.plaintext.equals(plaintext).should.be.ok();
+
+    encrypted.ciphertext[12345] ^= 1;
+    result = ccm.decrypt(key, iv, encrypted.ciphertext, aad, encrypted.auth_tag);
+    result.auth_ok.should.not.be.ok();
+    result.plaintext.length.should.equal(0);
+  });
+});
+
+describe('Software AES', function () {
+  var aad = Buffer.from('additional data');
+
+  before(function () {
+    aead.configureSoftwareAes(true).should.be.true();
+  });
+
+  after(function () {
+    aead.configureSoftwareAes();
+  });
+
+  function nodeEncrypt(mode, key, iv, plaintext, tagLength) {
+    var cipher = crypto.createCipheriv('aes-' + (key.length * 8) + '-' + mode, key, iv, { authTagLength: tagLength });
+    if (mode === 'ccm') {
+      cipher.setAAD(aad, { plaintextLength: plaintext.length });
+    } else {
+      cipher.setAAD(aad);
+    }
+    var ciphertext = Buffer.concat([cipher.update(plaintext), cipher.final()]);
+    return { ciphertext: ciphertext, auth_tag: cipher.getAuthTag() };
+  }
+
+  it('should match node crypto for gcm', function () {
+    [16, 24, 32].forEach(function (keyLength) {
+      [0, 1, 15, 16, 17, 63, 64, 65, 1000].forEach(function (size) {
+        [12, 16, 8].forEach(function (ivLength) {
+          var key = crypto.randomBytes(keyLength), iv = crypto.randomBytes(ivLength);
+          var plaintext = crypto.randomBytes(size);
+          var expected = nodeEncrypt('gcm', key, iv, plaintext, 16);
+          var actual = gcm.encrypt(key, iv, plaintext, aad);
+          actual.ciphertext.equals(expected.ciphertext).should.be.ok();
+          actual.auth_tag.equals(expected.auth_tag).should.be.ok();
+
+          var result = gcm.decrypt(key, iv, actual.ciphertext, aad, actual.auth_tag);
+          result.auth_ok.should.be.ok();
+          result.plaintext.equals(plaintext).should.be.ok();
+          actual.auth_tag[0] ^= 1;
+          gcm.decrypt(key, iv, actual.ciphertext, aad, actual.auth_tag).auth_ok.should.not.be.ok();
+        });
+      });
+    });
+  });
+
+  it('should match node crypto for ccm', function () {
+    [16, 24, 32].forEach(function (keyLength) {
+      [1, 15, 16, 17, 63, 64, 65, 1000].forEach(function (size) {
+        [[7, 16], [11, 8], [13, 4]].forEach(function (params) {
+          var key = crypto.randomBytes(keyLength), iv = crypto.randomBytes(params[0]);
+          var plaintext = crypto.randomBytes(size);
+          var expected = nodeEncrypt('ccm', key, iv, plaintext, params[1]);
+          var actual = ccm.encrypt(key, iv, plaintext, aad, params[1]);
+          actual.ciphertext.equals(expected.ciphertext).should.be.ok();
+          actual.auth_tag.equals(expected.auth_tag).should.be.ok();
+
+          var result = ccm.decrypt(key, iv, actual.ciphertext, aad, actual.auth_tag);
+          result.auth_ok.should.be.ok();
+          result.plaintext.equals(plaintext).should.be.ok();
+          actual.auth_tag[0] ^= 1;
+          result = ccm.decrypt(key, iv, actual.ciphertext, aad, actual.auth_tag);
+          result.auth_ok.should.not.be.ok();
+          result.plaintext.length.should.equal(0);
+        });
+      });
+    });
+  });
+
+  it('should be used by the async functions', function (done) {
+    var key = crypto.randomBytes(16), iv = crypto.randomBytes(12);
+    var plaintext = crypto.randomBytes(1 << 20);
+    var expected = nodeEncrypt('gcm', key, iv, plaintext, 16);
+    gcm.encryptAsync(key, iv, plaintext, aad, function (err, result) {
+      should(err).be.null();
+      result.ciphertext.equals(expected.ciphertext).should.be.ok();
+      result.auth_tag.equals(expected.auth_tag).should.be.ok();
+      var ops = [[false, iv, result.ciphertext, aad, result.auth_tag], [true, crypto.randomBytes(12), plaintext.slice(0, 64), aad]];
+      gcm.batchAsync(key, ops, function (err, results) {
+        should(err).be.null();
+        results[0].auth_ok.should.be.ok();
+        results[0].plaintext.equals(plaintext).should.be.ok();
+        var tag = nodeEncrypt('gcm', key, ops[1][1], ops[1][2], 16).auth_tag;
+        results[1].auth_tag.equals(tag).should.be.ok();
+        done();
+      });
+    });
+  });
+
+  it('should be switched off on request', function () {
+    aead.configureSoftwareAes(false).should.be.false();
+    aead.configureSoftwareAes(true).should.be.true();
+    (function () { aead.configureSoftwareAes('yes'); }).should.throw();
+  });
+
+  it('should be reported by getCapabilities', function () {
+    var capabilities = aead.getCapabilities();
+    capabilities.softwareAes.should.be.true();
+    ['gcm', 'ccm'].forEach(function (mode) {
+      capabilities.implementations[mode].forEach(function (bucket) {
+        bucket.implementation.should.equal('software');
+        should(bucket.parallel).be.null();
+      });
+    });
+  });
+});
+
+describe('getCapabilities', function () {
+  it('should report the CPU, OpenSSL and implementations', function () {
+    var capabilities = aead.getCapabilities();
+    capabilities.cpu.aesni.should.be.a.Boolean();
+    capabilities.openssl.version.should.match(/SSL/);
+    capabilities.openssl.versionNumber.should.be.above(0);
+    capabilities.openssl.system.should.be.a.Boolean();
+    capabilities.backends.should.containEql('openssl');
+    var buckets = aead.configureTuning().buckets;
+    ['gcm', 'ccm'].forEach(function (mode) {
+      capabilities.implementations[mode].map(function (bucket) {
+        return bucket.maxLength;
+      }).should.eql(buckets);
+      capabilities.implementations[mode].forEach(function (bucket) {
+        bucket.implementation.should.be.a.String();
+      });
+    });
+  });
+
+  it('should report which messages are split across the pool', function () {
+    // software AES never splits messages
+    if (aead.getCapabilities().softwareAes) return this.skip();
+    var saved = aead.configureTuning();
+    try {
+      aead.configureTuning({ parallelThreshold: 100000, kernels: { gcm: ['openssl', 'openssl', 'openssl', 'openssl', 'openssl'] } });
+      var gcm = aead.getCapabilities().implementations.gcm;
+      should(gcm[0].parallel).be.null();
+      should(gcm[2].parallel).be.null();
+      gcm[3].parallel.should.eql({ minLength: 100000, implementation: gcm[3].implementation });
+      gcm[4].parallel.minLength.should.equal(gcm[3].maxLength + 1);
+
+      aead.configureTuning({ parallelThreshold: 0 });
+      aead.getCapabilities().implementations.ccm.forEach(function (bucket) {
+        should(bucket.parallel).be.null();
+      });
+    } finally {
+      aead.configureTuning({ parallelThreshold: saved.parallelThreshold, kernels: saved.kernels });
+    }
+  });
+});
+
+describe('Tuning', function () {
+  var defaults;
+  var file = path.join(os.tmpdir(), 'node-aead-crypto-tuning-' + process.pid + '.json');
+
+  before(function () {
+    defaults = aead.configureTuning();
+  });
+
+  after(function () {
+    aead.configureTuning(defaults);
+    if (fs.existsSync(file)) fs.unlinkSync(file);
+  });
+
+  it('should use the configured kernels', function () {
+    var key = crypto.randomBytes(16), iv = crypto.randomBytes(12), plaintext = crypto.randomBytes(100);
+    var expected = aead.gcm.encrypt(key, iv, plaintext, null);
+    ['builtin', 'openssl', 'auto'].forEach(function (kernel) {
+      var kernels = [kernel, kernel, kernel, kernel, kernel];
+      aead.configureTuning({ kernels: { gcm: kernels, ccm: kernels } }).kernels.gcm.should.eql(kernels);
+      var actual = aead.gcm.encrypt(key, iv, plaintext, null);
+      actual.ciphertext.equals(expected.ciphertext).should.be.ok();
+      actual.auth_tag.equals(expected.auth_tag).should.be.ok();
+      aead.gcm.decrypt(key, iv, actual.ciphertext, null, actual.auth_tag).auth_ok.should.be.ok();
+      var e = aead.ccm.encrypt(key, iv, plaintext, null, 8);
+      aead.ccm.decrypt(key, iv, e.ciphertext, null, e.auth_tag).auth_ok.should.be.ok();
+    });
+  });
+
+  it('should reject invalid settings without changing anything', function () {
+    var before = aead.configureTuning();
+    (function () { aead.configureTuning({ kernels: { gcm: ['fast'] } }); }).should.throw();
+    (function () { aead.configureTuning({ parallelThreshold: 1, parallelChunkSize: 1 }); }).should.throw();
+    aead.configureTuning().should.eql(before);
+  });
+
+  it('should save a profile which loads on the same host', function () {
+    this.timeout(60000);
+    return aead.autotune({ profile: file, timePerCase: 1 }).then(function (profile) {
+      profile.kernels.gcm.length.should.equal(aead.configureTuning().buckets.length);
+      fs.existsSync(file).should.be.ok();
+      aead.loadTuningProfile(file).should.eql(profile);
+      aead.configureTuning().parallelChunkSize.should.equal(profile.parallelChunkSize);
+    });
+  });
+
+  it('should not trip the nonce reuse detection', function () {
+    this.timeout(60000);
+    // large enough that false positives are unlikely
+    aead.gcm.setNonceReuseDetection(1 << 20, true);
+    return aead.autotune({ timePerCase: 1 }).then(function () {
+      aead.gcm.getNonceReuseCount().should.equal(0);
+    }).then(function () {
+      aead.gcm.setNonceReuseDetection(0);
+      aead.configureTuning(defaults);
+    }, function (err) {
+      aead.gcm.setNonceReuseDetection(0);
+      aead.configureTuning(defaults);
+      throw err;
+    });
+  });
+
+  it('should ignore profiles of other hosts', function () {
+    var profile = JSON.parse(JSON.stringify(aead.configureTuning()));
+    profile.version = 1;
+    profile.host = { arch: 'other' };
+    aead.applyTuningProfile(profile).should.be.false();
+    should(aead.loadTuningProfile(file + '.missing')).be.null();
+  });
+});
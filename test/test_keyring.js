@@ -0,0 +1,483 @@
+// Test module for the native keyring
+// Verifies that keyring operations match the stateless gcm/ccm functions
+
+var should = require('should');
+var crypto = require('crypto');
+var path = require('path');
+var aead = require('../');
+var gcm = aead.gcm, ccm = aead.ccm, Keyring = aead.Keyring, ReplayWindow = aead.ReplayWindow;
+
+
+describe('Keyring', function () {
+  var keyring;
+  var gcmKey = crypto.randomBytes(16),
+      ccmKey = crypto.randomBytes(32),
+      gcmIv = crypto.randomBytes(12),
+      ccmIv = crypto.randomBytes(13),
+      plaintext = crypto.randomBytes(100),
+      aad = Buffer.from('additional data');
+
+  beforeEach(function () {
+    keyring = new Keyring();
+    keyring.set(1, 'gcm', gcmKey);
+    keyring.set(2, 'ccm', ccmKey);
+  });
+
+  it('should keep track of its keys', function () {
+    keyring.size.should.equal(2);
+    keyring.has(1).should.be.ok();
+    keyring.has(3).should.not.be.ok();
+    keyring.delete(1).should.be.ok();
+    keyring.delete(1).should.not.be.ok();
+    keyring.has(1).should.not.be.ok();
+    keyring.size.should.equal(1);
+  });
+
+  it('should reject invalid keys and modes', function () {
+    (function () { keyring.set(3, 'gcm', Buffer.alloc(15)); }).should.throw();
+    (function () { keyring.set(3, 'cbc', gcmKey); }).should.throw();
+    (function () { keyring.set(-1, 'gcm', gcmKey); }).should.throw();
+  });
+
+  it('should encrypt like gcm.encrypt', function () {
+    var expected = gcm.encrypt(gcmKey, gcmIv, plaintext, aad);
+    var actual = keyring.encrypt(1, gcmIv, plaintext, aad);
+    actual.ciphertext.equals(expected.ciphertext).should.be.ok();
+    actual.auth_tag.equals(expected.auth_tag).should.be.ok();
+  });
+
+  it('should encrypt like ccm.encrypt', function () {
+    var expected = ccm.encrypt(ccmKey, ccmIv, plaintext, aad, 8);
+    var actual = keyring.encrypt(2, ccmIv, plaintext, aad, 8);
+    actual.ciphertext.equals(expected.ciphertext).should.be.ok();
+    actual.auth_tag.equals(expected.auth_tag).should.be.ok();
+  });
+
+  it('should require the auth tag length for CCM keys', function () {
+    (function () { keyring.encrypt(2, ccmIv, plaintext, aad); }).should.throw();
+  });
+
+  it('should decrypt and authenticate', function () {
+    var encrypted = gcm.encrypt(gcmKey, gcmIv, plaintext, aad);
+    var decrypted = keyring.decrypt(1, gcmIv, encrypted.ciphertext, aad, encrypted.auth_tag);
+    decrypted.plaintext.equals(plaintext).should.be.ok();
+    decrypted.auth_ok.should.be.ok();
+    keyring.decrypt(1, gcmIv, encrypted.ciphertext, null, encrypted.auth_tag)
+      .auth_ok.should.not.be.ok();
+  });
+
+  it('should use the new key after a rotation', function () {
+    var newKey = crypto.randomBytes(16);
+    keyring.set(1, 'gcm', newKey);
+    var expected = gcm.encrypt(newKey, gcmIv, plaintext, aad);
+    keyring.encrypt(1, gcmIv, plaintext, aad).auth_tag
+      .equals(expected.auth_tag).should.be.ok();
+  });
+
+  describe('nonce reuse detection', function () {
+    it('should count reused nonces per key', function () {
+      keyring.set(3, 'gcm', gcmKey, { reuseDetection: true });
+      keyring.encrypt(3, gcmIv, plaintext, aad);
+      keyring.encrypt(3, gcmIv, plaintext, aad);
+      keyring.getNonceReuseCount(3).should.equal(1);
+      (function () { keyring.getNonceReuseCount(1); }).should.throw();
+    });
+
+    it('should reject reused nonces if requested', function () {
+      keyring.set(3, 'ccm', ccmKey, { reuseDetection: { capacity: 100, reject: true } });
+      keyring.encrypt(3, ccmIv, plaintext, aad, 8);
+      (function () { keyring.encrypt(3, ccmIv, plaintext, aad, 8); }).should.throw();
+    });
+
+    it('should not record nonces of invalid calls', function () {
+      keyring.set(3, 'ccm', ccmKey, { reuseDetection: { reject: true } });
+      (function () { keyring.encrypt(3, ccmIv, plaintext, aad, 5); }).should.throw();
+      (function () { keyring.encrypt(3, ccmIv, Buffer.alloc(65536), aad, 8); }).should.throw();
+      keyring.encrypt(3, ccmIv, plaintext, aad, 8);
+      keyring.getNonceReuseCount(3).should.equal(0);
+    });
+
+    it('should check sealed frames', function () {
+      keyring.set(3, 'gcm', gcmKey, { nonce: 'random', reuseDetection: { reject: true } });
+      for (var i = 0; i < 100; i++) keyring.seal(3, plaintext, aad);
+      keyring.getNonceReuseCount(3).should.equal(0);
+    });
+
+    it('should rarely flag distinct nonces', function () {
+      keyring.set(3, 'gcm', gcmKey, { reuseDetection: { capacity: 2048 } });
+      var iv = Buffer.alloc(12);
+      for (var i = 0; i < 4096; i++) {
+        iv.writeUInt32BE(i, 8);
+        keyring.encrypt(3, iv, plaintext.slice(0, 16), null);
+      }
+      keyring.getNonceReuseCount(3).should.be.below(20);
+    });
+  });
+
+  describe('usage limits', function () {
+    // the counters are BigInts where supported
+    function usage(keyId) {
+      var counters = keyring.usage(keyId);
+      return { messages: String(counters.messages), bytes: String(counters.bytes) };
+    }
+
+    it('should count messages and bytes', function () {
+      keyring.encrypt(1, gcmIv, plaintext, aad);
+      keyring.encrypt(1, gcmIv, plaintext, null);
+      usage(1).should.eql({ messages: '2', bytes: String(2 * plaintext.length + aad.length) });
+      usage(2).should.eql({ messages: '0', bytes: '0' });
+    });
+
+    it('should not count invalid calls', function () {
+      var events = [];
+      keyring.on('rotate', function (keyId) { events.push(keyId); });
+      keyring.set(3, 'ccm', ccmKey, { limits: { softMessages: 1 } });
+      (function () { keyring.encrypt(3, ccmIv, plaintext, aad, 5); }).should.throw();
+      usage(3).should.eql({ messages: '0', bytes: '0' });
+      events.should.eql([]);
+      keyring.encrypt(3, ccmIv, plaintext, aad, 8);
+      events.should.eql([3]);
+    });
+
+    it('should emit a rotate event at the soft limit', function () {
+      var events = [];
+      keyring.on('rotate', function (keyId, usage) { events.push([keyId, String(usage.messages)]); });
+      keyring.set(3, 'gcm', gcmKey, { nonce: 'random', limits: { softMessages: 2 } });
+      for (var i = 0; i < 4; i++) keyring.seal(3, plaintext, aad);
+      events.should.eql([[3, '2']]);
+    });
+
+    it('should refuse to encrypt beyond the hard limit', function () {
+      keyring.set(3, 'ccm', ccmKey, { limits: { hardBytes: 250 } });
+      keyring.encrypt(3, ccmIv, plaintext, null, 8);
+      keyring.encrypt(3, ccmIv, plaintext, null, 8);
+      (function () { keyring.encrypt(3, ccmIv, plaintext, null, 8); }).should.throw();
+      usage(3).bytes.should.equal('200');
+      // decryption is not limited
+      var e = ccm.encrypt(ccmKey, ccmIv, plaintext, null, 8);
+      keyring.decrypt(3, ccmIv, e.ciphertext, null, e.auth_tag).auth_ok.should.be.ok();
+    });
+
+    it('should reject invalid limits', function () {
+      (function () { keyring.set(3, 'gcm', gcmKey, { limits: { hardMessages: -1 } }); }).should.throw();
+      (function () { keyring.set(3, 'gcm', gcmKey, { limits: 5 }); }).should.throw();
+    });
+  });
+
+  describe('backends', function () {
+    it('should list the compiled-in backends', function () {
+      aead.getBackends().should.containEql('openssl');
+      aead.getBackends().should.containEql('builtin');
+    });
+
+    aead.getBackends().forEach(function (backend) {
+      it('should encrypt and decrypt with ' + backend, function () {
+        var key = crypto.randomBytes(32);
+        keyring.set(3, 'gcm', key, { backend: backend });
+        var expected = gcm.encrypt(key, gcmIv, plaintext, aad);
+        var actual = keyring.encrypt(3, gcmIv, plaintext, aad);
+        actual.ciphertext.equals(expected.ciphertext).should.be.ok();
+        actual.auth_tag.equals(expected.auth_tag).should.be.ok();
+        keyring.decrypt(3, gcmIv, actual.ciphertext, aad, actual.auth_tag).plaintext.equals(plaintext).should.be.ok();
+
+        // a forged tag yields either the decryption or zeros, never stale memory
+        var forged = Buffer.from(actual.auth_tag);
+        forged[0] ^= 1;
+        var result = keyring.decrypt(3, gcmIv, actual.ciphertext, aad, forged);
+        result.auth_ok.should.be.false();
+        (result.plaintext.equals(plaintext) || result.plaintext.equals(Buffer.alloc(plaintext.length))).should.be.ok();
+
+        // libsodium has no CCM; OpenSSL steps in
+        if (backend === 'libsodium') return;
+        keyring.set(4, 'ccm', ccmKey, { backend: backend });
+        expected = ccm.encrypt(ccmKey, ccmIv, plaintext, aad, 8);
+        actual = keyring.encrypt(4, ccmIv, plaintext, aad, 8);
+        actual.ciphertext.equals(expected.ciphertext).should.be.ok();
+        actual.auth_tag.equals(expected.auth_tag).should.be.ok();
+        keyring.decrypt(4, ccmIv, actual.ciphertext, aad, actual.auth_tag).auth_ok.should.be.ok();
+      });
+    });
+
+    it('should reject unknown backends', function () {
+      (function () { keyring.set(3, 'gcm', gcmKey, { backend: 'none' }); }).should.throw();
+      (function () { keyring.set(3, 'gcm', gcmKey, { backend: 1 }); }).should.throw();
+    });
+  });
+
+  describe('decryptBatch', function () {
+    it('should decrypt frames for different keys', function () {
+      var e1 = gcm.encrypt(gcmKey, gcmIv, plaintext, aad);
+      var e2 = ccm.encrypt(ccmKey, ccmIv, plaintext, null, 8);
+      var results = keyring.decryptBatch([
+        [1, gcmIv, e1.ciphertext, aad, e1.auth_tag],
+        [2, ccmIv, e2.ciphertext, null, e2.auth_tag],
+        [1, gcmIv, e1.ciphertext, null, e1.auth_tag],
+        [7, gcmIv, e1.ciphertext, aad, e1.auth_tag],
+      ]);
+      results.should.have.length(4);
+      results[0].auth_ok.should.be.ok();
+      results[0].plaintext.equals(plaintext).should.be.ok();
+      results[1].auth_ok.should.be.ok();
+      results[1].plaintext.equals(plaintext).should.be.ok();
+      results[2].auth_ok.should.not.be.ok();
+      results[3].auth_ok.should.not.be.ok();
+      should(results[3].plaintext).be.null();
+    });
+
+    it('should handle many keys', function () {
+      var frames = [], keys = [];
+      for (var i = 0; i < 1000; i++) {
+        keys.push(crypto.randomBytes(16));
+        keyring.set(1000 + i, 'gcm', keys[i]);
+      }
+      for (i = 0; i < 1000; i++) {
+        var e = gcm.encrypt(keys[i], gcmIv, plaintext, aad);
+        frames.push([1000 + i, gcmIv, e.ciphertext, aad, e.auth_tag]);
+      }
+      keyring.decryptBatch(frames).forEach(function (result) {
+        result.auth_ok.should.be.ok();
+        result.plaintext.equals(plaintext).should.be.ok();
+      });
+    });
+
+    it('should reject malformed frames', function () {
+      (function () { keyring.decryptBatch([[1, gcmIv]]); }).should.throw();
+      (function () { keyring.decryptBatch('nope'); }).should.throw();
+      (function () { keyring.decryptBatch([], {}); }).should.throw();
+    });
+
+    it('should skip replayed frames', function () {
+      var window = new ReplayWindow(64);
+      var e = gcm.encrypt(gcmKey, gcmIv, plaintext, aad);
+      var results = keyring.decryptBatch([
+        [1, gcmIv, e.ciphertext, aad, e.auth_tag, 100],
+        [1, gcmIv, e.ciphertext, aad, e.auth_tag, 100],
+        [1, gcmIv, e.ciphertext, null, e.auth_tag, 101],
+        [1, gcmIv, e.ciphertext, aad, e.auth_tag, 101],
+        [1, gcmIv, e.ciphertext, aad, e.auth_tag, 20],
+      ], window);
+      results[0].auth_ok.should.be.ok();
+      results[1].replayed.should.be.ok();
+      should(results[1].plaintext).be.null();
+      // failed authentication must not advance the window
+      results[2].auth_ok.should.not.be.ok();
+      should(results[2].replayed).be.undefined();
+      results[3].auth_ok.should.be.ok();
+      results[4].replayed.should.be.ok();
+      String(window.highest).should.equal('101');
+    });
+
+    it('should require sequence numbers with a replay window', function () {
+      var e = gcm.encrypt(gcmKey, gcmIv, plaintext, aad);
+      (function () {
+        keyring.decryptBatch([[1, gcmIv, e.ciphertext, aad, e.auth_tag]], new ReplayWindow());
+      }).should.throw();
+    });
+  });
+
+  describe('ReplayWindow', function () {
+    it('should track sequence numbers within the window', function () {
+      var window = new ReplayWindow(128);
+      window.size.should.equal(128);
+      window.check(5).should.be.ok();
+      window.update(5);
+      window.check(5).should.not.be.ok();
+      window.check(4).should.be.ok();
+      window.update(1000);
+      window.check(1000 - 128).should.not.be.ok();
+      window.check(1000 - 127).should.be.ok();
+      window.check(1001).should.be.ok();
+    });
+
+    it('should round sizes up to multiples of 64', function () {
+      new ReplayWindow(100).size.should.equal(128);
+    });
+
+    it('should reject invalid sizes', function () {
+      (function () { new ReplayWindow(32); }).should.throw();
+      (function () { new ReplayWindow(8192); }).should.throw();
+    });
+  });
+
+  describe('seal/open', function () {
+    var fixed = Buffer.from('01020304', 'hex');
+
+    it('should prepend sequential nonces', function () {
+      keyring.set(3, 'gcm', gcmKey, { fixedField: fixed, counter: 5 });
+      var frame = keyring.seal(3, plaintext, aad);
+      frame.length.should.equal(12 + plaintext.length + 16);
+      frame.slice(0, 12).toString('hex').should.equal('010203040000000000000005');
+      keyring.seal(3, plaintext, aad).slice(0, 12).toString('hex')
+        .should.equal('010203040000000000000006');
+      String(keyring.getNonceCounter(3)).should.equal('7');
+
+      var expected = gcm.encrypt(gcmKey, frame.slice(0, 12), plaintext, aad);
+      frame.slice(12, 12 + plaintext.length).equals(expected.ciphertext).should.be.ok();
+      frame.slice(12 + plaintext.length).equals(expected.auth_tag).should.be.ok();
+    });
+
+    it('should open sealed frames', function () {
+      keyring.set(4, 'ccm', ccmKey, { fixedField: Buffer.from('0102030405', 'hex') });
+      var frame = keyring.seal(4, plaintext, aad, 8);
+      frame.length.should.equal(13 + plaintext.length + 8);
+      var opened = keyring.open(4, frame, aad, 8);
+      opened.auth_ok.should.be.ok();
+      opened.plaintext.equals(plaintext).should.be.ok();
+      frame[20] ^= 1;
+      keyring.open(4, frame, aad, 8).auth_ok.should.not.be.ok();
+    });
+
+    it('should refuse to wrap the counter', function () {
+      if (typeof BigInt === 'undefined') this.skip();
+      keyring.set(3, 'gcm', gcmKey, { fixedField: fixed, counter: BigInt('18446744073709551614') });
+      keyring.seal(3, plaintext, aad);
+      (function () { keyring.seal(3, plaintext, aad); }).should.throw();
+    });
+
+    it('should prepend random nonces', function () {
+      keyring.set(3, 'gcm', gcmKey, { nonce: 'random' });
+      keyring.set(4, 'ccm', ccmKey, { nonce: 'random', nonceLength: 11 });
+      var first = keyring.seal(3, plaintext, aad),
+          second = keyring.seal(3, plaintext, aad);
+      first.length.should.equal(12 + plaintext.length + 16);
+      first.slice(0, 12).equals(second.slice(0, 12)).should.not.be.ok();
+      keyring.open(3, first, aad).plaintext.equals(plaintext).should.be.ok();
+
+      var frame = keyring.seal(4, plaintext, aad, 8);
+      frame.length.should.equal(11 + plaintext.length + 8);
+      keyring.open(4, frame, aad, 8).auth_ok.should.be.ok();
+      (function () { keyring.getNonceCounter(3); }).should.throw();
+    });
+
+    it('should reject conflicting nonce options', function () {
+      (function () { keyring.set(3, 'gcm', gcmKey, { nonce: 'random', fixedField: fixed }); }).should.throw();
+      (function () { keyring.set(3, 'gcm', gcmKey, { nonce: 'random', nonceLength: 8 }); }).should.throw();
+      (function () { keyring.set(3, 'gcm', gcmKey, { fixedField: fixed, nonceLength: 12 }); }).should.throw();
+      (function () { keyring.set(3, 'gcm', gcmKey, { nonce: 'sometimes' }); }).should.throw();
+    });
+
+    it('should reject keys without nonce configuration', function () {
+      (function () { keyring.seal(1, plaintext, aad); }).should.throw();
+      (function () { keyring.set(3, 'ccm', ccmKey, { fixedField: Buffer.alloc(6) }); }).should.throw();
+    });
+  });
+
+  describe('trialDecrypt', function () {
+    function candidates(count, length) {
+      var keys = [];
+      for (var i = 0; i < count; i++) keys.push(crypto.randomBytes(length || [16, 24, 32][i % 3]));
+      return keys;
+    }
+
+    it('should find the matching key among raw GCM keys', function () {
+      [1, 4, 5, 50].forEach(function (count) {
+        var keys = candidates(count), target = count - 1 - (count >> 1),
+            result = gcm.encrypt(keys[target], gcmIv, plaintext, aad),
+            frame = [gcmIv, result.ciphertext, aad, result.auth_tag];
+        var found = aead.trialDecrypt(frame, keys);
+        found.index.should.equal(target);
+        found.auth_ok.should.be.ok();
+        found.plaintext.equals(plaintext).should.be.ok();
+      });
+    });
+
+    it('should find the matching key among raw CCM keys', function () {
+      var keys = candidates(7),
+          result = ccm.encrypt(keys[3], ccmIv, plaintext, aad, 8),
+          found = aead.trialDecrypt([ccmIv, result.ciphertext, aad, result.auth_tag], keys, { mode: 'ccm' });
+      found.index.should.equal(3);
+      found.plaintext.equals(plaintext).should.be.ok();
+    });
+
+    it('should return no plaintext if no key matches', function () {
+      var keys = candidates(9),
+          result = gcm.encrypt(crypto.randomBytes(16), gcmIv, plaintext, null),
+          found = aead.trialDecrypt([gcmIv, result.ciphertext, null, result.auth_tag], keys);
+      found.should.eql({ index: -1, plaintext: null, auth_ok: false });
+      aead.trialDecrypt([gcmIv, result.ciphertext, null, result.auth_tag], []).index.should.equal(-1);
+    });
+
+    it('should try keyring keys by ID in their own modes', function () {
+      keyring.set(10, 'gcm', crypto.randomBytes(16));
+      keyring.set(11, 'ccm', ccmKey);
+      keyring.set(12, 'gcm', gcmKey);
+      var gcmResult = gcm.encrypt(gcmKey, gcmIv, plaintext, aad),
+          ccmResult = ccm.encrypt(ccmKey, ccmIv, plaintext, aad, 16);
+      // 99 is unknown and skipped
+      var found = aead.trialDecrypt([gcmIv, gcmResult.ciphertext, aad, gcmResult.auth_tag], keyring, { keyIds: [99, 10, 11, 12] });
+      found.index.should.equal(3);
+      found.plaintext.equals(plaintext).should.be.ok();
+      found = aead.trialDecrypt([ccmIv, ccmResult.ciphertext, aad, ccmResult.auth_tag], keyring, { keyIds: [10, 11, 12] });
+      found.index.should.equal(1);
+      found.plaintext.equals(plaintext).should.be.ok();
+    });
+
+    it('should split many candidates across the thread pool', function () {
+      var previous = aead.configureTuning().parallelThreshold;
+      aead.configureTuning({ parallelThreshold: 1 });
+      try {
+        var keys = candidates(400, 16),
+            result = gcm.encrypt(keys[377], gcmIv, plaintext, aad);
+        aead.trialDecrypt([gcmIv, result.ciphertext, aad, result.auth_tag], keys).index.should.equal(377);
+      } finally {
+        aead.configureTuning({ parallelThreshold: previous });
+      }
+    });
+
+    it('should reject invalid arguments', function () {
+      var result = gcm.encrypt(gcmKey, gcmIv, plaintext, aad),
+          frame = [gcmIv, result.ciphertext, aad, result.auth_tag];
+      (function () { aead.trialDecrypt([gcmIv, result.ciphertext], [gcmKey]); }).should.throw();
+      (function () { aead.trialDecrypt(frame, [gcmKey, 'key']); }).should.throw();
+      (function () { aead.trialDecrypt(frame, [crypto.randomBytes(20)]); }).should.throw();
+      (function () { aead.trialDecrypt(frame, [gcmKey], { mode: 'ocb' }); }).should.throw();
+      (function () { aead.trialDecrypt(frame, keyring); }).should.throw();
+    });
+  });
+
+  describe('share', function () {
+    var worker_threads;
+    try {
+      worker_threads = require('worker_threads');
+    } catch (e) { /* not available */ }
+    var canShare = !!worker_threads &&
+      parseInt(process.versions.node.split('.')[0], 10) >= 14;
+
+    (canShare ? it : it.skip)('should use the same keys in a worker thread', function (done) {
+      var worker = new worker_threads.Worker(
+        'var wt = require("worker_threads");' +
+        'var Keyring = require(wt.workerData.module).Keyring;' +
+        'var keyring = new Keyring(wt.workerData.shared);' +
+        'wt.parentPort.postMessage(keyring.encrypt(1, wt.workerData.iv, wt.workerData.plaintext, null));',
+        {
+          eval: true,
+          workerData: {
+            module: path.join(__dirname, '..'),
+            shared: keyring.share(),
+            iv: gcmIv,
+            plaintext: plaintext,
+          },
+        }
+      );
+      worker.on('error', done);
+      worker.on('message', function (result) {
+        var expected = gcm.encrypt(gcmKey, gcmIv, plaintext, null);
+        Buffer.from(result.auth_tag).equals(expected.auth_tag).should.be.ok();
+        Buffer.from(result.ciphertext).equals(expected.ciphertext).should.be.ok();
+        done();
+      });
+    });
+
+    (canShare ? it : it.skip)('should see keys added after sharing', function () {
+      var other = new Keyring(keyring.share());
+      keyring.set(5, 'gcm', gcmKey);
+      other.has(5).should.be.ok();
+      other.delete(5);
+      keyring.has(5).should.not.be.ok();
+    });
+
+    (canShare ? it : it.skip)('should reject foreign SharedArrayBuffers', function () {
+      (function () { new Keyring(new SharedArrayBuffer(8)); }).should.throw();
+    });
+  });
+});
@@ -0,0 +1,143 @@
+// Test module for the shared-memory crypto rings
+// Verifies that operations submitted through the rings match the keyring
+
+var should = require('should');
+var crypto = require('crypto');
+var aead = require('../');
+var gcm = aead.gcm, Keyring = aead.Keyring, CryptoRing = aead.CryptoRing;
+
+var canShare = parseInt(process.versions.node.split('.')[0], 10) >= 14;
+
+describe('CryptoRing', function () {
+  var keyring, ring;
+  var gcmKey = crypto.randomBytes(16),
+      ccmKey = crypto.randomBytes(32),
+      gcmIv = crypto.randomBytes(12),
+      ccmIv = crypto.randomBytes(13),
+      plaintext = crypto.randomBytes(100),
+      aad = Buffer.from('additional data');
+
+  // Data region layout used by the tests
+  var IV = 0, AAD = 16, INPUT = 64, OUTPUT = 1024, TAG = 2048;
+
+  function reapAll(count) {
+    var results = [];
+    while (results.length < count) {
+      ring.wait(1000).should.be.ok();
+      ring.reap(function (userData, status) {
+        results.push({ userData: userData, status: status });
+      });
+    }
+    return results;
+  }
+
+  beforeEach(function () {
+    if (!canShare) return;
+    keyring = new Keyring();
+    keyring.set(1, 'gcm', gcmKey);
+    keyring.set(2, 'ccm', ccmKey);
+    ring = new CryptoRing(keyring, { entries: 8, dataSize: 4096 });
+    gcmIv.copy(ring.data, IV);
+    aad.copy(ring.data, AAD);
+    plaintext.copy(ring.data, INPUT);
+  });
+
+  afterEach(function () {
+    if (ring) ring.close();
+    ring = undefined;
+  });
+
+  (canShare ? it : it.skip)('should encrypt like the keyring', function () {
+    ring.submit(CryptoRing.ENCRYPT, 1, 42, IV, 12, INPUT, plaintext.length, AAD, aad.length, OUTPUT, TAG, 16)
+      .should.be.ok();
+    var results = reapAll(1);
+    results[0].should.eql({ userData: 42, status: CryptoRing.OK });
+
+    var expected = keyring.encrypt(1, gcmIv, plaintext, aad);
+    ring.data.slice(OUTPUT, OUTPUT + plaintext.length).equals(expected.ciphertext).should.be.ok();
+    ring.data.slice(TAG, TAG + 16).equals(expected.auth_tag).should.be.ok();
+  });
+
+  (canShare ? it : it.skip)('should decrypt in place and report auth failures', function () {
+    var encrypted = gcm.encrypt(gcmKey, gcmIv, plaintext, aad);
+    encrypted.ciphertext.copy(ring.data, INPUT);
+    encrypted.auth_tag.copy(ring.data, TAG);
+    ring.submit(CryptoRing.DECRYPT, 1, 1, IV, 12, INPUT, plaintext.length, AAD, aad.length, INPUT, TAG, 16);
+    reapAll(1)[0].status.should.equal(CryptoRing.OK);
+    ring.data.slice(INPUT, INPUT + plaintext.length).equals(plaintext).should.be.ok();
+
+    // now the input is the plaintext, so authentication fails
+    ring.submit(CryptoRing.DECRYPT, 1, 2, IV, 12, INPUT, plaintext.length, AAD, aad.length, OUTPUT, TAG, 16);
+    reapAll(1)[0].status.should.equal(CryptoRing.AUTH_FAILED);
+    ring.data.slice(OUTPUT, OUTPUT + plaintext.length).equals(Buffer.alloc(plaintext.length)).should.be.ok();
+  });
+
+  (canShare ? it : it.skip)('should process CCM keys', function () {
+    ccmIv.copy(ring.data, IV);
+    ring.submit(CryptoRing.ENCRYPT, 2, 7, IV, 13, INPUT, plaintext.length, AAD, aad.length, OUTPUT, TAG, 8);
+    reapAll(1)[0].status.should.equal(CryptoRing.OK);
+    var expected = keyring.encrypt(2, ccmIv, plaintext, aad, 8);
+    ring.data.slice(OUTPUT, OUTPUT + plaintext.length).equals(expected.ciphertext).should.be.ok();
+    ring.data.slice(TAG, TAG + 8).equals(expected.auth_tag).should.be.ok();
+  });
+
+  (canShare ? it : it.skip)('should report invalid requests in the completion ring', function () {
+    ring.submit(CryptoRing.ENCRYPT, 3, 1, IV, 12, INPUT, 16, AAD, 0, OUTPUT, TAG, 16);
+    ring.submit(CryptoRing.ENCRYPT, 1, 2, IV, 12, 4000, 200, AAD, 0, OUTPUT, TAG, 16);
+    ring.submit(CryptoRing.ENCRYPT, 2, 3, IV, 12, INPUT, 16, AAD, 0, OUTPUT, TAG, 5);
+    ring.submit(CryptoRing.ENCRYPT, 1, 4, IV, 12, INPUT, 100, AAD, 0, INPUT + 1, TAG, 16);
+    ring.submit(7, 1, 5, IV, 12, INPUT, 16, AAD, 0, OUTPUT, TAG, 16);
+    var statuses = reapAll(5).map(function (result) { return result.status; });
+    statuses.should.eql([
+      CryptoRing.NO_KEY, CryptoRing.INVALID, CryptoRing.BAD_PARAMS, CryptoRing.INVALID, CryptoRing.INVALID,
+    ]);
+  });
+
+  (canShare ? it : it.skip)('should keep going when the rings wrap around', function () {
+    var submitted = 0, completed = 0;
+    while (completed < 100) {
+      while (submitted < 100 &&
+        ring.submit(CryptoRing.ENCRYPT, 1, submitted, IV, 12, INPUT, 16, AAD, 0, OUTPUT, TAG, 16)
+      ) {
+        submitted++;
+      }
+      ring.wait(1000).should.be.ok();
+      ring.reap(function (userData, status) {
+        userData.should.equal(completed++);
+        status.should.equal(CryptoRing.OK);
+      });
+    }
+  });
+
+  (canShare ? it : it.skip)('should emit rotate for keys reaching a soft limit', function (done) {
+    keyring.set(3, 'gcm', gcmKey, { limits: { softMessages: 1 } });
+    keyring.once('rotate', function (keyId, usage) {
+      keyId.should.equal(3);
+      String(usage.messages).should.equal('1');
+      done();
+    });
+    ring.submit(CryptoRing.ENCRYPT, 3, 1, IV, 12, INPUT, 16, AAD, 0, OUTPUT, TAG, 16).should.be.ok();
+    reapAll(1)[0].status.should.equal(CryptoRing.OK);
+  });
+
+  (canShare ? it : it.skip)('should wake up a sleeping poller', function (done) {
+    ring.close();
+    ring = new CryptoRing(keyring, { entries: 8, dataSize: 4096, idle: 0 });
+    gcmIv.copy(ring.data, IV);
+    setTimeout(function () {
+      ring.submit(CryptoRing.ENCRYPT, 1, 9, IV, 12, INPUT, 16, AAD, 0, OUTPUT, TAG, 16);
+      reapAll(1)[0].should.eql({ userData: 9, status: CryptoRing.OK });
+      done();
+    }, 20);
+  });
+
+  (canShare ? it : it.skip)('should reject invalid arguments', function () {
+    (function () { new CryptoRing({}); }).should.throw();
+    (function () { new CryptoRing(keyring, { entries: 6 }); }).should.throw();
+    (function () { new CryptoRing(keyring, { entries: 1 << 20 }); }).should.throw();
+  });
+
+  (canShare ? it.skip : it)('should require Node.js 14', function () {
+    (function () { new CryptoRing(new Keyring()); }).should.throw();
+  });
+});